@@ -150,3 +150,10 @@ decode_get()
     if (q_str)
 	url_decode(CGIParameterHandler(), CStringItor(q_str), CStringItor());
 }
+
+void
+decode_string(const string & s)
+{
+    cgi_params.clear();
+    url_decode(CGIParameterHandler(), CStringItor(s.c_str()), CStringItor());
+}
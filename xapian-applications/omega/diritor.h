@@ -167,6 +167,11 @@ class DirectoryIterator {
 	return statbuf.st_mtime;
     }
 
+    ino_t get_inode() {
+	ensure_statbuf_valid();
+	return statbuf.st_ino;
+    }
+
     const char * get_owner() {
 #ifndef __WIN32__
 	ensure_statbuf_valid();
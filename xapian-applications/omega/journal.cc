@@ -0,0 +1,166 @@
+/** @file journal.cc
+ * @brief Record the state of the files omindex has indexed.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "journal.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "safeerrno.h"
+#include "safeunistd.h"
+
+#include "loadfile.h"
+#include "str.h"
+#include "stringutils.h"
+
+using namespace std;
+
+// The journal file starts with a line identifying the format, then a line
+// giving the UUID, last docid and document count of the database when it was
+// saved.  Each entry is then:
+//
+//   <urlterm length>:<urlterm><last_mod> <size> <inode> <docid>\n
+#define JOURNAL_MAGIC "omindex journal 1\n"
+
+// Parse a decimal number terminated by @a term.
+template<typename T>
+static bool
+parse_number(const char ** p, const char * end, char term, T & result)
+{
+    const char * q = *p;
+    bool negative = (q != end && *q == '-');
+    if (negative) ++q;
+    if (q == end || !C_isdigit(*q)) return false;
+    T value = 0;
+    while (q != end && C_isdigit(*q)) {
+	value = value * 10 + (*q++ - '0');
+    }
+    if (q == end || *q != term) return false;
+    result = negative ? -value : value;
+    *p = q + 1;
+    return true;
+}
+
+static string
+database_state(const Xapian::Database & db)
+{
+    string state = db.get_uuid();
+    state += ' ';
+    state += str(db.get_lastdocid());
+    state += ' ';
+    state += str(db.get_doccount());
+    state += '\n';
+    return state;
+}
+
+bool
+IndexJournal::load(const string & path, const Xapian::Database & db)
+{
+    entries.clear();
+
+    string data;
+    if (!load_file(path, data)) return false;
+
+    string header = JOURNAL_MAGIC;
+    header += database_state(db);
+    if (!startswith(data, header)) return false;
+
+    const char * p = data.data() + header.size();
+    const char * end = data.data() + data.size();
+    while (p != end) {
+	size_t len;
+	if (!parse_number(&p, end, ':', len) || size_t(end - p) < len)
+	    break;
+	string urlterm(p, len);
+	p += len;
+	Entry e;
+	if (!parse_number(&p, end, ' ', e.last_mod) ||
+	    !parse_number(&p, end, ' ', e.size) ||
+	    !parse_number(&p, end, ' ', e.inode) ||
+	    !parse_number(&p, end, '\n', e.did))
+	    break;
+	entries[urlterm] = e;
+    }
+
+    if (p != end) {
+	// The journal is corrupt, so don't trust any of it.
+	entries.clear();
+	return false;
+    }
+    return true;
+}
+
+void
+IndexJournal::save(const string & path, const Xapian::Database & db,
+		   bool drop_unseen)
+{
+    // Write to a temporary file and rename it into place, so that we don't
+    // leave a partial journal if we're interrupted.
+    string tmp = path;
+    tmp += ".tmp";
+    {
+	ofstream out(tmp.c_str(), ios::out | ios::binary | ios::trunc);
+	out << JOURNAL_MAGIC << database_state(db);
+	map<string, Entry>::const_iterator i;
+	for (i = entries.begin(); i != entries.end(); ++i) {
+	    const Entry & e = i->second;
+	    if (drop_unseen && !e.seen) continue;
+	    out << i->first.size() << ':' << i->first
+		<< str(e.last_mod) << ' ' << str(e.size) << ' '
+		<< str(e.inode) << ' ' << e.did << '\n';
+	}
+	out.close();
+	if (!out) {
+	    unlink(tmp.c_str());
+	    throw "Couldn't write journal '" + tmp + "'";
+	}
+    }
+    if (rename(tmp.c_str(), path.c_str()) < 0) {
+	string msg = "Couldn't rename '" + tmp + "' to '" + path + "': ";
+	msg += strerror(errno);
+	unlink(tmp.c_str());
+	throw msg;
+    }
+}
+
+void
+IndexJournal::set(const string & urlterm, time_t last_mod, off_t size,
+		  ino_t inode, Xapian::docid did)
+{
+    Entry & e = entries[urlterm];
+    e.last_mod = last_mod;
+    e.size = size;
+    e.inode = inode;
+    e.did = did;
+    e.seen = true;
+}
+
+void
+IndexJournal::erase_prefix(const string & prefix)
+{
+    map<string, Entry>::iterator i = entries.lower_bound(prefix);
+    map<string, Entry>::iterator j = i;
+    while (j != entries.end() && startswith(j->first, prefix)) ++j;
+    entries.erase(i, j);
+}
@@ -0,0 +1,108 @@
+/** @file journal.h
+ * @brief Record the state of the files omindex has indexed.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef OMEGA_INCLUDED_JOURNAL_H
+#define OMEGA_INCLUDED_JOURNAL_H
+
+#include <map>
+#include <string>
+
+#include <sys/types.h>
+#include <ctime>
+
+#include <xapian.h>
+
+/** The state of each indexed file when it was last indexed.
+ *
+ *  This allows omindex to decide whether a file needs indexing again without
+ *  looking anything up in the database.  The journal is keyed by the unique
+ *  "U" term of each file's document.
+ *
+ *  The journal is saved as a simple text file and held in a std::map while
+ *  omindex runs, rather than being looked up in place in an mmapped or cdb
+ *  file.  Every entry gets looked at during a full scan anyway (to find
+ *  deleted files), entries need to be added, updated and removed as files
+ *  are indexed, and omega only has code to read cdb files, not write them.
+ *  So reading it all in once and writing it all out again after committing
+ *  is simplest, and a run still doesn't need to look anything up in the
+ *  database for unchanged files.
+ */
+class IndexJournal {
+  public:
+    struct Entry {
+	time_t last_mod;
+
+	off_t size;
+
+	ino_t inode;
+
+	Xapian::docid did;
+
+	/// Has this file been seen since the journal was loaded?
+	bool seen;
+
+	Entry() : last_mod(0), size(0), inode(0), did(0), seen(false) { }
+    };
+
+  private:
+    std::map<std::string, Entry> entries;
+
+  public:
+    /** Load the journal from file @a path.
+     *
+     *  If the file doesn't exist or can't be parsed, or was written for a
+     *  different database, or documents have been added to or deleted from
+     *  @a db since it was saved, the journal is left empty (so every file
+     *  will be checked against the database).
+     *
+     *  @return true if the journal was loaded.
+     */
+    bool load(const std::string & path, const Xapian::Database & db);
+
+    /** Save the journal to file @a path.
+     *
+     *  This should be called after changes to @a db have been committed.
+     *
+     *  @param drop_unseen	If true, don't save entries for files which
+     *				haven't been seen since the journal was loaded.
+     *
+     *  On error, a std::string describing the problem is thrown.
+     */
+    void save(const std::string & path, const Xapian::Database & db,
+	      bool drop_unseen);
+
+    /// Find the entry for @a urlterm, or return NULL if there isn't one.
+    Entry * find(const std::string & urlterm) {
+	std::map<std::string, Entry>::iterator i = entries.find(urlterm);
+	return i == entries.end() ? NULL : &i->second;
+    }
+
+    /// Record that @a urlterm was indexed as document @a did.
+    void set(const std::string & urlterm, time_t last_mod, off_t size,
+	     ino_t inode, Xapian::docid did);
+
+    /// Remove the entry for @a urlterm, if there is one.
+    void erase(const std::string & urlterm) { entries.erase(urlterm); }
+
+    /// Remove the entries for all urlterms starting with @a prefix.
+    void erase_prefix(const std::string & prefix);
+};
+
+#endif // OMEGA_INCLUDED_JOURNAL_H
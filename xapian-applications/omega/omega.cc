@@ -29,6 +29,7 @@
 #define XAPIAN_DEPRECATED(D) D
 
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 
 #include <algorithm>
@@ -36,6 +37,7 @@
 #include <iostream>
 #include <set>
 
+#include "safeerrno.h"
 #include "safefcntl.h"
 #include "safeunistd.h"
 
@@ -43,7 +45,9 @@
 #include "utils.h"
 #include "cgiparam.h"
 #include "query.h"
+#include "scgi.h"
 #include "str.h"
+#include "stringutils.h"
 #include "expand.h"
 
 using namespace std;
@@ -83,29 +87,189 @@ Xapian::Enquire::docid_order docid_order = Xapian::Enquire::ASCENDING;
 Xapian::valueno collapse_key = 0;
 bool collapse = false;
 
+// If true, keep databases open between requests.
+static bool cache_databases = false;
+
+static map<string, Xapian::Database> db_cache;
+
 static string
 map_dbname_to_dir(const string &database_name)
 {
     return database_dir + database_name;
 }
 
-int main(int argc, char *argv[])
-try {
-    read_config_file();
+static Xapian::Database
+open_database(const string &database_name)
+{
+    if (!cache_databases) {
+	return Xapian::Database(map_dbname_to_dir(database_name));
+    }
 
-    char *method;
-    MCI val;
-    pair<MCI, MCI> g;
+    map<string, Xapian::Database>::iterator i;
+    i = db_cache.find(database_name);
+    if (i != db_cache.end()) {
+	try {
+	    // Pick up any new revision - this is cheap if there isn't one.
+	    i->second.reopen();
+	    return i->second;
+	} catch (const Xapian::Error &) {
+	    // The database may have been replaced, so try opening it again.
+	    db_cache.erase(i);
+	}
+    }
+    Xapian::Database result(map_dbname_to_dir(database_name));
+    db_cache.insert(make_pair(database_name, result));
+    return result;
+}
 
+// Reset the global state to the defaults, ready to handle a request.
+static void
+reset_request_state()
+{
+    delete enquire;
+    enquire = NULL;
+    db = Xapian::Database();
+    rset = Xapian::RSet();
+
+    option.clear();
     option["flag_default"] = "true";
 
     // set default thousands and decimal separators: e.g. "16,729 hits" "1.4K"
     option["decimal"] = ".";
     option["thousand"] = ",";
-    
+
     // set the default stemming language
     option["stemmer"] = DEFAULT_STEM_LANGUAGE;
 
+    date_start.resize(0);
+    date_end.resize(0);
+    date_span.resize(0);
+    set_content_type = false;
+    suppress_http_headers = false;
+    dbname.resize(0);
+    fmtname = "query";
+    filters.resize(0);
+    topdoc = 0;
+    hits_per_page = 0;
+    min_hits = 0;
+    threshold = 0;
+    sort_key = Xapian::BAD_VALUENO;
+    sort_ascending = true;
+    sort_after = false;
+    docid_order = Xapian::Enquire::ASCENDING;
+    collapse_key = 0;
+    collapse = false;
+
+    reset_omegascript();
+}
+
+// Report the exception currently being handled.
+static void
+report_exception()
+{
+    try {
+	throw;
+    } catch (const Xapian::Error &e) {
+	if (!set_content_type && !suppress_http_headers)
+	    cout << "Content-Type: text/html\n\n";
+	cout << "Exception: " << html_escape(e.get_msg()) << endl;
+    } catch (const std::exception &e) {
+	if (!set_content_type && !suppress_http_headers)
+	    cout << "Content-Type: text/html\n\n";
+	cout << "Exception: std::exception " << html_escape(e.what()) << endl;
+    } catch (const string &s) {
+	if (!set_content_type && !suppress_http_headers)
+	    cout << "Content-Type: text/html\n\n";
+	cout << "Exception: " << html_escape(s) << endl;
+    } catch (const char *s) {
+	if (!set_content_type && !suppress_http_headers)
+	    cout << "Content-Type: text/html\n\n";
+	cout << "Exception: " << html_escape(s) << endl;
+    } catch (...) {
+	if (!set_content_type && !suppress_http_headers)
+	    cout << "Content-Type: text/html\n\n";
+	cout << "Caught unknown exception" << endl;
+    }
+}
+
+static void process_request();
+
+static void
+serve_scgi_request(const string & body)
+{
+    try {
+	reset_request_state();
+	const char * method = getenv("REQUEST_METHOD");
+	if (method && *method == 'P')
+	    decode_string(body);
+	else
+	    decode_get();
+	process_request();
+    } catch (...) {
+	report_exception();
+    }
+}
+
+// Run as an SCGI server.  There's no client to report errors to, so they go
+// to stderr and we exit with a non-zero status.
+static int
+scgi_main(int argc, char *argv[])
+try {
+    read_config_file();
+
+    // omega --scgi=/run/omega.sock --workers=8
+    string address(argv[1] + CONST_STRLEN("--scgi="));
+    unsigned workers = 4;
+    size_t max_body_size = 1000000;
+    for (int i = 2; i < argc; ++i) {
+	if (startswith(argv[i], "--workers=")) {
+	    workers = atoi(argv[i] + CONST_STRLEN("--workers="));
+	} else if (startswith(argv[i], "--max-body-size=")) {
+	    const char * p = argv[i] + CONST_STRLEN("--max-body-size=");
+	    char * end;
+	    errno = 0;
+	    unsigned long n = strtoul(p, &end, 10);
+	    if (*p < '0' || *p > '9' || *end || errno == ERANGE ||
+		n != size_t(n)) {
+		throw string("Bad value for --max-body-size: ") + p;
+	    }
+	    max_body_size = n;
+	} else {
+	    throw string("Unknown option: ") + argv[i];
+	}
+    }
+    cache_databases = true;
+    enable_omegascript_caching();
+    scgi_serve(address, workers, max_body_size, serve_scgi_request);
+    return 0;
+} catch (const Xapian::Error &e) {
+    cerr << PROGRAM_NAME": " << e.get_description() << endl;
+    return 1;
+} catch (const std::exception &e) {
+    cerr << PROGRAM_NAME": " << e.what() << endl;
+    return 1;
+} catch (const string &s) {
+    cerr << PROGRAM_NAME": " << s << endl;
+    return 1;
+} catch (const char *s) {
+    cerr << PROGRAM_NAME": " << s << endl;
+    return 1;
+} catch (...) {
+    cerr << PROGRAM_NAME": Caught unknown exception" << endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+try {
+    if (argc > 1 && startswith(argv[1], "--scgi="))
+	return scgi_main(argc, argv);
+
+    read_config_file();
+
+    char *method;
+
+    reset_request_state();
+
     // FIXME: set cout to linebuffered not stdout.  Or just flush regularly...
     //setvbuf(stdout, NULL, _IOLBF, 0);
 
@@ -132,6 +296,18 @@ try {
 	    decode_get();
     }
 
+    process_request();
+} catch (...) {
+    report_exception();
+}
+
+// Handle a request once the CGI parameters have been decoded.
+static void
+process_request()
+{
+    MCI val;
+    pair<MCI, MCI> g;
+
     try {
 	// get database(s) to search
 	dbname.resize(0);
@@ -148,7 +324,7 @@ try {
 			// Translate DB parameter to path of database directory
 			if (!dbname.empty()) dbname += '/';
 			dbname += s;
-			db.add_database(Xapian::Database(map_dbname_to_dir(s)));
+			db.add_database(open_database(s));
 			seen.insert(s);
 		    }
 		    if (q == string::npos) break;
@@ -158,7 +334,7 @@ try {
 	}
 	if (dbname.empty()) {
 	    dbname = default_dbname;
-	    db.add_database(Xapian::Database(map_dbname_to_dir(dbname)));
+	    db.add_database(open_database(dbname));
 	}
 	enquire = new Xapian::Enquire(db);
     }
@@ -361,25 +537,5 @@ try {
 	min_hits = atol(val->second.c_str());
     }
 
-    parse_omegascript(); 
-} catch (const Xapian::Error &e) {
-    if (!set_content_type && !suppress_http_headers)
-	cout << "Content-Type: text/html\n\n";
-    cout << "Exception: " << html_escape(e.get_msg()) << endl;
-} catch (const std::exception &e) {
-    if (!set_content_type && !suppress_http_headers)
-	cout << "Content-Type: text/html\n\n";
-    cout << "Exception: std::exception " << html_escape(e.what()) << endl;
-} catch (const string &s) {
-    if (!set_content_type && !suppress_http_headers)
-	cout << "Content-Type: text/html\n\n";
-    cout << "Exception: " << html_escape(s) << endl;
-} catch (const char *s) {
-    if (!set_content_type && !suppress_http_headers)
-	cout << "Content-Type: text/html\n\n";
-    cout << "Exception: " << html_escape(s) << endl;
-} catch (...) {
-    if (!set_content_type && !suppress_http_headers)
-	cout << "Content-Type: text/html\n\n";
-    cout << "Caught unknown exception" << endl;
+    parse_omegascript();
 }
@@ -42,6 +42,12 @@
 #include "safeerrno.h"
 #include <ctime>
 
+#ifdef HAVE_SYS_INOTIFY_H
+# include <set>
+# include <sys/inotify.h>
+# include "safesysselect.h"
+#endif
+
 #include <xapian.h>
 
 #include "append_filename_arg.h"
@@ -49,6 +55,8 @@
 #include "commonhelp.h"
 #include "diritor.h"
 #include "hashterm.h"
+#include "journal.h"
+#include "loadfile.h"
 #include "md5wrap.h"
 #include "metaxmlparse.h"
 #include "msxmlparse.h"
@@ -66,6 +74,7 @@
 #include "utf8convert.h"
 #include "utils.h"
 #include "values.h"
+#include "workerpool.h"
 #include "xmlparse.h"
 #include "xlsxparse.h"
 #include "xpsxmlparse.h"
@@ -106,6 +115,26 @@ static vector<bool> updated;
 // longer entry in the mime_map, we set this to that length instead.
 static size_t max_ext_len = 7;
 
+// If not NULL, text is extracted from files by these worker processes.
+static WorkerPool * workers = NULL;
+
+// If journal_path isn't empty, we record the state of each file we index in
+// journal, and use it to decide which files have changed.
+static string journal_path;
+static IndexJournal journal;
+
+#ifdef HAVE_SYS_INOTIFY_H
+// If >= 0, we watch each directory we index for changes.
+static int inotify_fd = -1;
+
+struct WatchedDirectory {
+    string path, url;
+    size_t depth_limit;
+};
+
+static map<int, WatchedDirectory> watches;
+#endif
+
 static void
 mark_as_seen(Xapian::docid did)
 {
@@ -292,22 +321,98 @@ skip(const string & file, const string & msg, unsigned flags = 0)
     cout << "Skipping - " << msg << endl;
 }
 
+// The text and metadata extracted from a file.
+struct ExtractedText {
+    string author, title, sample, keywords, topic, dump, md5;
+    time_t created;
+
+    // If not empty, the file should be skipped for this reason.
+    string skip_reason;
+    unsigned skip_flags;
+
+    // True if the filter for this file's MIME type isn't installed.
+    bool no_filter;
+
+    ExtractedText() : created(time_t(-1)), skip_flags(0), no_filter(false) { }
+
+    void skip(const string & msg, unsigned flags = 0) {
+	skip_reason = msg;
+	skip_flags = flags;
+    }
+};
+
 static void
-skip_cmd_failed(const string & file, const string & cmd)
+skip_cmd_failed(ExtractedText & out, const string & cmd)
 {
-    skip(file, "\"" + cmd + "\" failed");
+    out.skip("\"" + cmd + "\" failed");
 }
 
 static void
-skip_meta_tag(const string & file)
+skip_meta_tag(ExtractedText & out)
 {
-    skip(file, "indexing disallowed by meta tag");
+    out.skip("indexing disallowed by meta tag");
 }
 
 static void
-skip_unknown_mimetype(const string & file, const string & mimetype)
+skip_unknown_mimetype(ExtractedText & out, const string & mimetype)
+{
+    out.skip("unknown MIME type '" + mimetype + "'");
+}
+
+// The details of a file which we need to index it, so that the
+// DirectoryIterator can move on while text is extracted from the file.
+struct FileDetails {
+    string file, url, ext, mimetype, urlterm, leafname;
+    Xapian::docid did;
+    time_t last_mod;
+    off_t size;
+    ino_t inode;
+    bool try_noatime;
+    bool other_readable, group_readable, owner_readable;
+    // Empty if not known (or not needed).
+    string owner, group;
+
+    FileDetails() : did(0), last_mod(0), size(0), inode(0), try_noatime(false),
+		    other_readable(false), group_readable(false),
+		    owner_readable(false) { }
+
+    FileDetails(const string & file_, const string & url_,
+		const string & ext_, const string & mimetype_,
+		const string & urlterm_, Xapian::docid did_,
+		DirectoryIterator & d)
+	: file(file_), url(url_), ext(ext_), mimetype(mimetype_),
+	  urlterm(urlterm_), leafname(d.leafname()), did(did_),
+	  last_mod(d.get_mtime()), size(d.get_size()), inode(d.get_inode()),
+	  try_noatime(d.try_noatime()),
+	  other_readable(d.is_other_readable()),
+	  group_readable(false), owner_readable(false)
+    {
+	if (!other_readable) {
+	    group_readable = d.is_group_readable();
+	    if (group_readable) {
+		const char * p = d.get_group();
+		if (p) group = p;
+	    }
+	}
+	const char * p = d.get_owner();
+	if (p) {
+	    owner = p;
+	    if (!other_readable) owner_readable = d.is_owner_readable();
+	}
+    }
+};
+
+static string
+file_to_string(const string & file, bool try_noatime)
 {
-    skip(file, "unknown MIME type '" + mimetype + "'");
+    string out;
+    int flags = NOCACHE;
+    if (try_noatime) flags |= NOATIME;
+    if (!load_file(file, out, flags)) {
+	if (errno == ENOENT || errno == ENOTDIR) throw FileNotFound();
+	throw ReadError("load_file failed");
+    }
+    return out;
 }
 
 void
@@ -359,57 +464,19 @@ index_file(const string &file, const string &url, DirectoryIterator & d,
     index_mimetype(file, url, ext, mimetype, d, sample_size);
 }
 
-void
-index_mimetype(const string & file, const string & url, const string & ext,
-	       const string &mimetype, DirectoryIterator &d, size_t sample_size)
+// Extract the text and metadata from @a file.
+static void
+extract_text(const string & file, const string & mimetype, bool try_noatime,
+	     size_t sample_size, ExtractedText & out)
 {
-    string urlterm("U");
-    urlterm += url;
-
-    if (urlterm.length() > MAX_SAFE_TERM_LENGTH)
-	urlterm = hash_long_term(urlterm, MAX_SAFE_TERM_LENGTH);
-
-    time_t last_mod = d.get_mtime();
-    time_t created = time_t(-1);
-
-    Xapian::docid did = 0; 
-    if (skip_duplicates) {
-	Xapian::PostingIterator p = db.postlist_begin(urlterm);
-	if (p != db.postlist_end(urlterm)) {
-	    if (verbose)
-		cout << "already indexed, not updating" << endl;
-	    did = *p;
-	    mark_as_seen(did);
-	    return;
-	}
-    } else {
-	// If last_mod > last_mod_max, we know for sure that the file is new
-	// or updated.
-	if (last_mod <= last_mod_max) {
-	    Xapian::PostingIterator p = db.postlist_begin(urlterm);
-	    if (p != db.postlist_end(urlterm)) {
-		did = *p;
-		Xapian::Document doc = db.get_document(did);
-		string value = doc.get_value(VALUE_LASTMOD);
-		time_t old_last_mod = binary_string_to_int(value);
-		if (last_mod <= old_last_mod) {
-		    if (verbose)
-			cout << "already indexed" << endl;
-		    // The docid should be in updated - the only valid
-		    // exception is if the URL was long and hashed to the
-		    // same URL as an existing document indexed in the same
-		    // batch.
-		    mark_as_seen(did);
-		    return;
-		}
-	    }
-	}
-    }
-
-    if (verbose) cout << flush;
-
-    string author, title, sample, keywords, topic, dump;
-    string md5;
+    string & author = out.author;
+    string & title = out.title;
+    string & sample = out.sample;
+    string & keywords = out.keywords;
+    string & topic = out.topic;
+    string & dump = out.dump;
+    string & md5 = out.md5;
+    time_t & created = out.created;
 
     try {
 	map<string, Filter>::const_iterator cmd_it = commands.find(mimetype);
@@ -418,7 +485,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    // cases.
 	    string cmd = cmd_it->second.cmd;
 	    if (cmd.empty()) {
-		skip(file, "required filter not installed", SKIP_VERBOSE_ONLY);
+		out.skip("required filter not installed", SKIP_VERBOSE_ONLY);
 		return;
 	    }
 	    append_filename_argument(cmd, file);
@@ -434,7 +501,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 			p.ignore_metarobots();
 			p.parse_html(dump, newcharset, true);
 		    } catch (ReadError) {
-			skip_cmd_failed(file, cmd);
+			skip_cmd_failed(out, cmd);
 			return;
 		    }
 		    dump = p.dump;
@@ -446,11 +513,11 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		    created = p.created;
 		}
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (mimetype == "text/html") {
-	    const string & text = d.file_to_string();
+	    const string & text = file_to_string(file, try_noatime);
 	    MyHtmlParser p;
 	    if (ignore_exclusions) p.ignore_metarobots();
 	    try {
@@ -463,7 +530,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		p.parse_html(text, newcharset, true);
 	    }
 	    if (!p.indexing_allowed) {
-		skip_meta_tag(file);
+		skip_meta_tag(out);
 		return;
 	    }
 	    dump = p.dump;
@@ -477,7 +544,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	} else if (mimetype == "text/plain") {
 	    // Currently we assume that text files are UTF-8 unless they have a
 	    // byte-order mark.
-	    dump = d.file_to_string();
+	    dump = file_to_string(file, try_noatime);
 	    md5_string(dump, md5);
 
 	    // Look for Byte-Order Mark (BOM).
@@ -500,7 +567,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    try {
 		dump = stdout_to_string(cmd);
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	    get_pdf_metainfo(file, author, title, keywords, topic);
@@ -518,7 +585,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		string msg = "Couldn't create temporary directory (";
 		msg += strerror(errno);
 		msg += ")";
-		skip(file, msg);
+		out.skip(msg);
 		return;
 	    }
 	    string cmd = "ps2pdf";
@@ -531,7 +598,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		cmd += " -";
 		dump = stdout_to_string(cmd);
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		unlink(tmpfile.c_str());
 		return;
 	    } catch (...) {
@@ -559,7 +626,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		parser.parse(stdout_to_string(cmd));
 		dump = parser.dump;
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 
@@ -583,7 +650,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    try {
 		dump = stdout_to_string(cmd);
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (startswith(mimetype, "application/vnd.openxmlformats-officedocument.")) {
@@ -608,7 +675,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		    parser.parse(stdout_to_string(cmd));
 		    dump = parser.dump;
 		} catch (ReadError) {
-		    skip_cmd_failed(file, cmd);
+		    skip_cmd_failed(out, cmd);
 		    return;
 		}
 	    } else if (startswith(tail, "presentationml.")) {
@@ -618,7 +685,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		args = " ppt/slides/slide\\*.xml ppt/notesSlides/notesSlide\\*.xml ppt/comments/comment\\*.xml 2>/dev/null||test $? = 11";
 	    } else {
 		// Don't know how to index this type.
-		skip_unknown_mimetype(file, mimetype);
+		skip_unknown_mimetype(out, mimetype);
 		return;
 	    }
 
@@ -631,7 +698,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		    xmlparser.parse_xml(stdout_to_string(cmd));
 		    dump = xmlparser.dump;
 		} catch (ReadError) {
-		    skip_cmd_failed(file, cmd);
+		    skip_cmd_failed(out, cmd);
 		    return;
 		}
 	    }
@@ -653,7 +720,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	} else if (mimetype == "application/x-abiword") {
 	    // FIXME: Implement support for metadata.
 	    XmlParser xmlparser;
-	    const string & text = d.file_to_string();
+	    const string & text = file_to_string(file, try_noatime);
 	    xmlparser.parse_xml(text);
 	    dump = xmlparser.dump;
 	    md5_string(text, md5);
@@ -666,7 +733,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		xmlparser.parse_xml(stdout_to_string(cmd));
 		dump = xmlparser.dump;
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (mimetype == "text/x-perl") {
@@ -679,7 +746,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		dump = stdout_to_string(cmd);
 		convert_to_utf8(dump, "iso-8859-1");
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (mimetype == "application/x-dvi") {
@@ -694,7 +761,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		dump = stdout_to_string(cmd);
 		convert_to_utf8(dump, "iso-8859-1");
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (mimetype == "application/vnd.ms-xpsdocument") {
@@ -715,13 +782,13 @@ index_mimetype(const string & file, const string & url, const string & ext,
 		xpsparser.parse(dump);
 		dump = xpsparser.dump;
 	    } catch (ReadError) {
-		skip_cmd_failed(file, cmd);
+		skip_cmd_failed(out, cmd);
 		return;
 	    }
 	} else if (mimetype == "text/csv") {
 	    // Currently we assume that text files are UTF-8 unless they have a
 	    // byte-order mark.
-	    dump = d.file_to_string();
+	    dump = file_to_string(file, try_noatime);
 	    md5_string(dump, md5);
 
 	    // Look for Byte-Order Mark (BOM).
@@ -741,7 +808,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    generate_sample_from_csv(dump, sample, sample_size);
 	} else if (mimetype == "image/svg+xml") {
 	    SvgParser svgparser;
-	    const string & text = d.file_to_string();
+	    const string & text = file_to_string(file, try_noatime);
 	    md5_string(text, md5);
 	    svgparser.parse(text);
 	    dump = svgparser.dump;
@@ -772,7 +839,7 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    }
 	} else if (mimetype == "application/atom+xml") {
 	    AtomParser atomparser;
-	    const string & text = d.file_to_string();
+	    const string & text = file_to_string(file, try_noatime);
 	    md5_string(text, md5);
 	    atomparser.parse(text);
 	    dump = atomparser.dump;
@@ -782,17 +849,17 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    author = atomparser.author;
 	} else {
 	    // Don't know how to index this type.
-	    skip_unknown_mimetype(file, mimetype);
+	    skip_unknown_mimetype(out, mimetype);
 	    return;
 	}
 
 	// Compute the MD5 of the file if we haven't already.
-	if (md5.empty() && md5_file(file, md5, d.try_noatime()) == 0) {
+	if (md5.empty() && md5_file(file, md5, try_noatime) == 0) {
 	    if (errno == ENOENT || errno == ENOTDIR) {
-		skip(file, "File removed during indexing",
-		     SKIP_VERBOSE_ONLY | SKIP_SHOW_FILENAME);
+		out.skip("File removed during indexing",
+			 SKIP_VERBOSE_ONLY | SKIP_SHOW_FILENAME);
 	    } else {
-		skip(file, "failed to read file to calculate MD5 checksum");
+		out.skip("failed to read file to calculate MD5 checksum");
 	    }
 	    return;
 	}
@@ -807,20 +874,6 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	if (++trim_end != dump.size())
 	    dump.resize(trim_end);
 
-	if (dump.empty()) {
-	    switch (empty_body) {
-		case EMPTY_BODY_INDEX:
-		    break;
-		case EMPTY_BODY_WARN:
-		    cout << "no text extracted from document body, "
-			    "but indexing metadata anyway" << endl;
-		    break;
-		case EMPTY_BODY_SKIP:
-		    skip(file, "no text extracted from document body");
-		    return;
-	    }
-	}
-
 	// Produce a sample
 	if (sample.empty()) {
 	    sample = generate_sample(dump, sample_size, "...", " ...");
@@ -828,171 +881,441 @@ index_mimetype(const string & file, const string & url, const string & ext,
 	    sample = generate_sample(sample, sample_size, "...", " ...");
 	}
 
-	// Put the data in the document
-	Xapian::Document newdocument;
-	string record = "url=";
-	record += url;
-	record += "\nsample=";
-	record += sample;
-	if (!title.empty()) {
-	    record += "\ncaption=";
-	    record += generate_sample(title, TITLE_SIZE, "...", " ...");
-	}
-	if (!author.empty()) {
-	    record += "\nauthor=";
-	    record += author;
-	}
-	record += "\ntype=";
-	record += mimetype;
-	if (last_mod != (time_t)-1) {
-	    record += "\nmodtime=";
-	    record += str(last_mod);
-	}
-	if (created != (time_t)-1) {
-	    record += "\ncreated=";
-	    record += str(created);
-	}
-	record += "\nsize=";
-	record += str(d.get_size());
-	newdocument.set_data(record);
-
-	// Index the title, document text, keywords and topic.
-	indexer.set_document(newdocument);
-	if (!title.empty()) {
-	    indexer.index_text(title, 5, "S");
-	    indexer.increase_termpos(100);
-	}
-	if (!dump.empty()) {
-	    indexer.index_text(dump);
-	}
-	if (!keywords.empty()) {
-	    indexer.increase_termpos(100);
-	    indexer.index_text(keywords);
-	}
-	if (!topic.empty()) {
-	    indexer.increase_termpos(100);
-	    indexer.index_text(topic, 1, "B");
-	}
-	// Index the leafname of the file.
-	{
-	    indexer.increase_termpos(100);
-	    string leaf = d.leafname();
-	    string::size_type dot = leaf.find_last_of('.');
-	    if (dot != string::npos && leaf.size() - dot - 1 <= max_ext_len)
-		leaf.resize(dot);
-	    indexer.index_text(leaf);
-	}
+    } catch (ReadError) {
+	out.skip(string("can't read file: ") + strerror(errno));
+    } catch (NoSuchFilter) {
+	out.skip("Filter for \"" + mimetype + "\" not installed");
+	out.no_filter = true;
+	commands[mimetype] = Filter();
+    } catch (FileNotFound) {
+	out.skip("File removed during indexing",
+		 SKIP_VERBOSE_ONLY | SKIP_SHOW_FILENAME);
+    } catch (const std::string & error) {
+	out.skip(error);
+    }
+}
 
-	if (!author.empty()) {
-	    indexer.increase_termpos(100);
-	    indexer.index_text(author, 1, "A");
-	}
+// Index the text and metadata extracted from a file.
+static void
+index_extracted_text(const FileDetails & f, const ExtractedText & text)
+{
+    const string & file = f.file;
+    const string & url = f.url;
+    const string & mimetype = f.mimetype;
+    const string & urlterm = f.urlterm;
+    const string & author = text.author;
+    const string & title = text.title;
+    const string & sample = text.sample;
+    const string & keywords = text.keywords;
+    const string & topic = text.topic;
+    const string & dump = text.dump;
+    const string & md5 = text.md5;
+    time_t last_mod = f.last_mod;
+    time_t created = text.created;
+    Xapian::docid did = f.did;
+
+    // If the text was extracted by a worker process, we need to say which
+    // file this is about.
+    if (workers && verbose) cout << file.substr(root.size()) << ": ";
+
+    if (!text.skip_reason.empty()) {
+	unsigned flags = text.skip_flags;
+	if (workers && verbose) flags &= ~SKIP_SHOW_FILENAME;
+	skip(file, text.skip_reason, flags);
+	return;
+    }
 
-	// mimeType:
-	newdocument.add_boolean_term("T" + mimetype);
-
-	newdocument.add_boolean_term(site_term);
-
-	if (!host_term.empty())
-	    newdocument.add_boolean_term(host_term);
-
-	struct tm *tm = localtime(&last_mod);
-	string date_term = "D" + date_to_string(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
-	newdocument.add_boolean_term(date_term); // Date (YYYYMMDD)
-	date_term.resize(7);
-	date_term[0] = 'M';
-	newdocument.add_boolean_term(date_term); // Month (YYYYMM)
-	date_term.resize(5);
-	date_term[0] = 'Y';
-	newdocument.add_boolean_term(date_term); // Year (YYYY)
-
-	newdocument.add_boolean_term(urlterm); // Url
-
-	// Add last_mod as a value to allow "sort by date".
-	newdocument.add_value(VALUE_LASTMOD,
-			      int_to_binary_string((uint32_t)last_mod));
-
-	// Add MD5 as a value to allow duplicate documents to be collapsed
-	// together.
-	newdocument.add_value(VALUE_MD5, md5);
-
-	// Add the file size as a value to allow "sort by size" and size ranges.
-	newdocument.add_value(VALUE_SIZE,
-			      Xapian::sortable_serialise(d.get_size()));
-
-	bool inc_tag_added = false;
-	if (d.is_other_readable()) {
-	    inc_tag_added = true;
-	    newdocument.add_boolean_term("I*");
-	} else if (d.is_group_readable()) {
-	    const char * group = d.get_group();
-	    if (group) {
-		newdocument.add_boolean_term(string("I#") + group);
-	    }
-	}
-	const char * owner = d.get_owner();
-	if (owner) {
-	    newdocument.add_boolean_term(string("O") + owner);
-	    if (!inc_tag_added && d.is_owner_readable())
-		newdocument.add_boolean_term(string("I@") + owner);
+    if (dump.empty()) {
+	switch (empty_body) {
+	    case EMPTY_BODY_INDEX:
+		break;
+	    case EMPTY_BODY_WARN:
+		cout << "no text extracted from document body, "
+			"but indexing metadata anyway" << endl;
+		break;
+	    case EMPTY_BODY_SKIP:
+		skip(file, "no text extracted from document body");
+		return;
 	}
+    }
+
+    // Put the data in the document
+    Xapian::Document newdocument;
+    string record = "url=";
+    record += url;
+    record += "\nsample=";
+    record += sample;
+    if (!title.empty()) {
+	record += "\ncaption=";
+	record += generate_sample(title, TITLE_SIZE, "...", " ...");
+    }
+    if (!author.empty()) {
+	record += "\nauthor=";
+	record += author;
+    }
+    record += "\ntype=";
+    record += mimetype;
+    if (last_mod != (time_t)-1) {
+	record += "\nmodtime=";
+	record += str(last_mod);
+    }
+    if (created != (time_t)-1) {
+	record += "\ncreated=";
+	record += str(created);
+    }
+    record += "\nsize=";
+    record += str(f.size);
+    newdocument.set_data(record);
+
+    // Index the title, document text, keywords and topic.
+    indexer.set_document(newdocument);
+    if (!title.empty()) {
+	indexer.index_text(title, 5, "S");
+	indexer.increase_termpos(100);
+    }
+    if (!dump.empty()) {
+	indexer.index_text(dump);
+    }
+    if (!keywords.empty()) {
+	indexer.increase_termpos(100);
+	indexer.index_text(keywords);
+    }
+    if (!topic.empty()) {
+	indexer.increase_termpos(100);
+	indexer.index_text(topic, 1, "B");
+    }
+    // Index the leafname of the file.
+    {
+	indexer.increase_termpos(100);
+	string leaf = f.leafname;
+	string::size_type dot = leaf.find_last_of('.');
+	if (dot != string::npos && leaf.size() - dot - 1 <= max_ext_len)
+	    leaf.resize(dot);
+	indexer.index_text(leaf);
+    }
+
+    if (!author.empty()) {
+	indexer.increase_termpos(100);
+	indexer.index_text(author, 1, "A");
+    }
+
+    // mimeType:
+    newdocument.add_boolean_term("T" + mimetype);
+
+    newdocument.add_boolean_term(site_term);
+
+    if (!host_term.empty())
+	newdocument.add_boolean_term(host_term);
+
+    struct tm *tm = localtime(&last_mod);
+    string date_term = "D" + date_to_string(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+    newdocument.add_boolean_term(date_term); // Date (YYYYMMDD)
+    date_term.resize(7);
+    date_term[0] = 'M';
+    newdocument.add_boolean_term(date_term); // Month (YYYYMM)
+    date_term.resize(5);
+    date_term[0] = 'Y';
+    newdocument.add_boolean_term(date_term); // Year (YYYY)
+
+    newdocument.add_boolean_term(urlterm); // Url
+
+    // Add last_mod as a value to allow "sort by date".
+    newdocument.add_value(VALUE_LASTMOD,
+			  int_to_binary_string((uint32_t)last_mod));
+
+    // Add MD5 as a value to allow duplicate documents to be collapsed
+    // together.
+    newdocument.add_value(VALUE_MD5, md5);
+
+    // Add the file size as a value to allow "sort by size" and size ranges.
+    newdocument.add_value(VALUE_SIZE,
+			  Xapian::sortable_serialise(f.size));
+
+    if (f.other_readable) {
+	newdocument.add_boolean_term("I*");
+    } else if (!f.group.empty()) {
+	newdocument.add_boolean_term("I#" + f.group);
+    }
+    if (!f.owner.empty()) {
+	newdocument.add_boolean_term("O" + f.owner);
+	if (f.owner_readable)
+	    newdocument.add_boolean_term("I@" + f.owner);
+    }
 
-	string ext_term("E");
-	for (string::const_iterator i = ext.begin(); i != ext.end(); ++i) {
-	    char ch = *i;
-	    if (ch >= 'A' && ch <= 'Z')
-		ch |= 32;
-	    ext_term += ch;
+    string ext_term("E");
+    for (string::const_iterator i = f.ext.begin(); i != f.ext.end(); ++i) {
+	char ch = *i;
+	if (ch >= 'A' && ch <= 'Z')
+	    ch |= 32;
+	ext_term += ch;
+    }
+    newdocument.add_boolean_term(ext_term);
+
+    if (!skip_duplicates) {
+	// If this document has already been indexed, update the existing
+	// entry.
+	if (did) {
+	    // We already found out the document id above.
+	    db.replace_document(did, newdocument);
+	} else if (last_mod <= last_mod_max) {
+	    // We checked for the UID term and didn't find it.
+	    did = db.add_document(newdocument);
+	} else {
+	    did = db.replace_document(urlterm, newdocument);
 	}
-	newdocument.add_boolean_term(ext_term);
-
-	if (!skip_duplicates) {
-	    // If this document has already been indexed, update the existing
-	    // entry.
-	    if (did) {
-		// We already found out the document id above.
-		db.replace_document(did, newdocument);
-	    } else if (last_mod <= last_mod_max) {
-		// We checked for the UID term and didn't find it.
-		did = db.add_document(newdocument);
+	mark_as_seen(did);
+	if (!journal_path.empty())
+	    journal.set(urlterm, last_mod, f.size, f.inode, did);
+	if (verbose) {
+	    if (did <= old_lastdocid) {
+		cout << "updated" << endl;
 	    } else {
-		did = db.replace_document(urlterm, newdocument);
+		cout << "added" << endl;
 	    }
+	}
+    } else {
+	// If this were a duplicate, we'd have skipped it above.
+	did = db.add_document(newdocument);
+	if (!journal_path.empty())
+	    journal.set(urlterm, last_mod, f.size, f.inode, did);
+	if (verbose)
+	    cout << "added" << endl;
+    }
+}
+
+// The file each worker process is extracting text from.
+static vector<FileDetails> worker_files;
+
+static void
+pack_string(string & s, const string & value)
+{
+    s += str(value.size());
+    s += ':';
+    s += value;
+}
+
+static bool
+unpack_string(const char ** p, const char * end, string & value)
+{
+    const char * colon = static_cast<const char *>(memchr(*p, ':', end - *p));
+    if (!colon) return false;
+    size_t len = strtoul(*p, NULL, 10);
+    ++colon;
+    if (len > size_t(end - colon)) return false;
+    value.assign(colon, len);
+    *p = colon + len;
+    return true;
+}
+
+// Handle a request to extract text in a worker process.
+static void
+extract_text_request(const string & request, string & response)
+{
+    const char * p = request.data();
+    const char * end = p + request.size();
+    string file, mimetype, sample_size, try_noatime;
+    if (!unpack_string(&p, end, file) ||
+	!unpack_string(&p, end, mimetype) ||
+	!unpack_string(&p, end, sample_size) ||
+	!unpack_string(&p, end, try_noatime)) {
+	throw "Bad request to worker process";
+    }
+
+    ExtractedText text;
+    extract_text(file, mimetype, try_noatime == "1",
+		 strtoul(sample_size.c_str(), NULL, 10), text);
+    pack_string(response, text.author);
+    pack_string(response, text.title);
+    pack_string(response, text.sample);
+    pack_string(response, text.keywords);
+    pack_string(response, text.topic);
+    pack_string(response, text.dump);
+    pack_string(response, text.md5);
+    pack_string(response, str(text.created));
+    pack_string(response, text.skip_reason);
+    pack_string(response, str(text.skip_flags));
+    pack_string(response, text.no_filter ? "1" : "0");
+}
+
+// Wait for a worker process to finish extracting text, and index it.
+static void
+index_next_extracted()
+{
+    string response;
+    bool ok;
+    unsigned w = workers->wait(response, ok);
+
+    ExtractedText text;
+    if (ok) {
+	const char * p = response.data();
+	const char * end = p + response.size();
+	string created, skip_flags, no_filter;
+	ok = unpack_string(&p, end, text.author) &&
+	     unpack_string(&p, end, text.title) &&
+	     unpack_string(&p, end, text.sample) &&
+	     unpack_string(&p, end, text.keywords) &&
+	     unpack_string(&p, end, text.topic) &&
+	     unpack_string(&p, end, text.dump) &&
+	     unpack_string(&p, end, text.md5) &&
+	     unpack_string(&p, end, created) &&
+	     unpack_string(&p, end, text.skip_reason) &&
+	     unpack_string(&p, end, skip_flags) &&
+	     unpack_string(&p, end, no_filter);
+	text.created = time_t(strtol(created.c_str(), NULL, 10));
+	text.skip_flags = strtoul(skip_flags.c_str(), NULL, 10);
+	text.no_filter = (no_filter == "1");
+    }
+    if (!ok) text.skip("text extraction process failed");
+
+    // The worker only disabled the filter in its own copy of commands, so
+    // disable it here too - files of this type queued from now on will then
+    // be skipped without being passed to a worker.
+    if (text.no_filter)
+	commands[worker_files[w].mimetype] = Filter();
+
+    index_extracted_text(worker_files[w], text);
+}
+
+// Pass file @a f to a worker process to extract its text.  If all the workers
+// are busy, first wait for one to finish.
+static void
+queue_file(const FileDetails & f, size_t sample_size)
+{
+    // Finish off the "Indexing ..." line before we report on any other file.
+    if (verbose) cout << "queued" << endl;
+
+    if (workers->all_busy()) index_next_extracted();
+
+    string request;
+    pack_string(request, f.file);
+    pack_string(request, f.mimetype);
+    pack_string(request, str(sample_size));
+    pack_string(request, f.try_noatime ? "1" : "0");
+    worker_files[workers->submit(request)] = f;
+}
+
+void
+index_mimetype(const string & file, const string & url, const string & ext,
+	       const string &mimetype, DirectoryIterator &d, size_t sample_size)
+{
+    string urlterm("U");
+    urlterm += url;
+
+    if (urlterm.length() > MAX_SAFE_TERM_LENGTH)
+	urlterm = hash_long_term(urlterm, MAX_SAFE_TERM_LENGTH);
+
+    time_t last_mod = d.get_mtime();
+
+    Xapian::docid did = 0; 
+    IndexJournal::Entry * entry = NULL;
+    if (!journal_path.empty()) entry = journal.find(urlterm);
+    if (entry) {
+	// The journal tells us the state of the file when we last indexed it,
+	// so we don't need to look in the database.
+	did = entry->did;
+	if (skip_duplicates ||
+	    (last_mod == entry->last_mod && d.get_size() == entry->size &&
+	     d.get_inode() == entry->inode)) {
+	    if (verbose)
+		cout << "already indexed" << endl;
+	    entry->seen = true;
 	    mark_as_seen(did);
-	    if (verbose) {
-		if (did <= old_lastdocid) {
-		    cout << "updated" << endl;
-		} else {
-		    cout << "added" << endl;
+	    return;
+	}
+    } else if (skip_duplicates) {
+	Xapian::PostingIterator p = db.postlist_begin(urlterm);
+	if (p != db.postlist_end(urlterm)) {
+	    if (verbose)
+		cout << "already indexed, not updating" << endl;
+	    did = *p;
+	    mark_as_seen(did);
+	    if (!journal_path.empty())
+		journal.set(urlterm, last_mod, d.get_size(), d.get_inode(), did);
+	    return;
+	}
+    } else {
+	// If last_mod > last_mod_max, we know for sure that the file is new
+	// or updated.
+	if (last_mod <= last_mod_max) {
+	    Xapian::PostingIterator p = db.postlist_begin(urlterm);
+	    if (p != db.postlist_end(urlterm)) {
+		did = *p;
+		Xapian::Document doc = db.get_document(did);
+		string value = doc.get_value(VALUE_LASTMOD);
+		time_t old_last_mod = binary_string_to_int(value);
+		if (last_mod <= old_last_mod) {
+		    if (verbose)
+			cout << "already indexed" << endl;
+		    // The docid should be in updated - the only valid
+		    // exception is if the URL was long and hashed to the
+		    // same URL as an existing document indexed in the same
+		    // batch.
+		    mark_as_seen(did);
+		    if (!journal_path.empty())
+			journal.set(urlterm, last_mod, d.get_size(),
+				    d.get_inode(), did);
+		    return;
 		}
 	    }
-	} else {
-	    // If this were a duplicate, we'd have skipped it above.
-	    db.add_document(newdocument);
-	    if (verbose)
-		cout << "added" << endl;
 	}
-    } catch (ReadError) {
-	skip(file, string("can't read file: ") + strerror(errno));
-    } catch (NoSuchFilter) {
-	skip(file, "Filter for \"" + mimetype + "\" not installed");
-	commands[mimetype] = Filter();
-    } catch (FileNotFound) {
-	skip(file, "File removed during indexing",
-	     SKIP_VERBOSE_ONLY | SKIP_SHOW_FILENAME);
-    } catch (const std::string & error) {
-	skip(file, error);
     }
+
+    if (verbose) cout << flush;
+
+    FileDetails f(file, url, ext, mimetype, urlterm, did, d);
+    if (workers) {
+	// Don't hand a file to a worker if we already know its filter isn't
+	// installed - extract_text() will just skip it.
+	map<string, Filter>::const_iterator cmd_it = commands.find(mimetype);
+	if (cmd_it == commands.end() || !cmd_it->second.cmd.empty()) {
+	    queue_file(f, sample_size);
+	    return;
+	}
+    }
+
+    ExtractedText text;
+    extract_text(file, mimetype, f.try_noatime, sample_size, text);
+    index_extracted_text(f, text);
 }
 
+#ifdef HAVE_SYS_INOTIFY_H
+// Start watching directory @a path for changes, if we're in watch mode.
+static void
+watch_directory(const string & path, const string & url, size_t depth_limit)
+{
+    if (inotify_fd < 0) return;
+    int wd = inotify_add_watch(inotify_fd, path.c_str(),
+			       IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+			       IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd < 0) {
+	if (errno != ENOENT) {
+	    cout << "Couldn't watch directory \"" << path.substr(root.size())
+		 << "\": " << strerror(errno) << endl;
+	}
+	return;
+    }
+    WatchedDirectory & w = watches[wd];
+    w.path = path;
+    w.url = url;
+    w.depth_limit = depth_limit;
+}
+#endif
+
 static void
 index_directory(const string &path, const string &url_, size_t depth_limit,
-		map<string, string>& mime_map, size_t sample_size)
+		map<string, string>& mime_map, size_t sample_size,
+		bool recurse = true)
 {
     if (verbose)
 	cout << "[Entering directory \"" << path.substr(root.size()) << "\"]"
 	     << endl;
 
+#ifdef HAVE_SYS_INOTIFY_H
+    // Start watching before we look at the files, so we don't miss any
+    // changes made while we're indexing.
+    watch_directory(path, url_, depth_limit);
+#endif
+
     DirectoryIterator d(follow_symlinks);
     try {
 	// Crude workaround for MS-DFS share misbehaviour.
@@ -1010,6 +1333,7 @@ index_directory(const string &path, const string &url_, size_t depth_limit,
 	    try {
 		switch (d.get_type()) {
 		    case DirectoryIterator::DIRECTORY: {
+			if (!recurse) continue;
 			size_t new_limit = depth_limit;
 			if (new_limit) {
 			    if (--new_limit == 0) continue;
@@ -1043,6 +1367,191 @@ index_directory(const string &path, const string &url_, size_t depth_limit,
     }
 }
 
+// Finish indexing any files which worker processes are extracting text from.
+static void
+finish_queued_files()
+{
+    if (workers) {
+	while (workers->any_busy()) index_next_extracted();
+    }
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+// Remove the document for @a file, which has been deleted.  If @a file is a
+// directory (i.e. it ends in '/'), remove the documents for all the files
+// under it.
+static void
+remove_documents(const string & file, const string & url)
+{
+    string urlterm("U");
+    urlterm += url;
+    if (!endswith(file, '/')) {
+	if (urlterm.length() > MAX_SAFE_TERM_LENGTH)
+	    urlterm = hash_long_term(urlterm, MAX_SAFE_TERM_LENGTH);
+	db.delete_document(urlterm);
+	journal.erase(urlterm);
+	if (verbose)
+	    cout << "Removed \"" << file.substr(root.size()) << "\"" << endl;
+	return;
+    }
+
+    // Documents for files with very long URLs have a hashed URL term, so
+    // won't be found here - they'll get removed the next time omindex is run
+    // without --watch.
+    vector<string> urlterms;
+    Xapian::TermIterator t;
+    for (t = db.allterms_begin(urlterm); t != db.allterms_end(urlterm); ++t) {
+	urlterms.push_back(*t);
+    }
+    vector<string>::const_iterator i;
+    for (i = urlterms.begin(); i != urlterms.end(); ++i) {
+	db.delete_document(*i);
+    }
+    journal.erase_prefix(urlterm);
+
+    // Stop watching the directory and any subdirectories.
+    map<int, WatchedDirectory>::iterator w = watches.begin();
+    while (w != watches.end()) {
+	if (startswith(w->second.path, file)) {
+	    (void)inotify_rm_watch(inotify_fd, w->first);
+	    watches.erase(w++);
+	} else {
+	    ++w;
+	}
+    }
+    if (verbose)
+	cout << "Removed directory \"" << file.substr(root.size()) << "\""
+	     << endl;
+}
+
+// Watch for changes to the directories we've indexed and update the database
+// to reflect them.  Changes are committed once there have been no further
+// changes for a second.  This function only returns by throwing an exception.
+static void
+watch_for_changes(map<string, string>& mime_map, size_t sample_size)
+{
+    // Files may now have been modified since the newest document we indexed,
+    // so we always need to check the database for an existing document.
+    last_mod_max = numeric_limits<time_t>::max();
+    // So we report whether files were added or updated correctly.
+    old_lastdocid = db.get_lastdocid();
+
+    // Directories containing files which have been written to or moved in,
+    // which we reindex (without recursing) to pick up the changes.
+    set<int> changed_dirs;
+    // Directories which have been created or moved in.
+    vector<WatchedDirectory> new_dirs;
+    bool uncommitted = false;
+
+    union {
+	struct inotify_event event;
+	char data[65536];
+    } buf;
+    while (true) {
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(inotify_fd, &fds);
+	struct timeval timeout;
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+	int r = select(inotify_fd + 1, &fds, NULL, NULL,
+		       uncommitted ? &timeout : NULL);
+	if (r < 0) {
+	    if (errno == EINTR) continue;
+	    throw string("select failed: ") + strerror(errno);
+	}
+
+	if (r == 0) {
+	    // Things have gone quiet, so update the database.
+	    set<int>::const_iterator i;
+	    for (i = changed_dirs.begin(); i != changed_dirs.end(); ++i) {
+		map<int, WatchedDirectory>::const_iterator w = watches.find(*i);
+		if (w == watches.end()) continue;
+		// Take a copy as index_directory() may update watches.
+		WatchedDirectory dir = w->second;
+		index_directory(dir.path, dir.url, dir.depth_limit,
+				mime_map, sample_size, false);
+	    }
+	    changed_dirs.clear();
+	    vector<WatchedDirectory>::const_iterator j;
+	    for (j = new_dirs.begin(); j != new_dirs.end(); ++j) {
+		index_directory(j->path, j->url, j->depth_limit,
+				mime_map, sample_size);
+	    }
+	    new_dirs.clear();
+	    finish_queued_files();
+	    db.commit();
+	    if (!journal_path.empty())
+		journal.save(journal_path, db, false);
+	    old_lastdocid = db.get_lastdocid();
+	    uncommitted = false;
+	    continue;
+	}
+
+	ssize_t len = read(inotify_fd, buf.data, sizeof(buf.data));
+	if (len < 0) {
+	    if (errno == EINTR) continue;
+	    throw string("Reading inotify events failed: ") + strerror(errno);
+	}
+	const char * p = buf.data;
+	const char * end = p + len;
+	while (p < end) {
+	    const struct inotify_event * event =
+		reinterpret_cast<const struct inotify_event *>(p);
+	    p += sizeof(struct inotify_event) + event->len;
+	    uncommitted = true;
+
+	    if (event->mask & IN_Q_OVERFLOW) {
+		// We've missed some events, so check every directory.
+		map<int, WatchedDirectory>::const_iterator w;
+		for (w = watches.begin(); w != watches.end(); ++w) {
+		    changed_dirs.insert(w->first);
+		}
+		continue;
+	    }
+	    if (event->mask & IN_IGNORED) {
+		// The watch was removed (e.g. because the directory was).
+		watches.erase(event->wd);
+		continue;
+	    }
+
+	    map<int, WatchedDirectory>::const_iterator w;
+	    w = watches.find(event->wd);
+	    if (w == watches.end() || event->len == 0) continue;
+
+	    // The name is padded with zero bytes.
+	    const char * leafname = event->name;
+	    string file = w->second.path;
+	    file += leafname;
+	    string url = w->second.url;
+	    url_encode(url, leafname);
+
+	    if (event->mask & IN_ISDIR) {
+		if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		    remove_documents(file + '/', url + '/');
+		} else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+		    size_t new_limit = w->second.depth_limit;
+		    if (new_limit) {
+			if (--new_limit == 0) continue;
+		    }
+		    WatchedDirectory dir;
+		    dir.path = file + '/';
+		    dir.url = url + '/';
+		    dir.depth_limit = new_limit;
+		    new_dirs.push_back(dir);
+		}
+	    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		remove_documents(file, url);
+	    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+		// We wait for the file to be closed rather than indexing it
+		// when it's created, as it may not have been written yet.
+		changed_dirs.insert(event->wd);
+	    }
+	}
+    }
+}
+#endif
+
 static off_t
 parse_size(char* p)
 {
@@ -1083,8 +1592,10 @@ main(int argc, char **argv)
     string baseurl;
     size_t depth_limit = 0;
     size_t sample_size = SAMPLE_SIZE;
+    unsigned jobs = 1;
+    bool watch = false;
 
-    enum { OPT_OPENDIR_SLEEP = 256 };
+    enum { OPT_OPENDIR_SLEEP = 256, OPT_JOURNAL, OPT_WATCH };
     static const struct option longopts[] = {
 	{ "help",	no_argument,		NULL, 'h' },
 	{ "version",	no_argument,		NULL, 'V' },
@@ -1105,7 +1616,10 @@ main(int argc, char **argv)
 	{ "empty-docs",	required_argument,	NULL, 'e' },
 	{ "max-size",	required_argument,	NULL, 'm' },
 	{ "sample-size",required_argument,	NULL, 'E' },
+	{ "jobs",	required_argument,	NULL, 'j' },
 	{ "opendir-sleep",	required_argument,	NULL, OPT_OPENDIR_SLEEP },
+	{ "journal",	required_argument,	NULL, OPT_JOURNAL },
+	{ "watch",	no_argument,		NULL, OPT_WATCH },
 	{ 0, 0, NULL, 0 }
     };
 
@@ -1310,7 +1824,7 @@ main(int argc, char **argv)
 
     string dbpath;
     int getopt_ret;
-    while ((getopt_ret = gnu_getopt_long(argc, argv, "hvd:D:U:M:F:l:s:pfSVe:im:E:",
+    while ((getopt_ret = gnu_getopt_long(argc, argv, "hvd:D:U:M:F:l:s:pfSVe:im:E:j:",
 					 longopts, NULL)) != -1) {
 	switch (getopt_ret) {
 	case 'h': {
@@ -1349,10 +1863,18 @@ main(int argc, char **argv)
 "  -E, --sample-size=SIZE    maximum size for the document text sample\n"
 "                            (supports the same formats as --max-size).\n"
 "                            (default: 512)\n"
+"  -j, --jobs=N              run N worker processes to extract text from files\n"
+"                            in parallel with indexing (default: 1, which\n"
+"                            extracts text in the indexing process)\n"
 "      --opendir-sleep=SECS  sleep for SECS seconds before opening each\n"
 "                            directory - sleeping for 2 seconds seems to\n"
 "                            reliably work around problems with indexing files\n"
 "                            on Microsoft DFS shares.\n"
+"      --journal=FILE        record the state of each file indexed in FILE, and\n"
+"                            use it to decide which files have changed rather\n"
+"                            than checking the database\n"
+"      --watch               after indexing, keep running and index changes to\n"
+"                            files as they happen (only supported on Linux)\n"
 "  -v, --verbose             show more information about what is happening\n"
 "      --overwrite           create the database anew (the default is to update\n"
 "                            if the database already exists)" << endl;
@@ -1512,6 +2034,17 @@ main(int argc, char **argv)
 	    cerr << PROG_NAME": bad max size '" << optarg << "'" << endl;
 	    return 1;
 	}
+	case 'j': {
+	    char * p;
+	    unsigned long arg = strtoul(optarg, &p, 10);
+	    if (*p == '\0' && arg >= 1 && arg <= 1000) {
+		jobs = unsigned(arg);
+		break;
+	    }
+	    cerr << PROG_NAME": bad --jobs argument: "
+		 "'" << optarg << "'" << endl;
+	    return 1;
+	}
 	case OPT_OPENDIR_SLEEP: {
 	    // Don't want negative numbers, infinity, NaN, or hex numbers.
 	    char * p = optarg;
@@ -1524,6 +2057,12 @@ main(int argc, char **argv)
 		 "'" << optarg << "'" << endl;
 	    return 1;
 	}
+	case OPT_JOURNAL:
+	    journal_path = optarg;
+	    break;
+	case OPT_WATCH:
+	    watch = true;
+	    break;
 	case ':': // missing param
 	    return 1;
 	case '?': // unknown option: FIXME -> char
@@ -1535,6 +2074,12 @@ main(int argc, char **argv)
 	cerr << PROG_NAME": you must specify a database with --db." << endl;
 	return 1;
     }
+#ifndef HAVE_SYS_INOTIFY_H
+    if (watch) {
+	cerr << PROG_NAME": --watch isn't supported on this platform." << endl;
+	return 1;
+    }
+#endif
     if (baseurl.empty()) {
 	cerr << PROG_NAME": --url not specified, assuming '/'." << endl;
     }
@@ -1622,6 +2167,12 @@ main(int argc, char **argv)
 		numeric_limits<time_t> n;
 		last_mod_max = n.max();
 	    }
+	    if (!journal_path.empty() && !journal.load(journal_path, db)) {
+		if (verbose)
+		    cout << "Journal \"" << journal_path << "\" is missing or "
+			    "out of date - checking files against the database"
+			 << endl;
+	    }
 	} else {
 	    db = Xapian::WritableDatabase(dbpath, Xapian::DB_CREATE_OR_OVERWRITE);
 	}
@@ -1640,7 +2191,21 @@ main(int argc, char **argv)
 	    max_ext_len = max(max_ext_len, mt->first.size());
 	}
 
+	if (jobs > 1) {
+	    workers = new WorkerPool(jobs, extract_text_request, remove_tmpdir);
+	    worker_files.resize(jobs);
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watch) {
+	    inotify_fd = inotify_init();
+	    if (inotify_fd < 0)
+		throw string("inotify_init failed: ") + strerror(errno);
+	}
+#endif
+
 	index_directory(root, baseurl, depth_limit, mime_map, sample_size);
+	finish_queued_files();
 	if (delete_removed_documents && old_docs_not_seen) {
 	    if (verbose) {
 		cout << "Deleting " << old_docs_not_seen << " old documents which weren't found" << endl;
@@ -1665,6 +2230,14 @@ main(int argc, char **argv)
 	    }
 	}
 	db.commit();
+	if (!journal_path.empty()) {
+	    // If we deleted the documents for files we didn't see, we want to
+	    // drop their journal entries too.
+	    journal.save(journal_path, db, delete_removed_documents);
+	}
+#ifdef HAVE_SYS_INOTIFY_H
+	if (watch) watch_for_changes(mime_map, sample_size);
+#endif
 	exitcode = 0;
     } catch (const CommitAndExit &e) {
 	cout << "Exception: " << e.what() << endl;
@@ -1682,6 +2255,9 @@ main(int argc, char **argv)
 	cout << "Caught unknown exception" << endl;
     }
 
+    // Stop any worker processes.
+    delete workers;
+
     // If we created a temporary directory then delete it.
     remove_tmpdir();
 
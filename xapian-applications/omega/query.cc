@@ -50,6 +50,7 @@
 #include "safesysstat.h"
 #include "safefcntl.h"
 
+#include "autoptr.h"
 #include "realtime.h"
 
 #include <cdb.h>
@@ -132,6 +133,46 @@ static string error_msg;
 
 static double secs = -1;
 
+// If true, keep templates and cdb files cached between requests.
+static bool cache_files = false;
+
+struct cached_file {
+    // The device and inode, so we notice if the file is replaced.
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    off_t size;
+
+    cached_file() : dev(0), ino(0), mtime(0), size(0) { }
+
+    explicit cached_file(const struct stat & st)
+	: dev(st.st_dev), ino(st.st_ino), mtime(st.st_mtime), size(st.st_size)
+    { }
+
+    bool operator==(const cached_file & o) const {
+	return dev == o.dev && ino == o.ino && mtime == o.mtime &&
+	       size == o.size;
+    }
+};
+
+class compiled_template;
+
+// Cache of compiled template files, keyed by path.
+static map<string, pair<cached_file, compiled_template *> > template_cache;
+
+// Compiled templates which aren't in template_cache.  Macros defined with $def
+// refer to the template they're defined in, so these can't be deleted until
+// reset_omegascript() is called.
+static vector<compiled_template *> uncached_templates;
+
+struct cached_cdb {
+    cached_file file;
+    struct cdb cdb;
+};
+
+// Cache of open cdb files, keyed by path.
+static map<string, cached_cdb> cdb_cache;
+
 static const char DEFAULT_LOG_ENTRY[] =
 	"$or{$env{REMOTE_HOST},$env{REMOTE_ADDR},-}\t"
 	"[$date{$now,%d/%b/%Y:%H:%M:%S} +0000]\t"
@@ -314,7 +355,8 @@ set_probabilistic(const string &oldp)
 {
     // Parse the query string.
     qp.set_stemming_strategy(option["stem_all"] == "true" ? Xapian::QueryParser::STEM_ALL : Xapian::QueryParser::STEM_SOME);
-    qp.set_stopper(new MyStopper());
+    static MyStopper stopper;
+    qp.set_stopper(&stopper);
     qp.set_default_op(default_op);
     qp.set_database(db);
     // FIXME: provide a custom VRP which handles size:10..20K, etc.
@@ -478,12 +520,13 @@ run_query()
 	}
     }
 
-    Xapian::MatchDecider * mdecider = NULL;
+    AutoPtr<Xapian::MatchDecider> mdecider;
     if (!date_start.empty() || !date_end.empty() || !date_span.empty()) {
 	MCI i = cgi_params.find("DATEVALUE");
 	if (i != cgi_params.end()) {
 	    Xapian::valueno datevalue = string_to_int(i->second);
-	    mdecider = new DateMatchDecider(datevalue, date_start, date_end, date_span);
+	    mdecider.reset(new DateMatchDecider(datevalue, date_start, date_end,
+						date_span));
 	} else {
 	    Xapian::Query date_filter(Xapian::Query::OP_OR,
 				      date_range_filter(date_start, date_end,
@@ -540,7 +583,7 @@ run_query()
 	// can avoid offering a "next" button which leads to an empty page.
 	mset = enquire->get_mset(0, topdoc + hits_per_page,
 				 topdoc + max(hits_per_page + 1, min_hits),
-				 &rset, mdecider);
+				 &rset, mdecider.get());
     }
 }
 
@@ -824,7 +867,8 @@ static int percent;
 static double weight;
 static Xapian::doccount collapsed;
 
-static string print_caption(const string &fmt, const vector<string> &param);
+static string print_caption(const compiled_template &fmt,
+			    const vector<string> &param);
 
 enum tagval {
 CMD_,
@@ -1059,7 +1103,106 @@ T(weight,	   0, 0, N, 0), // weight of the current hit
 
 #undef T // Leaving T defined screws up Sun's C++ compiler!
 
-static vector<string> macros;
+/// One piece of a compiled OmegaScript template.
+struct template_item {
+    enum item_type { ITEM_TEXT, ITEM_PARAM, ITEM_CALL, ITEM_ERROR };
+
+    item_type type;
+
+    /// The text (ITEM_TEXT), function name (ITEM_CALL) or message (ITEM_ERROR).
+    string text;
+
+    /// The number of the parameter to substitute (ITEM_PARAM).
+    unsigned param;
+
+    /// The compiled arguments (ITEM_CALL).
+    vector<compiled_template *> args;
+
+    /** The function to call (ITEM_CALL), or NULL if the name isn't known.
+     *
+     *  $def can change what a name refers to, so this is looked up again if
+     *  func_map_generation has changed since it was last looked up.
+     */
+    mutable const func_attrib * func;
+
+    /// The value of func_map_generation when func was looked up.
+    mutable unsigned generation;
+
+    /// True if value holds the result of calling the builtin function.
+    bool folded;
+
+    /// The result of the call, if it was evaluated at compile time.
+    string value;
+
+    explicit template_item(item_type type_)
+	: type(type_), param(0), func(NULL), generation(0), folded(false) { }
+};
+
+/** An OmegaScript template, parsed so it can be evaluated repeatedly without
+ *  having to scan the text or look up functions each time.
+ */
+class compiled_template {
+    /// Don't allow assignment.
+    void operator=(const compiled_template &);
+
+    /// Don't allow copying.
+    compiled_template(const compiled_template &);
+
+  public:
+    vector<template_item> items;
+
+    compiled_template() { }
+
+    ~compiled_template() {
+	vector<template_item>::const_iterator i;
+	for (i = items.begin(); i != items.end(); ++i) {
+	    vector<compiled_template *>::const_iterator j;
+	    for (j = i->args.begin(); j != i->args.end(); ++j) delete *j;
+	}
+    }
+
+    /// Append literal text, merging it with any literal text before it.
+    void add_text(const string & s, string::size_type pos,
+		  string::size_type len) {
+	if (len == 0) return;
+	if (items.empty() || items.back().type != template_item::ITEM_TEXT)
+	    items.push_back(template_item(template_item::ITEM_TEXT));
+	items.back().text.append(s, pos, len);
+    }
+
+    void add_text(char ch) {
+	add_text(string(1, ch), 0, 1);
+    }
+
+    /// Append an error, to be thrown if evaluation gets this far.
+    void add_error(const string & msg) {
+	items.push_back(template_item(template_item::ITEM_ERROR));
+	items.back().text = msg;
+    }
+
+    /// Return true if this template always evaluates to the same text.
+    bool is_constant() const {
+	return items.empty() ||
+	       (items.size() == 1 &&
+		items[0].type == template_item::ITEM_TEXT);
+    }
+
+    /// The text a constant template evaluates to.
+    string get_constant() const {
+	return items.empty() ? string() : items[0].text;
+    }
+};
+
+static vector<const compiled_template *> macros;
+
+static map<string, const struct func_attrib *> func_map;
+
+// Incremented whenever func_map changes, so compiled templates know to look
+// up function names again.
+static unsigned func_map_generation = 1;
+
+// The value of $dbsize, or 0 if it hasn't been looked up yet.
+static Xapian::doccount dbsize;
 
 // Call write() repeatedly until all data is written or we get a
 // non-recoverable error.
@@ -1078,41 +1221,162 @@ write_all(int fd, const char * buf, size_t count)
     return 0;
 }
 
-static string
-eval(const string &fmt, const vector<string> &param)
+// Open cdb file @a path, or return NULL if it can't be opened.
+//
+// If cache_files is set, the open cdb is cached and reused until the file
+// changes.
+static struct cdb *
+open_cdb(const string & path)
+{
+    struct stat st;
+    if (cache_files) {
+	if (stat(path.c_str(), &st) < 0) return NULL;
+	map<string, cached_cdb>::iterator i = cdb_cache.find(path);
+	if (i != cdb_cache.end()) {
+	    if (i->second.file == cached_file(st)) return &i->second.cdb;
+	    cdb_free(&i->second.cdb);
+	    close(cdb_fileno(&i->second.cdb));
+	    cdb_cache.erase(i);
+	}
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return NULL;
+
+    if (!cache_files) {
+	struct cdb * cdb = new struct cdb;
+	cdb_init(cdb, fd);
+	return cdb;
+    }
+
+    // Use the details of the file we actually opened.
+    if (fstat(fd, &st) < 0) {
+	close(fd);
+	return NULL;
+    }
+    cached_cdb & entry = cdb_cache[path];
+    entry.file = cached_file(st);
+    cdb_init(&entry.cdb, fd);
+    return &entry.cdb;
+}
+
+// Close a cdb file opened by open_cdb() when cache_files isn't set.
+static void
+close_cdb(struct cdb * cdb)
+{
+    int fd = cdb_fileno(cdb);
+    cdb_free(cdb);
+    delete cdb;
+    close(fd);
+}
+
+static void
+init_func_map()
 {
-    static map<string, const struct func_attrib *> func_map;
     if (func_map.empty()) {
 	struct func_desc *p;
 	for (p = func_tab; p->name != NULL; p++) {
 	    func_map[string(p->name)] = &(p->a);
 	}
     }
-    string res;
+}
+
+static const struct func_attrib *
+lookup_function(const string & name)
+{
+    map<string, const struct func_attrib *>::const_iterator i;
+    i = func_map.find(name);
+    if (i == func_map.end()) return NULL;
+    return i->second;
+}
+
+// Return true if the builtin function with tag @a tag has no side effects and
+// its result depends only on its arguments.
+static bool
+is_pure_function(int tag)
+{
+    switch (tag) {
+	case CMD_add: case CMD_div: case CMD_eq: case CMD_ge: case CMD_gt:
+	case CMD_hostname: case CMD_html: case CMD_htmlstrip: case CMD_json:
+	case CMD_jsonarray: case CMD_le: case CMD_length: case CMD_lower:
+	case CMD_lt: case CMD_max: case CMD_min: case CMD_mod: case CMD_mul:
+	case CMD_muldiv: case CMD_ne: case CMD_not: case CMD_sub:
+	case CMD_substr: case CMD_uniq: case CMD_unpack: case CMD_upper:
+	case CMD_url:
+	    return true;
+    }
+    return false;
+}
+
+static void
+eval_call(const template_item & call, const struct func_attrib * func,
+	  vector<string> & args, const vector<string> & param,
+	  string & value);
+
+// If @a call is to a pure builtin function and all its arguments are
+// constant, evaluate it now so it doesn't need evaluating every time.
+static void
+fold_constant_call(template_item & call)
+{
+    const struct func_attrib * func = call.func;
+    if (func->tag >= CMD_MACRO || !is_pure_function(func->tag)) return;
+
+    vector<string> args;
+    vector<compiled_template *>::const_iterator i;
+    for (i = call.args.begin(); i != call.args.end(); ++i) {
+	if (!(*i)->is_constant()) return;
+	args.push_back((*i)->get_constant());
+    }
+    if ((int)args.size() < func->minargs) return;
+    if (func->maxargs != N && (int)args.size() > func->maxargs) return;
+
+    try {
+	vector<string> noparam;
+	eval_call(call, func, args, noparam, call.value);
+	call.folded = true;
+    } catch (...) {
+	// Leave it to be evaluated (and fail) when it's reached.
+	call.value.resize(0);
+    }
+}
+
+// Compile the OmegaScript in @a fmt.
+//
+// Any errors in @a fmt are compiled into the template, and only reported if
+// evaluation reaches them.
+static compiled_template *
+compile(const string &fmt)
+{
+    init_func_map();
+    compiled_template * tmpl = new compiled_template;
     string::size_type p = 0, q;
-    while ((q = fmt.find('$', p)) != string::npos) try {
-	res += fmt.substr(p, q - p);
+    while ((q = fmt.find('$', p)) != string::npos) {
+	tmpl->add_text(fmt, p, q - p);
 	string::size_type code_start = q; // note down for error reporting
 	q++;
-	if (q >= fmt.size()) break;
+	if (q >= fmt.size()) {
+	    // Output a trailing '$' literally.
+	    p = code_start;
+	    break;
+	}
 	unsigned char ch = fmt[q];
 	switch (ch) {
 	    // Magic sequences:
 	    // '$$' -> '$', '$(' -> '{', '$)' -> '}', '$.' -> ','
 	    case '$':
-		res += '$';
+		tmpl->add_text('$');
 		p = q + 1;
 		continue;
 	    case '(':
-		res += '{';
+		tmpl->add_text('{');
 		p = q + 1;
 		continue;
 	    case ')':
-		res += '}';
+		tmpl->add_text('}');
 		p = q + 1;
 		continue;
 	    case '.':
-		res += ',';
+		tmpl->add_text(',');
 		p = q + 1;
 		continue;
 	    case '_':
@@ -1120,8 +1384,8 @@ eval(const string &fmt, const vector<string> &param)
 		// FALL THRU
 	    case '1': case '2': case '3': case '4': case '5':
 	    case '6': case '7': case '8': case '9':
-		ch -= '0';
-		if (ch < param.size()) res += param[ch];
+		tmpl->items.push_back(template_item(template_item::ITEM_PARAM));
+		tmpl->items.back().param = ch - '0';
 		p = q + 1;
 		continue;
 	    case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
@@ -1137,993 +1401,1075 @@ eval(const string &fmt, const vector<string> &param)
 	    case '{':
 		break;
 	    default:
-		string msg = "Unknown $ code in: $" + fmt.substr(q);
-		throw msg;
+		tmpl->add_error("Unknown $ code in: $" + fmt.substr(q));
+		return tmpl;
 	}
 	p = find_if(fmt.begin() + q, fmt.end(), p_notid) - fmt.begin();
-	string var = fmt.substr(q, p - q);
-	map<string, const struct func_attrib *>::const_iterator func;
-	func = func_map.find(var);
-	if (func == func_map.end()) {
-	    throw "Unknown function '" + var + "'";
-	}
-	vector<string> args;
+	template_item call(template_item::ITEM_CALL);
+	call.text.assign(fmt, q, p - q);
+	call.func = lookup_function(call.text);
+	call.generation = func_map_generation;
+	// Names which aren't known yet may be macros defined later, which
+	// take split arguments.
+	bool split_args = (call.func == NULL || call.func->minargs != N);
 	if (fmt[p] == '{') {
 	    q = p + 1;
 	    int nest = 1;
 	    while (true) {
 		p = fmt.find_first_of(",{}", p + 1);
-		if (p == string::npos)
-		    throw "missing } in " + fmt.substr(code_start);
+		if (p == string::npos) {
+		    vector<compiled_template *>::const_iterator i;
+		    for (i = call.args.begin(); i != call.args.end(); ++i)
+			delete *i;
+		    tmpl->add_error("missing } in " + fmt.substr(code_start));
+		    return tmpl;
+		}
 		if (fmt[p] == '{') {
 		    ++nest;
 		} else {
 		    if (nest == 1) {
 			// should we split the args
-			if (func->second->minargs != N) {
-			    args.push_back(fmt.substr(q, p - q));
+			if (split_args) {
+			    call.args.push_back(compile(fmt.substr(q, p - q)));
 			    q = p + 1;
 			}
 		    }
 		    if (fmt[p] == '}' && --nest == 0) break;
 		}
 	    }
-	    if (func->second->minargs == N)
-		args.push_back(fmt.substr(q, p - q));
+	    if (!split_args)
+		call.args.push_back(compile(fmt.substr(q, p - q)));
 	    p++;
 	}
+	if (call.func) fold_constant_call(call);
+	tmpl->items.push_back(call);
+    }
+
+    tmpl->add_text(fmt, p, string::npos);
+    return tmpl;
+}
 
-	if (func->second->minargs != N) {
-	    if ((int)args.size() < func->second->minargs)
-		throw "too few arguments to $" + var;
-	    if (func->second->maxargs != N &&
-		(int)args.size() > func->second->maxargs)
-		throw "too many arguments to $" + var;
+static string
+eval(const compiled_template &tmpl, const vector<string> &param)
+{
+    string res;
+    vector<template_item>::const_iterator i;
+    for (i = tmpl.items.begin(); i != tmpl.items.end(); ++i) try {
+	switch (i->type) {
+	    case template_item::ITEM_TEXT:
+		res += i->text;
+		continue;
+	    case template_item::ITEM_PARAM:
+		if (i->param < param.size()) res += param[i->param];
+		continue;
+	    case template_item::ITEM_ERROR:
+		throw i->text;
+	    case template_item::ITEM_CALL:
+		break;
+	}
+	if (i->generation != func_map_generation) {
+	    init_func_map();
+	    i->func = lookup_function(i->text);
+	    i->generation = func_map_generation;
+	}
+	const struct func_attrib * func = i->func;
+	if (func == NULL) {
+	    throw "Unknown function '" + i->text + "'";
+	}
+	if (i->folded && func->tag < CMD_MACRO) {
+	    res += i->value;
+	    continue;
+	}
+	vector<string> args(i->args.size());
+	if (func->minargs != N) {
+	    if ((int)args.size() < func->minargs)
+		throw "too few arguments to $" + i->text;
+	    if (func->maxargs != N && (int)args.size() > func->maxargs)
+		throw "too many arguments to $" + i->text;
 
 	    vector<string>::size_type n;
-	    if (func->second->evalargs != N)
-		n = func->second->evalargs;
+	    if (func->evalargs != N)
+		n = func->evalargs;
 	    else
 		n = args.size();
 
+	    // Arguments which aren't evaluated here are left empty - the
+	    // function evaluates them from the compiled form if it needs to.
 	    for (vector<string>::size_type j = 0; j < n; j++)
-		args[j] = eval(args[j], param);
+		args[j] = eval(*i->args[j], param);
 	}
-	if (func->second->ensure == 'Q' || func->second->ensure == 'M')
+	if (func->ensure == 'Q' || func->ensure == 'M')
 	    ensure_query_parsed();
-	if (func->second->ensure == 'M') ensure_match();
+	if (func->ensure == 'M') ensure_match();
 	string value;
-	switch (func->second->tag) {
-	    case CMD_:
-	        break;
-	    case CMD_add: {
-		int total = 0;
-		vector<string>::const_iterator i;
-		for (i = args.begin(); i != args.end(); i++)
-		    total += string_to_int(*i);
-		value = str(total);
-		break;
-	    }
-	    case CMD_addfilter:
-		add_bterm(args[0]);
-		break;
-	    case CMD_allterms: {
-		// list of all terms indexing document
-		int id = q0;
-		if (!args.empty()) id = string_to_int(args[0]);
-		Xapian::TermIterator term = db.termlist_begin(id);
-		for ( ; term != db.termlist_end(id); term++)
-		    value = value + *term + '\t';
+	eval_call(*i, func, args, param, value);
+	res += value;
+    } catch (const Xapian::Error & e) {
+	// FIXME: this means we only see the most recent error in $error
+	// - is that the best approach?
+	error_msg = e.get_msg();
+    }
+    return res;
+}
 
-		if (!value.empty()) value.erase(value.size() - 1);
-		break;
-	    }
-	    case CMD_and: {
-		value = "true";
-		for (vector<string>::const_iterator i = args.begin();
-		     i != args.end(); i++) {
-		    if (eval(*i, param).empty()) {
-			value.resize(0);
-			break;
-		    }
-	        }
-		break;
-	    }
-	    case CMD_cgi: {
-		MCI i = cgi_params.find(args[0]);
-		if (i != cgi_params.end()) value = i->second;
-		break;
-	    }
-	    case CMD_cgilist: {
-		pair<MCI, MCI> g;
-		g = cgi_params.equal_range(args[0]);
-		for (MCI i = g.first; i != g.second; i++)
-		    value = value + i->second + '\t';
-		if (!value.empty()) value.erase(value.size() - 1);
-		break;
-	    }
-	    case CMD_collapsed: {
-		value = str(collapsed);
-		break;
-	    }
-	    case CMD_date:
-		value = args[0];
-		if (!value.empty()) {
-		    char buf[64] = "";
-		    time_t date = string_to_int(value);
-		    if (date != (time_t)-1) {
-			struct tm *then;
-			then = gmtime(&date);
-			string date_fmt = "%Y-%m-%d";
-			if (args.size() > 1) date_fmt = eval(args[1], param);
-			strftime(buf, sizeof buf, date_fmt.c_str(), then);
-		    }
-		    value = buf;
+// Call the function @a func with arguments @a args, putting the result in
+// @a value.
+static void
+eval_call(const template_item & call, const struct func_attrib * func,
+	  vector<string> & args, const vector<string> & param,
+	  string & value)
+{
+    switch (func->tag) {
+	case CMD_:
+	    break;
+	case CMD_add: {
+	    int total = 0;
+	    vector<string>::const_iterator i;
+	    for (i = args.begin(); i != args.end(); i++)
+		total += string_to_int(*i);
+	    value = str(total);
+	    break;
+	}
+	case CMD_addfilter:
+	    add_bterm(args[0]);
+	    break;
+	case CMD_allterms: {
+	    // list of all terms indexing document
+	    int id = q0;
+	    if (!args.empty()) id = string_to_int(args[0]);
+	    Xapian::TermIterator term = db.termlist_begin(id);
+	    for ( ; term != db.termlist_end(id); term++)
+		value = value + *term + '\t';
+
+	    if (!value.empty()) value.erase(value.size() - 1);
+	    break;
+	}
+	case CMD_and: {
+	    value = "true";
+	    vector<compiled_template *>::const_iterator i;
+	    for (i = call.args.begin(); i != call.args.end(); i++) {
+		if (eval(**i, param).empty()) {
+		    value.resize(0);
+		    break;
 		}
-		break;
-	    case CMD_dbname:
-		value = dbname;
-		break;
-	    case CMD_dbsize: {
-		static Xapian::doccount dbsize;
-		if (!dbsize) dbsize = db.get_doccount();
-		value = str(dbsize);
-		break;
 	    }
-	    case CMD_def: {
-		func_attrib *fa = new func_attrib;
-		fa->tag = CMD_MACRO + macros.size();
-		fa->minargs = 0;
-		fa->maxargs = 9;
-		fa->evalargs = N; // FIXME: or 0?
-		fa->ensure = 0;
-
-		macros.push_back(args[1]);
-		func_map[args[0]] = fa;
-		break;
-	    }
-	    case CMD_defaultop:
-		if (default_op == Xapian::Query::OP_AND) {
-		    value = "and";
-		} else {
-		    value = "or";
-		}
-		break;
-	    case CMD_div: {
-		int denom = string_to_int(args[1]);
-		if (denom == 0) {
-		    value = "divide by 0";
-		} else {
-		    value = str(string_to_int(args[0]) /
-				string_to_int(args[1]));
+	    break;
+	}
+	case CMD_cgi: {
+	    MCI i = cgi_params.find(args[0]);
+	    if (i != cgi_params.end()) value = i->second;
+	    break;
+	}
+	case CMD_cgilist: {
+	    pair<MCI, MCI> g;
+	    g = cgi_params.equal_range(args[0]);
+	    for (MCI i = g.first; i != g.second; i++)
+		value = value + i->second + '\t';
+	    if (!value.empty()) value.erase(value.size() - 1);
+	    break;
+	}
+	case CMD_collapsed: {
+	    value = str(collapsed);
+	    break;
+	}
+	case CMD_date:
+	    value = args[0];
+	    if (!value.empty()) {
+		char buf[64] = "";
+		time_t date = string_to_int(value);
+		if (date != (time_t)-1) {
+		    struct tm *then;
+		    then = gmtime(&date);
+		    string date_fmt = "%Y-%m-%d";
+		    if (args.size() > 1) date_fmt = eval(*call.args[1], param);
+		    strftime(buf, sizeof buf, date_fmt.c_str(), then);
 		}
-		break;
+		value = buf;
 	    }
-	    case CMD_eq:
-		if (args[0] == args[1]) value = "true";
-		break;
-	    case CMD_emptydocs: {
-		string t;
-		if (!args.empty())
-		    t = args[0];
-		Xapian::PostingIterator i;
-		for (i = db.postlist_begin(t); i != db.postlist_end(t); ++i) {
-		    if (i.get_doclength() != 0) continue;
-		    if (!value.empty()) value += '\t';
-		    value += str(*i);
-		}
-		break;
+	    break;
+	case CMD_dbname:
+	    value = dbname;
+	    break;
+	case CMD_dbsize:
+	    if (!dbsize) dbsize = db.get_doccount();
+	    value = str(dbsize);
+	    break;
+	case CMD_def: {
+	    func_attrib *fa = new func_attrib;
+	    fa->tag = CMD_MACRO + macros.size();
+	    fa->minargs = 0;
+	    fa->maxargs = 9;
+	    fa->evalargs = N; // FIXME: or 0?
+	    fa->ensure = 0;
+
+	    macros.push_back(call.args[1]);
+	    func_map[args[0]] = fa;
+	    ++func_map_generation;
+	    break;
+	}
+	case CMD_defaultop:
+	    if (default_op == Xapian::Query::OP_AND) {
+		value = "and";
+	    } else {
+		value = "or";
 	    }
-	    case CMD_env: {
-		char *env = getenv(args[0].c_str());
-		if (env != NULL) value = env;
-		break;
+	    break;
+	case CMD_div: {
+	    int denom = string_to_int(args[1]);
+	    if (denom == 0) {
+		value = "divide by 0";
+	    } else {
+		value = str(string_to_int(args[0]) /
+			    string_to_int(args[1]));
 	    }
-	    case CMD_error:
-		if (error_msg.empty() && enquire == NULL && !dbname.empty()) {
-		    error_msg = "Database '" + dbname + "' couldn't be opened";
-		}
-		value = error_msg;
-		break;
-	    case CMD_field: {
-		Xapian::docid did = q0;
-		if (args.size() > 1) did = string_to_int(args[1]);
-		value = fields.get_field(did, args[0]);
-		break;
+	    break;
+	}
+	case CMD_eq:
+	    if (args[0] == args[1]) value = "true";
+	    break;
+	case CMD_emptydocs: {
+	    string t;
+	    if (!args.empty())
+		t = args[0];
+	    Xapian::PostingIterator i;
+	    for (i = db.postlist_begin(t); i != db.postlist_end(t); ++i) {
+		if (i.get_doclength() != 0) continue;
+		if (!value.empty()) value += '\t';
+		value += str(*i);
+	    }
+	    break;
+	}
+	case CMD_env: {
+	    char *env = getenv(args[0].c_str());
+	    if (env != NULL) value = env;
+	    break;
+	}
+	case CMD_error:
+	    if (error_msg.empty() && enquire == NULL && !dbname.empty()) {
+		error_msg = "Database '" + dbname + "' couldn't be opened";
 	    }
-	    case CMD_filesize: {
-		// FIXME: rounding?  i18n?
-		int size = string_to_int(args[0]);
-		int intpart = size;
-		int fraction = -1;
-		const char * format = 0;
-		if (size < 0) {
-		    // Negative size -> empty result.
-		} else if (size == 1) {
-		    format = "%d byte";
-		} else if (size < 1024) {
-		    format = "%d bytes";
+	    value = error_msg;
+	    break;
+	case CMD_field: {
+	    Xapian::docid did = q0;
+	    if (args.size() > 1) did = string_to_int(args[1]);
+	    value = fields.get_field(did, args[0]);
+	    break;
+	}
+	case CMD_filesize: {
+	    // FIXME: rounding?  i18n?
+	    int size = string_to_int(args[0]);
+	    int intpart = size;
+	    int fraction = -1;
+	    const char * format = 0;
+	    if (size < 0) {
+		// Negative size -> empty result.
+	    } else if (size == 1) {
+		format = "%d byte";
+	    } else if (size < 1024) {
+		format = "%d bytes";
+	    } else {
+		if (size < 1024*1024) {
+		    format = "%d.%cK";
 		} else {
+		    size /= 1024;
 		    if (size < 1024*1024) {
-			format = "%d.%cK";
+			format = "%d.%cM";
 		    } else {
 			size /= 1024;
-			if (size < 1024*1024) {
-			    format = "%d.%cM";
-			} else {
-			    size /= 1024;
-			    format = "%d.%cG";
-			}
-		    }
-		    intpart = unsigned(size) / 1024;
-		    fraction = unsigned(size) % 1024;
-		}
-		if (format) {
-		    char buf[200];
-		    int len;
-		    if (fraction == -1) {
-			len = my_snprintf(buf, sizeof(buf), format, intpart);
-		    } else {
-			fraction = (fraction * 10 / 1024) + '0';
-			len = my_snprintf(buf, sizeof(buf), format, intpart, fraction);
+			format = "%d.%cG";
 		    }
-		    if (len < 0 || (unsigned)len > sizeof(buf)) len = sizeof(buf);
-		    value.assign(buf, len);
 		}
-		break;
+		intpart = unsigned(size) / 1024;
+		fraction = unsigned(size) % 1024;
 	    }
-	    case CMD_filters:
-		value = filters;
-		break;
-	    case CMD_filterterms: {
-		Xapian::TermIterator term = db.allterms_begin();
-		term.skip_to(args[0]);
-		while (term != db.allterms_end()) {
-		    string t = *term;
-		    if (!startswith(t, args[0])) break;
-		    value = value + t + '\t';
-		    ++term;
+	    if (format) {
+		char buf[200];
+		int len;
+		if (fraction == -1) {
+		    len = my_snprintf(buf, sizeof(buf), format, intpart);
+		} else {
+		    fraction = (fraction * 10 / 1024) + '0';
+		    len = my_snprintf(buf, sizeof(buf), format, intpart, fraction);
 		}
-
-		if (!value.empty()) value.erase(value.size() - 1);
-		break;
+		if (len < 0 || (unsigned)len > sizeof(buf)) len = sizeof(buf);
+		value.assign(buf, len);
 	    }
-	    case CMD_find: {
-		string l = args[0], s = args[1];
-		string::size_type i = 0, j = 0;
-		size_t count = 0;
-		while (j != l.size()) {
-		    j = l.find('\t', i);
-		    if (j == string::npos) j = l.size();
-		    if (j - i == s.length()) {
-			if (memcmp(s.data(), l.data() + i, j - i) == 0) {
-			    value = str(count);
-			    break;
-			}
-		    }
-		    ++count;
-		    i = j + 1;
-		}
-		break;
+	    break;
+	}
+	case CMD_filters:
+	    value = filters;
+	    break;
+	case CMD_filterterms: {
+	    Xapian::TermIterator term = db.allterms_begin();
+	    term.skip_to(args[0]);
+	    while (term != db.allterms_end()) {
+		string t = *term;
+		if (!startswith(t, args[0])) break;
+		value = value + t + '\t';
+		++term;
 	    }
-	    case CMD_fmt:
-		value = fmtname;
-		break;
-	    case CMD_freq:
-		try {
-		    value = str(mset.get_termfreq(args[0]));
-		} catch (const Xapian::InvalidOperationError&) {
-		    // An MSet will raise this error if it's empty and not
-		    // associated with a search.
-		    value = str(db.get_termfreq(args[0]));
-		}
-		break;
-            case CMD_ge:
-		if (string_to_int(args[0]) >= string_to_int(args[1]))
-		    value = "true";
-		break;
-            case CMD_gt:
-		if (string_to_int(args[0]) > string_to_int(args[1]))
-		    value = "true";
-		break;
-	    case CMD_highlight: {
-		string bra, ket;
-		if (args.size() > 2) {
-		    bra = args[2];
-		    if (args.size() > 3) {
-			ket = args[3];
-		    } else {
-			string::const_iterator i;
-			i = find_if(bra.begin() + 2, bra.end(), p_nottag);
-			ket = "</";
-			ket += bra.substr(1, i - bra.begin() - 1);
-			ket += '>';
-		    }
-		}
 
-		value = html_highlight(args[0], args[1], bra, ket);
-		break;
-	    }
-	    case CMD_hit:
-		// 0-based mset index
-		value = str(hit_no);
-		break;
-	    case CMD_hitlist:
-#if 0
-		const char *q;
-		int ch;
-
-		url_query_string = "?DB=";
-		url_query_string += dbname;
-		url_query_string += "&P=";
-		q = probabilistic_query[string()].c_str();
-		while ((ch = *q++) != '\0') {
-		    switch (ch) {
-		     case '+':
-			url_query_string += "%2b";
-			break;
-		     case '"':
-			url_query_string += "%22";
+	    if (!value.empty()) value.erase(value.size() - 1);
+	    break;
+	}
+	case CMD_find: {
+	    string l = args[0], s = args[1];
+	    string::size_type i = 0, j = 0;
+	    size_t count = 0;
+	    while (j != l.size()) {
+		j = l.find('\t', i);
+		if (j == string::npos) j = l.size();
+		if (j - i == s.length()) {
+		    if (memcmp(s.data(), l.data() + i, j - i) == 0) {
+			value = str(count);
 			break;
-		     case ' ':
-			ch = '+';
-			/* fall through */
-		     default:
-			url_query_string += ch;
 		    }
 		}
-	        // add any boolean terms
-		for (FMCI i = filter_map.begin(); i != filter_map.end(); i++) {
-		    url_query_string += "&B=";
-		    url_query_string += i->second;
-		}
-#endif
-		for (hit_no = topdoc; hit_no < last; hit_no++)
-		    value += print_caption(args[0], param);
-		hit_no = 0;
-		break;
-	    case CMD_hitsperpage:
-		value = str(hits_per_page);
-		break;
-	    case CMD_hostname: {
-	        value = args[0];
-		// remove URL scheme and/or path
-		string::size_type i = value.find("://");
-		if (i == string::npos) i = 0; else i += 3;
-		value = value.substr(i, value.find('/', i) - i);
-		// remove user@ or user:password@
-		i = value.find('@');
-		if (i != string::npos) value.erase(0, i + 1);
-		// remove :port
-		i = value.find(':');
-		if (i != string::npos) value.resize(i);
-		break;
+		++count;
+		i = j + 1;
 	    }
-	    case CMD_html:
-	        value = html_escape(args[0]);
-		break;
-	    case CMD_htmlstrip:
-	        value = html_strip(args[0]);
-		break;
-	    case CMD_httpheader:
-		if (!suppress_http_headers) {
-		    cout << args[0] << ": " << args[1] << endl;
-		    if (!set_content_type && args[0].length() == 12 &&
-			    strcasecmp(args[0].c_str(), "Content-Type") == 0) {
-			set_content_type = true;
-		    }
+	    break;
+	}
+	case CMD_fmt:
+	    value = fmtname;
+	    break;
+	case CMD_freq:
+	    try {
+		value = str(mset.get_termfreq(args[0]));
+	    } catch (const Xapian::InvalidOperationError&) {
+		// An MSet will raise this error if it's empty and not
+		// associated with a search.
+		value = str(db.get_termfreq(args[0]));
+	    }
+	    break;
+	case CMD_ge:
+	    if (string_to_int(args[0]) >= string_to_int(args[1]))
+		value = "true";
+	    break;
+	case CMD_gt:
+	    if (string_to_int(args[0]) > string_to_int(args[1]))
+		value = "true";
+	    break;
+	case CMD_highlight: {
+	    string bra, ket;
+	    if (args.size() > 2) {
+		bra = args[2];
+		if (args.size() > 3) {
+		    ket = args[3];
+		} else {
+		    string::const_iterator i;
+		    i = find_if(bra.begin() + 2, bra.end(), p_nottag);
+		    ket = "</";
+		    ket += bra.substr(1, i - bra.begin() - 1);
+		    ket += '>';
 		}
-	        break;
-	    case CMD_id:
-		// document id
-		value = str(q0);
-		break;
-	    case CMD_if:
-		if (!args[0].empty())
-		    value = eval(args[1], param);
-		else if (args.size() > 2)
-		    value = eval(args[2], param);
-		break;
-	    case CMD_include:
-	        value = eval_file(args[0]);
-	        break;
-	    case CMD_json:
-		value = args[0];
-		json_escape(value);
-		break;
-	    case CMD_jsonarray: {
-		const string & l = args[0];
-		string::size_type i = 0, j;
-		if (l.empty()) {
-		    value = "[]";
+	    }
+
+	    value = html_highlight(args[0], args[1], bra, ket);
+	    break;
+	}
+	case CMD_hit:
+	    // 0-based mset index
+	    value = str(hit_no);
+	    break;
+	case CMD_hitlist:
+#if 0
+	    const char *q;
+	    int ch;
+
+	    url_query_string = "?DB=";
+	    url_query_string += dbname;
+	    url_query_string += "&P=";
+	    q = probabilistic_query[string()].c_str();
+	    while ((ch = *q++) != '\0') {
+		switch (ch) {
+		 case '+':
+		    url_query_string += "%2b";
+		    break;
+		 case '"':
+		    url_query_string += "%22";
 		    break;
+		 case ' ':
+		    ch = '+';
+		    /* fall through */
+		 default:
+		    url_query_string += ch;
 		}
-		value = "[\"]";
-		while (true) {
-		    j = l.find('\t', i);
-		    string elt(l, i, j - i);
-		    json_escape(elt);
-		    value += elt;
-		    if (j == string::npos) break;
-		    value += "\",\"";
-		    i = j + 1;
+	    }
+	    // add any boolean terms
+	    for (FMCI i = filter_map.begin(); i != filter_map.end(); i++) {
+		url_query_string += "&B=";
+		url_query_string += i->second;
+	    }
+#endif
+	    for (hit_no = topdoc; hit_no < last; hit_no++)
+		value += print_caption(*call.args[0], param);
+	    hit_no = 0;
+	    break;
+	case CMD_hitsperpage:
+	    value = str(hits_per_page);
+	    break;
+	case CMD_hostname: {
+	    value = args[0];
+	    // remove URL scheme and/or path
+	    string::size_type i = value.find("://");
+	    if (i == string::npos) i = 0; else i += 3;
+	    value = value.substr(i, value.find('/', i) - i);
+	    // remove user@ or user:password@
+	    i = value.find('@');
+	    if (i != string::npos) value.erase(0, i + 1);
+	    // remove :port
+	    i = value.find(':');
+	    if (i != string::npos) value.resize(i);
+	    break;
+	}
+	case CMD_html:
+	    value = html_escape(args[0]);
+	    break;
+	case CMD_htmlstrip:
+	    value = html_strip(args[0]);
+	    break;
+	case CMD_httpheader:
+	    if (!suppress_http_headers) {
+		cout << args[0] << ": " << args[1] << endl;
+		if (!set_content_type && args[0].length() == 12 &&
+			strcasecmp(args[0].c_str(), "Content-Type") == 0) {
+		    set_content_type = true;
 		}
-		value += "\"]";
-		break;
 	    }
-	    case CMD_last:
-		value = str(last);
-		break;
-	    case CMD_lastpage: {
-		int l = mset.get_matches_estimated();
-		if (l > 0) l = (l - 1) / hits_per_page + 1;
-		value = str(l);
+	    break;
+	case CMD_id:
+	    // document id
+	    value = str(q0);
+	    break;
+	case CMD_if:
+	    if (!args[0].empty())
+		value = eval(*call.args[1], param);
+	    else if (args.size() > 2)
+		value = eval(*call.args[2], param);
+	    break;
+	case CMD_include:
+	    value = eval_file(args[0]);
+	    break;
+	case CMD_json:
+	    value = args[0];
+	    json_escape(value);
+	    break;
+	case CMD_jsonarray: {
+	    const string & l = args[0];
+	    string::size_type i = 0, j;
+	    if (l.empty()) {
+		value = "[]";
 		break;
 	    }
-            case CMD_le:
-		if (string_to_int(args[0]) <= string_to_int(args[1]))
-		    value = "true";
-		break;
-            case CMD_length:
-		if (args[0].empty()) {
-		    value = "0";
-		} else {
-		    size_t length = count(args[0].begin(), args[0].end(), '\t');
-		    value = str(length + 1);
+	    value = "[\"]";
+	    while (true) {
+		j = l.find('\t', i);
+		string elt(l, i, j - i);
+		json_escape(elt);
+		value += elt;
+		if (j == string::npos) break;
+		value += "\",\"";
+		i = j + 1;
+	    }
+	    value += "\"]";
+	    break;
+	}
+	case CMD_last:
+	    value = str(last);
+	    break;
+	case CMD_lastpage: {
+	    int l = mset.get_matches_estimated();
+	    if (l > 0) l = (l - 1) / hits_per_page + 1;
+	    value = str(l);
+	    break;
+	}
+	case CMD_le:
+	    if (string_to_int(args[0]) <= string_to_int(args[1]))
+		value = "true";
+	    break;
+	case CMD_length:
+	    if (args[0].empty()) {
+		value = "0";
+	    } else {
+		size_t length = count(args[0].begin(), args[0].end(), '\t');
+		value = str(length + 1);
+	    }
+	    break;
+	case CMD_list: {
+	    if (!args[0].empty()) {
+		string pre, inter, interlast, post;
+		switch (args.size()) {
+		 case 2:
+		    inter = interlast = args[1];
+		    break;
+		 case 3:
+		    inter = args[1];
+		    interlast = args[2];
+		    break;
+		 case 4:
+		    pre = args[1];
+		    inter = interlast = args[2];
+		    post = args[3];
+		    break;
+		 case 5:
+		    pre = args[1];
+		    inter = args[2];
+		    interlast = args[3];
+		    post = args[4];
+		    break;
 		}
-		break;
-	    case CMD_list: {
-		if (!args[0].empty()) {
-		    string pre, inter, interlast, post;
-		    switch (args.size()) {
-		     case 2:
-			inter = interlast = args[1];
-			break;
-		     case 3:
-			inter = args[1];
-			interlast = args[2];
-			break;
-		     case 4:
-			pre = args[1];
-			inter = interlast = args[2];
-			post = args[3];
-			break;
-		     case 5:
-			pre = args[1];
-			inter = args[2];
-			interlast = args[3];
-			post = args[4];
-			break;
-		    }
-		    value += pre;
-		    string list = args[0];
-		    string::size_type split = 0, split2;
-		    while ((split2 = list.find('\t', split)) != string::npos) {
-			if (split) value += inter;
-			value += list.substr(split, split2 - split);
-			split = split2 + 1;
-		    }
-		    if (split) value += interlast;
-		    value += list.substr(split);
-		    value += post;
+		value += pre;
+		string list = args[0];
+		string::size_type split = 0, split2;
+		while ((split2 = list.find('\t', split)) != string::npos) {
+		    if (split) value += inter;
+		    value += list.substr(split, split2 - split);
+		    split = split2 + 1;
 		}
-		break;
+		if (split) value += interlast;
+		value += list.substr(split);
+		value += post;
 	    }
-	    case CMD_log: {
-		if (!vet_filename(args[0])) break;
-		string logfile = log_dir + args[0];
-	        int fd = open(logfile.c_str(), O_CREAT|O_APPEND|O_WRONLY, 0644);
-		if (fd == -1) break;
-		vector<string> noargs;
-		noargs.resize(1);
-		string line;
-		if (args.size() > 1) {
-		    line = args[1];
-		} else {
-		    line = DEFAULT_LOG_ENTRY;
-		}
-		line = eval(line, noargs);
-		line += '\n';
-		(void)write_all(fd, line.data(), line.length());
-		close(fd);
-		break;
+	    break;
+	}
+	case CMD_log: {
+	    if (!vet_filename(args[0])) break;
+	    string logfile = log_dir + args[0];
+	    int fd = open(logfile.c_str(), O_CREAT|O_APPEND|O_WRONLY, 0644);
+	    if (fd == -1) break;
+	    vector<string> noargs;
+	    noargs.resize(1);
+	    const compiled_template * line_fmt;
+	    if (args.size() > 1) {
+		line_fmt = call.args[1];
+	    } else {
+		static const compiled_template * default_log_entry =
+		    compile(DEFAULT_LOG_ENTRY);
+		line_fmt = default_log_entry;
 	    }
-	    case CMD_lookup: {
-		if (!vet_filename(args[0])) break;
-		string cdbfile = cdb_dir + args[0];
-	        int fd = open(cdbfile.c_str(), O_RDONLY);
-		if (fd == -1) break;
-
-		struct cdb cdb;
-		cdb_init(&cdb, fd);
-
-		if (cdb_find(&cdb, args[1].data(), args[1].length()) > 0) {
-		    size_t datalen = cdb_datalen(&cdb);
-		    const void *dat = cdb_get(&cdb, datalen, cdb_datapos(&cdb));
-		    if (q) {
-			value = string(static_cast<const char *>(dat), datalen);
-		    }
-		}
-
-		cdb_free(&cdb);
-		close(fd); // FIXME: cache fds?
-		break;
+	    string line = eval(*line_fmt, noargs);
+	    line += '\n';
+	    (void)write_all(fd, line.data(), line.length());
+	    close(fd);
+	    break;
+	}
+	case CMD_lookup: {
+	    if (!vet_filename(args[0])) break;
+	    string cdbfile = cdb_dir + args[0];
+	    struct cdb * cdb = open_cdb(cdbfile);
+	    if (!cdb) break;
+
+	    if (cdb_find(cdb, args[1].data(), args[1].length()) > 0) {
+		size_t datalen = cdb_datalen(cdb);
+		const void *dat = cdb_get(cdb, datalen, cdb_datapos(cdb));
+		value = string(static_cast<const char *>(dat), datalen);
 	    }
-	    case CMD_lower:
-		value = Xapian::Unicode::tolower(args[0]);
-		break;
-            case CMD_lt:
-		if (string_to_int(args[0]) < string_to_int(args[1]))
-		    value = "true";
-		break;
-	    case CMD_map:
-		if (!args[0].empty()) {
-		    string l = args[0], pat = args[1];
-		    vector<string> new_args(param);
-		    string::size_type i = 0, j;
-		    while (true) {
-			j = l.find('\t', i);
-			new_args[0] = l.substr(i, j - i);
-			value += eval(pat, new_args);
-			if (j == string::npos) break;
-			value += '\t';
-			i = j + 1;
-		    }
+
+	    if (!cache_files) close_cdb(cdb);
+	    break;
+	}
+	case CMD_lower:
+	    value = Xapian::Unicode::tolower(args[0]);
+	    break;
+	case CMD_lt:
+	    if (string_to_int(args[0]) < string_to_int(args[1]))
+		value = "true";
+	    break;
+	case CMD_map:
+	    if (!args[0].empty()) {
+		const string & l = args[0];
+		const compiled_template & pat = *call.args[1];
+		vector<string> new_args(param);
+		string::size_type i = 0, j;
+		while (true) {
+		    j = l.find('\t', i);
+		    new_args[0] = l.substr(i, j - i);
+		    value += eval(pat, new_args);
+		    if (j == string::npos) break;
+		    value += '\t';
+		    i = j + 1;
 		}
-	        break;
-	    case CMD_max: {
-		vector<string>::const_iterator i = args.begin();
-		int val = string_to_int(*i++);
-		for (; i != args.end(); i++) {
-		    int x = string_to_int(*i);
-		    if (x > val) val = x;
-	        }
-		value = str(val);
-		break;
 	    }
-	    case CMD_min: {
-		vector<string>::const_iterator i = args.begin();
-		int val = string_to_int(*i++);
-		for (; i != args.end(); i++) {
-		    int x = string_to_int(*i);
-		    if (x < val) val = x;
-	        }
-		value = str(val);
-		break;
+	    break;
+	case CMD_max: {
+	    vector<string>::const_iterator i = args.begin();
+	    int val = string_to_int(*i++);
+	    for (; i != args.end(); i++) {
+		int x = string_to_int(*i);
+		if (x > val) val = x;
 	    }
-	    case CMD_msize:
-		// number of matches
-		value = str(mset.get_matches_estimated());
-		break;
-	    case CMD_msizeexact:
-		// is msize exact?
-		if (mset.get_matches_lower_bound()
-		    == mset.get_matches_upper_bound())
-		    value = "true";
-		break;
-	    case CMD_mod: {
-		int denom = string_to_int(args[1]);
-		if (denom == 0) {
-		    value = "divide by 0";
-		} else {
-		    value = str(string_to_int(args[0]) %
-				string_to_int(args[1]));
-		}
-		break;
+	    value = str(val);
+	    break;
+	}
+	case CMD_min: {
+	    vector<string>::const_iterator i = args.begin();
+	    int val = string_to_int(*i++);
+	    for (; i != args.end(); i++) {
+		int x = string_to_int(*i);
+		if (x < val) val = x;
 	    }
-	    case CMD_mul: {
-		vector<string>::const_iterator i = args.begin();
-		int total = string_to_int(*i++);
-		while (i != args.end())
-		    total *= string_to_int(*i++);
-		value = str(total);
-		break;
+	    value = str(val);
+	    break;
+	}
+	case CMD_msize:
+	    // number of matches
+	    value = str(mset.get_matches_estimated());
+	    break;
+	case CMD_msizeexact:
+	    // is msize exact?
+	    if (mset.get_matches_lower_bound()
+		== mset.get_matches_upper_bound())
+		value = "true";
+	    break;
+	case CMD_mod: {
+	    int denom = string_to_int(args[1]);
+	    if (denom == 0) {
+		value = "divide by 0";
+	    } else {
+		value = str(string_to_int(args[0]) %
+			    string_to_int(args[1]));
 	    }
-	    case CMD_muldiv: {
-		int denom = string_to_int(args[2]);
-		if (denom == 0) {
-		    value = "divide by 0";
-		} else {
-		    int num = string_to_int(args[0]) * string_to_int(args[1]);
-		    value = str(num / denom);
-		}
-		break;
+	    break;
+	}
+	case CMD_mul: {
+	    vector<string>::const_iterator i = args.begin();
+	    int total = string_to_int(*i++);
+	    while (i != args.end())
+		total *= string_to_int(*i++);
+	    value = str(total);
+	    break;
+	}
+	case CMD_muldiv: {
+	    int denom = string_to_int(args[2]);
+	    if (denom == 0) {
+		value = "divide by 0";
+	    } else {
+		int num = string_to_int(args[0]) * string_to_int(args[1]);
+		value = str(num / denom);
 	    }
-            case CMD_ne:
-		if (args[0] != args[1]) value = "true";
-		break;
-	    case CMD_nice: {
-		string::const_iterator i = args[0].begin();
-		int len = args[0].length();
-		while (len) {
-		    value += *i++;
-		    if (--len && len % 3 == 0) value += option["thousand"];
-		}
-		break;
+	    break;
+	}
+	case CMD_ne:
+	    if (args[0] != args[1]) value = "true";
+	    break;
+	case CMD_nice: {
+	    string::const_iterator i = args[0].begin();
+	    int len = args[0].length();
+	    while (len) {
+		value += *i++;
+		if (--len && len % 3 == 0) value += option["thousand"];
 	    }
-	    case CMD_not:
-		if (args[0].empty()) value = "true";
-		break;
-	    case CMD_now: {
-		char buf[64];
-		my_snprintf(buf, sizeof(buf), "%lu", (unsigned long)time(NULL));
-		// MSVC's snprintf omits the zero byte if the string if
-		// sizeof(buf) long.
-		buf[sizeof(buf) - 1] = '\0';
-		value = buf;
-		break;
+	    break;
+	}
+	case CMD_not:
+	    if (args[0].empty()) value = "true";
+	    break;
+	case CMD_now: {
+	    char buf[64];
+	    my_snprintf(buf, sizeof(buf), "%lu", (unsigned long)time(NULL));
+	    // MSVC's snprintf omits the zero byte if the string if
+	    // sizeof(buf) long.
+	    buf[sizeof(buf) - 1] = '\0';
+	    value = buf;
+	    break;
+	}
+	case CMD_opt:
+	    if (args.size() == 2) {
+		value = option[args[0] + "," + args[1]];
+	    } else {
+		value = option[args[0]];
 	    }
-	    case CMD_opt:
-		if (args.size() == 2) {
-		    value = option[args[0] + "," + args[1]];
-		} else {
-		    value = option[args[0]];
-		}
-		break;
-	    case CMD_or: {
-		for (vector<string>::const_iterator i = args.begin();
-		     i != args.end(); i++) {
-		    value = eval(*i, param);
-		    if (!value.empty()) break;
-	        }
-		break;
+	    break;
+	case CMD_or: {
+	    vector<compiled_template *>::const_iterator i;
+	    for (i = call.args.begin(); i != call.args.end(); i++) {
+		value = eval(**i, param);
+		if (!value.empty()) break;
 	    }
-	    case CMD_pack:
-		value = int_to_binary_string(string_to_int(args[0]));
-		break;
-	    case CMD_percentage:
-		// percentage score
-		value = str(percent);
-		break;
-	    case CMD_prettyterm:
-		value = pretty_term(args[0]);
-		break;
-	    case CMD_prettyurl:
-		value = args[0];
-		url_prettify(value);
-		break;
-	    case CMD_query:
-		value = probabilistic_query[args.empty() ? string() : args[0]];
-		break;
-	    case CMD_querydescription:
-		value = query.get_description();
-		break;
-	    case CMD_queryterms:
-		value = queryterms;
-		break;
-	    case CMD_range: {
-		int start = string_to_int(args[0]);
-		int end = string_to_int(args[1]);
-	        while (start <= end) {
-		    value += str(start);
-		    if (start < end) value += '\t';
-		    start++;
-		}
-		break;
+	    break;
+	}
+	case CMD_pack:
+	    value = int_to_binary_string(string_to_int(args[0]));
+	    break;
+	case CMD_percentage:
+	    // percentage score
+	    value = str(percent);
+	    break;
+	case CMD_prettyterm:
+	    value = pretty_term(args[0]);
+	    break;
+	case CMD_prettyurl:
+	    value = args[0];
+	    url_prettify(value);
+	    break;
+	case CMD_query:
+	    value = probabilistic_query[args.empty() ? string() : args[0]];
+	    break;
+	case CMD_querydescription:
+	    value = query.get_description();
+	    break;
+	case CMD_queryterms:
+	    value = queryterms;
+	    break;
+	case CMD_range: {
+	    int start = string_to_int(args[0]);
+	    int end = string_to_int(args[1]);
+	    while (start <= end) {
+		value += str(start);
+		if (start < end) value += '\t';
+		start++;
 	    }
-	    case CMD_record: {
-		int id = q0;
-		if (!args.empty()) id = string_to_int(args[0]);
-		value = db.get_document(id).get_data();
-		break;
+	    break;
+	}
+	case CMD_record: {
+	    int id = q0;
+	    if (!args.empty()) id = string_to_int(args[0]);
+	    value = db.get_document(id).get_data();
+	    break;
+	}
+	case CMD_relevant: {
+	    // document id if relevant; empty otherwise
+	    int id = q0;
+	    if (!args.empty()) id = string_to_int(args[0]);
+	    map<Xapian::docid, bool>::iterator i = ticked.find(id);
+	    if (i != ticked.end()) {
+		i->second = false; // icky side-effect
+		value = str(id);
 	    }
-	    case CMD_relevant: {
-		// document id if relevant; empty otherwise
-		int id = q0;
-		if (!args.empty()) id = string_to_int(args[0]);
-		map<Xapian::docid, bool>::iterator i = ticked.find(id);
-		if (i != ticked.end()) {
-		    i->second = false; // icky side-effect
-		    value = str(id);
+	    break;
+	}
+	case CMD_relevants:	{
+	    for (map <Xapian::docid, bool>::const_iterator i = ticked.begin();
+		 i != ticked.end(); i++) {
+		if (i->second) {
+		    value += str(i->first);
+		    value += '\t';
 		}
-		break;
 	    }
-	    case CMD_relevants:	{
-		for (map <Xapian::docid, bool>::const_iterator i = ticked.begin();
-		     i != ticked.end(); i++) {
-		    if (i->second) {
-			value += str(i->first);
-			value += '\t';
-		    }
-		}
-		if (!value.empty()) value.erase(value.size() - 1);
-		break;
+	    if (!value.empty()) value.erase(value.size() - 1);
+	    break;
+	}
+	case CMD_score:
+	    // Score (0 to 10)
+	    value = str(percent / 10);
+	    break;
+	case CMD_set:
+	    option[args[0]] = args[1];
+	    break;
+	case CMD_setmap: {
+	    string base = args[0] + ',';
+	    if (args.size() % 2 != 1)
+		throw string("$setmap requires an odd number of arguments");
+	    for (unsigned int i = 1; i + 1 < args.size(); i += 2) {
+		option[base + args[i]] = args[i + 1];
 	    }
-	    case CMD_score:
-	        // Score (0 to 10)
-		value = str(percent / 10);
-		break;
-	    case CMD_set:
-		option[args[0]] = args[1];
-		break;
-	    case CMD_setmap: {
-		string base = args[0] + ',';
-		if (args.size() % 2 != 1)
-		    throw string("$setmap requires an odd number of arguments");
-		for (unsigned int i = 1; i + 1 < args.size(); i += 2) {
-		    option[base + args[i]] = args[i + 1];
+	    break;
+	}
+	case CMD_setrelevant: {
+	    string::size_type i = 0, j;
+	    while (true) {
+		j = args[0].find_first_not_of("0123456789", i);
+		Xapian::docid id = atoi(args[0].substr(i, j - i).c_str());
+		if (id) {
+		    rset.add_document(id);
+		    ticked[id] = true;
 		}
-		break;
+		if (j == string::npos) break;
+		i = j + 1;
 	    }
-	    case CMD_setrelevant: {
-		string::size_type i = 0, j;
-		while (true) {
-		    j = args[0].find_first_not_of("0123456789", i);
-		    Xapian::docid id = atoi(args[0].substr(i, j - i).c_str());
-		    if (id) {
-			rset.add_document(id);
-			ticked[id] = true;
-		    }
-		    if (j == string::npos) break;
-		    i = j + 1;
-		}
-		break;
+	    break;
+	}
+	case CMD_slice: {
+	    string list = args[0], pos = args[1];
+	    vector<string> items;
+	    string::size_type i = 0, j;
+	    while (true) {
+		j = list.find('\t', i);
+		items.push_back(list.substr(i, j - i));
+		if (j == string::npos) break;
+		i = j + 1;
 	    }
-	    case CMD_slice: {
-		string list = args[0], pos = args[1];
-		vector<string> items;
-		string::size_type i = 0, j;
-		while (true) {
-		    j = list.find('\t', i);
-		    items.push_back(list.substr(i, j - i));
-		    if (j == string::npos) break;
-		    i = j + 1;
-		}
-		i = 0;
-		bool have_added = false;
-		while (true) {
-		    j = pos.find('\t', i);
-		    int item = string_to_int(pos.substr(i, j - i));
-		    if (item >= 0 && size_t(item) < items.size()) {
-			if (have_added) value += '\t';
-			value += items[item];
-			have_added = true;
-		    }
-		    if (j == string::npos) break;
-		    i = j + 1;
+	    i = 0;
+	    bool have_added = false;
+	    while (true) {
+		j = pos.find('\t', i);
+		int item = string_to_int(pos.substr(i, j - i));
+		if (item >= 0 && size_t(item) < items.size()) {
+		    if (have_added) value += '\t';
+		    value += items[item];
+		    have_added = true;
 		}
-	        break;
+		if (j == string::npos) break;
+		i = j + 1;
 	    }
-	    case CMD_snippet: {
-		Xapian::Snipper snipper;
-		snipper.set_mset(mset);
-		snipper.set_stemmer(Xapian::Stem(option["stemmer"]));
-		size_t len = (args.size() == 1) ? 200 : string_to_int(args[1]);
-		value = snipper.generate_snippet(args[0], len);
-		break;
+	    break;
+	}
+	case CMD_snippet: {
+	    Xapian::Snipper snipper;
+	    snipper.set_mset(mset);
+	    snipper.set_stemmer(Xapian::Stem(option["stemmer"]));
+	    size_t len = (args.size() == 1) ? 200 : string_to_int(args[1]);
+	    value = snipper.generate_snippet(args[0], len);
+	    break;
+	}
+	case CMD_split: {
+	    string split;
+	    if (args.size() == 1) {
+		split = " ";
+		value = args[0];
+	    } else {
+		split = args[0];
+		value = args[1];
 	    }
-	    case CMD_split: {
-		string split;
-		if (args.size() == 1) {
-		    split = " ";
-		    value = args[0];
-		} else {
-		    split = args[0];
-		    value = args[1];
-		}
-		string::size_type i = 0;
-		while (true) {
-		    if (split.empty()) {
-			++i;
-			if (i >= value.size()) break;
-		    } else {
-			i = value.find(split, i);
-			if (i == string::npos) break;
-		    }
-		    value.replace(i, split.size(), 1, '\t');
+	    string::size_type i = 0;
+	    while (true) {
+		if (split.empty()) {
 		    ++i;
+		    if (i >= value.size()) break;
+		} else {
+		    i = value.find(split, i);
+		    if (i == string::npos) break;
 		}
-	        break;
+		value.replace(i, split.size(), 1, '\t');
+		++i;
 	    }
-	    case CMD_stoplist: {
-		Xapian::TermIterator i = qp.stoplist_begin();
-		Xapian::TermIterator end = qp.stoplist_end();
-		while (i != end) {
-		    if (!value.empty()) value += '\t';
-		    value += *i;
-		    ++i;
-		}
-		break;
+	    break;
+	}
+	case CMD_stoplist: {
+	    Xapian::TermIterator i = qp.stoplist_begin();
+	    Xapian::TermIterator end = qp.stoplist_end();
+	    while (i != end) {
+		if (!value.empty()) value += '\t';
+		value += *i;
+		++i;
 	    }
-	    case CMD_sub:
-		value = str(string_to_int(args[0]) - string_to_int(args[1]));
-		break;
-	    case CMD_substr: {
-		int start = string_to_int(args[1]);
-		if (start < 0) {
-		    if (static_cast<size_t>(-start) >= args[0].size()) {
-			start = 0;
-		    } else {
-			start = static_cast<int>(args[0].size()) + start;
-		    }
+	    break;
+	}
+	case CMD_sub:
+	    value = str(string_to_int(args[0]) - string_to_int(args[1]));
+	    break;
+	case CMD_substr: {
+	    int start = string_to_int(args[1]);
+	    if (start < 0) {
+		if (static_cast<size_t>(-start) >= args[0].size()) {
+		    start = 0;
 		} else {
-		    if (static_cast<size_t>(start) >= args[0].size()) break;
+		    start = static_cast<int>(args[0].size()) + start;
 		}
-		size_t len = string::npos;
-		if (args.size() > 2) {
-		    int int_len = string_to_int(args[2]);
-		    if (int_len >= 0) {
-			len = size_t(int_len);
+	    } else {
+		if (static_cast<size_t>(start) >= args[0].size()) break;
+	    }
+	    size_t len = string::npos;
+	    if (args.size() > 2) {
+		int int_len = string_to_int(args[2]);
+		if (int_len >= 0) {
+		    len = size_t(int_len);
+		} else {
+		    len = args[0].size() - start;
+		    if (static_cast<size_t>(-int_len) >= len) {
+			len = 0;
 		    } else {
-			len = args[0].size() - start;
-			if (static_cast<size_t>(-int_len) >= len) {
-			    len = 0;
-			} else {
-			    len -= static_cast<size_t>(-int_len);
-			}
+			len -= static_cast<size_t>(-int_len);
 		    }
 		}
-		value = args[0].substr(start, len);
-		break;
 	    }
-	    case CMD_suggestion:
-		value = qp.get_corrected_query_string();
-		break;
-	    case CMD_terms:
-		if (enquire) {
-		    // list of matching terms
-		    Xapian::TermIterator term = enquire->get_matching_terms_begin(q0);
-		    while (term != enquire->get_matching_terms_end(q0)) {
-			// check term was in the typed query so we ignore
-			// boolean filter terms
-			if (termset.find(*term) != termset.end())
-			    value = value + *term + '\t';
-			++term;
-		    }
-
-		    if (!value.empty()) value.erase(value.size() - 1);
-		}
-		break;
-	    case CMD_thispage:
-		value = str(topdoc / hits_per_page + 1);
-		break;
-	    case CMD_time:
-		if (secs >= 0) {
-		    char buf[64];
-		    my_snprintf(buf, sizeof(buf), "%.6f", secs);
-		    // MSVC's snprintf omits the zero byte if the string if
-		    // sizeof(buf) long.
-		    buf[sizeof(buf) - 1] = '\0';
-		    value = buf;
+	    value = args[0].substr(start, len);
+	    break;
+	}
+	case CMD_suggestion:
+	    value = qp.get_corrected_query_string();
+	    break;
+	case CMD_terms:
+	    if (enquire) {
+		// list of matching terms
+		Xapian::TermIterator term = enquire->get_matching_terms_begin(q0);
+		while (term != enquire->get_matching_terms_end(q0)) {
+		    // check term was in the typed query so we ignore
+		    // boolean filter terms
+		    if (termset.find(*term) != termset.end())
+			value = value + *term + '\t';
+		    ++term;
 		}
-		break;
-	    case CMD_topdoc:
-		// first document on current page of hit list (counting from 0)
-		value = str(topdoc);
-		break;
-	    case CMD_topterms:
-		if (enquire) {
-		    int howmany = 16;
-		    if (!args.empty()) howmany = string_to_int(args[0]);
-		    if (howmany < 0) howmany = 0;
-
-		    // List of expand terms
-		    Xapian::ESet eset;
-		    OmegaExpandDecider decider(db, &termset);
-
-		    if (!rset.empty()) {
-			set_expansion_scheme(*enquire, option);
+
+		if (!value.empty()) value.erase(value.size() - 1);
+	    }
+	    break;
+	case CMD_thispage:
+	    value = str(topdoc / hits_per_page + 1);
+	    break;
+	case CMD_time:
+	    if (secs >= 0) {
+		char buf[64];
+		my_snprintf(buf, sizeof(buf), "%.6f", secs);
+		// MSVC's snprintf omits the zero byte if the string if
+		// sizeof(buf) long.
+		buf[sizeof(buf) - 1] = '\0';
+		value = buf;
+	    }
+	    break;
+	case CMD_topdoc:
+	    // first document on current page of hit list (counting from 0)
+	    value = str(topdoc);
+	    break;
+	case CMD_topterms:
+	    if (enquire) {
+		int howmany = 16;
+		if (!args.empty()) howmany = string_to_int(args[0]);
+		if (howmany < 0) howmany = 0;
+
+		// List of expand terms
+		Xapian::ESet eset;
+		OmegaExpandDecider decider(db, &termset);
+
+		if (!rset.empty()) {
+		    set_expansion_scheme(*enquire, option);
 #if XAPIAN_AT_LEAST(1,3,2)
-			eset = enquire->get_eset(howmany * 2, rset, &decider);
+		    eset = enquire->get_eset(howmany * 2, rset, &decider);
 #else
-			eset = enquire->get_eset(howmany * 2, rset, 0,
-						 expand_param_k, &decider);
+		    eset = enquire->get_eset(howmany * 2, rset, 0,
+					     expand_param_k, &decider);
 #endif
-		    } else if (mset.size()) {
-			// invent an rset
-			Xapian::RSet tmp;
-
-			int c = 5;
-			// FIXME: what if mset does not start at first match?
-			Xapian::MSetIterator m = mset.begin();
-			for ( ; m != mset.end(); ++m) {
-			    tmp.add_document(*m);
-			    if (--c == 0) break;
-			}
+		} else if (mset.size()) {
+		    // invent an rset
+		    Xapian::RSet tmp;
+
+		    int c = 5;
+		    // FIXME: what if mset does not start at first match?
+		    Xapian::MSetIterator m = mset.begin();
+		    for ( ; m != mset.end(); ++m) {
+			tmp.add_document(*m);
+			if (--c == 0) break;
+		    }
 
-			set_expansion_scheme(*enquire, option);
+		    set_expansion_scheme(*enquire, option);
 #if XAPIAN_AT_LEAST(1,3,2)
-			eset = enquire->get_eset(howmany * 2, tmp, &decider);
+		    eset = enquire->get_eset(howmany * 2, tmp, &decider);
 #else
-			eset = enquire->get_eset(howmany * 2, tmp, 0,
-						 expand_param_k, &decider);
+		    eset = enquire->get_eset(howmany * 2, tmp, 0,
+					     expand_param_k, &decider);
 #endif
-		    }
+		}
 
-		    // Don't show more than one word with the same stem.
-		    set<string> stems;
-		    Xapian::ESetIterator i;
-		    for (i = eset.begin(); i != eset.end(); ++i) {
-			string term(*i);
-			string stem = (*stemmer)(term);
-			if (stems.find(stem) != stems.end()) continue;
-			stems.insert(stem);
-			value += term;
-			value += '\t';
-			if (--howmany == 0) break;
-		    }
-		    if (!value.empty()) value.erase(value.size() - 1);
+		// Don't show more than one word with the same stem.
+		set<string> stems;
+		Xapian::ESetIterator i;
+		for (i = eset.begin(); i != eset.end(); ++i) {
+		    string term(*i);
+		    string stem = (*stemmer)(term);
+		    if (stems.find(stem) != stems.end()) continue;
+		    stems.insert(stem);
+		    value += term;
+		    value += '\t';
+		    if (--howmany == 0) break;
 		}
-		break;
-	    case CMD_transform:
-		omegascript_transform(value, args);
-		break;
-	    case CMD_truncate:
-		value = generate_sample(args[0],
-					string_to_int(args[1]),
-					args.size() > 2 ? args[2] : string(),
-					args.size() > 3 ? args[3] : string());
-		break;
-	    case CMD_uniq: {
-		const string &list = args[0];
-		if (list.empty()) break;
-		string::size_type split = 0, split2;
-		string prev;
-		do {
-		    split2 = list.find('\t', split);
-		    string item = list.substr(split, split2 - split);
-		    if (split == 0) {
-			value = item;
-		    } else if (item != prev) {
-			value += '\t';
-			value += item;
-		    }
-		    prev = item;
-		    split = split2 + 1;
-		} while (split2 != string::npos);
-		break;
+		if (!value.empty()) value.erase(value.size() - 1);
 	    }
-	    case CMD_unpack:
-		value = str(binary_string_to_int(args[0]));
-		break;
-	    case CMD_unstem: {
-		const string &term = args[0];
-		Xapian::TermIterator i = qp.unstem_begin(term);
-		Xapian::TermIterator end = qp.unstem_end(term);
-		while (i != end) {
-		    if (!value.empty()) value += '\t';
-		    value += *i;
-		    ++i;
+	    break;
+	case CMD_transform:
+	    omegascript_transform(value, args);
+	    break;
+	case CMD_truncate:
+	    value = generate_sample(args[0],
+				    string_to_int(args[1]),
+				    args.size() > 2 ? args[2] : string(),
+				    args.size() > 3 ? args[3] : string());
+	    break;
+	case CMD_uniq: {
+	    const string &list = args[0];
+	    if (list.empty()) break;
+	    string::size_type split = 0, split2;
+	    string prev;
+	    do {
+		split2 = list.find('\t', split);
+		string item = list.substr(split, split2 - split);
+		if (split == 0) {
+		    value = item;
+		} else if (item != prev) {
+		    value += '\t';
+		    value += item;
 		}
-		break;
-	    }
-	    case CMD_upper:
-		value = Xapian::Unicode::toupper(args[0]);
-		break;
-	    case CMD_url:
-		url_encode(value, args[0]);
-		break;
-	    case CMD_value: {
-		Xapian::docid id = q0;
-		Xapian::valueno value_no = string_to_int(args[0]);
-		if (args.size() > 1) id = string_to_int(args[1]);
-		value = db.get_document(id).get_value(value_no);
-		break;
-	    }
-	    case CMD_version:
-		value = PACKAGE_STRING;
-		break;
-	    case CMD_weight:
-		value = double_to_string(weight);
-		break;
-	    default: {
-		args.insert(args.begin(), param[0]);
-		int macro_no = func->second->tag - CMD_MACRO;
-		assert(macro_no >= 0 && (unsigned int)macro_no < macros.size());
-		// throw "Unknown function '" + var + "'";
-		value = eval(macros[macro_no], args);
-		break;
+		prev = item;
+		split = split2 + 1;
+	    } while (split2 != string::npos);
+	    break;
+	}
+	case CMD_unpack:
+	    value = str(binary_string_to_int(args[0]));
+	    break;
+	case CMD_unstem: {
+	    const string &term = args[0];
+	    Xapian::TermIterator i = qp.unstem_begin(term);
+	    Xapian::TermIterator end = qp.unstem_end(term);
+	    while (i != end) {
+		if (!value.empty()) value += '\t';
+		value += *i;
+		++i;
 	    }
+	    break;
+	}
+	case CMD_upper:
+	    value = Xapian::Unicode::toupper(args[0]);
+	    break;
+	case CMD_url:
+	    url_encode(value, args[0]);
+	    break;
+	case CMD_value: {
+	    Xapian::docid id = q0;
+	    Xapian::valueno value_no = string_to_int(args[0]);
+	    if (args.size() > 1) id = string_to_int(args[1]);
+	    value = db.get_document(id).get_value(value_no);
+	    break;
+	}
+	case CMD_version:
+	    value = PACKAGE_STRING;
+	    break;
+	case CMD_weight:
+	    value = double_to_string(weight);
+	    break;
+	default: {
+	    args.insert(args.begin(), param[0]);
+	    int macro_no = func->tag - CMD_MACRO;
+	    assert(macro_no >= 0 && (unsigned int)macro_no < macros.size());
+	    // throw "Unknown function '" + var + "'";
+	    value = eval(*macros[macro_no], args);
+	    break;
 	}
-        res += value;
-    } catch (const Xapian::Error & e) {
-	// FIXME: this means we only see the most recent error in $error
-	// - is that the best approach?
-	error_msg = e.get_msg();
     }
+}
 
-    res += fmt.substr(p);
-    return res;
+// Load and compile the template in @a file, or return NULL (with errno set)
+// if it can't be read.
+//
+// If cache_files is set, the compiled template is cached and reused until the
+// file changes.
+static const compiled_template *
+load_template(const string & file)
+{
+    string fmt;
+    if (!cache_files) {
+	if (!load_file(file, fmt)) return NULL;
+	compiled_template * tmpl = compile(fmt);
+	uncached_templates.push_back(tmpl);
+	return tmpl;
+    }
+
+    struct stat st;
+    if (stat(file.c_str(), &st) < 0) return NULL;
+    map<string, pair<cached_file, compiled_template *> >::iterator i;
+    i = template_cache.find(file);
+    if (i != template_cache.end() && i->second.first == cached_file(st))
+	return i->second.second;
+
+    if (!load_file(file, fmt)) return NULL;
+    compiled_template * tmpl = compile(fmt);
+    pair<cached_file, compiled_template *> & entry = template_cache[file];
+    // Macros defined by the old version may still be in use.
+    if (entry.second) uncached_templates.push_back(entry.second);
+    entry.first = cached_file(st);
+    entry.second = tmpl;
+    return tmpl;
 }
 
 static string
@@ -2132,11 +2478,11 @@ eval_file(const string &fmtfile)
     string err;
     if (vet_filename(fmtfile)) {
 	string file = template_dir + fmtfile;
-	string fmt;
-	if (load_file(file, fmt)) {
+	const compiled_template * fmt = load_template(file);
+	if (fmt) {
 	    vector<string> noargs;
 	    noargs.resize(1);
-	    return eval(fmt, noargs);
+	    return eval(*fmt, noargs);
 	}
 	err = strerror(errno);
     } else {
@@ -2204,7 +2550,7 @@ pretty_term(string term)
 }
 
 static string
-print_caption(const string &fmt, const vector<string> &param)
+print_caption(const compiled_template &fmt, const vector<string> &param)
 {
     q0 = *(mset[hit_no]);
 
@@ -2215,6 +2561,50 @@ print_caption(const string &fmt, const vector<string> &param)
     return eval(fmt, param);
 }
 
+void
+enable_omegascript_caching()
+{
+    cache_files = true;
+}
+
+void
+reset_omegascript()
+{
+    query_parsed = false;
+    done_query = false;
+    last = 0;
+    mset = Xapian::MSet();
+    ticked.clear();
+    query = Xapian::Query();
+    default_op = Xapian::Query::OP_AND;
+    qp = Xapian::QueryParser();
+    delete stemmer;
+    stemmer = NULL;
+    termset.clear();
+    termprefix_to_userprefix.clear();
+    queryterms.resize(0);
+    error_msg.resize(0);
+    secs = -1;
+    probabilistic_query.clear();
+    filter_map.clear();
+    fields = Fields();
+    dbsize = 0;
+
+    // Forget any macros defined with $def.
+    map<string, const struct func_attrib *>::iterator i;
+    for (i = func_map.begin(); i != func_map.end(); ++i) {
+	if (i->second->tag >= CMD_MACRO) delete i->second;
+    }
+    func_map.clear();
+    ++func_map_generation;
+    macros.clear();
+    vector<compiled_template *>::const_iterator t;
+    for (t = uncached_templates.begin(); t != uncached_templates.end(); ++t) {
+	delete *t;
+    }
+    uncached_templates.clear();
+}
+
 void
 parse_omegascript()
 {
@@ -35,6 +35,15 @@ void set_probabilistic_query(const std::string & prefix,
 
 void parse_omegascript();
 
+/** Keep templates and cdb files cached between requests.
+ *
+ *  Files are checked for changes each time they're used.
+ */
+void enable_omegascript_caching();
+
+/// Reset the state from the current request ready for another request.
+void reset_omegascript();
+
 std::string pretty_term(std::string term);
 
 class OmegaExpandDecider : public Xapian::ExpandDecider {
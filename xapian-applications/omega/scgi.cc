@@ -0,0 +1,380 @@
+/** @file scgi.cc
+ * @brief Serve requests using the SCGI protocol.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "scgi.h"
+
+#include <string>
+
+using namespace std;
+
+#if defined HAVE_FORK && defined HAVE_SOCKETPAIR && defined HAVE_SETENV
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include <sys/types.h>
+#include "realtime.h"
+#include "safeerrno.h"
+#include "safesysselect.h"
+#include "safesysstat.h"
+#include "safesyswait.h"
+#include "safeunistd.h"
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+// The SCGI protocol is described at http://python.ca/scgi/protocol.txt
+
+// Limit on the size of the headers we'll accept for a request.
+#define MAX_HEADER_SIZE 1000000
+
+// Limit on how long a client can take to send a request, in seconds, so a
+// slow or stalled client can't tie up a worker indefinitely.
+#define REQUEST_TIMEOUT 30
+
+// Read exactly count bytes, returning false on EOF, error, or if the time
+// given by deadline is reached.
+static bool
+read_all(int fd, char * buf, size_t count, double deadline)
+{
+    while (count) {
+	double remaining = deadline - RealTime::now();
+	if (remaining <= 0) return false;
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	struct timeval tv;
+	RealTime::to_timeval(remaining, &tv);
+	int s = select(fd + 1, &fds, NULL, NULL, &tv);
+	if (s <= 0) {
+	    if (s < 0 && errno == EINTR) continue;
+	    return false;
+	}
+	ssize_t r = read(fd, buf, count);
+	if (r <= 0) {
+	    if (r < 0 && errno == EINTR) continue;
+	    return false;
+	}
+	buf += r;
+	count -= r;
+    }
+    return true;
+}
+
+// Write count bytes, returning false on error.
+static bool
+write_all(int fd, const char * buf, size_t count)
+{
+    while (count) {
+	ssize_t r = write(fd, buf, count);
+	if (r < 0) {
+	    if (errno == EINTR) continue;
+	    return false;
+	}
+	buf += r;
+	count -= r;
+    }
+    return true;
+}
+
+// Send a response with HTTP status code status to the client, for a request
+// we aren't going to handle.
+static void
+send_error(int fd, int status)
+{
+    const char * reason = "400 Bad Request";
+    if (status == 413) reason = "413 Request Entity Too Large";
+    string response = "Status: ";
+    response += reason;
+    response += "\r\nContent-Type: text/plain\r\n\r\n";
+    response += reason;
+    response += '\n';
+    // If the client has gone away, there's nothing we can do.
+    (void)write_all(fd, response.data(), response.size());
+}
+
+// Parse a CONTENT_LENGTH value, returning false if it isn't a valid one.
+static bool
+parse_content_length(const char * value, size_t & result)
+{
+    // Some web servers pass an empty value when there's no body.
+    if (!*value) {
+	result = 0;
+	return true;
+    }
+    // strtoul() skips leading whitespace and accepts a sign, which we don't
+    // want to.
+    if (*value < '0' || *value > '9') return false;
+    char * end;
+    errno = 0;
+    unsigned long n = strtoul(value, &end, 10);
+    if (*end || errno == ERANGE || n != size_t(n)) return false;
+    result = n;
+    return true;
+}
+
+// An environment variable set for the current request, and the value it had
+// before (if any).
+struct SavedEnv {
+    string name;
+    bool was_set;
+    string old_value;
+};
+
+// The environment variables set for the current request, in the order set.
+static vector<SavedEnv> saved_env;
+
+// Set environment variable name to value, saving the old value so that
+// restore_env() can put it back.
+static void
+set_env(const string & name, const char * value)
+{
+    SavedEnv saved;
+    saved.name = name;
+    const char * old_value = getenv(name.c_str());
+    saved.was_set = (old_value != NULL);
+    if (old_value) saved.old_value = old_value;
+    if (setenv(name.c_str(), value, 1) == 0) saved_env.push_back(saved);
+}
+
+// Restore the environment variables set for the previous request.
+static void
+restore_env()
+{
+    // Work backwards so that a header repeated in a request gets the value
+    // from before the first occurrence.
+    while (!saved_env.empty()) {
+	const SavedEnv & saved = saved_env.back();
+	if (saved.was_set) {
+	    (void)setenv(saved.name.c_str(), saved.old_value.c_str(), 1);
+	} else {
+	    unsetenv(saved.name.c_str());
+	}
+	saved_env.pop_back();
+    }
+}
+
+// Read the headers and body of a request from fd.  The headers are put in
+// the environment and the body in body.  Returns 0 if a request was read,
+// -1 if we hit EOF or an error or the client took too long, or an HTTP status
+// code to send if the request is malformed (400) or its body is larger than
+// max_body_size bytes (413).
+static int
+read_request(int fd, string & body, size_t max_body_size)
+{
+    restore_env();
+
+    double deadline = RealTime::now() + REQUEST_TIMEOUT;
+
+    // The headers are sent as a netstring - "<length>:<headers>,".
+    size_t len = 0;
+    while (true) {
+	char ch;
+	if (!read_all(fd, &ch, 1, deadline)) return -1;
+	if (ch == ':') break;
+	if (ch < '0' || ch > '9') return 400;
+	len = len * 10 + (ch - '0');
+	if (len > MAX_HEADER_SIZE) return 413;
+    }
+    string headers(len + 1, '\0');
+    if (!read_all(fd, &headers[0], len + 1, deadline)) return -1;
+    if (headers[len] != ',') return 400;
+    headers.resize(len);
+
+    // Each header is a name and a value, each terminated by a zero byte.
+    size_t content_length = 0;
+    size_t p = 0;
+    while (p != len) {
+	size_t q = headers.find('\0', p);
+	if (q == string::npos) return 400;
+	size_t r = headers.find('\0', q + 1);
+	if (r == string::npos) return 400;
+	string name(headers, p, q - p);
+	const char * value = headers.c_str() + q + 1;
+	if (name == "CONTENT_LENGTH") {
+	    if (!parse_content_length(value, content_length)) return 400;
+	    if (content_length > max_body_size) return 413;
+	}
+	set_env(name, value);
+	p = r + 1;
+    }
+
+    body.resize(content_length);
+    if (content_length &&
+	!read_all(fd, &body[0], content_length, deadline))
+	return -1;
+    return 0;
+}
+
+static void
+serve_connections(int listener, size_t max_body_size,
+		  void (*handle_request)(const string & body))
+{
+    int saved_stdout = dup(1);
+    if (saved_stdout < 0) {
+	throw string("Couldn't duplicate stdout: ") + strerror(errno);
+    }
+    string body;
+    while (true) {
+	int fd = accept(listener, NULL, NULL);
+	if (fd < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED) continue;
+	    throw string("accept failed: ") + strerror(errno);
+	}
+	int status = read_request(fd, body, max_body_size);
+	if (status > 0) {
+	    send_error(fd, status);
+	} else if (status == 0) {
+	    // Send the output of the request to the client.
+	    cout.flush();
+	    fflush(stdout);
+	    if (dup2(fd, 1) >= 0) {
+		handle_request(body);
+		cout.flush();
+		fflush(stdout);
+		(void)dup2(saved_stdout, 1);
+	    }
+	    // If the client went away, writing will have failed - clear the
+	    // error state so the next request's output isn't discarded.
+	    cout.clear();
+	    clearerr(stdout);
+	}
+	close(fd);
+    }
+}
+
+static int
+open_listener(const string & address)
+{
+    int fd;
+    if (address.find('/') != string::npos) {
+	struct sockaddr_un sa;
+	if (address.size() >= sizeof(sa.sun_path)) {
+	    throw "SCGI socket path '" + address + "' is too long";
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, address.c_str());
+
+	// Remove any socket left over from a previous run, but don't
+	// remove anything else which might be there.
+	struct stat st;
+	if (lstat(address.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+	    unlink(address.c_str());
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+	    throw string("Couldn't create socket: ") + strerror(errno);
+	}
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) < 0) {
+	    throw "Couldn't bind to '" + address + "': " + strerror(errno);
+	}
+    } else {
+	int port = atoi(address.c_str());
+	if (port <= 0 || port > 65535) {
+	    throw "Bad SCGI port number '" + address + "'";
+	}
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+	    throw string("Couldn't create socket: ") + strerror(errno);
+	}
+	int on = 1;
+	(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR,
+			 reinterpret_cast<char *>(&on), sizeof(on));
+
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) < 0) {
+	    throw "Couldn't bind to port " + address + ": " + strerror(errno);
+	}
+    }
+    if (listen(fd, 64) < 0) {
+	throw string("listen failed: ") + strerror(errno);
+    }
+    return fd;
+}
+
+void
+scgi_serve(const string & address, unsigned workers, size_t max_body_size,
+	   void (*handle_request)(const string & body))
+{
+    int listener = open_listener(address);
+
+    // If a client disconnects, we want write() to fail rather than being
+    // killed by SIGPIPE.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (workers == 0) {
+	serve_connections(listener, max_body_size, handle_request);
+	return;
+    }
+
+    // Fork worker processes which all accept() on the listening socket, and
+    // start a replacement if one exits.
+    unsigned running = 0;
+    while (true) {
+	while (running < workers) {
+	    pid_t pid = fork();
+	    if (pid == 0) {
+		try {
+		    serve_connections(listener, max_body_size, handle_request);
+		} catch (const string & s) {
+		    cerr << s << endl;
+		} catch (const std::exception & e) {
+		    cerr << e.what() << endl;
+		}
+		_exit(1);
+	    }
+	    if (pid < 0) {
+		throw string("fork failed: ") + strerror(errno);
+	    }
+	    ++running;
+	}
+
+	int status;
+	if (wait(&status) < 0) {
+	    if (errno == EINTR) continue;
+	    throw string("wait failed: ") + strerror(errno);
+	}
+	--running;
+	// Avoid a tight loop if workers are failing straight away.
+	sleep(1);
+    }
+}
+
+#else
+
+void
+scgi_serve(const string &, unsigned, size_t, void (*)(const string &))
+{
+    throw string("SCGI mode isn't supported on this platform");
+}
+
+#endif
@@ -0,0 +1,53 @@
+/** @file scgi.h
+ * @brief Serve requests using the SCGI protocol.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef OMEGA_INCLUDED_SCGI_H
+#define OMEGA_INCLUDED_SCGI_H
+
+#include <cstddef>
+#include <string>
+
+/** Listen for SCGI requests and handle them until killed.
+ *
+ *  The SCGI headers for each request are put in the environment (replacing
+ *  those for the previous request, and restoring any variables they
+ *  overrode) and stdout is connected to the client while @a handle_request
+ *  is called.  A client which takes more than 30 seconds to send its
+ *  request is disconnected.
+ *
+ *  @param address	A path to listen on a Unix domain socket, or a port
+ *			number to listen on TCP on the loopback interface.
+ *  @param workers	The number of worker processes to fork.  Each worker
+ *			handles one request at a time.  If 0, requests are
+ *			handled in this process.
+ *  @param max_body_size	The largest request body to accept, in bytes.
+ *				A request with a larger CONTENT_LENGTH gets a
+ *				413 response, and one with an invalid
+ *				CONTENT_LENGTH gets a 400 response.
+ *  @param handle_request	Function to handle a request, which is passed
+ *				the request body.
+ *
+ *  On error, a std::string describing the problem is thrown.
+ */
+void scgi_serve(const std::string & address, unsigned workers,
+		size_t max_body_size,
+		void (*handle_request)(const std::string & body));
+
+#endif // OMEGA_INCLUDED_SCGI_H
@@ -0,0 +1,272 @@
+/** @file workerpool.cc
+ * @brief A pool of forked worker processes.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "workerpool.h"
+
+#include <string>
+
+using namespace std;
+
+#if defined HAVE_FORK && defined HAVE_SOCKETPAIR
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "safeerrno.h"
+#include "safesysselect.h"
+#include "safesyswait.h"
+#include "safeunistd.h"
+#include <sys/socket.h>
+
+#include "str.h"
+
+// Writing to a socket whose other end has been closed raises SIGPIPE, which
+// would kill us, so we suppress it where we can.
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+// Read exactly count bytes, returning false on EOF or error.
+static bool
+read_all(int fd, char * buf, size_t count)
+{
+    while (count) {
+	ssize_t r = read(fd, buf, count);
+	if (r <= 0) {
+	    if (r < 0 && errno == EINTR) continue;
+	    return false;
+	}
+	buf += r;
+	count -= r;
+    }
+    return true;
+}
+
+// Write all of count bytes, returning false on error.
+static bool
+write_all(int fd, const char * buf, size_t count)
+{
+    while (count) {
+	ssize_t r = send(fd, buf, count, MSG_NOSIGNAL);
+	if (r < 0) {
+	    if (errno == EINTR) continue;
+	    return false;
+	}
+	buf += r;
+	count -= r;
+    }
+    return true;
+}
+
+// Each message is sent as "<length>:<data>".
+static bool
+send_message(int fd, const string & msg)
+{
+    string header = str(msg.size());
+    header += ':';
+    return write_all(fd, header.data(), header.size()) &&
+	   write_all(fd, msg.data(), msg.size());
+}
+
+static bool
+receive_message(int fd, string & msg)
+{
+    size_t len = 0;
+    while (true) {
+	char ch;
+	if (!read_all(fd, &ch, 1)) return false;
+	if (ch == ':') break;
+	if (ch < '0' || ch > '9') return false;
+	len = len * 10 + (ch - '0');
+    }
+    msg.resize(len);
+    return len == 0 || read_all(fd, &msg[0], len);
+}
+
+WorkerPool::WorkerPool(unsigned n, handler_type handler_,
+		       cleanup_type cleanup_)
+    : handler(handler_), cleanup(cleanup_), workers(n), busy_count(0)
+{
+    for (unsigned w = 0; w != n; ++w) {
+	start_worker(w);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (unsigned w = 0; w != workers.size(); ++w) {
+	stop_worker(w);
+    }
+}
+
+void
+WorkerPool::start_worker(unsigned w)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, fds) < 0) {
+	throw string("socketpair failed: ") + strerror(errno);
+    }
+
+    // Make sure any buffered output isn't written by the child too.
+    cout.flush();
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+	// We're the child process.  Close our copies of the sockets to the
+	// other workers, so that they see EOF when the parent closes them.
+	for (unsigned i = 0; i != workers.size(); ++i) {
+	    if (workers[i].fd >= 0) close(workers[i].fd);
+	}
+	close(fds[0]);
+	int fd = fds[1];
+	try {
+	    string request, response;
+	    while (receive_message(fd, request)) {
+		response.resize(0);
+		handler(request, response);
+		if (!send_message(fd, response)) break;
+	    }
+	    if (cleanup) cleanup();
+	} catch (...) {
+	    if (cleanup) cleanup();
+	    _exit(1);
+	}
+	_exit(0);
+    }
+
+    // We're the parent process.
+    close(fds[1]);
+    if (pid < 0) {
+	close(fds[0]);
+	throw string("fork failed: ") + strerror(errno);
+    }
+    workers[w].pid = pid;
+    workers[w].fd = fds[0];
+    workers[w].busy = false;
+}
+
+void
+WorkerPool::stop_worker(unsigned w)
+{
+    // Closing the socket tells the worker to exit.
+    if (workers[w].fd >= 0) {
+	close(workers[w].fd);
+	workers[w].fd = -1;
+    }
+    if (workers[w].pid > 0) {
+	int status;
+	while (waitpid(workers[w].pid, &status, 0) < 0 && errno == EINTR) { }
+	workers[w].pid = 0;
+    }
+    if (workers[w].busy) {
+	workers[w].busy = false;
+	--busy_count;
+    }
+}
+
+unsigned
+WorkerPool::submit(const string & request)
+{
+    unsigned w = 0;
+    while (workers[w].busy) ++w;
+    workers[w].busy = true;
+    ++busy_count;
+    if (!send_message(workers[w].fd, request)) {
+	// The worker must have died - wait() will notice and report this.
+	close(workers[w].fd);
+	workers[w].fd = -1;
+    }
+    return w;
+}
+
+unsigned
+WorkerPool::wait(string & response, bool & ok)
+{
+    unsigned w;
+    while (true) {
+	fd_set readfds;
+	FD_ZERO(&readfds);
+	int maxfd = -1;
+	for (w = 0; w != workers.size(); ++w) {
+	    if (!workers[w].busy) continue;
+	    int fd = workers[w].fd;
+	    if (fd < 0) break;
+	    FD_SET(fd, &readfds);
+	    if (fd > maxfd) maxfd = fd;
+	}
+	if (w != workers.size()) {
+	    // Sending the request to worker w failed.
+	    ok = false;
+	    break;
+	}
+
+	if (select(maxfd + 1, &readfds, NULL, NULL, NULL) < 0) {
+	    if (errno == EINTR) continue;
+	    throw string("select failed: ") + strerror(errno);
+	}
+
+	for (w = 0; w != workers.size(); ++w) {
+	    if (workers[w].busy && FD_ISSET(workers[w].fd, &readfds)) break;
+	}
+	if (w == workers.size()) continue;
+
+	ok = receive_message(workers[w].fd, response);
+	if (ok) {
+	    workers[w].busy = false;
+	    --busy_count;
+	    return w;
+	}
+	break;
+    }
+
+    // Worker w died, so start a replacement.
+    response.resize(0);
+    stop_worker(w);
+    start_worker(w);
+    return w;
+}
+
+#else
+
+WorkerPool::WorkerPool(unsigned, handler_type, cleanup_type)
+{
+    throw string("Worker processes aren't supported on this platform");
+}
+
+WorkerPool::~WorkerPool() { }
+
+unsigned
+WorkerPool::submit(const string &)
+{
+    return 0;
+}
+
+unsigned
+WorkerPool::wait(string &, bool & ok)
+{
+    ok = false;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/** @file workerpool.h
+ * @brief A pool of forked worker processes.
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef OMEGA_INCLUDED_WORKERPOOL_H
+#define OMEGA_INCLUDED_WORKERPOOL_H
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+/** A pool of worker processes, each of which handles one request at a time.
+ *
+ *  Requests and responses are strings, passed over a socket, so the workers
+ *  can't affect the state of the parent process.  A worker which dies is
+ *  replaced by a new one.
+ */
+class WorkerPool {
+  public:
+    /** Function to handle a request in a worker process.
+     *
+     *  The response should be put in @a response.
+     */
+    typedef void (*handler_type)(const std::string & request,
+				 std::string & response);
+
+    /// Function to call in a worker process before it exits.
+    typedef void (*cleanup_type)();
+
+  private:
+    /// Don't allow assignment.
+    void operator=(const WorkerPool &);
+
+    /// Don't allow copying.
+    WorkerPool(const WorkerPool &);
+
+    struct Worker {
+	pid_t pid;
+
+	/// Our end of the socket to the worker, or -1 if sending failed.
+	int fd;
+
+	bool busy;
+
+	Worker() : pid(0), fd(-1), busy(false) { }
+    };
+
+    handler_type handler;
+
+    cleanup_type cleanup;
+
+    std::vector<Worker> workers;
+
+    unsigned busy_count;
+
+    /// Start (or restart) worker number @a w.
+    void start_worker(unsigned w);
+
+    /// Stop worker number @a w.
+    void stop_worker(unsigned w);
+
+  public:
+    /** Fork @a n worker processes.
+     *
+     *  @param n		The number of worker processes.
+     *  @param handler_	Function to handle each request.
+     *  @param cleanup_	Function for each worker to call when it is told
+     *			to exit (or NULL for none).
+     *
+     *  On error, a std::string describing the problem is thrown.
+     */
+    WorkerPool(unsigned n, handler_type handler_, cleanup_type cleanup_);
+
+    /// Stop the worker processes, and wait for them to exit.
+    ~WorkerPool();
+
+    /// Return true if all the workers are busy.
+    bool all_busy() const { return busy_count == workers.size(); }
+
+    /// Return true if any workers are busy.
+    bool any_busy() const { return busy_count != 0; }
+
+    /** Pass @a request to an idle worker.
+     *
+     *  There must be an idle worker (i.e. all_busy() must be false).
+     *
+     *  @return	The number of the worker handling the request (in the
+     *		range 0 to n - 1).
+     */
+    unsigned submit(const std::string & request);
+
+    /** Wait for a busy worker to finish.
+     *
+     *  There must be a busy worker (i.e. any_busy() must be true).
+     *
+     *  @param[out] response	The response from the worker.
+     *  @param[out] ok		Set to false if the worker died without
+     *				responding (it is restarted).
+     *
+     *  @return	The number of the worker which finished.
+     */
+    unsigned wait(std::string & response, bool & ok);
+};
+
+#endif // OMEGA_INCLUDED_WORKERPOOL_H
@@ -10,6 +10,7 @@ noinst_HEADERS +=\
 	api/queryinternal.h\
 	api/queryvector.h\
 	api/replication.h\
+	api/slowquerylog.h\
 	api/smallvector.h\
 	api/snipperinternal.h\
 	api/termlist.h\
@@ -42,6 +43,7 @@ lib_src +=\
 	api/queryinternal.cc\
 	api/registry.cc\
 	api/replication.cc\
+	api/slowquerylog.cc\
 	api/smallvector.cc\
 	api/snipper.cc\
 	api/sortable-serialise.cc\
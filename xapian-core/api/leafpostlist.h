@@ -50,9 +50,12 @@ class LeafPostList : public PostList {
     /// The term name for this postlist (empty for an alldocs postlist).
     std::string term;
 
+    /// Number of chunks of posting data read from disk so far.
+    Xapian::termcount chunk_reads;
+
     /// Only constructable as a base class for derived classes.
     LeafPostList(const std::string & term_)
-	: weight(0), need_doclength(false), term(term_) { }
+	: weight(0), need_doclength(false), term(term_), chunk_reads(0) { }
 
   public:
     ~LeafPostList();
@@ -88,6 +91,13 @@ class LeafPostList : public PostList {
 
     Xapian::termcount count_matching_subqs() const;
 
+    /** Return the number of chunks of posting data read so far.
+     *
+     *  Only backends which store postings in chunks count these (others
+     *  always return 0).  This is used by Enquire::set_profiling().
+     */
+    Xapian::termcount get_chunk_reads() const { return chunk_reads; }
+
     /** Open another postlist from the same database.
      *
      *  @param term_	The term to open a postlist for.  If term_ is near to
@@ -33,6 +33,7 @@
 #include <vector>
 
 #include "autoptr.h"
+#include "backends/memoryusage.h"
 #include "debuglog.h"
 #include "noreturn.h"
 #include "omassert.h"
@@ -85,6 +86,11 @@ MatchSpy::get_description() const {
     return "Xapian::MatchSpy()";
 }
 
+size_t
+MatchSpy::get_memory_usage() const {
+    return 0;
+}
+
 XAPIAN_NORETURN(static void unsupported_method());
 static void unsupported_method() {
     throw Xapian::InvalidOperationError("Method not supported for this type of termlist");
@@ -296,12 +302,25 @@ get_most_frequent_items(vector<StringAndFrequency> & result,
     }
 }
 
+/// Estimate of the bytes used by an entry for @a val in Internal::values.
+static inline size_t
+value_memory_usage(const string & val)
+{
+    return MAP_ENTRY_OVERHEAD + string_memory_usage(val.size()) +
+	   sizeof(doccount);
+}
+
 void
 ValueCountMatchSpy::operator()(const Document &doc, double) {
     Assert(internal.get());
     ++(internal->total);
     string val(doc.get_value(internal->slot));
-    if (!val.empty()) ++(internal->values[val]);
+    if (!val.empty()) {
+	map<string, doccount>::size_type n = internal->values.size();
+	++(internal->values[val]);
+	if (internal->values.size() != n)
+	    internal->values_memory += value_memory_usage(val);
+    }
 }
 
 TermIterator
@@ -387,7 +406,10 @@ ValueCountMatchSpy::merge_results(const string & s) {
 	    string val(p, vallen);
 	    p += vallen;
 	    doccount freq = decode_length(&p, end, false);
+	    map<string, doccount>::size_type n = internal->values.size();
 	    internal->values[val] += freq;
+	    if (internal->values.size() != n)
+		internal->values_memory += value_memory_usage(val);
 	    --items;
 	}
     }
@@ -406,3 +428,8 @@ ValueCountMatchSpy::get_description() const {
     }
     return d;
 }
+
+size_t
+ValueCountMatchSpy::get_memory_usage() const {
+    return internal.get() ? internal->values_memory : 0;
+}
@@ -39,6 +39,9 @@
 #include "backends/multi/multi_termlist.h"
 #include "backends/multivaluelist.h"
 #include "backends/database.h"
+#include "backends/iostatistics.h"
+#include "backends/memoryusage.h"
+#include "backends/prefetch.h"
 #include "editdistance.h"
 #include "expand/ortermlist.h"
 #include "noreturn.h"
@@ -136,6 +139,18 @@ Database::close()
     }
 }
 
+Database
+Database::clone_for_thread() const
+{
+    LOGCALL(API, Database, "Database::clone_for_thread", NO_ARGS);
+    Database result;
+    vector<intrusive_ptr<Database::Internal> >::const_iterator i;
+    for (i = internal.begin(); i != internal.end(); ++i) {
+	result.internal.push_back((*i)->clone_for_thread());
+    }
+    RETURN(result);
+}
+
 void
 Database::add_database(const Database & database)
 {
@@ -748,6 +763,63 @@ Database::get_uuid() const
     RETURN(uuid);
 }
 
+string
+Database::get_io_statistics() const
+{
+    LOGCALL(API, std::string, "Database::get_io_statistics", NO_ARGS);
+    IOStatistics stats;
+    for (size_t i = 0; i < internal.size(); ++i) {
+	internal[i]->get_io_statistics(stats);
+    }
+    RETURN(stats.get_json());
+}
+
+void
+Database::reset_io_statistics()
+{
+    LOGCALL_VOID(API, "Database::reset_io_statistics", NO_ARGS);
+    for (size_t i = 0; i < internal.size(); ++i) {
+	internal[i]->reset_io_statistics();
+    }
+}
+
+std::string
+Database::get_memory_usage() const
+{
+    LOGCALL(API, std::string, "Database::get_memory_usage", NO_ARGS);
+    MemoryUsage usage;
+    for (size_t i = 0; i < internal.size(); ++i) {
+	internal[i]->get_memory_usage(usage);
+    }
+    RETURN(usage.get_json());
+}
+
+size_t
+Database::prefetch(size_t max_bytes, Xapian::termcount max_terms,
+		   const vector<Xapian::valueno> & slots) const
+{
+    LOGCALL(API, size_t, "Database::prefetch", max_bytes | max_terms | slots.size());
+    PrefetchBudget budget(max_bytes);
+    for (size_t i = 0; i < internal.size(); ++i) {
+	internal[i]->prefetch(budget, max_terms, slots);
+    }
+    RETURN(budget.get_used());
+}
+
+size_t
+Database::prefetch_blocks(const string & blocks, size_t max_bytes) const
+{
+    LOGCALL(API, size_t, "Database::prefetch_blocks", blocks.size() | max_bytes);
+    if (internal.size() > 1)
+	throw Xapian::InvalidOperationError("prefetch_blocks() can't be used with more than one sub-database");
+    map<string, vector<uint4> > block_list;
+    parse_prefetch_list(blocks, block_list);
+    PrefetchBudget budget(max_bytes);
+    if (!internal.empty())
+	internal[0]->prefetch_blocks(block_list, budget);
+    RETURN(budget.get_used());
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 WritableDatabase::WritableDatabase() : Database()
@@ -790,6 +862,32 @@ WritableDatabase::commit()
 	internal[i]->commit();
 }
 
+void
+WritableDatabase::set_memory_limit(size_t bytes)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_memory_limit", bytes);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    for (size_t i = 0; i != n_dbs; ++i)
+	internal[i]->set_memory_limit(bytes);
+}
+
+Database
+WritableDatabase::get_snapshot() const
+{
+    LOGCALL(API, Database, "WritableDatabase::get_snapshot", NO_ARGS);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    if (n_dbs == 1)
+	RETURN(Database(internal[0]->open_snapshot()));
+    Database snapshot;
+    for (size_t i = 0; i != n_dbs; ++i)
+	snapshot.add_database(Database(internal[i]->open_snapshot()));
+    RETURN(snapshot);
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
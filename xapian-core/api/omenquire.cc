@@ -41,6 +41,8 @@
 #include "matcher/multimatch.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "realtime.h"
+#include "slowquerylog.h"
 #include "str.h"
 #include "weight/weightinternal.h"
 
@@ -60,6 +62,10 @@ namespace Xapian {
 
 MatchDecider::~MatchDecider() { }
 
+Reranker::~Reranker() { }
+
+SlowQueryLogger::~SlowQueryLogger() { }
+
 // Methods for Xapian::RSet
 
 RSet::RSet() : internal(new RSet::Internal)
@@ -150,6 +156,28 @@ MSetItem::get_description() const
     return description;
 }
 
+string
+MatchMemoryUsage::get_json() const
+{
+    if (!known) return string();
+    string result = "{\"total\":";
+    result += str(total());
+    result += ",\"items\":";
+    result += str(items);
+    result += ",\"collapse\":";
+    result += str(collapse);
+    result += ",\"matchspies\":";
+    result += str(matchspies);
+    if (limit) {
+	result += ",\"limit\":";
+	result += str(limit);
+	result += ",\"limit_exceeded\":";
+	result += limit_exceeded ? "true" : "false";
+    }
+    result += '}';
+    return result;
+}
+
 }
 
 // Methods for Xapian::MSet
@@ -314,6 +342,20 @@ MSet::get_max_attained() const
     return internal->max_attained;
 }
 
+string
+MSet::get_profile() const
+{
+    Assert(internal.get() != 0);
+    return internal->profile;
+}
+
+string
+MSet::get_memory_usage() const
+{
+    Assert(internal.get() != 0);
+    return internal->memory_usage.get_json();
+}
+
 Xapian::doccount
 MSet::size() const
 {
@@ -638,8 +680,10 @@ Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
     sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
-    sorter(0), time_limit(0.0), errorhandler(errorhandler_), weight(0),
-    eweightname("trad"), expand_k(1.0)
+    sorter(0), time_limit(0.0), memory_limit(0), profiling(false), reranker(0), rerank_size(0),
+    slow_query_threshold(0), slow_query_logger(0),
+    errorhandler(errorhandler_),
+    weight(0), eweightname("trad"), expand_k(1.0)
 {
     if (db.internal.empty()) {
 	throw InvalidArgumentError("Can't make an Enquire object from an uninitialised Database object.");
@@ -680,11 +724,23 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	weight = new BM25Weight;
     }
 
+    double start_time = slow_query_logger ? RealTime::now() : 0;
     Xapian::doccount first_orig = first;
+    Xapian::doccount maxitems_orig = maxitems;
+    Xapian::doccount check_at_least_orig = check_at_least;
+    Xapian::doccount rerank_first = 0, rerank_maxitems = 0;
     {
 	Xapian::doccount docs = db.get_doccount();
 	first = min(first, docs);
 	maxitems = min(maxitems, docs);
+	if (reranker && maxitems) {
+	    // Find the candidates for reranking, then pick out the requested
+	    // portion after they've been reranked.
+	    rerank_first = first;
+	    rerank_maxitems = maxitems;
+	    maxitems = max(min(first + maxitems, docs), min(rerank_size, docs));
+	    first = 0;
+	}
 	check_at_least = min(check_at_least, docs);
 	check_at_least = max(check_at_least, maxitems);
     }
@@ -694,14 +750,16 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		       collapse_max, collapse_key,
 		       percent_cutoff, weight_cutoff,
 		       order, sort_key, sort_by, sort_value_forward,
-		       time_limit, errorhandler, *(stats.get()), weight, spies,
+		       time_limit, memory_limit, errorhandler, *(stats.get()),
+		       weight, spies,
 		       (sorter != NULL),
-		       (mdecider != NULL));
+		       (mdecider != NULL),
+		       profiling);
     // Run query and put results into supplied Xapian::MSet object.
     MSet retval;
     match.get_mset(first, maxitems, check_at_least, retval,
 		   *(stats.get()), mdecider, sorter);
-    if (first_orig != first && retval.internal.get()) {
+    if (first_orig != first && retval.internal.get() && rerank_maxitems == 0) {
 	retval.internal->firstitem = first_orig;
     }
 
@@ -717,9 +775,80 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	retval.internal->stats = stats.release();
     }
 
+    if (rerank_maxitems) {
+	retval = rerank(retval, first_orig, rerank_first, rerank_maxitems);
+    }
+
+    if (slow_query_logger) {
+	double elapsed = RealTime::now() - start_time;
+	if (elapsed >= slow_query_threshold) {
+	    (*slow_query_logger)(
+		get_slow_query_record(first_orig, maxitems_orig,
+				      check_at_least_orig, rset,
+				      mdecider != NULL, match.get_timings(),
+				      elapsed, retval));
+	}
+    }
+
     return retval;
 }
 
+/// Order MSetItems by descending weight.
+struct ByDescendingWeight {
+    bool operator()(const Xapian::Internal::MSetItem & a,
+		    const Xapian::Internal::MSetItem & b) const {
+	return a.wt > b.wt;
+    }
+};
+
+MSet
+Enquire::Internal::rerank(MSet & candidates, Xapian::doccount first_orig,
+			  Xapian::doccount first,
+			  Xapian::doccount maxitems) const
+{
+    LOGCALL(MATCH, MSet, "Enquire::Internal::rerank", candidates | first_orig | first | maxitems);
+
+    vector<double> scores;
+    (*reranker)(query, candidates, scores);
+
+    MSet::Internal & in = *(candidates.internal);
+    vector<Xapian::Internal::MSetItem> & items = in.items;
+    if (scores.size() != items.size()) {
+	throw InvalidOperationError("Reranker returned " + str(scores.size()) +
+				    " scores for " + str(items.size()) +
+				    " documents");
+    }
+    for (size_t i = 0; i != items.size(); ++i) {
+	items[i].wt = scores[i];
+    }
+    stable_sort(items.begin(), items.end(), ByDescendingWeight());
+
+    double max_score = items.empty() ? 0.0 : items[0].wt;
+    vector<Xapian::Internal::MSetItem> portion;
+    if (first < items.size()) {
+	Xapian::doccount end = min(Xapian::doccount(items.size()),
+				   first + maxitems);
+	portion.assign(items.begin() + first, items.begin() + end);
+    }
+
+    // Use a new MSet::Internal so that any documents the reranker read
+    // aren't left cached under the wrong index.
+    MSet retval(new MSet::Internal(first_orig,
+				   in.matches_upper_bound,
+				   in.matches_lower_bound,
+				   in.matches_estimated,
+				   in.uncollapsed_upper_bound,
+				   in.uncollapsed_lower_bound,
+				   in.uncollapsed_estimated,
+				   max_score, max_score,
+				   portion, 0));
+    retval.internal->enquire = in.enquire;
+    swap(retval.internal->stats, in.stats);
+    swap(retval.internal->profile, in.profile);
+    retval.internal->memory_usage = in.memory_usage;
+    RETURN(retval);
+}
+
 ESet
 Enquire::Internal::get_eset(Xapian::termcount maxitems,
 			    const RSet & rset, int flags,
@@ -1059,6 +1188,41 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_memory_limit(size_t bytes)
+{
+    internal->memory_limit = bytes;
+}
+
+void
+Enquire::set_profiling(bool profiling)
+{
+    internal->profiling = profiling;
+}
+
+void
+Enquire::set_reranker(Reranker * reranker, Xapian::doccount rerank_size)
+{
+    internal->reranker = reranker;
+    internal->rerank_size = rerank_size;
+}
+
+void
+Enquire::set_slow_query_log(double threshold, SlowQueryLogger * logger)
+{
+    internal->slow_query_threshold = threshold;
+    internal->slow_query_logger = logger;
+    internal->slow_query_file_logger.reset();
+}
+
+void
+Enquire::set_slow_query_log(double threshold, const string & filename)
+{
+    internal->slow_query_file_logger.reset(new SlowQueryFileLogger(filename));
+    internal->slow_query_threshold = threshold;
+    internal->slow_query_logger = internal->slow_query_file_logger.get();
+}
+
 MSet
 Enquire::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		  Xapian::doccount check_at_least, const RSet *rset,
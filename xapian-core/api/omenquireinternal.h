@@ -37,10 +37,13 @@
 #include <map>
 #include <set>
 
+#include "autoptr.h"
 #include "weight/weightinternal.h"
 
 using namespace std;
 
+struct MatchTimings;
+
 class OmExpand;
 class MultiMatch;
 
@@ -110,6 +113,41 @@ class MSetItem {
 	string get_description() const;
 };
 
+/// Estimates of the memory used by a match.
+struct MatchMemoryUsage {
+    /// Bytes used by the candidate items.
+    size_t items;
+
+    /// Bytes used by the collapse table.
+    size_t collapse;
+
+    /// Bytes used by the results of the match spies.
+    size_t matchspies;
+
+    /// The limit set with Enquire::set_memory_limit() (0 for no limit).
+    size_t limit;
+
+    /// Was the limit reached?
+    bool limit_exceeded;
+
+    /// False if the usage isn't known (e.g. for a remote match).
+    bool known;
+
+    MatchMemoryUsage()
+	: items(0), collapse(0), matchspies(0), limit(0),
+	  limit_exceeded(false), known(false) { }
+
+    size_t total() const { return items + collapse + matchspies; }
+
+    /** Return the usage as a JSON object.
+     *
+     *  This is only built when it's asked for, so it doesn't add to the
+     *  cost of every match.  If the usage isn't known, an empty string is
+     *  returned.
+     */
+    string get_json() const;
+};
+
 }
 
 /** Internals of enquire system.
@@ -153,6 +191,27 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	double time_limit;
 
+	/// Bytes of memory after which to disable check_at_least (0 for none).
+	size_t memory_limit;
+
+	/// Should get_mset() collect profiling counters?
+	bool profiling;
+
+	/// The reranker to apply to the top documents (0 if not set).
+	Reranker * reranker;
+
+	/// The number of documents to rerank.
+	Xapian::doccount rerank_size;
+
+	/// Log queries which take at least this many seconds.
+	double slow_query_threshold;
+
+	/// The slow query logger (0 if not set).
+	SlowQueryLogger * slow_query_logger;
+
+	/// The logger created by set_slow_query_log() with a filename.
+	AutoPtr<SlowQueryLogger> slow_query_file_logger;
+
 	/** The error handler, if set.  (0 if not set).
 	 */
 	ErrorHandler * errorhandler;
@@ -190,6 +249,35 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 		      const RSet *omrset,
 		      const MatchDecider *mdecider) const;
 
+	/** Rerank the candidate documents found by get_mset().
+	 *
+	 *  @param candidates	The documents to rerank.
+	 *  @param first_orig	The first parameter passed to get_mset().
+	 *  @param first	The index of the first reranked document to
+	 *			return.
+	 *  @param maxitems	The maximum number of documents to return.
+	 */
+	MSet rerank(MSet & candidates, Xapian::doccount first_orig,
+		    Xapian::doccount first, Xapian::doccount maxitems) const;
+
+	/** Build the record describing a query for the slow query log.
+	 *
+	 *  @param first, maxitems, check_at_least, rset
+	 *			The parameters passed to get_mset().
+	 *  @param have_mdecider Was a MatchDecider passed to get_mset()?
+	 *  @param timings	The time spent in each phase of the match.
+	 *  @param elapsed	The total time taken by get_mset().
+	 *  @param mset		The result of the match.
+	 */
+	string get_slow_query_record(Xapian::doccount first,
+				     Xapian::doccount maxitems,
+				     Xapian::doccount check_at_least,
+				     const RSet * rset,
+				     bool have_mdecider,
+				     const MatchTimings & timings,
+				     double elapsed,
+				     const MSet & mset) const;
+
 	ESet get_eset(Xapian::termcount maxitems, const RSet & omrset, int flags,
 		      const ExpandDecider *edecider, double min_wt) const;
 
@@ -252,6 +340,12 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
 	double max_attained;
 
+	/// Profile of the match as JSON (empty unless profiling was enabled).
+	std::string profile;
+
+	/// Estimate of the memory used by the match.
+	Xapian::Internal::MatchMemoryUsage memory_usage;
+
 	Internal()
 		: percent_factor(0),
 		  stats(NULL),
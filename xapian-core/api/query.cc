@@ -86,6 +86,21 @@ Query::Query(op op_, Xapian::valueno slot, const std::string & limit)
     }
 }
 
+Query::Query(op op_, const vector<string> & terms)
+{
+    LOGCALL_CTOR(API, "Query", op_ | terms.size());
+
+    if (rare(op_ != OP_AND && op_ != OP_OR && op_ != OP_SYNONYM))
+	throw Xapian::InvalidArgumentError("op must be OP_AND, OP_OR or OP_SYNONYM");
+    if (terms.empty()) return;
+    if (terms.size() == 1) {
+	internal = new Xapian::Internal::QueryTerm(terms[0], 1, 0);
+	return;
+    }
+    vector<string> copy(terms);
+    internal = new Xapian::Internal::QueryTermList(op_, copy);
+}
+
 Query::Query(op op_, Xapian::valueno slot,
 	     const std::string & begin, const std::string & end)
 {
@@ -227,6 +242,9 @@ Query::init(op op_, size_t n_subqueries, Xapian::termcount parameter)
 	case OP_MAX:
 	    internal = new Xapian::Internal::QueryMax(n_subqueries);
 	    break;
+	case OP_ADAPTIVE_OR:
+	    internal = new Xapian::Internal::QueryAdaptiveOr(n_subqueries);
+	    break;
 	default:
 	    throw InvalidArgumentError("op not valid with a list of subqueries");
     }
@@ -28,6 +28,7 @@
 
 #include "matcher/const_database_wrapper.h"
 #include "leafpostlist.h"
+#include "matcher/adaptiveorpostlist.h"
 #include "matcher/andmaybepostlist.h"
 #include "matcher/andnotpostlist.h"
 #include "emptypostlist.h"
@@ -48,6 +49,7 @@
 #include "debuglog.h"
 #include "omassert.h"
 #include "str.h"
+#include "stringutils.h"
 #include "unicode/description_append.h"
 
 #include <algorithm>
@@ -158,6 +160,7 @@ class OrContext : public Context {
 
     PostList * postlist(QueryOptimiser* qopt);
     PostList * postlist_max(QueryOptimiser* qopt);
+    PostList * postlist_adaptive(QueryOptimiser* qopt);
 };
 
 void
@@ -210,11 +213,14 @@ OrContext::postlist(QueryOptimiser* qopt)
 
 	if (pls.size() == 1) {
 	    pls.clear();
-	    return pl;
+	    return qopt->profile(pl, "OR");
 	}
 
 	pop_heap(pls.begin(), pls.end(), ComparePostListTermFreqAscending());
-	pls.back() = pl;
+	// pl now owns the postlist we just popped, so remove it from pls
+	// before we wrap pl (which deletes pl if it throws).
+	pls.pop_back();
+	pls.push_back(qopt->profile(pl, "OR"));
 	push_heap(pls.begin(), pls.end(), ComparePostListTermFreqAscending());
     }
 }
@@ -238,7 +244,26 @@ OrContext::postlist_max(QueryOptimiser* qopt)
     pl = new MaxPostList(pls.begin(), pls.end(), qopt->matcher, qopt->db_size);
 
     pls.clear();
-    return pl;
+    return qopt->profile(pl, "MAX");
+}
+
+PostList *
+OrContext::postlist_adaptive(QueryOptimiser* qopt)
+{
+    Assert(!pls.empty());
+
+    if (pls.size() == 1) {
+	PostList * pl = pls[0];
+	pls.clear();
+	return pl;
+    }
+
+    PostList * pl;
+    pl = new AdaptiveOrPostList(pls.begin(), pls.end(), qopt->matcher,
+				qopt->db_size);
+
+    pls.clear();
+    return qopt->profile(pl, "ADAPTIVE_OR");
 }
 
 class XorContext : public Context {
@@ -257,7 +282,7 @@ XorContext::postlist(QueryOptimiser* qopt)
 
     // Empty pls so our destructor doesn't delete them all!
     pls.clear();
-    return pl;
+    return qopt->profile(pl, "XOR");
 }
 
 class AndContext : public Context {
@@ -275,6 +300,11 @@ class AndContext : public Context {
 	    : op_(op__), begin(begin_), end(end_), window(window_) { }
 
 	PostList * postlist(PostList * pl, const vector<PostList*>& pls) const;
+
+	/// Label to use for this filter when profiling.
+	const char * get_label() const {
+	    return op_ == Xapian::Query::OP_NEAR ? "NEAR" : "PHRASE";
+	}
     };
 
     list<PosFilter> pos_filters;
@@ -325,6 +355,7 @@ AndContext::postlist(QueryOptimiser* qopt)
 {
     AutoPtr<PostList> pl(new MultiAndPostList(pls.begin(), pls.end(),
 					      qopt->matcher, qopt->db_size));
+    pl.reset(qopt->profile(pl.release(), "AND"));
 
     // Sort the positional filters to try to apply them in an efficient order.
     // FIXME: We need to figure out what that is!  Try applying lowest cf/tf
@@ -335,6 +366,7 @@ AndContext::postlist(QueryOptimiser* qopt)
     for (i = pos_filters.begin(); i != pos_filters.end(); ++i) {
 	const PosFilter & filter = *i;
 	pl.reset(filter.postlist(pl.release(), pls));
+	pl.reset(qopt->profile(pl.release(), filter.get_label()));
     }
 
     // Empty pls so our destructor doesn't delete them all!
@@ -414,6 +446,9 @@ Query::Internal::unserialise(const char ** p, const char * end,
 		case 7: // OP_MAX
 		    result = new Xapian::Internal::QueryMax(n_subqs);
 		    break;
+		case 8: // OP_ADAPTIVE_OR
+		    result = new Xapian::Internal::QueryAdaptiveOr(n_subqs);
+		    break;
 		case 13: // OP_ELITE_SET
 		    result = new Xapian::Internal::QueryEliteSet(n_subqs,
 								 parameter);
@@ -427,7 +462,7 @@ Query::Internal::unserialise(const char ** p, const char * end,
 							       parameter);
 		    break;
 		default:
-		    // 8 to 12 are currently unused.
+		    // 9 to 12 are currently unused.
 		    throw SerialisationError("Unknown multi-way branch Query operator");
 	    }
 	    do {
@@ -477,6 +512,8 @@ Query::Internal::unserialise(const char ** p, const char * end,
 	}
 	case 0: {
 	    switch (ch & 0x0f) {
+		case 0x0b: // List of terms
+		    return Xapian::Internal::QueryTermList::unserialise(p, end);
 		case 0x0c: { // PostingSource
 		    size_t len = decode_length(p, end, true);
 		    string name(*p, len);
@@ -647,7 +684,180 @@ QueryTerm::postlist(QueryOptimiser * qopt, double factor) const
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryTerm::postlist", qopt | factor);
     if (factor != 0.0)
 	qopt->inc_total_subqs();
-    RETURN(qopt->open_post_list(term, wqf, factor));
+    LeafPostList * pl = qopt->open_post_list(term, wqf, factor);
+    RETURN(qopt->profile_leaf(pl, term.empty() ? "<alldocuments>" : term));
+}
+
+QueryTermList::QueryTermList(Query::op op_, vector<string> & terms_)
+    : op(op_)
+{
+    AssertRel(terms_.size(),>=,2);
+    swap(terms, terms_);
+    sort(terms.begin(), terms.end());
+}
+
+const Query
+QueryTermList::get_subquery(size_t n) const
+{
+    return Query(terms[n]);
+}
+
+template<class CONTEXT>
+void
+QueryTermList::add_postlists(CONTEXT & ctx, QueryOptimiser * qopt,
+			     double factor) const
+{
+    vector<string>::const_iterator i;
+    for (i = terms.begin(); i != terms.end(); ++i) {
+	// This is the same as QueryTerm::postlist() with wqf = 1.
+	if (factor != 0.0)
+	    qopt->inc_total_subqs();
+	LeafPostList * pl = qopt->open_post_list(*i, 1, factor);
+	ctx.add_postlist(qopt->profile_leaf(pl, i->empty() ? "<alldocuments>" : *i));
+    }
+}
+
+PostingIterator::Internal *
+QueryTermList::postlist(QueryOptimiser * qopt, double factor) const
+{
+    LOGCALL(QUERY, PostingIterator::Internal *, "QueryTermList::postlist", qopt | factor);
+    if (op == Query::OP_AND) {
+	AndContext ctx(terms.size());
+	add_postlists(ctx, qopt, factor);
+	RETURN(ctx.postlist(qopt));
+    }
+
+    if (op == Query::OP_OR) {
+	OrContext ctx(terms.size());
+	add_postlists(ctx, qopt, factor);
+	RETURN(ctx.postlist(qopt));
+    }
+
+    AssertEq(op, Query::OP_SYNONYM);
+    // As for QuerySynonym, only count one subquery for the whole synonym.
+    Xapian::termcount save_total_subqs = qopt->get_total_subqs();
+    if (factor != 0.0)
+	++save_total_subqs;
+    OrContext ctx(terms.size());
+    add_postlists(ctx, qopt, 0.0);
+    PostList * pl = ctx.postlist(qopt);
+    if (factor != 0.0) {
+	pl = qopt->make_synonym_postlist(pl, factor);
+	pl = qopt->profile(pl, "SYNONYM");
+    }
+    qopt->set_total_subqs(save_total_subqs);
+    RETURN(pl);
+}
+
+void
+QueryTermList::postlist_sub_and_like(AndContext& ctx, QueryOptimiser * qopt, double factor) const
+{
+    if (op == Query::OP_AND) {
+	add_postlists(ctx, qopt, factor);
+    } else {
+	ctx.add_postlist(postlist(qopt, factor));
+    }
+}
+
+void
+QueryTermList::postlist_sub_or_like(OrContext& ctx, QueryOptimiser * qopt, double factor) const
+{
+    if (op == Query::OP_OR) {
+	add_postlists(ctx, qopt, factor);
+    } else {
+	ctx.add_postlist(postlist(qopt, factor));
+    }
+}
+
+void
+QueryTermList::serialise(string & result) const
+{
+    // Each term is stored as the length of the prefix it shares with the
+    // previous term, followed by the rest of the term.  Since the terms are
+    // sorted, generated queries with many terms with the same prefix (e.g.
+    // "Q" unique ids) serialise much smaller than as separate terms.
+    result += '\x0b';
+    result += static_cast<char>(op);
+    result += encode_length(terms.size() - 2);
+    const string * prev = NULL;
+    vector<string>::const_iterator i;
+    for (i = terms.begin(); i != terms.end(); ++i) {
+	size_t reuse = prev ? common_prefix_length(*prev, *i) : 0;
+	result += encode_length(reuse);
+	result += encode_length(i->size() - reuse);
+	result.append(*i, reuse, string::npos);
+	prev = &*i;
+    }
+}
+
+QueryTermList *
+QueryTermList::unserialise(const char ** p, const char * end)
+{
+    if (*p == end)
+	throw SerialisationError("Not enough data");
+    Query::op op_ = static_cast<Query::op>(*(*p)++);
+    if (op_ != Query::OP_AND && op_ != Query::OP_OR &&
+	op_ != Query::OP_SYNONYM) {
+	throw SerialisationError("Bad operator for list of terms");
+    }
+    size_t n_terms = decode_length(p, end, false) + 2;
+    vector<string> terms_;
+    terms_.reserve(n_terms);
+    string term;
+    while (n_terms--) {
+	size_t reuse = decode_length(p, end, false);
+	size_t len = decode_length(p, end, true);
+	if (reuse > term.size())
+	    throw SerialisationError("Bad prefix length in list of terms");
+	term.resize(reuse);
+	term.append(*p, len);
+	*p += len;
+	terms_.push_back(term);
+    }
+    return new QueryTermList(op_, terms_);
+}
+
+string
+QueryTermList::get_description() const
+{
+    const char * op_desc;
+    switch (op) {
+	case Query::OP_AND:
+	    op_desc = " AND ";
+	    break;
+	case Query::OP_OR:
+	    op_desc = " OR ";
+	    break;
+	default:
+	    AssertEq(op, Query::OP_SYNONYM);
+	    op_desc = " SYNONYM ";
+	    break;
+    }
+    string desc = "(";
+    vector<string>::const_iterator i;
+    for (i = terms.begin(); i != terms.end(); ++i) {
+	if (i != terms.begin()) desc += op_desc;
+	if (i->empty()) {
+	    desc += "<alldocuments>";
+	} else {
+	    description_append(desc, *i);
+	}
+    }
+    desc += ')';
+    return desc;
+}
+
+void
+QueryTermList::gather_terms(void * void_terms) const
+{
+    vector<pair<Xapian::termpos, string> > &vec =
+	*static_cast<vector<pair<Xapian::termpos, string> >*>(void_terms);
+    vector<string>::const_iterator i;
+    for (i = terms.begin(); i != terms.end(); ++i) {
+	// Skip Xapian::Query::MatchAll (aka Xapian::Query("")).
+	if (!i->empty())
+	    vec.push_back(make_pair(Xapian::termpos(0), *i));
+    }
 }
 
 PostingIterator::Internal *
@@ -658,7 +868,9 @@ QueryPostingSource::postlist(QueryOptimiser * qopt, double factor) const
     if (factor != 0.0)
 	qopt->inc_total_subqs();
     Xapian::Database wrappeddb(new ConstDatabaseWrapper(&(qopt->db)));
-    RETURN(new ExternalPostList(wrappeddb, source, factor, qopt->matcher));
+    PostList * pl = new ExternalPostList(wrappeddb, source, factor,
+					 qopt->matcher);
+    RETURN(qopt->profile(pl, "POSTING_SOURCE"));
 }
 
 PostingIterator::Internal *
@@ -691,7 +903,8 @@ QueryValueRange::postlist(QueryOptimiser *qopt, double factor) const
     if (!lb.empty() && (end < lb || begin > db.get_value_upper_bound(slot))) {
 	RETURN(new EmptyPostList);
     }
-    RETURN(new ValueRangePostList(&db, slot, begin, end));
+    RETURN(qopt->profile(new ValueRangePostList(&db, slot, begin, end),
+			 "VALUE_RANGE"));
 }
 
 void
@@ -737,7 +950,8 @@ QueryValueLE::postlist(QueryOptimiser *qopt, double factor) const
     if (limit < db.get_value_lower_bound(slot)) {
 	RETURN(new EmptyPostList);
     }
-    RETURN(new ValueRangePostList(&db, slot, string(), limit));
+    RETURN(qopt->profile(new ValueRangePostList(&db, slot, string(), limit),
+			 "VALUE_LE"));
 }
 
 void
@@ -783,7 +997,7 @@ QueryValueGE::postlist(QueryOptimiser *qopt, double factor) const
     if (!lb.empty() && limit > db.get_value_upper_bound(slot)) {
 	RETURN(new EmptyPostList);
     }
-    RETURN(new ValueGePostList(&db, slot, limit));
+    RETURN(qopt->profile(new ValueGePostList(&db, slot, limit), "VALUE_GE"));
 }
 
 void
@@ -849,7 +1063,8 @@ QueryBranch::serialise_(string & result, Xapian::termcount parameter) const
 	0,		// OP_VALUE_GE
 	0,		// OP_VALUE_LE
 	MULTIWAY(6),	// OP_SYNONYM
-	MULTIWAY(7)	// OP_MAX
+	MULTIWAY(7),	// OP_MAX
+	MULTIWAY(8)	// OP_ADAPTIVE_OR
     };
     Xapian::Query::op op_ = get_op();
     AssertRel(size_t(op_),<,sizeof(first_byte));
@@ -964,7 +1179,8 @@ QueryBranch::do_synonym(QueryOptimiser * qopt, double factor) const
 
     // We build an OP_OR tree for OP_SYNONYM and then wrap it in a
     // SynonymPostList, which supplies the weights.
-    RETURN(qopt->make_synonym_postlist(pl, factor));
+    pl = qopt->make_synonym_postlist(pl, factor);
+    RETURN(qopt->profile(pl, "SYNONYM"));
 }
 
 PostList *
@@ -1268,8 +1484,9 @@ QueryAndNot::postlist(QueryOptimiser * qopt, double factor) const
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, 0.0, 0, 1);
     AutoPtr<PostList> r(ctx.postlist(qopt));
-    RETURN(new AndNotPostList(l.release(), r.release(),
-			      qopt->matcher, qopt->db_size));
+    PostList * pl = new AndNotPostList(l.release(), r.release(),
+				       qopt->matcher, qopt->db_size);
+    RETURN(qopt->profile(pl, "AND_NOT"));
 }
 
 PostingIterator::Internal *
@@ -1301,8 +1518,9 @@ QueryAndMaybe::postlist(QueryOptimiser * qopt, double factor) const
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, factor, 0, 1);
     AutoPtr<PostList> r(ctx.postlist(qopt));
-    RETURN(new AndMaybePostList(l.release(), r.release(),
-				qopt->matcher, qopt->db_size));
+    PostList * pl = new AndMaybePostList(l.release(), r.release(),
+					 qopt->matcher, qopt->db_size);
+    RETURN(qopt->profile(pl, "AND_MAYBE"));
 }
 
 PostingIterator::Internal *
@@ -1315,7 +1533,9 @@ QueryFilter::postlist(QueryOptimiser * qopt, double factor) const
     AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
     pls[1] = subqueries[1].internal->postlist(qopt, 0.0);
     pls[0] = l.release();
-    RETURN(new MultiAndPostList(pls, pls + 2, qopt->matcher, qopt->db_size));
+    PostList * pl = new MultiAndPostList(pls, pls + 2,
+					 qopt->matcher, qopt->db_size);
+    RETURN(qopt->profile(pl, "FILTER"));
 }
 
 void
@@ -1423,6 +1643,26 @@ QueryMax::postlist(QueryOptimiser * qopt, double factor) const
     RETURN(pl);
 }
 
+PostingIterator::Internal *
+QueryAdaptiveOr::postlist(QueryOptimiser * qopt, double factor) const
+{
+    LOGCALL(QUERY, PostingIterator::Internal *, "QueryAdaptiveOr::postlist", qopt | factor);
+    OrContext ctx(subqueries.size());
+    do_or_like(ctx, qopt, factor);
+    if (factor == 0.0) {
+	// If we have a factor of 0, there are no weights for us to use to
+	// prune, so we're just like a normal OR query.
+	RETURN(ctx.postlist(qopt));
+    }
+    RETURN(ctx.postlist_adaptive(qopt));
+}
+
+void
+QueryAdaptiveOr::postlist_sub_or_like(OrContext& ctx, QueryOptimiser * qopt, double factor) const
+{
+    do_or_like(ctx, qopt, factor);
+}
+
 string
 QueryAnd::get_description() const
 {
@@ -1489,5 +1729,11 @@ QueryMax::get_description() const
     return get_description_helper(" MAX ");
 }
 
+string
+QueryAdaptiveOr::get_description() const
+{
+    return get_description_helper(" ADAPTIVE_OR ");
+}
+
 }
 }
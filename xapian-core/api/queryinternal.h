@@ -26,6 +26,9 @@
 #include "xapian/intrusive_ptr.h"
 #include "xapian/query.h"
 
+#include <string>
+#include <vector>
+
 /// Default set_size for OP_ELITE_SET:
 const Xapian::termcount DEFAULT_ELITE_SET_SIZE = 10;
 
@@ -60,6 +63,54 @@ class QueryTerm : public Query::Internal {
     void gather_terms(void * void_terms) const;
 };
 
+/** OP_AND, OP_OR or OP_SYNONYM over a list of terms.
+ *
+ *  This is what Query(op, terms) builds.  It holds all the terms in a single
+ *  node rather than needing a QueryTerm object for each, which makes large
+ *  generated queries cheaper to build, copy and destroy.  The terms are kept
+ *  sorted, which allows them to be prefix-compressed when serialised.
+ */
+class QueryTermList : public Query::Internal {
+    Xapian::Query::op op;
+
+    std::vector<std::string> terms;
+
+    template<class CONTEXT>
+    void add_postlists(CONTEXT & ctx, QueryOptimiser * qopt,
+		       double factor) const;
+
+  public:
+    /** Construct from a list of at least two terms.
+     *
+     *  The contents of @a terms_ are swapped in, so @a terms_ will be left
+     *  empty.
+     */
+    QueryTermList(Xapian::Query::op op_, std::vector<std::string> & terms_);
+
+    Xapian::Query::op get_type() const { return op; }
+
+    size_t get_num_subqueries() const { return terms.size(); }
+
+    const Query get_subquery(size_t n) const;
+
+    termcount get_length() const { return terms.size(); }
+
+    PostingIterator::Internal * postlist(QueryOptimiser * qopt, double factor) const;
+
+    void postlist_sub_and_like(AndContext& ctx, QueryOptimiser * qopt, double factor) const;
+
+    void postlist_sub_or_like(OrContext& ctx, QueryOptimiser * qopt, double factor) const;
+
+    void serialise(std::string & result) const;
+
+    /// Unserialise the body of a serialised QueryTermList.
+    static QueryTermList * unserialise(const char ** p, const char * end);
+
+    std::string get_description() const;
+
+    void gather_terms(void * void_terms) const;
+};
+
 class QueryPostingSource : public Query::Internal {
     PostingSource * source;
 
@@ -385,6 +436,19 @@ class QueryMax : public QueryOrLike {
     std::string get_description() const;
 };
 
+class QueryAdaptiveOr : public QueryOrLike {
+    Xapian::Query::op get_op() const { return Xapian::Query::OP_ADAPTIVE_OR; }
+
+  public:
+    QueryAdaptiveOr(size_t n_subqueries) : QueryOrLike(n_subqueries) { }
+
+    PostingIterator::Internal * postlist(QueryOptimiser * qopt, double factor) const;
+
+    void postlist_sub_or_like(OrContext& ctx, QueryOptimiser * qopt, double factor) const;
+
+    std::string get_description() const;
+};
+
 }
 
 }
@@ -0,0 +1,225 @@
+/** @file slowquerylog.cc
+ * @brief Record the details of slow queries.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "slowquerylog.h"
+
+#include "safeerrno.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include <set>
+#include <string>
+
+#include "xapian/error.h"
+#include "xapian/weight.h"
+
+#include "api/omenquireinternal.h"
+#include "backends/database.h"
+#include "matcher/multimatch.h"
+#include "io_utils.h"
+#include "jsonescape.h"
+#include "pack.h"
+#include "realtime.h"
+#include "str.h"
+
+using namespace std;
+
+void
+SlowQueryFileLogger::operator()(const string & record)
+{
+    int fd = open(filename.c_str(), O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC,
+		  0666);
+    if (fd < 0) return;
+    string line(record);
+    line += '\n';
+    try {
+	io_write(fd, line.data(), line.size());
+    } catch (const Xapian::DatabaseError &) {
+	// The disk is probably full, and there's nothing useful we can do
+	// about that here - we mustn't make the search fail.
+    }
+    close(fd);
+}
+
+/** Append binary string @a s to @a result as a quoted string of hex digits.
+ *
+ *  Serialised queries can contain any bytes, and not all JSON parsers cope
+ *  with escaped nul bytes, so they're logged in hex.
+ */
+static void
+append_json_hex(string & result, const string & s)
+{
+    static const char hex[] = "0123456789abcdef";
+    result += '"';
+    for (string::const_iterator i = s.begin(); i != s.end(); ++i) {
+	unsigned char ch = *i;
+	result += hex[ch >> 4];
+	result += hex[ch & 0x0f];
+    }
+    result += '"';
+}
+
+static const char *
+sort_by_name(Xapian::Enquire::Internal::sort_setting setting)
+{
+    switch (setting) {
+	case Xapian::Enquire::Internal::REL:
+	    return "relevance";
+	case Xapian::Enquire::Internal::VAL:
+	    return "value";
+	case Xapian::Enquire::Internal::VAL_REL:
+	    return "value_then_relevance";
+	case Xapian::Enquire::Internal::REL_VAL:
+	    return "relevance_then_value";
+    }
+    return "unknown";
+}
+
+static const char *
+docid_order_name(Xapian::Enquire::docid_order order)
+{
+    switch (order) {
+	case Xapian::Enquire::ASCENDING:
+	    return "ascending";
+	case Xapian::Enquire::DESCENDING:
+	    return "descending";
+	case Xapian::Enquire::DONT_CARE:
+	    return "dont_care";
+    }
+    return "unknown";
+}
+
+string
+Xapian::Enquire::Internal::get_slow_query_record(Xapian::doccount first,
+						 Xapian::doccount maxitems,
+						 Xapian::doccount check_at_least,
+						 const Xapian::RSet * rset,
+						 bool have_mdecider,
+						 const MatchTimings & timings,
+						 double elapsed,
+						 const Xapian::MSet & mset) const
+{
+    string result = "{\"time\":";
+    result += str(elapsed);
+    result += ",\"timestamp\":";
+    result += str(RealTime::now());
+    result += ",\"query\":";
+    try {
+	append_json_hex(result, query.serialise());
+    } catch (const Xapian::UnimplementedError &) {
+	// The query uses a PostingSource which can't be serialised, so only
+	// the description can be logged.
+	result += "null";
+    }
+    result += ",\"query_description\":";
+    append_json_string(result, query.get_description());
+    result += ",\"qlen\":";
+    result += str(qlen);
+    result += ",\"weighting_scheme\":";
+    append_json_string(result, weight->name());
+    result += ",\"weighting_params\":";
+    try {
+	append_json_hex(result, weight->serialise());
+    } catch (const Xapian::UnimplementedError &) {
+	// A user weighting scheme which doesn't support serialisation.
+	result += "null";
+    }
+    result += ",\"first\":";
+    result += str(first);
+    result += ",\"maxitems\":";
+    result += str(maxitems);
+    result += ",\"check_at_least\":";
+    result += str(check_at_least);
+    result += ",\"docid_order\":\"";
+    result += docid_order_name(order);
+    result += "\",\"percent_cutoff\":";
+    result += str(percent_cutoff);
+    result += ",\"weight_cutoff\":";
+    result += str(weight_cutoff);
+    result += ",\"sort_by\":\"";
+    result += sort_by_name(sort_by);
+    result += "\",\"sort_key\":";
+    result += str(sort_key);
+    result += ",\"sort_value_forward\":";
+    result += sort_value_forward ? "true" : "false";
+    result += ",\"sorter\":";
+    result += sorter ? "true" : "false";
+    result += ",\"collapse_key\":";
+    result += str(collapse_key);
+    result += ",\"collapse_max\":";
+    result += str(collapse_max);
+    result += ",\"time_limit\":";
+    result += str(time_limit);
+    result += ",\"rset\":[";
+    if (rset && rset->internal.get()) {
+	const set<Xapian::docid> & items = rset->internal->get_items();
+	set<Xapian::docid>::const_iterator i;
+	for (i = items.begin(); i != items.end(); ++i) {
+	    if (i != items.begin()) result += ',';
+	    result += str(*i);
+	}
+    }
+    result += "],\"match_decider\":";
+    result += have_mdecider ? "true" : "false";
+    result += ",\"matchspies\":";
+    result += str(spies.size());
+    result += ",\"reranker\":";
+    result += reranker ? "true" : "false";
+    result += ",\"phases\":{\"stats\":";
+    result += str(timings.stats);
+    result += ",\"postlists\":";
+    result += str(timings.postlists);
+    result += ",\"loop\":";
+    result += str(timings.loop);
+    result += ",\"remote\":";
+    result += str(timings.remote);
+    result += "},\"size\":";
+    result += str(mset.size());
+    result += ",\"matches_estimated\":";
+    result += str(mset.get_matches_estimated());
+    result += ",\"databases\":[";
+    for (size_t i = 0; i != db.internal.size(); ++i) {
+	if (i) result += ',';
+	const Xapian::Database::Internal * subdb = db.internal[i].get();
+	result += "{\"uuid\":";
+	append_json_string(result, subdb->get_uuid());
+	result += ",\"doccount\":";
+	result += str(subdb->get_doccount());
+	result += ",\"revision\":";
+	string revision;
+	try {
+	    revision = subdb->get_revision_info();
+	} catch (const Xapian::UnimplementedError &) {
+	    // This backend doesn't have revisions.
+	}
+	const char * p = revision.data();
+	unsigned long rev;
+	if (unpack_uint(&p, p + revision.size(), &rev)) {
+	    result += str(rev);
+	} else {
+	    result += "null";
+	}
+	result += '}';
+    }
+    result += "]}";
+    return result;
+}
@@ -0,0 +1,48 @@
+/** @file slowquerylog.h
+ * @brief Record the details of slow queries.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SLOWQUERYLOG_H
+#define XAPIAN_INCLUDED_SLOWQUERYLOG_H
+
+#include <string>
+
+#include "xapian/enquire.h"
+
+/// A SlowQueryLogger which appends each record to a file.
+class SlowQueryFileLogger : public Xapian::SlowQueryLogger {
+    /// The file to append to.
+    std::string filename;
+
+  public:
+    explicit SlowQueryFileLogger(const std::string & filename_)
+	: filename(filename_) { }
+
+    /** Append @a record to the file as a single line.
+     *
+     *  The file is opened for each record, so it can be rotated while in use,
+     *  and the line is written with a single write() call (unless that is
+     *  short) so that records from different processes appending to the same
+     *  file don't get mixed up.  Any error is ignored, so that logging can't
+     *  cause a search to fail.
+     */
+    void operator()(const std::string & record);
+};
+
+#endif // XAPIAN_INCLUDED_SLOWQUERYLOG_H
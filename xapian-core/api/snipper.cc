@@ -27,20 +27,36 @@
 
 #include <xapian/document.h>
 #include <xapian/enquire.h>
-#include <xapian/termgenerator.h>
+#include <xapian/query.h>
 #include <xapian/stem.h>
 
 #include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "queryparser/termgenerator_internal.h"
 #include "str.h"
+#include "unordered_map.h"
 
 using namespace std;
 
 namespace Xapian {
 
+/// Is @a term one which could come from unprefixed text?
+static bool
+is_text_term(const string & term)
+{
+    if (term.empty()) return false;
+    unsigned char ch = term[0];
+    if (ch == 'Z') {
+	if (term.size() == 1) return false;
+	ch = term[1];
+    }
+    return !(ch >= 'A' && ch <= 'Z');
+}
+
 Snipper::Snipper() : internal(new Snipper::Internal)
 {
 }
@@ -75,6 +91,29 @@ Snipper::generate_snippet(const string & text,
     return internal->generate_snippet(text, length, window_size, smoothing);
 }
 
+string
+Snipper::generate_snippet(const string & text,
+			  const Document & doc,
+			  size_t length,
+			  Xapian::termcount window_size,
+			  double smoothing)
+{
+    return internal->generate_snippet(text, doc, length, window_size,
+				      smoothing);
+}
+
+void
+Snipper::set_query(const Query & query)
+{
+    internal->query_terms.clear();
+    for (TermIterator t = query.get_terms_begin();
+	 t != query.get_terms_end();
+	 ++t) {
+	if (is_text_term(*t))
+	    internal->query_terms.push_back(*t);
+    }
+}
+
 void
 Snipper::set_stemmer(const Stem & stemmer)
 {
@@ -127,161 +166,316 @@ Snipper::Internal::calculate_rm(const MSet & mset, Xapian::doccount rm_docno)
     }
 }
 
-string
-Snipper::Internal::generate_snippet(const string & text,
-				    size_t length,
-				    Xapian::termcount window_size,
-				    double smoothing)
-{
-    Document text_doc;
-    TermGenerator term_gen;
-
-    term_gen.set_document(text_doc);
-    term_gen.set_stemmer(stemmer);
-    term_gen.index_text(text);
+/** The terms of a text, in order, with each distinct term given an id.
+ *
+ *  If there are query terms, we stop as soon as we've seen a window which
+ *  covers all of them.
+ */
+class SnippetTerms : public TermSink {
+    /// Map from term to id.
+    unordered_map<string, unsigned> term_ids;
+
+    /// The query terms to cover.
+    const vector<string> & query_terms;
+
+    const Stem & stemmer;
+
+    /// Size of window which must cover all the query terms.
+    Xapian::termcount window_size;
+
+    /** Index into ids of the last occurrence of each query term, plus one.
+     *
+     *  Zero if the query term hasn't been seen yet.
+     */
+    vector<size_t> last_seen;
+
+    /// The number of query terms seen so far.
+    size_t n_seen;
+
+  public:
+    /// The distinct terms in the text, prefixed with "Z" and stemmed.
+    vector<string> stems;
+
+    /// The index into query_terms of each distinct term, or -1.
+    vector<int> query_index;
+
+    /// The id of the term at each position in the text.
+    vector<unsigned> ids;
+
+    /// The byte offset of the term at each position in the text.
+    vector<size_t> offsets;
+
+    /// Index into ids of the start of a window covering all query terms.
+    size_t cover_begin;
+
+    /// Has a window covering all the query terms been found?
+    bool covered;
+
+    SnippetTerms(const vector<string> & query_terms_, const Stem & stemmer_,
+		 Xapian::termcount window_size_)
+	: query_terms(query_terms_), stemmer(stemmer_),
+	  window_size(window_size_), last_seen(query_terms_.size()),
+	  n_seen(0), cover_begin(0), covered(false) { }
+
+    /// Return the id of @a term, allocating one if it's a new term.
+    unsigned get_id(const string & term) {
+	unordered_map<string, unsigned>::const_iterator i = term_ids.find(term);
+	if (i != term_ids.end())
+	    return i->second;
+	unsigned id = stems.size();
+	term_ids.insert(make_pair(term, id));
+	string stem("Z");
+	stem += stemmer(term);
+	int q = -1;
+	for (size_t j = 0; j != query_terms.size(); ++j) {
+	    if (query_terms[j] == term || query_terms[j] == stem) {
+		q = int(j);
+		break;
+	    }
+	}
+	stems.push_back(stem);
+	query_index.push_back(q);
+	return id;
+    }
 
-    const Document & snippet_doc = term_gen.get_document();
+    /// Add the term with id @a id at the next position.
+    bool add(unsigned id) {
+	ids.push_back(id);
+	int q = query_index[id];
+	if (q < 0 || window_size == 0)
+	    return true;
+	if (last_seen[q] == 0) ++n_seen;
+	last_seen[q] = ids.size();
+	if (n_seen < query_terms.size())
+	    return true;
+	size_t first = *min_element(last_seen.begin(), last_seen.end());
+	if (ids.size() - first >= window_size)
+	    return true;
+	cover_begin = first - 1;
+	covered = true;
+	return false;
+    }
 
-    // Document terms.
-    vector<TermPositionInfo> docterms;
-    for (TermIterator it = snippet_doc.termlist_begin(); it != snippet_doc.termlist_end(); ++it) {
-	if (is_stemmed(*it))
-	    continue;
+    bool operator()(const string & term, size_t offset) {
+	offsets.push_back(offset);
+	return add(get_id(term));
+    }
+};
 
-	for (PositionIterator pit = it.positionlist_begin(); pit != it.positionlist_end(); ++pit) {
-	    docterms.push_back(TermPositionInfo(*it, *pit));
-	}
+/** Find the byte offset in a text of the term at a given term position.
+ *
+ *  The text's terms are matched up with their positions in the document, so
+ *  this works even if the text wasn't indexed starting at position 1 (e.g.
+ *  if a title was indexed before it) or there are gaps in the positions.
+ *  Each term is assigned the lowest position it has in the document after
+ *  the position of the previous term.
+ */
+class FindOffset : public TermSink {
+    /// The positions of each term in the document, in ascending order.
+    const map<string, vector<Xapian::termpos> > & positions;
+
+    /// The position to find.
+    Xapian::termpos target;
+
+    /// The position of the last term matched up.
+    Xapian::termpos pos;
+
+  public:
+    size_t offset;
+
+    FindOffset(const map<string, vector<Xapian::termpos> > & positions_,
+	       Xapian::termpos target_)
+	: positions(positions_), target(target_), pos(0),
+	  offset(string::npos) { }
+
+    bool operator()(const string & term, size_t offset_) {
+	map<string, vector<Xapian::termpos> >::const_iterator i;
+	i = positions.find(term);
+	if (i == positions.end())
+	    return true;
+	vector<Xapian::termpos>::const_iterator p;
+	p = upper_bound(i->second.begin(), i->second.end(), pos);
+	if (p == i->second.end())
+	    return true;
+	pos = *p;
+	if (pos < target)
+	    return true;
+	offset = offset_;
+	return false;
     }
+};
 
-    sort(docterms.begin(), docterms.end());
+/** Return the snippet of @a text starting at the sentence containing the
+ *  byte offset @a offset.
+ */
+static string
+snippet_from(const string & text, size_t offset, size_t length)
+{
+    size_t begin = text.rfind(". ", offset);
+    begin = (begin == string::npos) ? 0 : begin + 1;
+    if (text.size() - begin < length)
+	return string(text, begin);
+    string snippet(text, begin, length - 3);
+    snippet += "...";
+    return snippet;
+}
 
-    // Relevance model for each term.
-    map<string, double> term_score;
+double
+Snipper::Internal::term_relevance(const string & stem, double alpha) const
+{
+    static const RMTermInfo no_term_info;
+    map<string, RMTermInfo>::const_iterator t = rm_term_data.find(stem);
+    const RMTermInfo & term_info =
+	(t == rm_term_data.end()) ? no_term_info : t->second;
+    double irrelevant_prob = (double)term_info.coll_occurrence / rm_coll_size;
+    double relevant_prob = 0;
+    vector<TermDocInfo>::const_iterator i;
+    for (i = term_info.indexed_docs_freq.begin();
+	 i != term_info.indexed_docs_freq.end();
+	 ++i) {
+	rm_docid c_docid = i->docid;
+	// Occurrence of term in document.
+	Xapian::doccount doc_freq = i->freq;
+
+	// Document info.
+	const RMDocumentInfo & rm_doc_info = rm_documents[c_docid];
+	// Probability for term to be relevant in the current document.
+	double term_doc_prob = alpha * ((double)doc_freq / rm_doc_info.document_size)
+			       + (1 - alpha) * irrelevant_prob;
+
+	// Probability for the current document to be relevant to the query.
+	double doc_query_prob = rm_doc_info.weight / rm_total_weight;
+
+	relevant_prob += term_doc_prob * doc_query_prob;
+    }
 
-    // Smoothing coefficient for relevance probability.
-    double alpha = smoothing;
+    return relevant_prob - irrelevant_prob;
+}
 
-    // Init docterms score.
-    for (vector<TermPositionInfo>::iterator it = docterms.begin(); it < docterms.end(); ++it) {
-	string term = "Z" + stemmer(it->term);
-	term_score[term] = 0;
-    }
+size_t
+Snipper::Internal::choose_window(const SnippetTerms & terms,
+				 Xapian::termcount window_size,
+				 double smoothing) const
+{
+    if (terms.covered)
+	return terms.cover_begin;
 
-    for (map<string, double>::iterator it = term_score.begin(); it != term_score.end(); ++it) {
-	const string & term = it->first;
-
-	const RMTermInfo & term_info = rm_term_data[term];
-	double irrelevant_prob = (double)term_info.coll_occurrence / rm_coll_size;
-	double relevant_prob = 0;
-	vector<TermDocInfo>::const_iterator i;
-	for (i = term_info.indexed_docs_freq.begin();
-	     i != term_info.indexed_docs_freq.end();
-	     ++i) {
-	    rm_docid c_docid = i->docid;
-	    // Occurrence of term in document.
-	    Xapian::doccount doc_freq = i->freq;
-
-	    // Document info.
-	    const RMDocumentInfo & rm_doc_info = rm_documents[c_docid];
-	    // Probability for term to be relevant in the current document.
-	    double term_doc_prob = alpha * ((double)doc_freq / rm_doc_info.document_size)
-				   + (1 - alpha) * irrelevant_prob;
-
-	    // Probability for the current document to be relevant to the query.
-	    double doc_query_prob = rm_doc_info.weight / rm_total_weight;
-
-	    relevant_prob += term_doc_prob * doc_query_prob;
-	}
+    const vector<unsigned> & ids = terms.ids;
 
-	// Add relevance to map.
-	it->second = relevant_prob - irrelevant_prob;
+    // Relevance model score for each distinct term.
+    vector<double> term_score;
+    term_score.reserve(terms.stems.size());
+    for (size_t i = 0; i != terms.stems.size(); ++i) {
+	term_score.push_back(term_relevance(terms.stems[i], smoothing));
     }
 
-    // Calculate basic snippet.
-    unsigned int snippet_begin = 0;
-    unsigned int snippet_end = window_size < docterms.size() ? window_size : docterms.size();
-    double sum = 0;
-    double max_sum = 0;
     vector<double> docterms_relevance;
-
-    for (size_t i = 0; i < docterms.size(); ++i) {
-	string term = "Z" + stemmer(docterms[i].term);
-	docterms_relevance.push_back(term_score[term]);
+    docterms_relevance.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+	docterms_relevance.push_back(term_score[ids[i]]);
     }
 
     // Remove interrupts.
-    for (size_t i = 0; i < docterms.size(); ++i) {
+    for (size_t i = 0; i < ids.size(); ++i) {
 	double prev_score = i > 0 ? docterms_relevance[i - 1] : 0;
-	double next_score = i < (docterms.size() - 1) ? docterms_relevance[i + 1] : 0;
+	double next_score = i < (ids.size() - 1) ? docterms_relevance[i + 1] : 0;
 	if (docterms_relevance[i] < prev_score &&
 	    docterms_relevance[i] < next_score) {
 	    docterms_relevance[i] = (prev_score + next_score) / 2;
 	}
     }
 
-    for (unsigned int i = snippet_begin; i < snippet_end; ++i) {
-	double score = docterms_relevance[i];
-	sum += score;
+    // Find the window with the highest total relevance.
+    size_t snippet_begin = 0;
+    size_t snippet_end = window_size < ids.size() ? window_size : ids.size();
+    double sum = 0;
+    for (size_t i = snippet_begin; i < snippet_end; ++i) {
+	sum += docterms_relevance[i];
     }
-    max_sum = sum;
+    double max_sum = sum;
 
-    for (size_t i = snippet_end; i < docterms.size(); ++i) {
-	double score = docterms_relevance[i];
-	sum += score;
-
-	double head_score = docterms_relevance[i - window_size];
-	sum -= head_score;
+    for (size_t i = snippet_end; i < ids.size(); ++i) {
+	sum += docterms_relevance[i];
+	sum -= docterms_relevance[i - window_size];
 
 	if (sum > max_sum) {
 	    max_sum = sum;
 	    snippet_begin = i - window_size + 1;
-	    snippet_end = i + 1;
 	}
     }
 
-    size_t last_pos = 0;
-
-    // Retrieve actual snippet.
-    string snippet;
-
-    unsigned int current_size = 0;
-    while (snippet.size() < length) {
-	if (last_pos == text.length()) {
-	    break;
-	}
-
-	size_t new_pos = text.find(". ", last_pos);
-	if (new_pos == string::npos) {
-	    new_pos = text.length() - 1;
-	}
-
-	string sentence(text, last_pos, new_pos - last_pos + 1);
-	Document sent_doc;
-	term_gen.set_document(sent_doc);
-	term_gen.index_text(sentence);
+    return snippet_begin;
+}
 
-	int sent_size = 0;
-	for (TermIterator it = sent_doc.termlist_begin(); it != sent_doc.termlist_end(); ++it) {
-	    if (is_stemmed(*it)) {
-		continue;
-	    }
+string
+Snipper::Internal::generate_snippet(const string & text,
+				    size_t length,
+				    Xapian::termcount window_size,
+				    double smoothing)
+{
+    // Tokenise the text just once, stopping early if we find a window which
+    // covers all the query terms.
+    SnippetTerms terms(query_terms, stemmer, window_size);
+    tokenise_text(text, terms);
+    if (terms.ids.empty())
+	return string();
+
+    size_t snippet_begin = choose_window(terms, window_size, smoothing);
+    return snippet_from(text, terms.offsets[snippet_begin], length);
+}
 
-	    sent_size += it.positionlist_count();
+string
+Snipper::Internal::generate_snippet(const string & text,
+				    const Document & doc,
+				    size_t length,
+				    Xapian::termcount window_size,
+				    double smoothing)
+{
+    // Read the sequence of terms from the positional information in the
+    // document.
+    SnippetTerms terms(query_terms, stemmer, window_size);
+    vector<pair<Xapian::termpos, unsigned> > postings;
+    map<string, vector<Xapian::termpos> > positions;
+    for (TermIterator t = doc.termlist_begin(); t != doc.termlist_end(); ++t) {
+	const string & term = *t;
+	if (!is_text_term(term) || term[0] == 'Z')
+	    continue;
+	PositionIterator p = t.positionlist_begin();
+	if (p == t.positionlist_end())
+	    continue;
+	unsigned id = terms.get_id(term);
+	vector<Xapian::termpos> & term_positions = positions[term];
+	for ( ; p != t.positionlist_end(); ++p) {
+	    postings.push_back(make_pair(*p, id));
+	    term_positions.push_back(*p);
 	}
+    }
 
-	current_size += sent_size;
-	if (current_size > snippet_begin)
-	    snippet += sentence;
-
-	last_pos = new_pos + 1;
+    if (postings.empty()) {
+	// No positional information stored, so tokenise the text instead.
+	return generate_snippet(text, length, window_size, smoothing);
     }
 
-    if (snippet.size() >= length) {
-	snippet.resize(length - 3);
-	snippet += "...";
+    sort(postings.begin(), postings.end());
+    vector<pair<Xapian::termpos, unsigned> >::const_iterator i;
+    for (i = postings.begin(); i != postings.end(); ++i) {
+	if (!terms.add(i->second))
+	    break;
     }
 
-    return snippet;
+    // The window starts at an index into postings, which we need to convert
+    // to a term position since positions can have gaps or be shared.
+    size_t snippet_begin = choose_window(terms, window_size, smoothing);
+    Xapian::termpos window_pos = postings[snippet_begin].first;
+
+    // We only need to tokenise the text as far as the start of the window.
+    FindOffset find_offset(positions, window_pos);
+    tokenise_text(text, find_offset);
+    if (find_offset.offset == string::npos) {
+	// The positional information doesn't match the text.
+	return generate_snippet(text, length, window_size, smoothing);
+    }
+    return snippet_from(text, find_offset.offset, length);
 }
 
 string
@@ -33,6 +33,8 @@
 
 namespace Xapian {
 
+class SnippetTerms;
+
 class Snipper::Internal : public Xapian::Internal::intrusive_base {
 
     private:
@@ -84,21 +86,6 @@ class Snipper::Internal : public Xapian::Internal::intrusive_base {
 	    RMTermInfo() : coll_occurrence(0) { }
 	};
 
-	/** Holds information about a term and its position in a document */
-	struct TermPositionInfo {
-	    std::string term;
-	    Xapian::termpos position;
-
-	    TermPositionInfo(std::string term_, Xapian::termpos position_) :
-		term(term_),
-		position(position_) { }
-
-	    bool operator < (const TermPositionInfo & other) const
-	    {
-		return position < other.position;
-	    }
-	};
-
 	/** Stemmer used for generating text terms */
 	Stem stemmer;
 
@@ -114,13 +101,36 @@ class Snipper::Internal : public Xapian::Internal::intrusive_base {
 	/** Relevance model total document weight */
 	double rm_total_weight;
 
+	/** Query terms which a snippet should try to cover. */
+	std::vector<std::string> query_terms;
+
 	Internal() : rm_coll_size(0),
 		     rm_total_weight(0) { }
 
+	/** Return the relevance model score for stemmed term @a stem. */
+	double term_relevance(const std::string & stem, double alpha) const;
+
+	/** Pick the term position at which the snippet should start.
+	 *
+	 *  @param terms	The terms of the text, in order.
+	 */
+	size_t choose_window(const SnippetTerms & terms,
+			     Xapian::termcount window_size,
+			     double smoothing) const;
+
 	/** Return snippet generated from text using the precalculated relevance model */
 	std::string generate_snippet(const std::string & text,
 				     size_t length,
-				     unsigned int window_size,
+				     Xapian::termcount window_size,
+				     double smoothing);
+
+	/** Return snippet generated from text, using the positional
+	 *  information in @a doc rather than tokenising all of @a text.
+	 */
+	std::string generate_snippet(const std::string & text,
+				     const Document & doc,
+				     size_t length,
+				     Xapian::termcount window_size,
 				     double smoothing);
 
 	/** Calculate relevance model based on a MSet.
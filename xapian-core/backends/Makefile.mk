@@ -6,8 +6,11 @@ noinst_HEADERS +=\
 	backends/databasereplicator.h\
 	backends/document.h\
 	backends/flint_lock.h\
+	backends/iostatistics.h\
+	backends/memoryusage.h\
 	backends/multivaluelist.h\
 	backends/positionlist.h\
+	backends/prefetch.h\
 	backends/prefix_compressed_strings.h\
 	backends/slowvaluelist.h\
 	backends/valuelist.h\
@@ -23,6 +26,9 @@ lib_src +=\
 	backends/database.cc\
 	backends/databasereplicator.cc\
 	backends/dbfactory.cc\
+	backends/iostatistics.cc\
+	backends/memoryusage.cc\
+	backends/prefetch.cc\
 	backends/slowvaluelist.cc\
 	backends/valuelist.cc
 
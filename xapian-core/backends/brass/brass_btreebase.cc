@@ -33,6 +33,7 @@
 #include "pack.h"
 #include "posixy_wrapper.h"
 #include "str.h"
+#include "tracepoint.h"
 
 #include <algorithm>
 #include <climits>
@@ -227,6 +228,9 @@ BrassTable_base::write_to_file(const string &filename,
 	changes->write_block(buf);
     }
 
-    if (!no_sync)
+    if (!no_sync) {
+	XAPIAN_TRACE(fsync_start, h, 0);
 	io_sync(h);
+	XAPIAN_TRACE(fsync_end, h, 0);
+    }
 }
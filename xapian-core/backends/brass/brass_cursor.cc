@@ -58,8 +58,10 @@ BrassCursor::BrassCursor(const BrassTable *B_, const Brass::Cursor * C_)
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  cursor_count(B_->cursor_count)
 {
+    ++cursor_count->count;
     B->cursor_created_since_last_modification = true;
     C = new Brass::Cursor[level + 1];
     if (!C_) C_ = B->C;
@@ -94,6 +96,7 @@ BrassCursor::rebuild()
 
 BrassCursor::~BrassCursor()
 {
+    --cursor_count->count;
     delete [] C;
 }
 
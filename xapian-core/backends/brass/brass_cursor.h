@@ -25,6 +25,8 @@
 
 #include "brass_types.h"
 
+#include "backends/memoryusage.h"
+
 #include "omassert.h"
 
 #include <algorithm>
@@ -187,6 +189,9 @@ class BrassCursor {
 	/** The value of level in the Btree structure. */
 	int level;
 
+	/// The count of cursors on the table, which includes this one.
+	Xapian::Internal::intrusive_ptr<CursorCount> cursor_count;
+
 	/** Get the key.
 	 *
 	 *  The key of the item at the cursor is copied into key.
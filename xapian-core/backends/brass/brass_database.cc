@@ -39,6 +39,9 @@
 #include "brass_replicate_internal.h"
 #include "brass_document.h"
 #include "../flint_lock.h"
+#ifdef XAPIAN_HAS_INMEMORY_BACKEND
+# include "../inmemory/inmemory_overlay.h"
+#endif
 #include "brass_metadata.h"
 #include "brass_positionlist.h"
 #include "brass_postlist.h"
@@ -56,8 +59,10 @@
 #include "replicationprotocol.h"
 #include "net/length.h"
 #include "posixy_wrapper.h"
+#include "realtime.h"
 #include "str.h"
 #include "stringutils.h"
+#include "tracepoint.h"
 #include "backends/valuestats.h"
 
 #include "safeerrno.h"
@@ -67,6 +72,7 @@
 #include <algorithm>
 #include "autoptr.h"
 #include <cstdlib>
+#include <functional>
 #include <string>
 
 using namespace std;
@@ -170,6 +176,36 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
     }
 }
 
+BrassDatabase::BrassDatabase(const BrassDatabase & other,
+			     brass_revision_number_t revision)
+	: db_dir(other.db_dir),
+	  readonly(true),
+	  version_file(db_dir),
+	  postlist_table(db_dir, readonly),
+	  position_table(db_dir, readonly),
+	  termlist_table(db_dir, readonly),
+	  value_manager(&postlist_table, &termlist_table),
+	  synonym_table(db_dir, readonly),
+	  spelling_table(db_dir, readonly),
+	  record_table(db_dir, readonly),
+	  lock(db_dir),
+	  changes(db_dir)
+{
+    LOGCALL_CTOR(DB, "BrassDatabase", Literal("other") | revision);
+
+    version_file.read_and_check();
+    bool ok = record_table.open_shared(0, other.record_table, revision);
+    ok = spelling_table.open_shared(0, other.spelling_table, revision) && ok;
+    ok = synonym_table.open_shared(0, other.synonym_table, revision) && ok;
+    ok = termlist_table.open_shared(0, other.termlist_table, revision) && ok;
+    ok = position_table.open_shared(0, other.position_table, revision) && ok;
+    ok = postlist_table.open_shared(0, other.postlist_table, revision) && ok;
+    if (!ok) {
+	throw Xapian::DatabaseModifiedError("The revision being read has been discarded - you should call Xapian::Database::reopen() and retry the operation");
+    }
+    stats.read(postlist_table);
+}
+
 BrassDatabase::~BrassDatabase()
 {
     LOGCALL_DTOR(DB, "BrassDatabase");
@@ -321,6 +357,15 @@ BrassDatabase::open_tables(int flags, brass_revision_number_t revision)
     postlist_table.open(flags, revision);
 }
 
+Xapian::Database::Internal *
+BrassDatabase::clone_for_thread() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "BrassDatabase::clone_for_thread", NO_ARGS);
+    if (!postlist_table.is_open())
+	BrassTable::throw_database_closed();
+    RETURN(new BrassDatabase(*this, get_revision_number()));
+}
+
 brass_revision_number_t
 BrassDatabase::get_revision_number() const
 {
@@ -812,6 +857,7 @@ LeafPostList *
 BrassDatabase::open_post_list(const string& term) const
 {
     LOGCALL(DB, LeafPostList *, "BrassDatabase::open_post_list", term);
+    XAPIAN_TRACE(postlist_open, trace_pack(term), trace_pack(term, 8));
     intrusive_ptr<const BrassDatabase> ptrtothis(this);
 
     if (term.empty()) {
@@ -954,6 +1000,141 @@ BrassDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+void
+BrassDatabase::get_io_statistics(IOStatistics & result) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::get_io_statistics", NO_ARGS);
+    result.add(io_stats);
+    result.value_chunk_reads += value_manager.get_chunk_reads();
+    const BrassTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	const BrassTable * table = tables[i];
+	result.add_table(table->get_tablename(), table->get_io_statistics());
+    }
+}
+
+void
+BrassDatabase::reset_io_statistics()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::reset_io_statistics", NO_ARGS);
+    io_stats.reset();
+    value_manager.reset_chunk_reads();
+    postlist_table.reset_io_statistics();
+    position_table.reset_io_statistics();
+    termlist_table.reset_io_statistics();
+    synonym_table.reset_io_statistics();
+    spelling_table.reset_io_statistics();
+    record_table.reset_io_statistics();
+}
+
+void
+BrassDatabase::get_memory_usage(MemoryUsage & result) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::get_memory_usage", NO_ARGS);
+    const BrassTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	const BrassTable * table = tables[i];
+	result.add_table(table->get_tablename(), table->get_memory_usage());
+    }
+    result.value_stats += value_manager.get_value_stats_memory_usage();
+}
+
+void
+BrassDatabase::prefetch(PrefetchBudget & budget, Xapian::termcount max_terms,
+			const vector<Xapian::valueno> & slots) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::prefetch",
+		 budget.get_remaining() | max_terms | slots.size());
+    // Every search needs the internal levels of the tables it uses, so read
+    // those first.
+    PrefetchLeaves leaves;
+    postlist_table.prefetch_index(budget, &leaves);
+    const BrassTable * tables[] = {
+	&position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	tables[i]->prefetch_index(budget, NULL);
+    }
+
+    // Then the document lengths, which most weighting schemes need.
+    vector<uint4> blocks;
+    prefetch_leaves_with_prefix(leaves, string("\0\xe0", 2), blocks);
+    postlist_table.prefetch_blocks(blocks, budget);
+
+    // Then the value streams.  If no slots were specified, read those for
+    // every slot which has values, starting with the most frequently set.
+    vector<Xapian::valueno> value_slots(slots);
+    if (value_slots.empty()) {
+	vector<pair<Xapian::doccount, Xapian::valueno> > freqs;
+	AutoPtr<BrassCursor> cursor(postlist_table.cursor_get());
+	if (cursor.get()) {
+	    // The keys of the value statistics, as made by
+	    // make_valuestats_key().
+	    const string prefix("\0\xd0", 2);
+	    cursor->find_entry(prefix);
+	    while (cursor->next() && startswith(cursor->current_key, prefix)) {
+		const string & key = cursor->current_key;
+		const char * p = key.data() + prefix.size();
+		Xapian::valueno slot;
+		if (!unpack_uint_last(&p, key.data() + key.size(), &slot))
+		    throw Xapian::DatabaseCorruptError("Bad value statistics key");
+		cursor->read_tag();
+		const string & tag = cursor->current_tag;
+		const char * pos = tag.data();
+		Xapian::doccount freq;
+		if (!unpack_uint(&pos, pos + tag.size(), &freq))
+		    throw Xapian::DatabaseCorruptError("Bad value statistics item");
+		freqs.push_back(make_pair(freq, slot));
+	    }
+	}
+	sort(freqs.begin(), freqs.end(),
+	     greater<pair<Xapian::doccount, Xapian::valueno> >());
+	for (size_t i = 0; i != freqs.size(); ++i) {
+	    value_slots.push_back(freqs[i].second);
+	}
+    }
+    for (size_t i = 0; i != value_slots.size(); ++i) {
+	// The start of the keys of the slot's value chunks, as made by
+	// make_valuechunk_key().
+	string prefix("\0\xd8", 2);
+	pack_uint(prefix, value_slots[i]);
+	blocks.clear();
+	prefetch_leaves_with_prefix(leaves, prefix, blocks);
+	postlist_table.prefetch_blocks(blocks, budget);
+    }
+
+    // And finally the longest postlists.
+    blocks.clear();
+    prefetch_longest_postlists(leaves, max_terms, blocks);
+    postlist_table.prefetch_blocks(blocks, budget);
+}
+
+void
+BrassDatabase::prefetch_blocks(const map<string, vector<uint4> > & blocks,
+			      PrefetchBudget & budget) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::prefetch_blocks",
+		 blocks.size() | budget.get_remaining());
+    const BrassTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	map<string, vector<uint4> >::const_iterator j;
+	j = blocks.find(tables[i]->get_tablename());
+	if (j == blocks.end()) continue;
+	vector<uint4> table_blocks(j->second);
+	tables[i]->prefetch_blocks(table_blocks, budget);
+    }
+}
+
 void
 BrassDatabase::throw_termlist_table_close_exception() const
 {
@@ -971,6 +1152,7 @@ BrassWritableDatabase::BrassWritableDatabase(const string &dir, int flags,
 	: BrassDatabase(dir, flags, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  memory_limit(0),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1001,12 +1183,16 @@ BrassWritableDatabase::commit()
 void
 BrassWritableDatabase::flush_postlist_changes() const
 {
+    double start = RealTime::now();
+    XAPIAN_TRACE(postlist_flush_start, change_count, 0);
     stats.set_oldest_changeset(changes.get_oldest_changeset());
     stats.write(postlist_table);
     inverter.flush(postlist_table);
     inverter.flush_pos_lists(position_table);
 
     change_count = 0;
+    io_stats.flushed(RealTime::now() - start);
+    XAPIAN_TRACE(postlist_flush_end, 0, 0);
 }
 
 void
@@ -1023,8 +1209,11 @@ BrassWritableDatabase::close()
 void
 BrassWritableDatabase::apply()
 {
+    double start = RealTime::now();
     value_manager.set_value_stats(value_stats);
     BrassDatabase::apply();
+    changed_docids.clear();
+    io_stats.committed(RealTime::now() - start);
 }
 
 Xapian::docid
@@ -1044,6 +1233,7 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
 {
     LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_document_", did | document);
     Assert(did != 0);
+    changed_docids.insert(did);
     try {
 	// Add the record using that document ID.
 	record_table.replace_record(document.get_data(), did);
@@ -1086,10 +1276,10 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    // The memory used is an estimate from the inverter's bookkeeping, so is
+    // only checked if the user has set a memory limit.
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1102,6 +1292,7 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::delete_document", did);
     Assert(did != 0);
+    changed_docids.insert(did);
 
     if (!termlist_table.is_open())
 	throw_termlist_table_close_exception();
@@ -1153,7 +1344,8 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1165,6 +1357,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::replace_document", did | document);
     Assert(did != 0);
+    changed_docids.insert(did);
 
     try {
 	if (did > stats.get_last_docid()) {
@@ -1313,7 +1506,8 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1406,6 +1600,7 @@ LeafPostList *
 BrassWritableDatabase::open_post_list(const string& tname) const
 {
     LOGCALL(DB, LeafPostList *, "BrassWritableDatabase::open_post_list", tname);
+    XAPIAN_TRACE(postlist_open, trace_pack(tname), trace_pack(tname, 8));
     intrusive_ptr<const BrassWritableDatabase> ptrtothis(this);
 
     if (tname.empty()) {
@@ -1491,9 +1686,17 @@ BrassWritableDatabase::cancel()
 
     inverter.clear();
     value_stats.clear();
+    changed_docids.clear();
     change_count = 0;
 }
 
+void
+BrassWritableDatabase::set_memory_limit(size_t limit)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::set_memory_limit", limit);
+    memory_limit = limit;
+}
+
 void
 BrassWritableDatabase::add_spelling(const string & word,
 				    Xapian::termcount freqinc) const
@@ -1563,3 +1766,26 @@ BrassWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+Xapian::Database::Internal *
+BrassWritableDatabase::open_snapshot() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "BrassWritableDatabase::open_snapshot", NO_ARGS);
+#ifdef XAPIAN_HAS_INMEMORY_BACKEND
+    // A new reader sees the last committed revision, and we overlay the
+    // documents which have changed since then.
+    intrusive_ptr<Xapian::Database::Internal> base(new BrassDatabase(db_dir));
+    Xapian::Database source(const_cast<BrassWritableDatabase *>(this));
+    RETURN(InMemoryOverlayDatabase::open(base.get(), source, changed_docids));
+#else
+    throw Xapian::FeatureUnavailableError("Snapshots of brass databases require the inmemory backend");
+#endif
+}
+
+void
+BrassWritableDatabase::get_memory_usage(MemoryUsage & result) const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::get_memory_usage", NO_ARGS);
+    BrassDatabase::get_memory_usage(result);
+    result.pending_changes += get_pending_changes_memory();
+}
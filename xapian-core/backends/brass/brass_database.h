@@ -39,6 +39,8 @@
 #include "brass_version.h"
 #include "../flint_lock.h"
 #include "brass_types.h"
+#include "backends/iostatistics.h"
+#include "backends/memoryusage.h"
 #include "backends/valuestats.h"
 
 #include "noreturn.h"
@@ -46,6 +48,7 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <set>
 
 class BrassTermList;
 class BrassAllDocsPostList;
@@ -60,6 +63,7 @@ class BrassDatabase : public Xapian::Database::Internal {
     friend class BrassPostList;
     friend class BrassAllTermsList;
     friend class BrassAllDocsPostList;
+    friend class BrassValueList;
     private:
 	/** Directory to store databases in.
 	 */
@@ -121,6 +125,12 @@ class BrassDatabase : public Xapian::Database::Internal {
 	/// Replication changesets.
 	BrassChanges changes;
 
+	/** Counters of I/O which isn't specific to a table.
+	 *
+	 *  The tables keep their own counters.
+	 */
+	mutable IOStatistics io_stats;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -241,6 +251,20 @@ class BrassDatabase : public Xapian::Database::Internal {
 	BrassDatabase(const string &db_dir_, int flags = Xapian::DB_READONLY_,
 		      unsigned int block_size = 0u);
 
+	/** Open a read-only brass database at a particular revision.
+	 *
+	 *  The tables share the file descriptors of @a other's tables where
+	 *  possible (see BrassTable::open_shared()).
+	 *
+	 *  @exception Xapian::DatabaseModifiedError is thrown if @a revision
+	 *             is no longer available.
+	 *
+	 *  @param other	the database to share file descriptors with
+	 *  @param revision	the revision to open
+	 */
+	BrassDatabase(const BrassDatabase & other,
+		      brass_revision_number_t revision);
+
 	~BrassDatabase();
 
 	/// Get a postlist table cursor (used by BrassValueList).
@@ -297,6 +321,14 @@ class BrassDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	Xapian::Database::Internal * clone_for_thread() const;
+	void get_io_statistics(IOStatistics & stats) const;
+	void reset_io_statistics();
+	void get_memory_usage(MemoryUsage & usage) const;
+	void prefetch(PrefetchBudget & budget, Xapian::termcount max_terms,
+		      const vector<Xapian::valueno> & slots) const;
+	void prefetch_blocks(const map<string, vector<uint4> > & blocks,
+			     PrefetchBudget & budget) const;
 	//@}
 
 	XAPIAN_NORETURN(void throw_termlist_table_close_exception() const);
@@ -309,6 +341,13 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	mutable map<Xapian::valueno, ValueStats> value_stats;
 
+	/** The docids of documents added, deleted, or replaced since the last
+	 *  commit.
+	 *
+	 *  Used by open_snapshot().
+	 */
+	std::set<Xapian::docid> changed_docids;
+
 	/** The number of documents added, deleted, or replaced since the last
 	 *  flush.
 	 */
@@ -317,6 +356,29 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// If change_count reaches this threshold we automatically flush.
 	Xapian::doccount flush_threshold;
 
+	/** If the buffered changes are estimated to use this many bytes we
+	 *  automatically flush (0 means no limit).
+	 */
+	size_t memory_limit;
+
+	/// Return an estimate of the bytes held by buffered changes.
+	size_t get_pending_changes_memory() const {
+	    return inverter.get_memory_usage() +
+		   value_manager.get_changes_memory_usage() +
+		   value_stats.size() * (MAP_ENTRY_OVERHEAD + sizeof(ValueStats));
+	}
+
+	/// Return true if the buffered changes should be flushed.
+	bool flush_needed() const {
+	    if (change_count >= flush_threshold) return true;
+	    if (!memory_limit) return false;
+	    // During a transaction, flushing only writes out the postlist
+	    // changes, so don't count the other changes.
+	    size_t bytes = transaction_active() ?
+		inverter.get_memory_usage() : get_pending_changes_memory();
+	    return bytes >= memory_limit;
+	}
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -347,6 +409,8 @@ class BrassWritableDatabase : public BrassDatabase {
 	/** Cancel pending modifications to the database. */
 	void cancel();
 
+	void set_memory_limit(size_t limit);
+
 	Xapian::docid add_document(const Xapian::Document & document);
 	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
 	// Stop the default implementation of delete_document(term) and
@@ -411,6 +475,9 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+
+	Xapian::Database::Internal * open_snapshot() const;
+	void get_memory_usage(MemoryUsage & usage) const;
 	//@}
 };
 
@@ -56,7 +56,7 @@ BrassFreeList::write_block(BrassTable * B, uint4 n, byte * ptr)
 }
 
 uint4
-BrassFreeList::get_block(BrassTable *B)
+BrassFreeList::get_block(BrassTable *B, uint4 * blk_to_free)
 {
     if (fl == fl_end) {
 	return first_unused_block++;
@@ -65,19 +65,32 @@ BrassFreeList::get_block(BrassTable *B)
     if (p == 0 || fl.c == block_size - 4) {
 	if (p == 0) {
 	    p = new byte[block_size];
+	    read_block(B, fl.n, p);
 	} else {
-	    mark_block_unused(B, fl.n);
+	    uint4 old_fl_blk = fl.n;
 	    fl.n = getint4(p, fl.c);
 	    // Allow for mini-header at start of freelist block.
 	    fl.c = C_BASE;
+	    read_block(B, fl.n, p);
+	    // Only mark the old freelist block as unused once we've moved on to
+	    // the next one, as doing so may need to call get_block() to extend
+	    // the freelist being written, and if we were still at the end of
+	    // the old block we'd recurse forever.  If we were called by
+	    // mark_block_unused(), it has to mark the block once it's finished
+	    // updating the freelist being written.
+	    if (blk_to_free) {
+		Assert(*blk_to_free == BLK_UNUSED);
+		*blk_to_free = old_fl_blk;
+	    } else {
+		mark_block_unused(B, old_fl_blk);
+	    }
 	}
-	read_block(B, fl.n, p);
 
 	// Either the freelist end is in this block, or this freelist block has a
 	// next pointer.
 	Assert(fl.n == fl_end.n || getint4(p, block_size - 4) != -1);
 
-	return get_block(B);
+	return get_block(B, blk_to_free);
     }
 
     // Either the freelist end is in this block, or this freelist block has a
@@ -100,7 +113,7 @@ BrassFreeList::walk(BrassTable *B, bool inclusive)
 	return static_cast<uint4>(-1);
     }
 
-    if (p == 0 || fl.c == block_size) {
+    if (p == 0 || fl.c == block_size - 4) {
 	if (p == 0) {
 	    p = new byte[block_size];
 	} else {
@@ -139,8 +152,9 @@ BrassFreeList::mark_block_unused(BrassTable * B, uint4 blk)
 	    flw_appending = true;
 	}
     }
+    uint4 blk_to_free = BLK_UNUSED;
     if (flw.c == 0) {
-	uint4 n = get_block(B);
+	uint4 n = get_block(B, &blk_to_free);
 	flw.n = n;
 	flw.c = C_BASE;
 	if (fl.c == 0) {
@@ -151,7 +165,7 @@ BrassFreeList::mark_block_unused(BrassTable * B, uint4 blk)
     } else if (flw.c == block_size - 4) {
 	// blk is free *after* the current revision gets released, so we can't
 	// just use blk as the next block in the freelist chain.
-	uint4 n = get_block(B);
+	uint4 n = get_block(B, &blk_to_free);
 	setint4(pw, flw.c, n);
 	SET_REVISION(pw, revision + 1);
 	write_block(B, flw.n, pw);
@@ -167,6 +181,12 @@ BrassFreeList::mark_block_unused(BrassTable * B, uint4 blk)
 
     setint4(pw, flw.c, blk);
     flw.c += 4;
+
+    if (blk_to_free != BLK_UNUSED) {
+	// Now the freelist being written is consistent, we can mark the used
+	// up freelist block as unused.
+	mark_block_unused(B, blk_to_free);
+    }
 }
 
 void
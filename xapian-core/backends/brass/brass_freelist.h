@@ -99,7 +99,14 @@ class BrassFreeList {
 
     bool empty() const { return fl == fl_end; }
 
-    uint4 get_block(BrassTable * B);
+    /** Get a block to use.
+     *
+     *  @param blk_to_free	If non-NULL and a freelist block is used up,
+     *				it is stored here for the caller to pass to
+     *				mark_block_unused(), rather than this method
+     *				calling mark_block_unused() itself.
+     */
+    uint4 get_block(BrassTable * B, uint4 * blk_to_free = NULL);
 
     uint4 walk(BrassTable *B, bool inclusive);
 
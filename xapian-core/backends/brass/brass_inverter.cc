@@ -96,8 +96,15 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & term,
 			   const string & s)
 {
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-	.first->second[did] = s;
+    pair<map<string, map<Xapian::docid, string> >::iterator, bool> r;
+    r = pos_changes.insert(make_pair(term, map<Xapian::docid, string>()));
+    if (r.second) {
+	pos_changes_memory += MAP_ENTRY_OVERHEAD +
+	    string_memory_usage(term.size()) + sizeof(map<Xapian::docid, string>);
+    }
+    r.first->second[did] = s;
+    pos_changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+	string_memory_usage(s.size());
 }
 
 void
@@ -166,6 +173,7 @@ Inverter::flush_post_list(BrassPostListTable & table, const string & term)
 
     // Flush buffered changes for just this term's postlist.
     table.merge_changes(term, i->second);
+    forget_term_changes(i);
     postlist_changes.erase(i);
 }
 
@@ -177,6 +185,7 @@ Inverter::flush_all_post_lists(BrassPostListTable & table)
 	table.merge_changes(i->first, i->second);
     }
     postlist_changes.clear();
+    postlist_changes_memory = 0;
 }
 
 void
@@ -191,6 +200,7 @@ Inverter::flush_post_lists(BrassPostListTable & table, const string & pfx)
 
     for (i = begin; i != end; ++i) {
 	table.merge_changes(i->first, i->second);
+	forget_term_changes(i);
     }
 
     // Erase all the entries in one go, as that's:
@@ -223,4 +233,5 @@ Inverter::flush_pos_lists(BrassPositionListTable & table)
 	}
     }
     pos_changes.clear();
+    pos_changes_memory = 0;
 }
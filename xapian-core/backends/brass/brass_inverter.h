@@ -23,10 +23,12 @@
 
 #include "xapian/types.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
 
+#include "backends/memoryusage.h"
 #include "omassert.h"
 #include "str.h"
 #include "xapian/error.h"
@@ -41,6 +43,10 @@ class TermIterator;
 /** Magic wdf value used for a deleted posting. */
 const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 
+/// Estimate of the bytes used to buffer a change to a posting.
+const size_t POSTING_CHANGE_MEMORY =
+    MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) + sizeof(Xapian::termcount);
+
 /** Class which "inverts the file". */
 class Inverter {
     friend class BrassPostListTable;
@@ -109,6 +115,9 @@ class Inverter {
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/// Get the number of postings changed.
+	size_t get_changes_count() const { return pl_changes.size(); }
     };
 
     /// Buffered changes to postlists.
@@ -117,6 +126,34 @@ class Inverter {
     /// Buffered changes to positional data.
     std::map<std::string, std::map<Xapian::docid, std::string> > pos_changes;
 
+    /** Estimate of the bytes held by postlist_changes.
+     *
+     *  This is updated as changes are buffered, as it needs to be cheap to
+     *  check after each document.  Changing the same posting twice is counted
+     *  twice, so it tends to be an overestimate.
+     */
+    size_t postlist_changes_memory;
+
+    /// Estimate of the bytes held by pos_changes.
+    size_t pos_changes_memory;
+
+    /// Estimate of the bytes a term's entry in postlist_changes holds.
+    static size_t term_changes_memory(const std::string & term,
+				      const PostingChanges & changes) {
+	return MAP_ENTRY_OVERHEAD + string_memory_usage(term.size()) +
+	       sizeof(PostingChanges) +
+	       changes.get_changes_count() * POSTING_CHANGE_MEMORY;
+    }
+
+    /// Stop counting the buffered changes for the term at @a i.
+    void forget_term_changes(
+	    std::map<std::string, PostingChanges>::const_iterator i) {
+	size_t m = term_changes_memory(i->first, i->second);
+	// postlist_changes_memory can count a posting more than once, so it
+	// can't go below zero here, but it's better to be safe.
+	postlist_changes_memory -= std::min(m, postlist_changes_memory);
+    }
+
     void store_positions(const BrassPositionListTable & position_table,
 			 Xapian::docid did,
 			 const std::string & tname,
@@ -132,15 +169,19 @@ class Inverter {
     std::map<Xapian::docid, Xapian::termcount> doclen_changes;
 
   public:
+    Inverter() : postlist_changes_memory(0), pos_changes_memory(0) { }
+
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf))).first;
+	    postlist_changes_memory += term_changes_memory(term, i->second);
 	} else {
 	    i->second.add_posting(did, wdf);
+	    postlist_changes_memory += POSTING_CHANGE_MEMORY;
 	}
     }
 
@@ -149,10 +190,12 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf, false))).first;
+	    postlist_changes_memory += term_changes_memory(term, i->second);
 	} else {
 	    i->second.remove_posting(did, wdf);
+	    postlist_changes_memory += POSTING_CHANGE_MEMORY;
 	}
     }
 
@@ -162,10 +205,12 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf))).first;
+	    postlist_changes_memory += term_changes_memory(term, i->second);
 	} else {
 	    i->second.update_posting(did, old_wdf, new_wdf);
+	    postlist_changes_memory += POSTING_CHANGE_MEMORY;
 	}
     }
 
@@ -188,6 +233,13 @@ class Inverter {
 	doclen_changes.clear();
 	postlist_changes.clear();
 	pos_changes.clear();
+	postlist_changes_memory = pos_changes_memory = 0;
+    }
+
+    /// Return an estimate of the bytes held by the buffered changes.
+    size_t get_memory_usage() const {
+	return postlist_changes_memory + pos_changes_memory +
+	       doclen_changes.size() * POSTING_CHANGE_MEMORY;
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
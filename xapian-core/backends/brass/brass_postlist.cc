@@ -85,6 +85,16 @@ BrassPostListTable::document_exists(Xapian::docid did,
 // Or indexing speed.  Or something...
 const unsigned int CHUNKSIZE = 2000;
 
+/** How many chunks ahead skip_to() will step through with the cursor before
+ *  it resorts to looking up the chunk in the B-tree.
+ *
+ *  Stepping the cursor on to the next chunk is usually cheaper than a
+ *  find_entry() call (which starts again from the root of the B-tree) so
+ *  when the target is only a few chunks ahead, as is common when the other
+ *  postlists in an AND have a similar term frequency, we scan forward.
+ */
+const unsigned int MAX_CHUNKS_TO_SCAN = 4;
+
 /** PostlistChunkWriter is a wrapper which acts roughly as an
  *  output iterator on a postlist chunk, taking care of the
  *  messy details.  It's intended to be used with deletion and
@@ -672,6 +682,7 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 			     bool keep_reference)
 	: LeafPostList(term_),
 	  this_db(keep_reference ? this_db_ : NULL),
+	  io_stats(&this_db_->io_stats),
 	  have_started(false),
 	  is_at_end(false),
 	  cursor(this_db_->postlist_table.cursor_get())
@@ -685,6 +696,7 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 			     BrassCursor * cursor_)
 	: LeafPostList(term_),
 	  this_db(this_db_),
+	  io_stats(&this_db_->io_stats),
 	  have_started(false),
 	  is_at_end(false),
 	  cursor(cursor_)
@@ -708,6 +720,8 @@ BrassPostList::init()
 	last_did_in_chunk = 0;
 	return;
     }
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
@@ -798,6 +812,8 @@ BrassPostList::next_chunk()
     }
     did = newdid;
 
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
@@ -875,6 +891,8 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
     }
     is_at_end = false;
 
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
@@ -905,6 +923,29 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
     if (desired_did > last_did_in_chunk) next_chunk();
 }
 
+bool
+BrassPostList::scan_forward_to_chunk_containing(Xapian::docid desired_did)
+{
+    LOGCALL(DB, bool, "BrassPostList::scan_forward_to_chunk_containing", desired_did);
+    AssertRel(desired_did,>,last_did_in_chunk);
+
+    // Use the range of docids in the current chunk to estimate how many
+    // chunks ahead desired_did is, and don't bother trying if it looks
+    // like we'd run out of steps before we got there.
+    Xapian::docid span = last_did_in_chunk - first_did_in_chunk + 1;
+    if ((desired_did - last_did_in_chunk - 1) / span >= MAX_CHUNKS_TO_SCAN)
+	RETURN(false);
+
+    for (unsigned n = 0; n != MAX_CHUNKS_TO_SCAN; ++n) {
+	next_chunk();
+	// If desired_did falls between two chunks, we'll end up at the start
+	// of the later one, which is what we want.
+	if (is_at_end || desired_did <= last_did_in_chunk)
+	    RETURN(true);
+    }
+    RETURN(false);
+}
+
 bool
 BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 {
@@ -943,9 +984,11 @@ BrassPostList::skip_to(Xapian::docid desired_did, double w_min)
     // Don't skip back, and don't need to do anything if already there.
     if (is_at_end || desired_did <= did) RETURN(NULL);
 
-    // Move to correct chunk
+    // Move to correct chunk.  We know desired_did > did, so if it isn't in
+    // the current chunk, it must be in a later one.
     if (!current_chunk_contains(desired_did)) {
-	move_to_chunk_containing(desired_did);
+	if (!scan_forward_to_chunk_containing(desired_did))
+	    move_to_chunk_containing(desired_did);
 	// Might be at_end now, so we need to check before trying to move
 	// forward in chunk.
 	if (is_at_end) RETURN(NULL);
@@ -41,6 +41,7 @@ using namespace std;
 
 class BrassCursor;
 class BrassDatabase;
+struct IOStatistics;
 
 namespace Brass {
     class PostlistChunkReader;
@@ -131,6 +132,12 @@ class BrassPostList : public LeafPostList {
 	 */
 	Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db;
 
+	/** The database's I/O counters.
+	 *
+	 *  This is set even when we don't keep a reference to the database.
+	 */
+	IOStatistics * io_stats;
+
 	/// The position list object for this posting list.
 	BrassPositionList positionlist;
 
@@ -207,6 +214,17 @@ class BrassPostList : public LeafPostList {
 	 */
 	void move_to_chunk_containing(Xapian::docid desired_did);
 
+	/** Try to move forward to the chunk containing the specified document
+	 *  ID by stepping the cursor through the following few chunks.
+	 *
+	 *  @a desired_did must be after the end of the current chunk.
+	 *
+	 *  @return true if we're now in the right chunk (or at the end of the
+	 *	    list); false if we gave up, in which case the caller should
+	 *	    call move_to_chunk_containing().
+	 */
+	bool scan_forward_to_chunk_containing(Xapian::docid desired_did);
+
 	/** Scan forward in the current chunk for the specified document ID.
 	 *
 	 *  This is particularly efficient if the desired document ID is
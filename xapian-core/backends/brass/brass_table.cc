@@ -49,10 +49,13 @@
 #include "io_utils.h"
 #include "omassert.h"
 #include "pack.h"
+#include "tracepoint.h"
 #include "unaligned.h"
 
 #include <algorithm>  // for std::min()
+#include <map>
 #include <string>
+#include <vector>
 
 #include "xapian/constants.h"
 
@@ -153,6 +156,114 @@ static inline byte *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
+size_t
+BrassTable::get_memory_usage() const
+{
+    // The blocks held by our own cursor, and the buffers used for writing.
+    size_t blocks = 0;
+    for (int j = 0; j <= level; ++j) {
+	if (C[j].get_p()) ++blocks;
+    }
+    if (split_p) ++blocks;
+    if (kt.get_address()) ++blocks;
+    if (buffer) ++blocks;
+    // A BrassCursor shares blocks with the cursor it was cloned from until it
+    // moves, so this is an upper bound.
+    blocks += cursor_count->count * (level + 1);
+    return blocks * block_size;
+}
+
+void
+BrassTable::prefetch_index(PrefetchBudget & budget, PrefetchLeaves * leaves) const
+{
+    LOGCALL_VOID(DB, "BrassTable::prefetch_index",
+		 budget.get_remaining() | (void*)leaves);
+    if (handle < 0) {
+	if (handle == -2)
+	    BrassTable::throw_database_closed();
+	// A lazy table which hasn't been created yet.
+	return;
+    }
+
+    // The blocks at the level we're reading, each with the lowest key which
+    // can be in it.  A branch block may start with an item with a null key,
+    // which stands for the key of the item pointing to the block.
+    map<uint4, string> blocks;
+    blocks[root] = string();
+    if (level == 0) {
+	// The root is the only block, and it's a leaf.
+	vector<uint4> to_read(1, root);
+	prefetch_read(handle, block_size, to_read, budget);
+	return;
+    }
+
+    for (int j = level; j > 0 && !blocks.empty(); --j) {
+	vector<uint4> to_read;
+	to_read.reserve(blocks.size());
+	map<uint4, string>::const_iterator i;
+	for (i = blocks.begin(); i != blocks.end(); ++i) {
+	    to_read.push_back(i->first);
+	}
+	string data;
+	prefetch_read(handle, block_size, to_read, budget, &data);
+
+	map<uint4, string> children;
+	for (size_t b = 0; b != to_read.size(); ++b) {
+	    const byte * p = reinterpret_cast<const byte *>(data.data()) +
+			     b * block_size;
+	    // If a writer has committed since we opened the table, the block
+	    // may have been reused, so check it still looks like ours.
+	    int dir_end = DIR_END(p);
+	    if (REVISION(p) > revision_number || GET_LEVEL(p) != j ||
+		dir_end < DIR_START || unsigned(dir_end) > block_size) {
+		continue;
+	    }
+	    const string & lowest = blocks[to_read[b]];
+	    for (int c = DIR_START; c < dir_end; c += D2) {
+		Item item(p, c);
+		uint4 child = item.block_given_by();
+		if (child >= base.get_first_unused_block()) continue;
+		string key;
+		if (getK(item.key().get_address(), 0) == K1) {
+		    key = lowest;
+		} else {
+		    item.key().read(&key);
+		}
+		if (j == 1) {
+		    if (leaves) leaves->push_back(make_pair(key, child));
+		} else {
+		    children[child] = key;
+		}
+	    }
+	}
+	swap(blocks, children);
+    }
+
+    if (leaves) sort(leaves->begin(), leaves->end());
+}
+
+void
+BrassTable::prefetch_blocks(vector<uint4> & blocks, PrefetchBudget & budget) const
+{
+    LOGCALL_VOID(DB, "BrassTable::prefetch_blocks",
+		 blocks.size() | budget.get_remaining());
+    if (handle < 0) {
+	if (handle == -2)
+	    BrassTable::throw_database_closed();
+	return;
+    }
+    vector<uint4>::iterator i = blocks.begin();
+    while (i != blocks.end()) {
+	uint4 n = *i;
+	if (n >= base.get_first_unused_block()) {
+	    i = blocks.erase(i);
+	} else {
+	    ++i;
+	}
+    }
+    prefetch_read(handle, block_size, blocks, budget);
+}
+
 /// read_block(n, p) reads block n of the DB file to address p.
 void
 BrassTable::read_block(uint4 n, byte * p) const
@@ -164,6 +275,9 @@ BrassTable::read_block(uint4 n, byte * p) const
     AssertRel(n,<,base.get_first_unused_block());
 
     io_read_block(handle, reinterpret_cast<char *>(p), block_size, n);
+    XAPIAN_TRACE(block_read, n, trace_pack(tablename));
+    ++io_stats.block_reads;
+    io_stats.bytes_read += block_size;
 
     if (GET_LEVEL(p) != LEVEL_FREELIST) {
 	int dir_end = DIR_END(p);
@@ -229,6 +343,8 @@ BrassTable::write_block(uint4 n, const byte * p, bool appending) const
     } // FIXME: replicate removal of old bases?
 
     io_write_block(handle, p, block_size, n);
+    ++io_stats.block_writes;
+    io_stats.bytes_written += block_size;
 
     if (!changes_obj) return;
 
@@ -459,6 +575,7 @@ BrassTable::find(Brass::Cursor * C_) const
 {
     LOGCALL(DB, bool, "BrassTable::find", (void*)C_);
     // Note: the parameter is needed when we're called by BrassCursor
+    ++io_stats.seeks;
     const byte * p;
     int c;
     Key key = kt.key();
@@ -1313,10 +1430,7 @@ BrassTable::basic_open(bool revision_supplied, brass_revision_number_t revision_
 	}
 
 	if (!valid_base) {
-	    if (handle >= 0) {
-		::close(handle);
-		handle = -1;
-	    }
+	    if (handle >= 0) close_handle();
 	    string message = "Error opening table '";
 	    message += name;
 	    message += "DB':\n";
@@ -1519,6 +1633,7 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  faked_root_block(true),
 	  sequential(true),
 	  handle(-1),
+	  shared_handle(NULL),
 	  level(0),
 	  root(0),
 	  kt(0),
@@ -1535,6 +1650,7 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  cursor_created_since_last_modification(false),
 	  cursor_version(0),
 	  changes_obj(NULL),
+	  cursor_count(new CursorCount),
 	  split_p(0),
 	  compress_strategy(compress_strategy_),
 	  comp_stream(compress_strategy_),
@@ -1621,8 +1737,7 @@ void BrassTable::close(bool permanent) {
     if (handle >= 0) {
 	// If an error occurs here, we just ignore it, since we're just
 	// trying to free everything.
-	(void)::close(handle);
-	handle = -1;
+	close_handle();
     }
 
     if (permanent) {
@@ -1721,7 +1836,10 @@ BrassTable::commit(brass_revision_number_t revision)
 	// happen, and so the calls to io_sync() are adjacent which may be
 	// more efficient, at least with some Linux kernel versions.
 	if ((flags & Xapian::DB_NO_SYNC) == 0) {
-	    if (!io_sync(handle)) {
+	    XAPIAN_TRACE(fsync_start, handle, 0);
+	    bool synced = io_sync(handle);
+	    XAPIAN_TRACE(fsync_end, handle, 0);
+	    if (!synced) {
 		(void)::close(handle);
 		handle = -1;
 		(void)unlink(tmp.c_str());
@@ -1812,23 +1930,33 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
     if (handle == -2) {
 	BrassTable::throw_database_closed();
     }
-    handle = ::open((name + "DB").c_str(), O_RDONLY | O_BINARY | O_CLOEXEC);
-    if (handle < 0) {
-	if (lazy) {
-	    // This table is optional when reading!
-	    revision_number = revision_;
-	    RETURN(true);
+    if (shared_handle) {
+	// open_shared() has given us another table's file descriptor.
+	handle = *shared_handle;
+    } else {
+	handle = ::open((name + "DB").c_str(), O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (handle < 0) {
+	    if (lazy) {
+		// This table is optional when reading!
+		revision_number = revision_;
+		RETURN(true);
+	    }
+	    string message("Couldn't open ");
+	    message += name;
+	    message += "DB to read: ";
+	    message += strerror(errno);
+	    throw Xapian::DatabaseOpeningError(message);
+	}
+	try {
+	    shared_handle = new SharedFD(handle);
+	} catch (...) {
+	    close_handle();
+	    throw;
 	}
-	string message("Couldn't open ");
-	message += name;
-	message += "DB to read: ";
-	message += strerror(errno);
-	throw Xapian::DatabaseOpeningError(message);
     }
 
     if (!basic_open(revision_supplied, revision_)) {
-	::close(handle);
-	handle = -1;
+	close_handle();
 	if (revision_supplied) {
 	    // The requested revision was not available.
 	    // This could be because the database was modified underneath us, or
@@ -1895,6 +2023,47 @@ BrassTable::open(int flags_, brass_revision_number_t revision)
     RETURN(true);
 }
 
+bool
+BrassTable::open_shared(int flags_, const BrassTable & other,
+			brass_revision_number_t revision)
+{
+    LOGCALL(DB, bool, "BrassTable::open_shared", flags_ | Literal("other") | revision);
+    Assert(!writable);
+    close();
+
+    flags = flags_;
+
+#ifdef HAVE_PREAD
+    // Blocks are read with pread(), so several tables can use the same file
+    // descriptor, even from different threads.
+    if (other.shared_handle) {
+	shared_handle = other.shared_handle;
+	shared_handle->ref();
+    }
+#else
+    (void)other;
+#endif
+
+    if (!do_open_to_read(true, revision)) {
+	close();
+	RETURN(false);
+    }
+    AssertEq(revision_number, revision);
+    RETURN(true);
+}
+
+void
+BrassTable::close_handle()
+{
+    if (shared_handle) {
+	shared_handle->unref();
+	shared_handle = NULL;
+    } else {
+	(void)::close(handle);
+    }
+    handle = -1;
+}
+
 bool
 BrassTable::prev_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 {
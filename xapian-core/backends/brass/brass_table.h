@@ -30,8 +30,13 @@
 #include "brass_btreebase.h"
 #include "brass_cursor.h"
 
+#include "backends/iostatistics.h"
+#include "backends/memoryusage.h"
+#include "backends/prefetch.h"
+
 #include "noreturn.h"
 #include "omassert.h"
+#include "sharedfd.h"
 #include "str.h"
 #include "stringutils.h"
 #include "unaligned.h"
@@ -373,6 +378,23 @@ class BrassTable {
 	 */
 	bool open(int flags_, brass_revision_number_t revision_);
 
+	/** Open the btree at a given revision, sharing the file of @a other.
+	 *
+	 *  Like open(flags_, revision_), but where the platform can read blocks
+	 *  without seeking, the file descriptor of @a other is shared rather
+	 *  than opening the file again, so clones of a database used by
+	 *  different threads don't each need a file descriptor per table.
+	 *  The table must be read-only.
+	 *
+	 *  @param other	  - table to share the file descriptor of.
+	 *  @param revision_      - revision number to open.
+	 *
+	 *  @return true if table is successfully opened at desired revision;
+	 *          false if table cannot be opened at desired revision.
+	 */
+	bool open_shared(int flags_, const BrassTable & other,
+			 brass_revision_number_t revision_);
+
 	/** Return true if this table is open.
 	 *
 	 *  NB If the table is lazy and doesn't yet exist, returns false.
@@ -585,6 +607,46 @@ class BrassTable {
 	 */
 	bool is_modified() const { return Btree_modified; }
 
+	/// Return the name of the table (e.g. "postlist").
+	const char * get_tablename() const { return tablename; }
+
+	/// Return counters of the I/O done by this table.
+	const TableIOStatistics & get_io_statistics() const {
+	    return io_stats;
+	}
+
+	/// Reset the counters returned by get_io_statistics().
+	void reset_io_statistics() const { io_stats.reset(); }
+
+	/** Return an estimate of the bytes of block buffers held.
+	 *
+	 *  This includes the buffers held by cursors open on this table.
+	 */
+	size_t get_memory_usage() const;
+
+	/** Read the internal levels of the B-tree into the page cache.
+	 *
+	 *  Each level is read with large sequential reads.
+	 *
+	 *  @param budget	The budget to spend the bytes read from.
+	 *  @param leaves	If not NULL, the leaf blocks found from the level
+	 *			above them are stored here.
+	 */
+	void prefetch_index(PrefetchBudget & budget,
+			    PrefetchLeaves * leaves) const;
+
+	/** Read blocks of this table into the page cache.
+	 *
+	 *  Block numbers which aren't in use by this revision of the table are
+	 *  ignored.
+	 *
+	 *  @param blocks	The numbers of the blocks to read.  This is
+	 *			sorted by this method.
+	 *  @param budget	The budget to spend the bytes read from.
+	 */
+	void prefetch_blocks(std::vector<uint4> & blocks,
+			     PrefetchBudget & budget) const;
+
 	/** Set the maximum item size given the block capacity.
 	 *
 	 *  At least this many items of maximum size must fit into a block.
@@ -625,6 +687,9 @@ class BrassTable {
 			      bool create_db = false);
 	bool basic_open(bool revision_supplied, brass_revision_number_t revision);
 
+	/// Close handle, or release our reference to it, and set it to -1.
+	void close_handle();
+
 	bool find(Brass::Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
@@ -697,6 +762,13 @@ class BrassTable {
 	 */
 	int handle;
 
+	/** The object which owns handle if it can be shared, else NULL.
+	 *
+	 *  Tables opened to read hold their file descriptor through this so
+	 *  that open_shared() can share it.
+	 */
+	SharedFD * shared_handle;
+
 	/// number of levels, counting from 0
 	int level;
 
@@ -751,6 +823,12 @@ class BrassTable {
 	 */
 	BrassChanges * changes_obj;
 
+	/// Counters of the I/O done by this table.
+	mutable TableIOStatistics io_stats;
+
+	/// The number of BrassCursor objects open on this table.
+	Xapian::Internal::intrusive_ptr<CursorCount> cursor_count;
+
 	/* B-tree navigation functions */
 	bool prev(Brass::Cursor *C_, int j) const {
 	    if (sequential) return prev_for_sequential(C_, j);
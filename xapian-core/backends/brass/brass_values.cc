@@ -139,6 +139,8 @@ BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = val;
+    changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+		      string_memory_usage(val.size());
 }
 
 void
@@ -150,6 +152,8 @@ BrassValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = string();
+    changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+		      string_memory_usage(0);
 }
 
 Xapian::docid
@@ -187,6 +191,7 @@ BrassValueManager::get_chunk_containing_did(Xapian::valueno slot,
 
     cursor->read_tag();
     swap(chunk, cursor->current_tag);
+    ++chunk_reads;
 
     return did;
 }
@@ -354,6 +359,7 @@ BrassValueManager::merge_changes()
 	}
 	changes.clear();
     }
+    changes_memory = 0;
 }
 
 void
@@ -403,6 +409,8 @@ BrassValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
     if (slots_used.empty() && slots.find(did) == slots.end()) {
 	// Adding a new document with no values which we didn't just remove.
     } else {
+	changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+			  string_memory_usage(slots_used.size());
 	swap(slots[did], slots_used);
     }
 }
@@ -22,7 +22,9 @@
 #ifndef XAPIAN_INCLUDED_BRASS_VALUES_H
 #define XAPIAN_INCLUDED_BRASS_VALUES_H
 
+#include "internaltypes.h"
 #include "pack.h"
+#include "backends/memoryusage.h"
 #include "backends/valuestats.h"
 
 #include "xapian/error.h"
@@ -93,8 +95,14 @@ class BrassValueManager {
 
     std::map<Xapian::valueno, std::map<Xapian::docid, std::string> > changes;
 
+    /// Estimate of the bytes held by slots and changes.
+    size_t changes_memory;
+
     mutable AutoPtr<BrassCursor> cursor;
 
+    /// The number of value chunks read by get_chunk_containing_did().
+    mutable uint8 chunk_reads;
+
     void add_value(Xapian::docid did, Xapian::valueno slot,
 		   const std::string & val);
 
@@ -115,7 +123,9 @@ class BrassValueManager {
 		      BrassTermListTable * termlist_table_)
 	: mru_slot(Xapian::BAD_VALUENO),
 	  postlist_table(postlist_table_),
-	  termlist_table(termlist_table_) { }
+	  termlist_table(termlist_table_),
+	  changes_memory(0),
+	  chunk_reads(0) { }
 
     // Merge in batched-up changes.
     void merge_changes();
@@ -171,7 +181,24 @@ class BrassValueManager {
 	// Discard batched-up changes.
 	slots.clear();
 	changes.clear();
+	changes_memory = 0;
     }
+
+    /// Return an estimate of the bytes held by batched-up changes.
+    size_t get_changes_memory_usage() const { return changes_memory; }
+
+    /// Return an estimate of the bytes held by the cached value statistics.
+    size_t get_value_stats_memory_usage() const {
+	if (mru_slot == Xapian::BAD_VALUENO) return 0;
+	return sizeof(ValueStats) + mru_valstats.lower_bound.size() +
+	       mru_valstats.upper_bound.size();
+    }
+
+    /// Return the number of value chunks read by this object.
+    uint8 get_chunk_reads() const { return chunk_reads; }
+
+    /// Reset the count returned by get_chunk_reads().
+    void reset_chunk_reads() { chunk_reads = 0; }
 };
 
 namespace Brass {
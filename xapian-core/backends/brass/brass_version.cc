@@ -31,6 +31,7 @@
 #include "posixy_wrapper.h"
 #include "stringutils.h" // For STRINGIZE() and CONST_STRLEN().
 #include "str.h"
+#include "tracepoint.h"
 
 #include <cstring> // For memcmp() and memcpy().
 #include <string>
@@ -86,8 +87,11 @@ BrassVersion::create(int flags)
 	throw;
     }
 
-    if ((flags & Xapian::DB_NO_SYNC) == 0)
+    if ((flags & Xapian::DB_NO_SYNC) == 0) {
+	XAPIAN_TRACE(fsync_start, fd, 0);
 	io_sync(fd);
+	XAPIAN_TRACE(fsync_end, fd, 0);
+    }
     if (close(fd) != 0) {
 	string msg("Failed to create brass version file: ");
 	msg += filename;
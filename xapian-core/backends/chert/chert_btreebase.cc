@@ -33,6 +33,7 @@
 #include "pack.h"
 #include "posixy_wrapper.h"
 #include "str.h"
+#include "tracepoint.h"
 
 #include <algorithm>
 #include <climits>
@@ -315,12 +316,16 @@ ChertTable_base::write_to_file(const string &filename,
 	if (changes_tail != NULL) {
 	    io_write(changes_fd, changes_tail->data(), changes_tail->size());
 	    // changes_tail is only specified for the final table, so sync.
+	    XAPIAN_TRACE(fsync_start, changes_fd, 0);
 	    io_sync(changes_fd);
+	    XAPIAN_TRACE(fsync_end, changes_fd, 0);
 	}
     }
 
     io_write(h, buf.data(), buf.size());
+    XAPIAN_TRACE(fsync_start, h, 0);
     io_sync(h);
+    XAPIAN_TRACE(fsync_end, h, 0);
 }
 
 /*
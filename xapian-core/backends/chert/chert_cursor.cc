@@ -56,8 +56,10 @@ ChertCursor::ChertCursor(const ChertTable *B_)
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  cursor_count(B_->cursor_count)
 {
+    ++cursor_count->count;
     B->cursor_created_since_last_modification = true;
     C = new Cursor[level + 1];
 
@@ -101,6 +103,7 @@ ChertCursor::rebuild()
 
 ChertCursor::~ChertCursor()
 {
+    --cursor_count->count;
     // Use the value of level stored in the cursor rather than the
     // Btree, since the Btree might have been deleted already.
     for (int j = 0; j < level; j++) {
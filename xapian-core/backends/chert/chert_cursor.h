@@ -27,6 +27,8 @@
 
 #include "chert_types.h"
 
+#include "backends/memoryusage.h"
+
 #include <string>
 using std::string;
 
@@ -108,6 +110,9 @@ class XAPIAN_VISIBILITY_DEFAULT ChertCursor {
 	/** The value of level in the Btree structure. */
 	int level;
 
+	/// The count of cursors on the table, which includes this one.
+	Xapian::Internal::intrusive_ptr<CursorCount> cursor_count;
+
 	/** Get the key.
 	 *
 	 *  The key of the item at the cursor is copied into key.
@@ -40,6 +40,9 @@
 #include "chert_replicate_internal.h"
 #include "chert_document.h"
 #include "../flint_lock.h"
+#ifdef XAPIAN_HAS_INMEMORY_BACKEND
+# include "../inmemory/inmemory_overlay.h"
+#endif
 #include "chert_metadata.h"
 #include "chert_modifiedpostlist.h"
 #include "chert_positionlist.h"
@@ -59,8 +62,10 @@
 #include "api/replication.h"
 #include "replicationprotocol.h"
 #include "net/length.h"
+#include "realtime.h"
 #include "str.h"
 #include "stringutils.h"
+#include "tracepoint.h"
 #include "backends/valuestats.h"
 
 #include "safeerrno.h"
@@ -70,6 +75,7 @@
 #include <algorithm>
 #include "autoptr.h"
 #include <cstdlib>
+#include <functional>
 #include <string>
 
 using namespace std;
@@ -173,6 +179,36 @@ ChertDatabase::ChertDatabase(const string &chert_dir, int flags,
     }
 }
 
+ChertDatabase::ChertDatabase(const ChertDatabase & other,
+			     chert_revision_number_t revision)
+	: db_dir(other.db_dir),
+	  readonly(true),
+	  version_file(db_dir),
+	  postlist_table(db_dir, readonly),
+	  position_table(db_dir, readonly),
+	  termlist_table(db_dir, readonly),
+	  value_manager(&postlist_table, &termlist_table),
+	  synonym_table(db_dir, readonly),
+	  spelling_table(db_dir, readonly),
+	  record_table(db_dir, readonly),
+	  lock(db_dir),
+	  max_changesets(0)
+{
+    LOGCALL_CTOR(DB, "ChertDatabase", Literal("other") | revision);
+
+    version_file.read_and_check();
+    bool ok = record_table.open_shared(other.record_table, revision);
+    ok = spelling_table.open_shared(other.spelling_table, revision) && ok;
+    ok = synonym_table.open_shared(other.synonym_table, revision) && ok;
+    ok = termlist_table.open_shared(other.termlist_table, revision) && ok;
+    ok = position_table.open_shared(other.position_table, revision) && ok;
+    ok = postlist_table.open_shared(other.postlist_table, revision) && ok;
+    if (!ok) {
+	throw Xapian::DatabaseModifiedError("The revision being read has been discarded - you should call Xapian::Database::reopen() and retry the operation");
+    }
+    stats.read(postlist_table);
+}
+
 ChertDatabase::~ChertDatabase()
 {
     LOGCALL_DTOR(DB, "ChertDatabase");
@@ -312,6 +348,15 @@ ChertDatabase::open_tables(chert_revision_number_t revision)
     postlist_table.open(revision);
 }
 
+Xapian::Database::Internal *
+ChertDatabase::clone_for_thread() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "ChertDatabase::clone_for_thread", NO_ARGS);
+    if (!postlist_table.is_open())
+	ChertTable::throw_database_closed();
+    RETURN(new ChertDatabase(*this, get_revision_number()));
+}
+
 chert_revision_number_t
 ChertDatabase::get_revision_number() const
 {
@@ -851,6 +896,7 @@ LeafPostList *
 ChertDatabase::open_post_list(const string& term) const
 {
     LOGCALL(DB, LeafPostList *, "ChertDatabase::open_post_list", term);
+    XAPIAN_TRACE(postlist_open, trace_pack(term), trace_pack(term, 8));
     intrusive_ptr<const ChertDatabase> ptrtothis(this);
 
     if (term.empty()) {
@@ -993,6 +1039,141 @@ ChertDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+void
+ChertDatabase::get_io_statistics(IOStatistics & result) const
+{
+    LOGCALL_VOID(DB, "ChertDatabase::get_io_statistics", NO_ARGS);
+    result.add(io_stats);
+    result.value_chunk_reads += value_manager.get_chunk_reads();
+    const ChertTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	const ChertTable * table = tables[i];
+	result.add_table(table->get_tablename(), table->get_io_statistics());
+    }
+}
+
+void
+ChertDatabase::reset_io_statistics()
+{
+    LOGCALL_VOID(DB, "ChertDatabase::reset_io_statistics", NO_ARGS);
+    io_stats.reset();
+    value_manager.reset_chunk_reads();
+    postlist_table.reset_io_statistics();
+    position_table.reset_io_statistics();
+    termlist_table.reset_io_statistics();
+    synonym_table.reset_io_statistics();
+    spelling_table.reset_io_statistics();
+    record_table.reset_io_statistics();
+}
+
+void
+ChertDatabase::get_memory_usage(MemoryUsage & result) const
+{
+    LOGCALL_VOID(DB, "ChertDatabase::get_memory_usage", NO_ARGS);
+    const ChertTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	const ChertTable * table = tables[i];
+	result.add_table(table->get_tablename(), table->get_memory_usage());
+    }
+    result.value_stats += value_manager.get_value_stats_memory_usage();
+}
+
+void
+ChertDatabase::prefetch(PrefetchBudget & budget, Xapian::termcount max_terms,
+			const vector<Xapian::valueno> & slots) const
+{
+    LOGCALL_VOID(DB, "ChertDatabase::prefetch",
+		 budget.get_remaining() | max_terms | slots.size());
+    // Every search needs the internal levels of the tables it uses, so read
+    // those first.
+    PrefetchLeaves leaves;
+    postlist_table.prefetch_index(budget, &leaves);
+    const ChertTable * tables[] = {
+	&position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	tables[i]->prefetch_index(budget, NULL);
+    }
+
+    // Then the document lengths, which most weighting schemes need.
+    vector<uint4> blocks;
+    prefetch_leaves_with_prefix(leaves, string("\0\xe0", 2), blocks);
+    postlist_table.prefetch_blocks(blocks, budget);
+
+    // Then the value streams.  If no slots were specified, read those for
+    // every slot which has values, starting with the most frequently set.
+    vector<Xapian::valueno> value_slots(slots);
+    if (value_slots.empty()) {
+	vector<pair<Xapian::doccount, Xapian::valueno> > freqs;
+	AutoPtr<ChertCursor> cursor(postlist_table.cursor_get());
+	if (cursor.get()) {
+	    // The keys of the value statistics, as made by
+	    // make_valuestats_key().
+	    const string prefix("\0\xd0", 2);
+	    cursor->find_entry(prefix);
+	    while (cursor->next() && startswith(cursor->current_key, prefix)) {
+		const string & key = cursor->current_key;
+		const char * p = key.data() + prefix.size();
+		Xapian::valueno slot;
+		if (!unpack_uint_last(&p, key.data() + key.size(), &slot))
+		    throw Xapian::DatabaseCorruptError("Bad value statistics key");
+		cursor->read_tag();
+		const string & tag = cursor->current_tag;
+		const char * pos = tag.data();
+		Xapian::doccount freq;
+		if (!unpack_uint(&pos, pos + tag.size(), &freq))
+		    throw Xapian::DatabaseCorruptError("Bad value statistics item");
+		freqs.push_back(make_pair(freq, slot));
+	    }
+	}
+	sort(freqs.begin(), freqs.end(),
+	     greater<pair<Xapian::doccount, Xapian::valueno> >());
+	for (size_t i = 0; i != freqs.size(); ++i) {
+	    value_slots.push_back(freqs[i].second);
+	}
+    }
+    for (size_t i = 0; i != value_slots.size(); ++i) {
+	// The start of the keys of the slot's value chunks, as made by
+	// make_valuechunk_key().
+	string prefix("\0\xd8", 2);
+	pack_uint(prefix, value_slots[i]);
+	blocks.clear();
+	prefetch_leaves_with_prefix(leaves, prefix, blocks);
+	postlist_table.prefetch_blocks(blocks, budget);
+    }
+
+    // And finally the longest postlists.
+    blocks.clear();
+    prefetch_longest_postlists(leaves, max_terms, blocks);
+    postlist_table.prefetch_blocks(blocks, budget);
+}
+
+void
+ChertDatabase::prefetch_blocks(const map<string, vector<uint4> > & blocks,
+			      PrefetchBudget & budget) const
+{
+    LOGCALL_VOID(DB, "ChertDatabase::prefetch_blocks",
+		 blocks.size() | budget.get_remaining());
+    const ChertTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	map<string, vector<uint4> >::const_iterator j;
+	j = blocks.find(tables[i]->get_tablename());
+	if (j == blocks.end()) continue;
+	vector<uint4> table_blocks(j->second);
+	tables[i]->prefetch_blocks(table_blocks, budget);
+    }
+}
+
 void
 ChertDatabase::throw_termlist_table_close_exception() const
 {
@@ -1013,6 +1194,8 @@ ChertWritableDatabase::ChertWritableDatabase(const string &dir, int action,
 	  mod_plists(),
 	  change_count(0),
 	  flush_threshold(0),
+	  change_bytes(0),
+	  memory_limit(0),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1043,6 +1226,8 @@ ChertWritableDatabase::commit()
 void
 ChertWritableDatabase::flush_postlist_changes() const
 {
+    double start = RealTime::now();
+    XAPIAN_TRACE(postlist_flush_start, change_count, 0);
     postlist_table.merge_changes(mod_plists, doclens, freq_deltas);
     stats.write(postlist_table);
 
@@ -1050,6 +1235,9 @@ ChertWritableDatabase::flush_postlist_changes() const
     doclens.clear();
     mod_plists.clear();
     change_count = 0;
+    change_bytes = 0;
+    io_stats.flushed(RealTime::now() - start);
+    XAPIAN_TRACE(postlist_flush_end, 0, 0);
 }
 
 void
@@ -1066,8 +1254,11 @@ ChertWritableDatabase::close()
 void
 ChertWritableDatabase::apply()
 {
+    double start = RealTime::now();
     value_manager.set_value_stats(value_stats);
     ChertDatabase::apply();
+    changed_docids.clear();
+    io_stats.committed(RealTime::now() - start);
 }
 
 void
@@ -1079,6 +1270,8 @@ ChertWritableDatabase::add_freq_delta(const string & tname,
     i = freq_deltas.find(tname);
     if (i == freq_deltas.end()) {
 	freq_deltas.insert(make_pair(tname, make_pair(tf_delta, cf_delta)));
+	change_bytes += MAP_ENTRY_OVERHEAD + string_memory_usage(tname.size()) +
+			2 * sizeof(termcount_diff);
     } else {
 	i->second.first += tf_delta;
 	i->second.second += cf_delta;
@@ -1096,8 +1289,12 @@ ChertWritableDatabase::insert_mod_plist(Xapian::docid did,
     if (j == mod_plists.end()) {
 	map<docid, pair<char, termcount> > m;
 	j = mod_plists.insert(make_pair(tname, m)).first;
+	change_bytes += MAP_ENTRY_OVERHEAD + string_memory_usage(tname.size()) +
+			sizeof(m);
     }
     j->second[did] = make_pair('A', wdf);
+    change_bytes += MAP_ENTRY_OVERHEAD + sizeof(docid) +
+		    sizeof(pair<char, termcount>);
 }
 
 void
@@ -1112,12 +1309,16 @@ ChertWritableDatabase::update_mod_plist(Xapian::docid did,
     if (j == mod_plists.end()) {
 	map<docid, pair<char, termcount> > m;
 	j = mod_plists.insert(make_pair(tname, m)).first;
+	change_bytes += MAP_ENTRY_OVERHEAD + string_memory_usage(tname.size()) +
+			sizeof(m);
     }
 
     map<docid, pair<char, termcount> >::iterator k;
     k = j->second.find(did);
     if (k == j->second.end()) {
 	j->second.insert(make_pair(did, make_pair(type, wdf)));
+	change_bytes += MAP_ENTRY_OVERHEAD + sizeof(docid) +
+			sizeof(pair<char, termcount>);
     } else {
 	if (type == 'A') {
 	    // Adding an entry which has already been deleted.
@@ -1145,6 +1346,7 @@ ChertWritableDatabase::add_document_(Xapian::docid did,
 {
     LOGCALL(DB, Xapian::docid, "ChertWritableDatabase::add_document_", did | document);
     Assert(did != 0);
+    changed_docids.insert(did);
     try {
 	// Add the record using that document ID.
 	record_table.replace_record(document.get_data(), did);
@@ -1194,17 +1396,10 @@ ChertWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.
-    // We could also look at:
-    // * mod_plists.size()
-    // * doclens.size()
-    // * freq_deltas.size()
-    //
-    // cout << "+++ mod_plists.size() " << mod_plists.size() <<
-    //     ", doclens.size() " << doclens.size() <<
-    //	   ", freq_deltas.size() " << freq_deltas.size() << endl;
-    if (++change_count >= flush_threshold) {
+    // The memory used is an estimate from our bookkeeping, so is only
+    // checked if the user has set a memory limit.
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1217,6 +1412,7 @@ ChertWritableDatabase::delete_document(Xapian::docid did)
 {
     LOGCALL_VOID(DB, "ChertWritableDatabase::delete_document", did);
     Assert(did != 0);
+    changed_docids.insert(did);
 
     if (!termlist_table.is_open())
 	throw_termlist_table_close_exception();
@@ -1270,7 +1466,8 @@ ChertWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1282,6 +1479,7 @@ ChertWritableDatabase::replace_document(Xapian::docid did,
 {
     LOGCALL_VOID(DB, "ChertWritableDatabase::replace_document", did | document);
     Assert(did != 0);
+    changed_docids.insert(did);
 
     try {
 	if (did > stats.get_last_docid()) {
@@ -1445,7 +1643,8 @@ ChertWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    if (flush_needed()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1538,6 +1737,7 @@ LeafPostList *
 ChertWritableDatabase::open_post_list(const string& tname) const
 {
     LOGCALL(DB, LeafPostList *, "ChertWritableDatabase::open_post_list", tname);
+    XAPIAN_TRACE(postlist_open, trace_pack(tname), trace_pack(tname, 8));
     intrusive_ptr<const ChertWritableDatabase> ptrtothis(this);
 
     if (tname.empty()) {
@@ -1593,7 +1793,16 @@ ChertWritableDatabase::cancel()
     doclens.clear();
     mod_plists.clear();
     value_stats.clear();
+    changed_docids.clear();
     change_count = 0;
+    change_bytes = 0;
+}
+
+void
+ChertWritableDatabase::set_memory_limit(size_t limit)
+{
+    LOGCALL_VOID(DB, "ChertWritableDatabase::set_memory_limit", limit);
+    memory_limit = limit;
 }
 
 void
@@ -1665,3 +1874,26 @@ ChertWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+void
+ChertWritableDatabase::get_memory_usage(MemoryUsage & result) const
+{
+    LOGCALL_VOID(DB, "ChertWritableDatabase::get_memory_usage", NO_ARGS);
+    ChertDatabase::get_memory_usage(result);
+    result.pending_changes += get_pending_changes_memory();
+}
+
+Xapian::Database::Internal *
+ChertWritableDatabase::open_snapshot() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "ChertWritableDatabase::open_snapshot", NO_ARGS);
+#ifdef XAPIAN_HAS_INMEMORY_BACKEND
+    // A new reader sees the last committed revision, and we overlay the
+    // documents which have changed since then.
+    intrusive_ptr<Xapian::Database::Internal> base(new ChertDatabase(db_dir));
+    Xapian::Database source(const_cast<ChertWritableDatabase *>(this));
+    RETURN(InMemoryOverlayDatabase::open(base.get(), source, changed_docids));
+#else
+    throw Xapian::FeatureUnavailableError("Snapshots of chert databases require the inmemory backend");
+#endif
+}
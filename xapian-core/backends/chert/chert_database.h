@@ -37,6 +37,8 @@
 #include "chert_version.h"
 #include "../flint_lock.h"
 #include "chert_types.h"
+#include "backends/iostatistics.h"
+#include "backends/memoryusage.h"
 #include "backends/valuestats.h"
 
 #include "noreturn.h"
@@ -44,6 +46,7 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <set>
 
 class ChertTermList;
 class ChertAllDocsPostList;
@@ -58,6 +61,7 @@ class ChertDatabase : public Xapian::Database::Internal {
     friend class ChertPostList;
     friend class ChertAllTermsList;
     friend class ChertAllDocsPostList;
+    friend class ChertValueList;
     private:
 	/** Directory to store databases in.
 	 */
@@ -120,6 +124,12 @@ class ChertDatabase : public Xapian::Database::Internal {
 	/// Database statistics.
 	ChertDatabaseStats stats;
 
+	/** Counters of I/O which isn't specific to a table.
+	 *
+	 *  The tables keep their own counters.
+	 */
+	mutable IOStatistics io_stats;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -239,6 +249,20 @@ class ChertDatabase : public Xapian::Database::Internal {
 	ChertDatabase(const string &db_dir_, int action = Xapian::DB_READONLY_,
 		      unsigned int block_size = 0u);
 
+	/** Open a read-only chert database at a particular revision.
+	 *
+	 *  The tables share the file descriptors of @a other's tables where
+	 *  possible (see ChertTable::open_shared()).
+	 *
+	 *  @exception Xapian::DatabaseModifiedError is thrown if @a revision
+	 *             is no longer available.
+	 *
+	 *  @param other	the database to share file descriptors with
+	 *  @param revision	the revision to open
+	 */
+	ChertDatabase(const ChertDatabase & other,
+		      chert_revision_number_t revision);
+
 	~ChertDatabase();
 
 	/// Get a postlist table cursor (used by ChertValueList).
@@ -295,6 +319,14 @@ class ChertDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	Xapian::Database::Internal * clone_for_thread() const;
+	void get_io_statistics(IOStatistics & stats) const;
+	void reset_io_statistics();
+	void get_memory_usage(MemoryUsage & usage) const;
+	void prefetch(PrefetchBudget & budget, Xapian::termcount max_terms,
+		      const vector<Xapian::valueno> & slots) const;
+	void prefetch_blocks(const map<string, vector<uint4> > & blocks,
+			     PrefetchBudget & budget) const;
 	//@}
 
 	XAPIAN_NORETURN(void throw_termlist_table_close_exception() const);
@@ -316,6 +348,13 @@ class ChertWritableDatabase : public ChertDatabase {
 
 	mutable map<Xapian::valueno, ValueStats> value_stats;
 
+	/** The docids of documents added, deleted, or replaced since the last
+	 *  commit.
+	 *
+	 *  Used by open_snapshot().
+	 */
+	std::set<Xapian::docid> changed_docids;
+
 	/** The number of documents added, deleted, or replaced since the last
 	 *  flush.
 	 */
@@ -324,6 +363,43 @@ class ChertWritableDatabase : public ChertDatabase {
 	/// If change_count reaches this threshold we automatically flush.
 	Xapian::doccount flush_threshold;
 
+	/** Estimate of the bytes held by freq_deltas and mod_plists.
+	 *
+	 *  This is updated as changes are buffered, as it needs to be cheap to
+	 *  check after each document.
+	 */
+	mutable size_t change_bytes;
+
+	/** If the buffered changes are estimated to use this many bytes we
+	 *  automatically flush (0 means no limit).
+	 */
+	size_t memory_limit;
+
+	/// Return an estimate of the bytes held by buffered postlist changes.
+	size_t get_postlist_changes_memory() const {
+	    return change_bytes +
+		   doclens.size() * (MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+				     sizeof(Xapian::termcount));
+	}
+
+	/// Return an estimate of the bytes held by buffered changes.
+	size_t get_pending_changes_memory() const {
+	    return get_postlist_changes_memory() +
+		   value_manager.get_changes_memory_usage() +
+		   value_stats.size() * (MAP_ENTRY_OVERHEAD + sizeof(ValueStats));
+	}
+
+	/// Return true if the buffered changes should be flushed.
+	bool flush_needed() const {
+	    if (change_count >= flush_threshold) return true;
+	    if (!memory_limit) return false;
+	    // During a transaction, flushing only writes out the postlist
+	    // changes, so don't count the other changes.
+	    size_t bytes = transaction_active() ?
+		get_postlist_changes_memory() : get_pending_changes_memory();
+	    return bytes >= memory_limit;
+	}
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -390,6 +466,8 @@ class ChertWritableDatabase : public ChertDatabase {
 	/** Cancel pending modifications to the database. */
 	void cancel();
 
+	void set_memory_limit(size_t limit);
+
 	Xapian::docid add_document(const Xapian::Document & document);
 	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
 	// Stop the default implementation of delete_document(term) and
@@ -451,6 +529,9 @@ class ChertWritableDatabase : public ChertDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+	void get_memory_usage(MemoryUsage & usage) const;
+
+	Xapian::Database::Internal * open_snapshot() const;
 	//@}
 };
 
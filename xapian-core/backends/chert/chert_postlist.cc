@@ -671,6 +671,7 @@ ChertPostList::ChertPostList(intrusive_ptr<const ChertDatabase> this_db_,
 			     bool keep_reference)
 	: LeafPostList(term_),
 	  this_db(keep_reference ? this_db_ : NULL),
+	  io_stats(&this_db_->io_stats),
 	  have_started(false),
 	  is_at_end(false),
 	  cursor(this_db_->postlist_table.cursor_get())
@@ -688,6 +689,8 @@ ChertPostList::ChertPostList(intrusive_ptr<const ChertDatabase> this_db_,
 	last_did_in_chunk = 0;
 	return;
     }
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
@@ -767,6 +770,8 @@ ChertPostList::next_chunk()
     }
     did = newdid;
 
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
@@ -844,6 +849,8 @@ ChertPostList::move_to_chunk_containing(Xapian::docid desired_did)
     }
     is_at_end = false;
 
+    ++chunk_reads;
+    ++io_stats->postlist_chunk_reads;
     cursor->read_tag();
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
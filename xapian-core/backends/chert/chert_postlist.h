@@ -40,6 +40,7 @@ using namespace std;
 
 class ChertCursor;
 class ChertDatabase;
+struct IOStatistics;
 
 namespace Chert {
     class PostlistChunkReader;
@@ -131,6 +132,12 @@ class ChertPostList : public LeafPostList {
 	 */
 	Xapian::Internal::intrusive_ptr<const ChertDatabase> this_db;
 
+	/** The database's I/O counters.
+	 *
+	 *  This is set even when we don't keep a reference to the database.
+	 */
+	IOStatistics * io_stats;
+
 	/// The position list object for this posting list.
 	ChertPositionList positionlist;
 
@@ -36,6 +36,7 @@ ChertValueList::update_reader()
     if (!first_did) return false;
 
     cursor->read_tag();
+    ++db->io_stats.value_chunk_reads;
     const string & tag = cursor->current_tag;
     reader.assign(tag.data(), tag.size(), first_did);
     return true;
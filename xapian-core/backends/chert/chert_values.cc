@@ -138,6 +138,8 @@ ChertValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = val;
+    changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+		      string_memory_usage(val.size());
 }
 
 void
@@ -149,6 +151,8 @@ ChertValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = string();
+    changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+		      string_memory_usage(0);
 }
 
 Xapian::docid
@@ -186,6 +190,7 @@ ChertValueManager::get_chunk_containing_did(Xapian::valueno slot,
 
     cursor->read_tag();
     swap(chunk, cursor->current_tag);
+    ++chunk_reads;
 
     return did;
 }
@@ -349,6 +354,7 @@ ChertValueManager::merge_changes()
 	}
 	changes.clear();
     }
+    changes_memory = 0;
 }
 
 void
@@ -398,6 +404,8 @@ ChertValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
     if (slots_used.empty() && slots.find(did) == slots.end()) {
 	// Adding a new document with no values which we didn't just remove.
     } else {
+	changes_memory += MAP_ENTRY_OVERHEAD + sizeof(Xapian::docid) +
+			  string_memory_usage(slots_used.size());
 	swap(slots[did], slots_used);
     }
 }
@@ -30,6 +30,7 @@
 #include "omassert.h"
 #include "stringutils.h" // For STRINGIZE() and CONST_STRLEN().
 #include "str.h"
+#include "tracepoint.h"
 
 #include <cstring> // For memcmp() and memcpy().
 #include <string>
@@ -83,7 +84,9 @@ ChertVersion::create()
 	throw;
     }
 
+    XAPIAN_TRACE(fsync_start, fd, 0);
     io_sync(fd);
+    XAPIAN_TRACE(fsync_end, fd, 0);
     if (close(fd) != 0) {
 	string msg("Failed to create chert version file: ");
 	msg += filename;
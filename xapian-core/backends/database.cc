@@ -125,6 +125,11 @@ Database::Internal::cancel()
     Assert(false);
 }
 
+void
+Database::Internal::set_memory_limit(size_t)
+{
+}
+
 void
 Database::Internal::begin_transaction(bool flushed)
 {
@@ -330,6 +335,39 @@ Database::Internal::reopen()
     return false;
 }
 
+Database::Internal *
+Database::Internal::clone_for_thread() const
+{
+    throw Xapian::UnimplementedError("This backend doesn't support clone_for_thread()");
+}
+
+void
+Database::Internal::get_io_statistics(IOStatistics &) const
+{
+}
+
+void
+Database::Internal::reset_io_statistics()
+{
+}
+
+void
+Database::Internal::get_memory_usage(MemoryUsage &) const
+{
+}
+
+void
+Database::Internal::prefetch(PrefetchBudget &, Xapian::termcount,
+			     const vector<Xapian::valueno> &) const
+{
+}
+
+void
+Database::Internal::prefetch_blocks(const map<string, vector<uint4> > &,
+				    PrefetchBudget &) const
+{
+}
+
 void
 Database::Internal::request_document(Xapian::docid /*did*/) const
 {
@@ -350,6 +388,12 @@ Database::Internal::write_changesets_to_fd(int, const string &, bool, Replicatio
     throw Xapian::UnimplementedError("This backend doesn't provide changesets");
 }
 
+Database::Internal *
+Database::Internal::open_snapshot() const
+{
+    throw Xapian::UnimplementedError("This backend doesn't support snapshots");
+}
+
 string
 Database::Internal::get_revision_info() const
 {
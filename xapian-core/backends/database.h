@@ -25,7 +25,9 @@
 #ifndef OM_HGUARD_DATABASE_H
 #define OM_HGUARD_DATABASE_H
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include "internaltypes.h"
 
@@ -39,7 +41,10 @@
 
 using namespace std;
 
+struct IOStatistics;
+struct MemoryUsage;
 class LeafPostList;
+class PrefetchBudget;
 class RemoteDatabase;
 
 typedef Xapian::TermIterator::Internal TermList;
@@ -390,6 +395,49 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual void close() = 0;
 
+	/** Open a new handle on the same revision of this database.
+	 *
+	 *  See Database::clone_for_thread() for more information.
+	 */
+	virtual Internal * clone_for_thread() const;
+
+	/** Add counters of the I/O done by this database to @a stats.
+	 *
+	 *  See Database::get_io_statistics() for more information.  The
+	 *  default implementation adds nothing.
+	 */
+	virtual void get_io_statistics(IOStatistics & stats) const;
+
+	/// Reset the counters returned by get_io_statistics().
+	virtual void reset_io_statistics();
+
+	/** Add estimates of the memory held by this database to @a usage.
+	 *
+	 *  See Database::get_memory_usage() for more information.  The
+	 *  default implementation adds nothing.
+	 */
+	virtual void get_memory_usage(MemoryUsage & usage) const;
+
+	/** Read parts of this database into the page cache.
+	 *
+	 *  See Database::prefetch() for more information.  The default
+	 *  implementation reads nothing.
+	 */
+	virtual void prefetch(PrefetchBudget & budget,
+			      Xapian::termcount max_terms,
+			      const std::vector<Xapian::valueno> & slots) const;
+
+	/** Read a list of blocks into the page cache.
+	 *
+	 *  See Database::prefetch_blocks() for more information.  The default
+	 *  implementation reads nothing.
+	 *
+	 *  @param blocks	The numbers of the blocks to read, keyed by table
+	 *			name.
+	 */
+	virtual void prefetch_blocks(const std::map<std::string, std::vector<uint4> > & blocks,
+				     PrefetchBudget & budget) const;
+
 	//////////////////////////////////////////////////////////////////
 	// Modifying the database:
 	// =======================
@@ -403,6 +451,20 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	/** Cancel pending modifications to the database. */
 	virtual void cancel();
 
+	/** Set a soft limit on the memory used to buffer changes.
+	 *
+	 *  See WritableDatabase::set_memory_limit() for more information.  The
+	 *  default implementation does nothing, which is appropriate for
+	 *  backends which don't buffer changes.
+	 */
+	virtual void set_memory_limit(size_t limit);
+
+	/** Open a read-only snapshot including any pending modifications.
+	 *
+	 *  See WritableDatabase::get_snapshot() for more information.
+	 */
+	virtual Internal * open_snapshot() const;
+
 	/** Begin a transaction.
 	 *
 	 *  See WritableDatabase::begin_transaction() for more information.
@@ -44,6 +44,7 @@
 # include "chert/chert_database.h"
 #endif
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
+# include "inmemory/inmemory_compact.h"
 # include "inmemory/inmemory_database.h"
 #endif
 // Even if none of the above get included, we still need a definition of
@@ -63,6 +64,12 @@ InMemory::open() {
     LOGCALL_STATIC(API, Database, "InMemory::open", NO_ARGS);
     return WritableDatabase(new InMemoryDatabase);
 }
+
+Database
+InMemory::open_compact(const Database & db) {
+    LOGCALL_STATIC(API, Database, "InMemory::open_compact", db);
+    return Database(InMemoryCompactDatabase::open(db));
+}
 #endif
 
 static void
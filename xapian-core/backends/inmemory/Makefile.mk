@@ -9,13 +9,17 @@ noinst_HEADERS +=\
 if BUILD_BACKEND_INMEMORY
 noinst_HEADERS +=\
 	backends/inmemory/inmemory_alltermslist.h\
+	backends/inmemory/inmemory_compact.h\
 	backends/inmemory/inmemory_database.h\
-	backends/inmemory/inmemory_document.h
+	backends/inmemory/inmemory_document.h\
+	backends/inmemory/inmemory_overlay.h
 
 lib_src +=\
 	backends/inmemory/inmemory_alltermslist.cc\
+	backends/inmemory/inmemory_compact.cc\
 	backends/inmemory/inmemory_database.cc\
 	backends/inmemory/inmemory_document.cc\
+	backends/inmemory/inmemory_overlay.cc\
 	backends/inmemory/inmemory_positionlist.cc
 else
 # Xapian::Document uses MapTermList which uses InMemoryPositionList so we
@@ -24,6 +24,12 @@
 
 #include "stringutils.h"
 
+#include "xapian/error.h"
+
+#include <algorithm>
+
+using namespace std;
+
 string
 InMemoryAllTermsList::get_termname() const
 {
@@ -100,3 +106,73 @@ InMemoryAllTermsList::at_end() const
     Assert(it == tmap->end() || !it->first.empty());
     return (it == tmap->end());
 }
+
+InMemoryMetadataKeyList::InMemoryMetadataKeyList(
+	const map<string, string> & metadata, const string & prefix)
+    : started(false)
+{
+    map<string, string>::const_iterator i;
+    for (i = metadata.lower_bound(prefix); i != metadata.end(); ++i) {
+	if (!startswith(i->first, prefix)) break;
+	keys.push_back(i->first);
+    }
+    it = keys.begin();
+}
+
+Xapian::termcount
+InMemoryMetadataKeyList::get_approx_size() const
+{
+    return keys.size();
+}
+
+string
+InMemoryMetadataKeyList::get_termname() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return *it;
+}
+
+Xapian::doccount
+InMemoryMetadataKeyList::get_termfreq() const
+{
+    throw Xapian::InvalidOperationError("get_termfreq() not meaningful for a metadata key list");
+}
+
+Xapian::termcount
+InMemoryMetadataKeyList::get_collection_freq() const
+{
+    throw Xapian::InvalidOperationError("get_collection_freq() not meaningful for a metadata key list");
+}
+
+TermList *
+InMemoryMetadataKeyList::next()
+{
+    if (started) {
+	Assert(!at_end());
+	++it;
+    } else {
+	started = true;
+    }
+    return NULL;
+}
+
+TermList *
+InMemoryMetadataKeyList::skip_to(const string & key)
+{
+    if (started) {
+	Assert(!at_end());
+	// Don't skip backwards.
+	if (key <= *it) return NULL;
+    } else {
+	started = true;
+    }
+    it = lower_bound(it, vector<string>::const_iterator(keys.end()), key);
+    return NULL;
+}
+
+bool
+InMemoryMetadataKeyList::at_end() const
+{
+    return started && it == keys.end();
+}
@@ -73,4 +73,48 @@ class InMemoryAllTermsList : public AllTermsList
 	bool at_end() const;
 };
 
+/// Iterate a sorted list of metadata keys.
+class InMemoryMetadataKeyList : public AllTermsList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryMetadataKeyList &);
+
+    /// Don't allow copying.
+    InMemoryMetadataKeyList(const InMemoryMetadataKeyList &);
+
+    /// The keys, in ascending order.
+    std::vector<std::string> keys;
+
+    /// The current position.
+    std::vector<std::string>::const_iterator it;
+
+    /// Has next() or skip_to() been called yet?
+    bool started;
+
+  public:
+    /** Construct from the keys in @a metadata which start with @a prefix.
+     *
+     *  The keys are copied, so the list is unaffected by later changes to
+     *  @a metadata.
+     */
+    InMemoryMetadataKeyList(const std::map<std::string, std::string> & metadata,
+			    const std::string & prefix);
+
+    /// Return true if there are no keys to iterate.
+    bool empty() const { return keys.empty(); }
+
+    Xapian::termcount get_approx_size() const;
+
+    std::string get_termname() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::termcount get_collection_freq() const;
+
+    TermList * next();
+
+    TermList * skip_to(const std::string & key);
+
+    bool at_end() const;
+};
+
 #endif /* OM_HGUARD_INMEMORY_ALLTERMSLIST_H */
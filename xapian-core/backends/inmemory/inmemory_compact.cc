@@ -0,0 +1,1209 @@
+/** @file inmemory_compact.cc
+ * @brief Compact read-only database held in memory.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "inmemory_compact.h"
+
+#include <xapian/document.h>
+#include <xapian/error.h>
+#include <xapian/positioniterator.h>
+#include <xapian/postingiterator.h>
+#include <xapian/termiterator.h>
+#include <xapian/valueiterator.h>
+
+#include "atomiccount.h"
+#include "autoptr.h"
+#include "debuglog.h"
+#include "expand/expandweight.h"
+#include "inmemory_alltermslist.h"
+#include "omassert.h"
+#include "pack.h"
+#include "str.h"
+#include "stringutils.h"
+
+#include <algorithm>
+
+using namespace std;
+using Xapian::Internal::intrusive_ptr;
+
+InMemoryCompactTables::InMemoryCompactTables()
+    : refs(0), doccount(0), lastdocid(0), total_length(0),
+      doclength_lbound(0), doclength_ubound(0), has_positions(false)
+{
+}
+
+size_t
+InMemoryCompactTables::add_positions(Xapian::PositionIterator pos,
+				     const Xapian::PositionIterator & pos_end)
+{
+    if (pos == pos_end) return 0;
+    string pos_data;
+    Xapian::termcount count = 0;
+    Xapian::termpos prev_pos = 0;
+    for ( ; pos != pos_end; ++pos) {
+	pack_uint(pos_data, *pos - prev_pos);
+	prev_pos = *pos;
+	++count;
+    }
+    size_t pos_offset = positions.size() + 1;
+    pack_uint(positions, count);
+    positions += pos_data;
+    return pos_offset;
+}
+
+void
+InMemoryCompactTables::add_data_and_values(const Xapian::Document & doc)
+{
+    data_offsets.push_back(data.size());
+    data += doc.get_data();
+
+    value_offsets.push_back(values.size());
+    Xapian::valueno prev_slot = 0;
+    Xapian::ValueIterator v;
+    for (v = doc.values_begin(); v != doc.values_end(); ++v) {
+	Xapian::valueno slot = v.get_valueno();
+	pack_uint(values, slot - prev_slot);
+	pack_string(values, *v);
+	prev_slot = slot;
+
+	ValueStats & stats = valuestats[slot];
+	if (stats.freq++ == 0) {
+	    stats.lower_bound = stats.upper_bound = *v;
+	} else if (*v < stats.lower_bound) {
+	    stats.lower_bound = *v;
+	} else if (*v > stats.upper_bound) {
+	    stats.upper_bound = *v;
+	}
+    }
+}
+
+void
+InMemoryCompactTables::add_end_term()
+{
+    TermInfo info;
+    info.name = names.size();
+    info.postings = postings.size();
+    info.skips = skips.size();
+    info.termfreq = info.collfreq = info.wdf_max = 0;
+    terms.push_back(info);
+}
+
+InMemoryCompactTables *
+InMemoryCompactTables::build(const Xapian::Database & db)
+{
+    LOGCALL_STATIC(DB, InMemoryCompactTables *, "InMemoryCompactTables::build", db);
+    AutoPtr<InMemoryCompactTables> tables(new InMemoryCompactTables);
+    InMemoryCompactTables & res = *tables;
+
+    res.lastdocid = db.get_lastdocid();
+    Xapian::PostingIterator d;
+    for (d = db.postlist_begin(string()); d != db.postlist_end(string()); ++d) {
+	Xapian::termcount doclen = d.get_doclength();
+	res.docids.push_back(*d);
+	res.doclengths.push_back(doclen);
+	if (res.doccount == 0 || (doclen && doclen < res.doclength_lbound))
+	    res.doclength_lbound = doclen;
+	res.doclength_ubound = max(res.doclength_ubound, doclen);
+	res.total_length += doclen;
+	++res.doccount;
+    }
+
+    // The termlist entries for each document, which we build up as we work
+    // through the postlists.
+    vector<string> doc_termlists(res.doccount);
+    vector<Xapian::termcount> doc_termcounts(res.doccount);
+    vector<size_t> doc_prev_term(res.doccount);
+
+    Xapian::TermIterator term;
+    for (term = db.allterms_begin(); term != db.allterms_end(); ++term) {
+	size_t t = res.terms.size();
+	TermInfo info;
+	info.name = res.names.size();
+	info.postings = res.postings.size();
+	info.skips = res.skips.size();
+	info.termfreq = 0;
+	info.collfreq = 0;
+	info.wdf_max = 0;
+	res.names += *term;
+
+	Xapian::docid prev_did = 0;
+	Xapian::PostingIterator p;
+	for (p = db.postlist_begin(*term); p != db.postlist_end(*term); ++p) {
+	    Xapian::docid did = *p;
+	    Xapian::termcount wdf = p.get_wdf();
+	    if (info.termfreq && info.termfreq % SKIP_INTERVAL == 0) {
+		SkipEntry skip;
+		skip.did = prev_did;
+		skip.offset = res.postings.size();
+		res.skips.push_back(skip);
+	    }
+	    ++info.termfreq;
+	    info.collfreq += wdf;
+	    info.wdf_max = max(info.wdf_max, wdf);
+
+	    size_t pos_offset = res.add_positions(p.positionlist_begin(),
+						  p.positionlist_end());
+
+	    pack_uint(res.postings, did - prev_did);
+	    pack_uint(res.postings, wdf);
+	    pack_uint(res.postings, pos_offset);
+	    prev_did = did;
+
+	    size_t doc = res.doc_index(did);
+	    string & tl = doc_termlists[doc];
+	    pack_uint(tl, t - doc_prev_term[doc]);
+	    pack_uint(tl, wdf);
+	    pack_uint(tl, pos_offset);
+	    doc_prev_term[doc] = t;
+	    ++doc_termcounts[doc];
+	}
+	res.terms.push_back(info);
+    }
+    res.add_end_term();
+
+    res.termlist_offsets.reserve(res.doccount + 1);
+    res.data_offsets.reserve(res.doccount + 1);
+    res.value_offsets.reserve(res.doccount + 1);
+    for (size_t doc = 0; doc != res.doccount; ++doc) {
+	res.termlist_offsets.push_back(res.termlists.size());
+	pack_uint(res.termlists, doc_termcounts[doc]);
+	res.termlists += doc_termlists[doc];
+	string().swap(doc_termlists[doc]);
+
+	res.add_data_and_values(db.get_document(res.docids[doc]));
+    }
+    res.termlist_offsets.push_back(res.termlists.size());
+    res.data_offsets.push_back(res.data.size());
+    res.value_offsets.push_back(res.values.size());
+
+    Xapian::TermIterator k;
+    for (k = db.metadata_keys_begin(); k != db.metadata_keys_end(); ++k) {
+	res.metadata.insert(make_pair(*k, db.get_metadata(*k)));
+    }
+
+    res.has_positions = db.has_positions();
+
+    RETURN(tables.release());
+}
+
+namespace {
+
+/// A term being collected by the document-based build().
+struct PendingTerm {
+    std::string postings;
+
+    /// Skip entries, with offsets relative to the start of postings.
+    std::vector<InMemoryCompactTables::SkipEntry> skips;
+
+    Xapian::docid prev_did;
+
+    Xapian::doccount termfreq;
+
+    Xapian::termcount collfreq;
+
+    Xapian::termcount wdf_max;
+
+    /// The term number, which is only known once we have all the terms.
+    size_t t;
+
+    PendingTerm() : prev_did(0), termfreq(0), collfreq(0), wdf_max(0), t(0) { }
+};
+
+/// A termlist entry for the document-based build().
+struct PendingTermListEntry {
+    const PendingTerm * term;
+
+    Xapian::termcount wdf;
+
+    size_t pos_offset;
+
+    PendingTermListEntry(const PendingTerm * term_, Xapian::termcount wdf_,
+			 size_t pos_offset_)
+	: term(term_), wdf(wdf_), pos_offset(pos_offset_) { }
+};
+
+}
+
+InMemoryCompactTables *
+InMemoryCompactTables::build(const Xapian::Database & db,
+			     const vector<Xapian::docid> & dids)
+{
+    LOGCALL_STATIC(DB, InMemoryCompactTables *, "InMemoryCompactTables::build", db | dids.size());
+    AutoPtr<InMemoryCompactTables> tables(new InMemoryCompactTables);
+    InMemoryCompactTables & res = *tables;
+
+    // We don't know the term numbers until we've seen all the documents, so
+    // collect the postings for each term and the termlist for each document
+    // separately first.
+    map<string, PendingTerm> pending;
+    vector<vector<PendingTermListEntry> > doc_termlists;
+
+    res.lastdocid = db.get_lastdocid();
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	Xapian::docid did = *i;
+	AssertRel(did,>,(res.docids.empty() ? 0 : res.docids.back()));
+	Xapian::Document doc;
+	try {
+	    doc = db.get_document(did);
+	} catch (const Xapian::DocNotFoundError &) {
+	    continue;
+	}
+
+	Xapian::termcount doclen = db.get_doclength(did);
+	res.docids.push_back(did);
+	res.doclengths.push_back(doclen);
+	if (res.doccount == 0 || (doclen && doclen < res.doclength_lbound))
+	    res.doclength_lbound = doclen;
+	res.doclength_ubound = max(res.doclength_ubound, doclen);
+	res.total_length += doclen;
+	++res.doccount;
+
+	res.add_data_and_values(doc);
+
+	doc_termlists.push_back(vector<PendingTermListEntry>());
+	vector<PendingTermListEntry> & tl = doc_termlists.back();
+	Xapian::TermIterator term;
+	for (term = doc.termlist_begin(); term != doc.termlist_end(); ++term) {
+	    PendingTerm & info = pending[*term];
+	    Xapian::termcount wdf = term.get_wdf();
+	    if (info.termfreq && info.termfreq % SKIP_INTERVAL == 0) {
+		SkipEntry skip;
+		skip.did = info.prev_did;
+		skip.offset = info.postings.size();
+		info.skips.push_back(skip);
+	    }
+	    ++info.termfreq;
+	    info.collfreq += wdf;
+	    info.wdf_max = max(info.wdf_max, wdf);
+
+	    size_t pos_offset = res.add_positions(term.positionlist_begin(),
+						  term.positionlist_end());
+
+	    pack_uint(info.postings, did - info.prev_did);
+	    pack_uint(info.postings, wdf);
+	    pack_uint(info.postings, pos_offset);
+	    info.prev_did = did;
+
+	    tl.push_back(PendingTermListEntry(&info, wdf, pos_offset));
+	}
+    }
+    res.data_offsets.push_back(res.data.size());
+    res.value_offsets.push_back(res.values.size());
+
+    map<string, PendingTerm>::iterator j;
+    for (j = pending.begin(); j != pending.end(); ++j) {
+	PendingTerm & p = j->second;
+	p.t = res.terms.size();
+	TermInfo info;
+	info.name = res.names.size();
+	info.postings = res.postings.size();
+	info.skips = res.skips.size();
+	info.termfreq = p.termfreq;
+	info.collfreq = p.collfreq;
+	info.wdf_max = p.wdf_max;
+	res.names += j->first;
+	res.postings += p.postings;
+	string().swap(p.postings);
+	vector<SkipEntry>::const_iterator k;
+	for (k = p.skips.begin(); k != p.skips.end(); ++k) {
+	    SkipEntry skip = *k;
+	    skip.offset += info.postings;
+	    res.skips.push_back(skip);
+	}
+	res.terms.push_back(info);
+    }
+    res.add_end_term();
+
+    res.termlist_offsets.reserve(res.doccount + 1);
+    vector<vector<PendingTermListEntry> >::const_iterator tl;
+    for (tl = doc_termlists.begin(); tl != doc_termlists.end(); ++tl) {
+	res.termlist_offsets.push_back(res.termlists.size());
+	pack_uint(res.termlists, tl->size());
+	// The termlist is in term order, so the term numbers ascend.
+	size_t prev_t = 0;
+	vector<PendingTermListEntry>::const_iterator e;
+	for (e = tl->begin(); e != tl->end(); ++e) {
+	    pack_uint(res.termlists, e->term->t - prev_t);
+	    pack_uint(res.termlists, e->wdf);
+	    pack_uint(res.termlists, e->pos_offset);
+	    prev_t = e->term->t;
+	}
+    }
+    res.termlist_offsets.push_back(res.termlists.size());
+
+    Xapian::TermIterator k;
+    for (k = db.metadata_keys_begin(); k != db.metadata_keys_end(); ++k) {
+	res.metadata.insert(make_pair(*k, db.get_metadata(*k)));
+    }
+
+    res.has_positions = !res.positions.empty();
+
+    RETURN(tables.release());
+}
+
+void
+InMemoryCompactTables::ref() const
+{
+    atomic_increment(refs);
+}
+
+void
+InMemoryCompactTables::unref() const
+{
+    if (atomic_decrement(refs) == 0)
+	delete this;
+}
+
+size_t
+InMemoryCompactTables::lower_bound(const string & term) const
+{
+    // Binary search, ignoring the end marker.
+    size_t lo = 0, hi = terms.size() - 1;
+    while (lo < hi) {
+	size_t mid = lo + (hi - lo) / 2;
+	size_t len = terms[mid + 1].name - terms[mid].name;
+	if (names.compare(terms[mid].name, len, term) < 0) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo;
+}
+
+size_t
+InMemoryCompactTables::find(const string & term) const
+{
+    size_t t = lower_bound(term);
+    size_t n = terms.size() - 1;
+    if (t == n) return n;
+    size_t len = terms[t + 1].name - terms[t].name;
+    if (names.compare(terms[t].name, len, term) != 0) return n;
+    return t;
+}
+
+Xapian::termcount
+InMemoryCompactTables::count_positions(size_t pos_offset) const
+{
+    if (pos_offset == 0) return 0;
+    const char * p = positions.data() + pos_offset - 1;
+    const char * end = positions.data() + positions.size();
+    Xapian::termcount count;
+    if (!unpack_uint(&p, end, &count))
+	throw Xapian::DatabaseCorruptError("Bad position data");
+    return count;
+}
+
+//////////////
+// Database //
+//////////////
+
+InMemoryCompactDatabase::InMemoryCompactDatabase(const InMemoryCompactTables * tables_)
+    : tables(tables_)
+{
+    tables->ref();
+}
+
+InMemoryCompactDatabase *
+InMemoryCompactDatabase::open(const Xapian::Database & db)
+{
+    LOGCALL_STATIC(DB, InMemoryCompactDatabase *, "InMemoryCompactDatabase::open", db);
+    if (db.internal.size() == 1) {
+	const InMemoryCompactDatabase * other =
+	    dynamic_cast<const InMemoryCompactDatabase *>(db.internal[0].get());
+	if (other) {
+	    // Share the existing data.
+	    RETURN(new InMemoryCompactDatabase(&other->get_tables()));
+	}
+    }
+    AutoPtr<InMemoryCompactTables> tables(InMemoryCompactTables::build(db));
+    InMemoryCompactDatabase * res = new InMemoryCompactDatabase(tables.get());
+    tables.release();
+    RETURN(res);
+}
+
+InMemoryCompactDatabase *
+InMemoryCompactDatabase::open(const Xapian::Database & db,
+			      const vector<Xapian::docid> & dids)
+{
+    LOGCALL_STATIC(DB, InMemoryCompactDatabase *, "InMemoryCompactDatabase::open", db | dids.size());
+    AutoPtr<InMemoryCompactTables> tables(InMemoryCompactTables::build(db, dids));
+    InMemoryCompactDatabase * res = new InMemoryCompactDatabase(tables.get());
+    tables.release();
+    RETURN(res);
+}
+
+InMemoryCompactDatabase::~InMemoryCompactDatabase()
+{
+    dtor_called();
+    if (tables) tables->unref();
+}
+
+void
+InMemoryCompactDatabase::throw_database_closed()
+{
+    throw Xapian::DatabaseError("Database has been closed");
+}
+
+bool
+InMemoryCompactDatabase::reopen()
+{
+    // A snapshot never changes, so there's nothing to reopen.
+    if (is_closed()) throw_database_closed();
+    return false;
+}
+
+Xapian::Database::Internal *
+InMemoryCompactDatabase::clone_for_thread() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "InMemoryCompactDatabase::clone_for_thread", NO_ARGS);
+    if (is_closed()) throw_database_closed();
+    // The tables are never modified and their reference count is atomic, so
+    // the clone can share them.
+    RETURN(new InMemoryCompactDatabase(tables));
+}
+
+void
+InMemoryCompactDatabase::close()
+{
+    if (tables) {
+	tables->unref();
+	tables = NULL;
+    }
+}
+
+Xapian::doccount
+InMemoryCompactDatabase::get_doccount() const
+{
+    return get_tables().doccount;
+}
+
+Xapian::docid
+InMemoryCompactDatabase::get_lastdocid() const
+{
+    return get_tables().lastdocid;
+}
+
+totlen_t
+InMemoryCompactDatabase::get_total_length() const
+{
+    return get_tables().total_length;
+}
+
+Xapian::doclength
+InMemoryCompactDatabase::get_avlength() const
+{
+    const InMemoryCompactTables & t = get_tables();
+    if (t.doccount == 0) return 0;
+    return Xapian::doclength(t.total_length) / t.doccount;
+}
+
+Xapian::termcount
+InMemoryCompactDatabase::get_doclength(Xapian::docid did) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    size_t doc = t.doc_index(did);
+    if (doc == t.docids.size()) {
+	throw Xapian::DocNotFoundError("Docid " + str(did) + " not found");
+    }
+    return t.doclengths[doc];
+}
+
+void
+InMemoryCompactDatabase::get_freqs(const string & term,
+				   Xapian::doccount * termfreq_ptr,
+				   Xapian::termcount * collfreq_ptr) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    const InMemoryCompactTables::TermInfo & info = t.terms[t.find(term)];
+    if (termfreq_ptr)
+	*termfreq_ptr = info.termfreq;
+    if (collfreq_ptr)
+	*collfreq_ptr = info.collfreq;
+}
+
+Xapian::doccount
+InMemoryCompactDatabase::get_value_freq(Xapian::valueno slot) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    map<Xapian::valueno, ValueStats>::const_iterator i;
+    i = t.valuestats.find(slot);
+    if (i == t.valuestats.end()) return 0;
+    return i->second.freq;
+}
+
+string
+InMemoryCompactDatabase::get_value_lower_bound(Xapian::valueno slot) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    map<Xapian::valueno, ValueStats>::const_iterator i;
+    i = t.valuestats.find(slot);
+    if (i == t.valuestats.end()) return string();
+    return i->second.lower_bound;
+}
+
+string
+InMemoryCompactDatabase::get_value_upper_bound(Xapian::valueno slot) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    map<Xapian::valueno, ValueStats>::const_iterator i;
+    i = t.valuestats.find(slot);
+    if (i == t.valuestats.end()) return string();
+    return i->second.upper_bound;
+}
+
+Xapian::termcount
+InMemoryCompactDatabase::get_doclength_lower_bound() const
+{
+    return get_tables().doclength_lbound;
+}
+
+Xapian::termcount
+InMemoryCompactDatabase::get_doclength_upper_bound() const
+{
+    return get_tables().doclength_ubound;
+}
+
+Xapian::termcount
+InMemoryCompactDatabase::get_wdf_upper_bound(const string & term) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    return t.terms[t.find(term)].wdf_max;
+}
+
+bool
+InMemoryCompactDatabase::term_exists(const string & tname) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    return t.find(tname) != t.terms.size() - 1;
+}
+
+bool
+InMemoryCompactDatabase::has_positions() const
+{
+    return get_tables().has_positions;
+}
+
+LeafPostList *
+InMemoryCompactDatabase::open_post_list(const string & tname) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    if (tname.empty())
+	return new InMemoryCompactAllDocsPostList(this);
+    return new InMemoryCompactPostList(this, t.find(tname), tname);
+}
+
+TermList *
+InMemoryCompactDatabase::open_term_list(Xapian::docid did) const
+{
+    Assert(did != 0);
+    if (!get_tables().doc_exists(did)) {
+	throw Xapian::DocNotFoundError("Docid " + str(did) + " not found");
+    }
+    return new InMemoryCompactTermList(this, did);
+}
+
+TermList *
+InMemoryCompactDatabase::open_allterms(const string & prefix) const
+{
+    (void)get_tables();
+    return new InMemoryCompactAllTermsList(this, prefix);
+}
+
+PositionList *
+InMemoryCompactDatabase::open_position_list(Xapian::docid did,
+					    const string & tname) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    size_t pos_offset = 0;
+    if (t.doc_exists(did)) {
+	InMemoryCompactTermList tl(this, did);
+	tl.skip_to(tname);
+	if (!tl.at_end() && tl.get_termname() == tname)
+	    pos_offset = tl.get_pos_offset();
+    }
+    return new InMemoryCompactPositionList(t, pos_offset);
+}
+
+Xapian::Document::Internal *
+InMemoryCompactDatabase::open_document(Xapian::docid did, bool lazy) const
+{
+    Assert(did != 0);
+    if (!get_tables().doc_exists(did)) {
+	if (lazy) return NULL;
+	throw Xapian::DocNotFoundError("Docid " + str(did) + " not found");
+    }
+    return new InMemoryCompactDocument(this, did);
+}
+
+string
+InMemoryCompactDatabase::get_metadata(const string & key) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    map<string, string>::const_iterator i = t.metadata.find(key);
+    if (i == t.metadata.end())
+	return string();
+    return i->second;
+}
+
+TermList *
+InMemoryCompactDatabase::open_metadata_keylist(const string & prefix) const
+{
+    const InMemoryCompactTables & t = get_tables();
+    AutoPtr<InMemoryMetadataKeyList> keys(
+	new InMemoryMetadataKeyList(t.metadata, prefix));
+    if (keys->empty()) return NULL;
+    return keys.release();
+}
+
+///////////////////
+// Position list //
+///////////////////
+
+InMemoryCompactPositionList::InMemoryCompactPositionList(
+	const InMemoryCompactTables & tables, size_t pos_offset)
+    : p(NULL), end(NULL), size(0), current_pos(0), started(false)
+{
+    if (pos_offset) {
+	p = tables.positions.data() + pos_offset - 1;
+	end = tables.positions.data() + tables.positions.size();
+	if (!unpack_uint(&p, end, &size))
+	    throw Xapian::DatabaseCorruptError("Bad position data");
+    }
+}
+
+Xapian::termcount
+InMemoryCompactPositionList::get_size() const
+{
+    return size;
+}
+
+Xapian::termpos
+InMemoryCompactPositionList::get_position() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return current_pos;
+}
+
+void
+InMemoryCompactPositionList::next()
+{
+    if (started) {
+	Assert(!at_end());
+	--size;
+    } else {
+	started = true;
+    }
+    if (size == 0) return;
+    Xapian::termpos delta;
+    if (!unpack_uint(&p, end, &delta))
+	throw Xapian::DatabaseCorruptError("Bad position data");
+    current_pos += delta;
+}
+
+void
+InMemoryCompactPositionList::skip_to(Xapian::termpos termpos)
+{
+    if (!started) next();
+    while (!at_end() && current_pos < termpos) next();
+}
+
+bool
+InMemoryCompactPositionList::at_end() const
+{
+    return size == 0;
+}
+
+//////////////
+// Postlist //
+//////////////
+
+InMemoryCompactPostList::InMemoryCompactPostList(const InMemoryCompactDatabase * db_,
+						 size_t t_,
+						 const string & term_)
+    : LeafPostList(term_), db(db_), t(t_), did(0), wdf(0), pos_offset(0),
+      started(false), positions(NULL)
+{
+    const InMemoryCompactTables & tables = db->get_tables();
+    if (t == tables.terms.size() - 1) {
+	p = end = NULL;
+	skip = skip_end = 0;
+    } else {
+	p = tables.postings.data() + tables.terms[t].postings;
+	end = tables.postings.data() + tables.terms[t + 1].postings;
+	skip = tables.terms[t].skips;
+	skip_end = tables.terms[t + 1].skips;
+    }
+}
+
+InMemoryCompactPostList::~InMemoryCompactPostList()
+{
+    delete positions;
+}
+
+void
+InMemoryCompactPostList::read_posting()
+{
+    if (p == end) {
+	did = 0;
+	return;
+    }
+    Xapian::docid delta;
+    if (!unpack_uint(&p, end, &delta) ||
+	!unpack_uint(&p, end, &wdf) ||
+	!unpack_uint(&p, end, &pos_offset)) {
+	throw Xapian::DatabaseCorruptError("Bad postlist data");
+    }
+    did += delta;
+}
+
+Xapian::doccount
+InMemoryCompactPostList::get_termfreq() const
+{
+    return db->get_tables().terms[t].termfreq;
+}
+
+Xapian::docid
+InMemoryCompactPostList::get_docid() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return did;
+}
+
+Xapian::termcount
+InMemoryCompactPostList::get_doclength() const
+{
+    Assert(started);
+    Assert(!at_end());
+    const InMemoryCompactTables & tables = db->get_tables();
+    return tables.doclengths[tables.doc_index(did)];
+}
+
+Xapian::termcount
+InMemoryCompactPostList::get_wdf() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return wdf;
+}
+
+PositionList *
+InMemoryCompactPostList::read_position_list()
+{
+    delete positions;
+    positions = NULL;
+    positions = new InMemoryCompactPositionList(db->get_tables(), pos_offset);
+    return positions;
+}
+
+PositionList *
+InMemoryCompactPostList::open_position_list() const
+{
+    return new InMemoryCompactPositionList(db->get_tables(), pos_offset);
+}
+
+PostList *
+InMemoryCompactPostList::next(double)
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    Assert(!started || !at_end());
+    started = true;
+    read_posting();
+    return NULL;
+}
+
+PostList *
+InMemoryCompactPostList::skip_to(Xapian::docid did_, double)
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    if (started) {
+	Assert(!at_end());
+	if (did_ <= did) return NULL;
+    }
+    started = true;
+
+    // Use the skip entries to jump over blocks of postings which are
+    // entirely before did_.
+    const InMemoryCompactTables & tables = db->get_tables();
+    if (skip != skip_end && tables.skips[skip].did < did_) {
+	do {
+	    ++skip;
+	} while (skip != skip_end && tables.skips[skip].did < did_);
+	const InMemoryCompactTables::SkipEntry & entry = tables.skips[skip - 1];
+	if (entry.did > did) {
+	    did = entry.did;
+	    p = tables.postings.data() + entry.offset;
+	}
+    }
+
+    do {
+	read_posting();
+    } while (did != 0 && did < did_);
+    return NULL;
+}
+
+bool
+InMemoryCompactPostList::at_end() const
+{
+    return started && did == 0;
+}
+
+string
+InMemoryCompactPostList::get_description() const
+{
+    return "InMemoryCompactPostList " + str(get_termfreq());
+}
+
+////////////////////////
+// All docs post list //
+////////////////////////
+
+InMemoryCompactAllDocsPostList::InMemoryCompactAllDocsPostList(const InMemoryCompactDatabase * db_)
+    : LeafPostList(string()), db(db_), i(size_t(-1))
+{
+}
+
+Xapian::doccount
+InMemoryCompactAllDocsPostList::get_termfreq() const
+{
+    return db->get_tables().doccount;
+}
+
+Xapian::docid
+InMemoryCompactAllDocsPostList::get_docid() const
+{
+    Assert(i != size_t(-1));
+    Assert(!at_end());
+    return db->get_tables().docids[i];
+}
+
+Xapian::termcount
+InMemoryCompactAllDocsPostList::get_doclength() const
+{
+    Assert(i != size_t(-1));
+    Assert(!at_end());
+    return db->get_tables().doclengths[i];
+}
+
+Xapian::termcount
+InMemoryCompactAllDocsPostList::get_wdf() const
+{
+    return 1;
+}
+
+PositionList *
+InMemoryCompactAllDocsPostList::read_position_list()
+{
+    throw Xapian::UnimplementedError("Can't open position list for all docs iterator");
+}
+
+PositionList *
+InMemoryCompactAllDocsPostList::open_position_list() const
+{
+    throw Xapian::UnimplementedError("Can't open position list for all docs iterator");
+}
+
+PostList *
+InMemoryCompactAllDocsPostList::next(double)
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    Assert(!at_end());
+    // This wraps from -1 to 0 for the first call.
+    ++i;
+    return NULL;
+}
+
+PostList *
+InMemoryCompactAllDocsPostList::skip_to(Xapian::docid did_, double)
+{
+    const InMemoryCompactTables & tables = db->get_tables();
+    Assert(!at_end());
+    vector<Xapian::docid>::const_iterator start = tables.docids.begin();
+    if (i != size_t(-1)) {
+	// Don't skip backwards.
+	if (did_ <= tables.docids[i]) return NULL;
+	start += i;
+    }
+    i = lower_bound(start, tables.docids.end(), did_) - tables.docids.begin();
+    return NULL;
+}
+
+bool
+InMemoryCompactAllDocsPostList::at_end() const
+{
+    return i != size_t(-1) && i >= db->get_tables().docids.size();
+}
+
+string
+InMemoryCompactAllDocsPostList::get_description() const
+{
+    return "InMemoryCompactAllDocsPostList " + str(i);
+}
+
+//////////////
+// Termlist //
+//////////////
+
+InMemoryCompactTermList::InMemoryCompactTermList(const InMemoryCompactDatabase * db_,
+						 Xapian::docid did_)
+    : db(db_), did(did_), t(size_t(-1)), wdf(0), pos_offset(0),
+      at_end_(false)
+{
+    const InMemoryCompactTables & tables = db->get_tables();
+    doc = tables.doc_index(did);
+    AssertRel(doc,<,tables.docids.size());
+    p = tables.termlists.data() + tables.termlist_offsets[doc];
+    end = tables.termlists.data() + tables.termlist_offsets[doc + 1];
+    if (!unpack_uint(&p, end, &size))
+	throw Xapian::DatabaseCorruptError("Bad termlist data");
+}
+
+Xapian::termcount
+InMemoryCompactTermList::get_approx_size() const
+{
+    return size;
+}
+
+void
+InMemoryCompactTermList::accumulate_stats(Xapian::Internal::ExpandStats & stats) const
+{
+    Assert(!at_end());
+    const InMemoryCompactTables & tables = db->get_tables();
+    stats.accumulate(wdf, tables.doclengths[doc],
+		     tables.terms[t].termfreq, tables.doccount);
+}
+
+string
+InMemoryCompactTermList::get_termname() const
+{
+    Assert(!at_end());
+    return db->get_tables().get_termname(t);
+}
+
+Xapian::termcount
+InMemoryCompactTermList::get_wdf() const
+{
+    Assert(!at_end());
+    return wdf;
+}
+
+Xapian::doccount
+InMemoryCompactTermList::get_termfreq() const
+{
+    Assert(!at_end());
+    return db->get_tables().terms[t].termfreq;
+}
+
+Xapian::termcount
+InMemoryCompactTermList::get_collection_freq() const
+{
+    Assert(!at_end());
+    return db->get_tables().terms[t].collfreq;
+}
+
+TermList *
+InMemoryCompactTermList::next()
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    Assert(!at_end());
+    if (p == end) {
+	at_end_ = true;
+	return NULL;
+    }
+    size_t delta;
+    if (!unpack_uint(&p, end, &delta) ||
+	!unpack_uint(&p, end, &wdf) ||
+	!unpack_uint(&p, end, &pos_offset)) {
+	throw Xapian::DatabaseCorruptError("Bad termlist data");
+    }
+    // The first delta is the term number itself.
+    t = (t == size_t(-1)) ? delta : t + delta;
+    return NULL;
+}
+
+TermList *
+InMemoryCompactTermList::skip_to(const string & term)
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    // Term numbers are in sort order, so we can compare those.
+    size_t target = db->get_tables().lower_bound(term);
+    if (t == size_t(-1)) next();
+    while (!at_end_ && t < target) next();
+    return NULL;
+}
+
+bool
+InMemoryCompactTermList::at_end() const
+{
+    return at_end_;
+}
+
+Xapian::termcount
+InMemoryCompactTermList::positionlist_count() const
+{
+    Assert(!at_end());
+    return db->get_tables().count_positions(pos_offset);
+}
+
+Xapian::PositionIterator
+InMemoryCompactTermList::positionlist_begin() const
+{
+    Assert(!at_end());
+    return Xapian::PositionIterator(
+	new InMemoryCompactPositionList(db->get_tables(), pos_offset));
+}
+
+////////////////////
+// All terms list //
+////////////////////
+
+InMemoryCompactAllTermsList::InMemoryCompactAllTermsList(
+	const InMemoryCompactDatabase * db_, const string & prefix_)
+    : db(db_), prefix(prefix_), started(false)
+{
+    const InMemoryCompactTables & tables = db->get_tables();
+    t = tables.lower_bound(prefix);
+    if (prefix.empty()) {
+	t_end = tables.terms.size() - 1;
+    } else {
+	// Find the first term which doesn't start with prefix.
+	t_end = t;
+	while (t_end != tables.terms.size() - 1 &&
+	       startswith(tables.get_termname(t_end), prefix)) {
+	    ++t_end;
+	}
+    }
+}
+
+Xapian::termcount
+InMemoryCompactAllTermsList::get_approx_size() const
+{
+    return t_end - t;
+}
+
+string
+InMemoryCompactAllTermsList::get_termname() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return db->get_tables().get_termname(t);
+}
+
+Xapian::doccount
+InMemoryCompactAllTermsList::get_termfreq() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return db->get_tables().terms[t].termfreq;
+}
+
+Xapian::termcount
+InMemoryCompactAllTermsList::get_collection_freq() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return db->get_tables().terms[t].collfreq;
+}
+
+TermList *
+InMemoryCompactAllTermsList::next()
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    if (started) {
+	Assert(!at_end());
+	++t;
+    } else {
+	started = true;
+    }
+    return NULL;
+}
+
+TermList *
+InMemoryCompactAllTermsList::skip_to(const string & term)
+{
+    if (db->is_closed()) InMemoryCompactDatabase::throw_database_closed();
+    size_t target = db->get_tables().lower_bound(term);
+    // Don't skip backwards.
+    if (target > t) t = min(target, t_end);
+    started = true;
+    return NULL;
+}
+
+bool
+InMemoryCompactAllTermsList::at_end() const
+{
+    return t == t_end;
+}
+
+//////////////
+// Document //
+//////////////
+
+string
+InMemoryCompactDocument::do_get_value(Xapian::valueno slot) const
+{
+    LOGCALL(DB, string, "InMemoryCompactDocument::do_get_value", slot);
+    map<Xapian::valueno, string> values_;
+    do_get_all_values(values_);
+    map<Xapian::valueno, string>::const_iterator i = values_.find(slot);
+    if (i == values_.end())
+	RETURN(string());
+    RETURN(i->second);
+}
+
+void
+InMemoryCompactDocument::do_get_all_values(map<Xapian::valueno, string> & values_) const
+{
+    LOGCALL_VOID(DB, "InMemoryCompactDocument::do_get_all_values", values_);
+    const InMemoryCompactDatabase * db;
+    db = static_cast<const InMemoryCompactDatabase*>(database.get());
+    const InMemoryCompactTables & tables = db->get_tables();
+    size_t doc = tables.doc_index(did);
+    AssertRel(doc,<,tables.docids.size());
+    const char * p = tables.values.data() + tables.value_offsets[doc];
+    const char * end = tables.values.data() + tables.value_offsets[doc + 1];
+    values_.clear();
+    Xapian::valueno slot = 0;
+    while (p != end) {
+	Xapian::valueno delta;
+	string value;
+	if (!unpack_uint(&p, end, &delta) || !unpack_string(&p, end, value))
+	    throw Xapian::DatabaseCorruptError("Bad value data");
+	slot += delta;
+	values_.insert(make_pair(slot, value));
+    }
+}
+
+string
+InMemoryCompactDocument::do_get_data() const
+{
+    LOGCALL(DB, string, "InMemoryCompactDocument::do_get_data", NO_ARGS);
+    const InMemoryCompactDatabase * db;
+    db = static_cast<const InMemoryCompactDatabase*>(database.get());
+    const InMemoryCompactTables & tables = db->get_tables();
+    size_t doc = tables.doc_index(did);
+    AssertRel(doc,<,tables.docids.size());
+    size_t start = tables.data_offsets[doc];
+    RETURN(tables.data.substr(start, tables.data_offsets[doc + 1] - start));
+}
@@ -0,0 +1,584 @@
+/** @file inmemory_compact.h
+ * @brief Compact read-only database held in memory.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_INMEMORY_COMPACT_H
+#define XAPIAN_INCLUDED_INMEMORY_COMPACT_H
+
+#include "api/leafpostlist.h"
+#include "api/termlist.h"
+#include "backends/alltermslist.h"
+#include "backends/database.h"
+#include "backends/document.h"
+#include "backends/positionlist.h"
+#include "backends/valuestats.h"
+#include "internaltypes.h"
+#include "noreturn.h"
+
+#include <xapian/database.h>
+#include <xapian/document.h>
+#include <xapian/positioniterator.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+/** The data for a compact in-memory database.
+ *
+ *  Once built this is never modified, so it can be shared between
+ *  InMemoryCompactDatabase objects used by different threads.  The only
+ *  thing which changes is the reference count, which is updated atomically
+ *  where the compiler allows.
+ *
+ *  Terms are held in a sorted array, and each term's postings are stored
+ *  delta-coded in a single shared string, as are the positions and the
+ *  termlists.  So there's no allocation per posting, and iterating a
+ *  postlist reads sequentially through memory.
+ */
+class InMemoryCompactTables {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactTables &);
+
+    /// Don't allow copying.
+    InMemoryCompactTables(const InMemoryCompactTables &);
+
+    /// Reference count.
+    mutable long refs;
+
+    InMemoryCompactTables();
+
+    /// Append the positions from @a pos to @a pos_end, returning pos_offset.
+    size_t add_positions(Xapian::PositionIterator pos,
+			 const Xapian::PositionIterator & pos_end);
+
+    /// Append the data and values of @a doc.
+    void add_data_and_values(const Xapian::Document & doc);
+
+    /// Add the entry marking the end of the last term's data.
+    void add_end_term();
+
+  public:
+    /// Information about a term.
+    struct TermInfo {
+	/// Offset of the term name in names.
+	size_t name;
+
+	/// Offset of the term's postings in postings.
+	size_t postings;
+
+	/// Index of the term's first skip entry in skips.
+	size_t skips;
+
+	Xapian::doccount termfreq;
+
+	Xapian::termcount collfreq;
+
+	Xapian::termcount wdf_max;
+    };
+
+    /** An entry allowing skip_to() to jump into the middle of a postlist.
+     *
+     *  We add one every SKIP_INTERVAL postings.
+     */
+    struct SkipEntry {
+	/// The docid of the posting before the one at offset.
+	Xapian::docid did;
+
+	/// Offset in postings.
+	size_t offset;
+    };
+
+    /// How many postings between skip entries.
+    static const Xapian::doccount SKIP_INTERVAL = 64;
+
+    /// The term names, concatenated.
+    std::string names;
+
+    /** The terms, in sorted order.
+     *
+     *  There's an extra entry on the end so that the end of each term's
+     *  data is the start of the next term's.
+     */
+    std::vector<TermInfo> terms;
+
+    /** The postings for each term.
+     *
+     *  Each posting is stored as the difference from the previous docid, the
+     *  wdf, and 0 or 1 more than the offset of its positions in positions.
+     */
+    std::string postings;
+
+    /// Skip entries for the longer postlists.
+    std::vector<SkipEntry> skips;
+
+    /** The positions for each posting which has any.
+     *
+     *  Stored as the number of positions, then the differences between
+     *  successive positions.
+     */
+    std::string positions;
+
+    /** The termlist for each document.
+     *
+     *  Stored as the number of terms, then for each term the difference
+     *  from the previous term number, the wdf and the positions offset.
+     */
+    std::string termlists;
+
+    /** The docids of the documents, in ascending order.
+     *
+     *  The other per-document arrays are indexed by position in this array,
+     *  so unused docids take no space.
+     */
+    std::vector<Xapian::docid> docids;
+
+    /// Offset in termlists for each document, plus one for the end.
+    std::vector<size_t> termlist_offsets;
+
+    /// Length of each document.
+    std::vector<Xapian::termcount> doclengths;
+
+    /// The document data, concatenated.
+    std::string data;
+
+    /// Offset in data for each document, plus one for the end.
+    std::vector<size_t> data_offsets;
+
+    /** The values, stored as the difference from the previous slot number
+     *  and the value.
+     */
+    std::string values;
+
+    /// Offset in values for each document, plus one for the end.
+    std::vector<size_t> value_offsets;
+
+    std::map<Xapian::valueno, ValueStats> valuestats;
+
+    std::map<std::string, std::string> metadata;
+
+    Xapian::doccount doccount;
+
+    Xapian::docid lastdocid;
+
+    totlen_t total_length;
+
+    Xapian::termcount doclength_lbound;
+
+    Xapian::termcount doclength_ubound;
+
+    bool has_positions;
+
+    /// Build from the contents of a database.
+    static InMemoryCompactTables * build(const Xapian::Database & db);
+
+    /** Build from some of the documents in a database.
+     *
+     *  All the metadata is copied too.
+     *
+     *  @param db	The database.
+     *  @param dids	The docids of the documents to copy, in ascending
+     *			order.  Any which don't exist in @a db are ignored.
+     */
+    static InMemoryCompactTables *
+    build(const Xapian::Database & db, const std::vector<Xapian::docid> & dids);
+
+    /// Add a reference.
+    void ref() const;
+
+    /// Remove a reference, deleting this object if it was the last one.
+    void unref() const;
+
+    /// Return the name of term number @a t.
+    std::string get_termname(size_t t) const {
+	return names.substr(terms[t].name, terms[t + 1].name - terms[t].name);
+    }
+
+    /// Find the first term >= @a term, returning terms.size() - 1 if none.
+    size_t lower_bound(const std::string & term) const;
+
+    /// Find term @a term, returning terms.size() - 1 if it's not present.
+    size_t find(const std::string & term) const;
+
+    /** Find the position of @a did in docids.
+     *
+     *  Returns docids.size() if @a did isn't a document in the database.
+     */
+    size_t doc_index(Xapian::docid did) const {
+	// Usually the docids are dense, in which case we can go straight there.
+	if (did != 0 && did <= docids.size() && docids[did - 1] == did)
+	    return did - 1;
+	std::vector<Xapian::docid>::const_iterator i;
+	i = std::lower_bound(docids.begin(), docids.end(), did);
+	if (i == docids.end() || *i != did) return docids.size();
+	return i - docids.begin();
+    }
+
+    /// Is @a did a document in the database?
+    bool doc_exists(Xapian::docid did) const {
+	return doc_index(did) != docids.size();
+    }
+
+    /// Return the number of positions at offset @a pos_offset.
+    Xapian::termcount count_positions(size_t pos_offset) const;
+};
+
+/** A compact read-only database held in memory.
+ *
+ *  Each object has its own reference to the shared InMemoryCompactTables,
+ *  so a separate object (and so a separate Xapian::Database) should be used
+ *  by each thread.
+ */
+class InMemoryCompactDatabase : public Xapian::Database::Internal {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactDatabase &);
+
+    /// Don't allow copying.
+    InMemoryCompactDatabase(const InMemoryCompactDatabase &);
+
+    /// The data, or NULL if we've been closed.
+    const InMemoryCompactTables * tables;
+
+  public:
+    /// Construct, taking a reference to @a tables_.
+    explicit InMemoryCompactDatabase(const InMemoryCompactTables * tables_);
+
+    /** Open a compact copy of @a db.
+     *
+     *  If @a db is itself a compact in-memory database, the new object shares
+     *  its data.
+     */
+    static InMemoryCompactDatabase * open(const Xapian::Database & db);
+
+    /** Open a compact copy of some of the documents in @a db.
+     *
+     *  See InMemoryCompactTables::build() for details of the parameters.
+     */
+    static InMemoryCompactDatabase *
+    open(const Xapian::Database & db, const std::vector<Xapian::docid> & dids);
+
+    ~InMemoryCompactDatabase();
+
+    /// Return the data, throwing an exception if we've been closed.
+    const InMemoryCompactTables & get_tables() const {
+	if (rare(!tables)) throw_database_closed();
+	return *tables;
+    }
+
+    bool is_closed() const { return tables == NULL; }
+
+    XAPIAN_NORETURN(static void throw_database_closed());
+
+    /** Implementation of virtual methods @{ */
+    bool reopen();
+    void close();
+    Xapian::Database::Internal * clone_for_thread() const;
+    Xapian::doccount get_doccount() const;
+    Xapian::docid get_lastdocid() const;
+    totlen_t get_total_length() const;
+    Xapian::doclength get_avlength() const;
+    Xapian::termcount get_doclength(Xapian::docid did) const;
+    void get_freqs(const string & term,
+		   Xapian::doccount * termfreq_ptr,
+		   Xapian::termcount * collfreq_ptr) const;
+    Xapian::doccount get_value_freq(Xapian::valueno slot) const;
+    std::string get_value_lower_bound(Xapian::valueno slot) const;
+    std::string get_value_upper_bound(Xapian::valueno slot) const;
+    Xapian::termcount get_doclength_lower_bound() const;
+    Xapian::termcount get_doclength_upper_bound() const;
+    Xapian::termcount get_wdf_upper_bound(const std::string & term) const;
+    bool term_exists(const string & tname) const;
+    bool has_positions() const;
+    LeafPostList * open_post_list(const string & tname) const;
+    TermList * open_term_list(Xapian::docid did) const;
+    TermList * open_allterms(const string & prefix) const;
+    PositionList * open_position_list(Xapian::docid did,
+				      const string & tname) const;
+    Xapian::Document::Internal * open_document(Xapian::docid did,
+					       bool lazy) const;
+    std::string get_metadata(const std::string & key) const;
+    TermList * open_metadata_keylist(const std::string & prefix) const;
+    /** @} */
+};
+
+/// A position list in a compact in-memory database.
+class InMemoryCompactPositionList : public PositionList {
+    /// Pointer to the next position difference.
+    const char * p;
+
+    /// Pointer to the end of the data.
+    const char * end;
+
+    /// The number of positions.
+    Xapian::termcount size;
+
+    /// The current position.
+    Xapian::termpos current_pos;
+
+    /// Have we started iterating?
+    bool started;
+
+  public:
+    /** Construct.
+     *
+     *  @param tables	The data.
+     *  @param pos_offset	The positions offset stored in the posting
+     *			(0 if there are no positions).
+     */
+    InMemoryCompactPositionList(const InMemoryCompactTables & tables,
+				size_t pos_offset);
+
+    Xapian::termcount get_size() const;
+
+    Xapian::termpos get_position() const;
+
+    void next();
+
+    void skip_to(Xapian::termpos termpos);
+
+    bool at_end() const;
+};
+
+/// A postlist in a compact in-memory database.
+class InMemoryCompactPostList : public LeafPostList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactPostList &);
+
+    /// Don't allow copying.
+    InMemoryCompactPostList(const InMemoryCompactPostList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryCompactDatabase> db;
+
+    /// The term number.
+    size_t t;
+
+    /// Pointer to the next posting.
+    const char * p;
+
+    /// Pointer to the end of the postings.
+    const char * end;
+
+    /// The current docid, or 0 if we're at the end.
+    Xapian::docid did;
+
+    Xapian::termcount wdf;
+
+    size_t pos_offset;
+
+    bool started;
+
+    /// Index of the next skip entry we might use.
+    size_t skip;
+
+    /// Index after the last skip entry for this term.
+    size_t skip_end;
+
+    /// Positions for read_position_list().
+    InMemoryCompactPositionList * positions;
+
+    /// Decode the next posting, if there is one.
+    void read_posting();
+
+  public:
+    InMemoryCompactPostList(const InMemoryCompactDatabase * db_, size_t t_,
+			    const std::string & term_);
+
+    ~InMemoryCompactPostList();
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_wdf() const;
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    bool at_end() const;
+
+    std::string get_description() const;
+};
+
+/// A postlist over all documents in a compact in-memory database.
+class InMemoryCompactAllDocsPostList : public LeafPostList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactAllDocsPostList &);
+
+    /// Don't allow copying.
+    InMemoryCompactAllDocsPostList(const InMemoryCompactAllDocsPostList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryCompactDatabase> db;
+
+    /// Index of the current document in docids, or -1 before we start.
+    size_t i;
+
+  public:
+    explicit InMemoryCompactAllDocsPostList(const InMemoryCompactDatabase * db_);
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_wdf() const;
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    bool at_end() const;
+
+    std::string get_description() const;
+};
+
+/// A termlist in a compact in-memory database.
+class InMemoryCompactTermList : public TermList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactTermList &);
+
+    /// Don't allow copying.
+    InMemoryCompactTermList(const InMemoryCompactTermList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryCompactDatabase> db;
+
+    Xapian::docid did;
+
+    /// Index of the document in the per-document arrays.
+    size_t doc;
+
+    /// Pointer to the next entry.
+    const char * p;
+
+    /// Pointer to the end of the entries.
+    const char * end;
+
+    /// The number of terms.
+    Xapian::termcount size;
+
+    /// The current term number, or -1 before we start.
+    size_t t;
+
+    Xapian::termcount wdf;
+
+    size_t pos_offset;
+
+    bool at_end_;
+
+  public:
+    InMemoryCompactTermList(const InMemoryCompactDatabase * db_,
+			    Xapian::docid did_);
+
+    Xapian::termcount get_approx_size() const;
+
+    void accumulate_stats(Xapian::Internal::ExpandStats & stats) const;
+
+    std::string get_termname() const;
+
+    Xapian::termcount get_wdf() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::termcount get_collection_freq() const;
+
+    TermList * next();
+
+    TermList * skip_to(const std::string & term);
+
+    bool at_end() const;
+
+    Xapian::termcount positionlist_count() const;
+
+    Xapian::PositionIterator positionlist_begin() const;
+
+    /// Return the positions offset for the current term.
+    size_t get_pos_offset() const { return pos_offset; }
+};
+
+/// An allterms list in a compact in-memory database.
+class InMemoryCompactAllTermsList : public AllTermsList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactAllTermsList &);
+
+    /// Don't allow copying.
+    InMemoryCompactAllTermsList(const InMemoryCompactAllTermsList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryCompactDatabase> db;
+
+    std::string prefix;
+
+    /// The current term number.
+    size_t t;
+
+    /// The term number after the last one with prefix.
+    size_t t_end;
+
+    bool started;
+
+  public:
+    InMemoryCompactAllTermsList(const InMemoryCompactDatabase * db_,
+				const std::string & prefix_);
+
+    Xapian::termcount get_approx_size() const;
+
+    std::string get_termname() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::termcount get_collection_freq() const;
+
+    TermList * next();
+
+    TermList * skip_to(const std::string & term);
+
+    bool at_end() const;
+};
+
+/// A document read from a compact in-memory database.
+class InMemoryCompactDocument : public Xapian::Document::Internal {
+    /// Don't allow assignment.
+    void operator=(const InMemoryCompactDocument &);
+
+    /// Don't allow copying.
+    InMemoryCompactDocument(const InMemoryCompactDocument &);
+
+  public:
+    InMemoryCompactDocument(const InMemoryCompactDatabase * db,
+			    Xapian::docid did_)
+	: Xapian::Document::Internal(db, did_) { }
+
+    /** Implementation of virtual methods @{ */
+    std::string do_get_value(Xapian::valueno slot) const;
+    void do_get_all_values(std::map<Xapian::valueno, std::string> & values_) const;
+    std::string do_get_data() const;
+    /** @} */
+};
+
+#endif // XAPIAN_INCLUDED_INMEMORY_COMPACT_H
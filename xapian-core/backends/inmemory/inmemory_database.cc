@@ -27,9 +27,12 @@
 
 #include "debuglog.h"
 
+#include "autoptr.h"
 #include "expand/expandweight.h"
+#include "inmemory_compact.h"
 #include "inmemory_document.h"
 #include "inmemory_alltermslist.h"
+#include "inmemory_overlay.h"
 #include "str.h"
 #include "backends/valuestats.h"
 
@@ -418,9 +421,40 @@ InMemoryDatabase::close()
     valuestats.clear();
     doclengths.clear();
     metadata.clear();
+    snapshot_base = NULL;
+    snapshot_changed.clear();
     closed = true;
 }
 
+Xapian::Database::Internal *
+InMemoryDatabase::open_snapshot() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "InMemoryDatabase::open_snapshot", NO_ARGS);
+    if (closed) InMemoryDatabase::throw_database_closed();
+    Xapian::Database db(const_cast<InMemoryDatabase *>(this));
+    // Overlaying costs more per document than a compact copy, so once a
+    // quarter of the documents have changed, take a fresh copy instead.
+    if (snapshot_base.get() == NULL || snapshot_changed.size() > totdocs / 4) {
+	snapshot_base = InMemoryCompactDatabase::open(db);
+	snapshot_changed.clear();
+    }
+    // Each snapshot gets its own object, but shares the data of the copy.
+    Xapian::Database base_db(snapshot_base.get());
+    if (snapshot_changed.empty())
+	RETURN(InMemoryCompactDatabase::open(base_db));
+    Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> base;
+    base = InMemoryCompactDatabase::open(base_db);
+    RETURN(InMemoryOverlayDatabase::open(base.get(), db, snapshot_changed));
+}
+
+Xapian::Database::Internal *
+InMemoryDatabase::clone_for_thread() const
+{
+    // The clone can't share our data structures as they can be modified, so
+    // it gets a compact copy.
+    return open_snapshot();
+}
+
 LeafPostList *
 InMemoryDatabase::open_post_list(const string & tname) const
 {
@@ -571,12 +605,13 @@ InMemoryDatabase::get_metadata(const std::string & key) const
 }
  
 TermList *
-InMemoryDatabase::open_metadata_keylist(const string &) const
+InMemoryDatabase::open_metadata_keylist(const string & prefix) const
 {
     if (closed) InMemoryDatabase::throw_database_closed();
-    if (metadata.empty()) return NULL;
-    // FIXME: nobody implemented this yet...
-    throw Xapian::UnimplementedError("InMemory backend doesn't currently implement Database::metadata_keys_begin()");
+    AutoPtr<InMemoryMetadataKeyList> keys(
+	new InMemoryMetadataKeyList(metadata, prefix));
+    if (keys->empty()) return NULL;
+    return keys.release();
 }
 
 void
@@ -682,6 +717,7 @@ InMemoryDatabase::delete_document(Xapian::docid did)
 	throw Xapian::DocNotFoundError(string("Docid ") + str(did) +
 				 string(" not found"));
     }
+    if (snapshot_base.get()) snapshot_changed.insert(did);
     termlists[did-1].is_valid = false;
     doclists[did-1] = string();
     map<Xapian::valueno, string>::const_iterator j;
@@ -793,6 +829,7 @@ InMemoryDatabase::add_document(const Xapian::Document & document)
 void
 InMemoryDatabase::finish_add_doc(Xapian::docid did, const Xapian::Document &document)
 {
+    if (snapshot_base.get()) snapshot_changed.insert(did);
     {
 	map<Xapian::valueno, string> values;
 	Xapian::ValueIterator k = document.values_begin();
@@ -30,6 +30,7 @@
 #include "backends/database.h"
 #include "backends/valuestats.h"
 #include <map>
+#include <set>
 #include <vector>
 #include <algorithm>
 #include <xapian/document.h>
@@ -259,6 +260,16 @@ class InMemoryDatabase : public Xapian::Database::Internal {
     // Flag, true if the db has been closed.
     bool closed;
 
+    /** The compact copy taken by the last full snapshot, or NULL.
+     *
+     *  Later snapshots share its data and overlay the documents which have
+     *  changed since, so they don't have to copy the whole database.
+     */
+    mutable Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> snapshot_base;
+
+    /// The docids of documents changed since snapshot_base was taken.
+    mutable std::set<Xapian::docid> snapshot_changed;
+
     // Stop copy / assignment being allowed
     InMemoryDatabase& operator=(const InMemoryDatabase &);
     InMemoryDatabase(const InMemoryDatabase &);
@@ -312,6 +323,10 @@ class InMemoryDatabase : public Xapian::Database::Internal {
     void close();
     bool is_closed() const { return closed; }
 
+    Xapian::Database::Internal * open_snapshot() const;
+
+    Xapian::Database::Internal * clone_for_thread() const;
+
     Xapian::doccount get_doccount() const;
 
     Xapian::docid get_lastdocid() const;
@@ -0,0 +1,761 @@
+/** @file inmemory_overlay.cc
+ * @brief Read-only database with changed documents overlaid from memory.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "inmemory_overlay.h"
+
+#include <xapian/document.h>
+#include <xapian/error.h>
+#include <xapian/termiterator.h>
+#include <xapian/valueiterator.h>
+
+#include "autoptr.h"
+#include "debuglog.h"
+#include "expand/expandweight.h"
+#include "inmemory_compact.h"
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+InMemoryOverlayDatabase *
+InMemoryOverlayDatabase::open(Xapian::Database::Internal * base_,
+			      const Xapian::Database & source,
+			      const set<Xapian::docid> & changed)
+{
+    LOGCALL_STATIC(DB, InMemoryOverlayDatabase *, "InMemoryOverlayDatabase::open", source | changed.size());
+    AutoPtr<InMemoryOverlayDatabase> res(new InMemoryOverlayDatabase);
+    res->base = base_;
+
+    res->masked.assign(changed.begin(), changed.end());
+
+    Xapian::Database base_db(base_);
+    Xapian::doccount n_masked = 0;
+    totlen_t masked_length = 0;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = res->masked.begin(); i != res->masked.end(); ++i) {
+	Xapian::docid did = *i;
+	// Note the statistics of the old version, which we need to hide.
+	try {
+	    Xapian::Document doc = base_db.get_document(did);
+	    Xapian::TermIterator t;
+	    for (t = doc.termlist_begin(); t != doc.termlist_end(); ++t) {
+		pair<Xapian::doccount, Xapian::termcount> & freqs =
+		    res->masked_freqs[*t];
+		++freqs.first;
+		freqs.second += t.get_wdf();
+	    }
+	    Xapian::ValueIterator v;
+	    for (v = doc.values_begin(); v != doc.values_end(); ++v) {
+		++res->masked_value_freqs[v.get_valueno()];
+	    }
+	    masked_length += base_db.get_doclength(did);
+	    ++n_masked;
+	} catch (const Xapian::DocNotFoundError &) {
+	    // A new document.
+	}
+    }
+
+    // Copy the current versions of the changed documents which still exist.
+    // This also copies all the metadata - it's not usually large, and we've
+    // no way to tell which entries have changed.
+    res->delta = InMemoryCompactDatabase::open(source, res->masked);
+
+    res->base_doccount = base_->get_doccount() - n_masked;
+    res->doccount = res->base_doccount + res->delta->get_doccount();
+    res->lastdocid = source.get_lastdocid();
+    res->total_length = base_->get_total_length() - masked_length +
+			res->delta->get_total_length();
+    RETURN(res.release());
+}
+
+InMemoryOverlayDatabase::~InMemoryOverlayDatabase()
+{
+    dtor_called();
+}
+
+void
+InMemoryOverlayDatabase::throw_database_closed()
+{
+    throw Xapian::DatabaseError("Database has been closed");
+}
+
+bool
+InMemoryOverlayDatabase::is_masked(Xapian::docid did) const
+{
+    return binary_search(masked.begin(), masked.end(), did);
+}
+
+void
+InMemoryOverlayDatabase::get_masked_freqs(const string & term,
+					  Xapian::doccount & termfreq,
+					  Xapian::termcount & collfreq) const
+{
+    map<string, pair<Xapian::doccount, Xapian::termcount> >::const_iterator i;
+    i = masked_freqs.find(term);
+    if (i != masked_freqs.end()) {
+	termfreq += i->second.first;
+	collfreq += i->second.second;
+    }
+}
+
+Xapian::Database::Internal *
+InMemoryOverlayDatabase::get_db_for(Xapian::docid did) const
+{
+    if (rare(is_closed())) throw_database_closed();
+    if (is_masked(did)) return delta.get();
+    return base.get();
+}
+
+bool
+InMemoryOverlayDatabase::reopen()
+{
+    // A snapshot never changes, so there's nothing to reopen.
+    if (is_closed()) throw_database_closed();
+    return false;
+}
+
+void
+InMemoryOverlayDatabase::close()
+{
+    if (is_closed()) return;
+    base->close();
+    delta->close();
+    base = NULL;
+    delta = NULL;
+}
+
+Xapian::doccount
+InMemoryOverlayDatabase::get_doccount() const
+{
+    if (is_closed()) throw_database_closed();
+    return doccount;
+}
+
+Xapian::docid
+InMemoryOverlayDatabase::get_lastdocid() const
+{
+    if (is_closed()) throw_database_closed();
+    return lastdocid;
+}
+
+totlen_t
+InMemoryOverlayDatabase::get_total_length() const
+{
+    if (is_closed()) throw_database_closed();
+    return total_length;
+}
+
+Xapian::doclength
+InMemoryOverlayDatabase::get_avlength() const
+{
+    if (is_closed()) throw_database_closed();
+    if (doccount == 0) return 0;
+    return Xapian::doclength(total_length) / doccount;
+}
+
+Xapian::termcount
+InMemoryOverlayDatabase::get_doclength(Xapian::docid did) const
+{
+    Assert(did != 0);
+    return get_db_for(did)->get_doclength(did);
+}
+
+void
+InMemoryOverlayDatabase::get_freqs(const string & term,
+				   Xapian::doccount * termfreq_ptr,
+				   Xapian::termcount * collfreq_ptr) const
+{
+    if (is_closed()) throw_database_closed();
+    Xapian::doccount tf = 0, delta_tf = 0, masked_tf = 0;
+    Xapian::termcount cf = 0, delta_cf = 0, masked_cf = 0;
+    base->get_freqs(term, &tf, &cf);
+    delta->get_freqs(term, &delta_tf, &delta_cf);
+    get_masked_freqs(term, masked_tf, masked_cf);
+    if (termfreq_ptr)
+	*termfreq_ptr = tf - masked_tf + delta_tf;
+    if (collfreq_ptr)
+	*collfreq_ptr = cf - masked_cf + delta_cf;
+}
+
+Xapian::doccount
+InMemoryOverlayDatabase::get_value_freq(Xapian::valueno slot) const
+{
+    if (is_closed()) throw_database_closed();
+    Xapian::doccount freq = base->get_value_freq(slot);
+    map<Xapian::valueno, Xapian::doccount>::const_iterator i;
+    i = masked_value_freqs.find(slot);
+    if (i != masked_value_freqs.end()) freq -= i->second;
+    return freq + delta->get_value_freq(slot);
+}
+
+string
+InMemoryOverlayDatabase::get_value_lower_bound(Xapian::valueno slot) const
+{
+    if (is_closed()) throw_database_closed();
+    // The bounds of the base database may include hidden documents, but
+    // they're still valid bounds.
+    if (delta->get_value_freq(slot) == 0)
+	return base->get_value_lower_bound(slot);
+    if (get_value_freq(slot) == delta->get_value_freq(slot))
+	return delta->get_value_lower_bound(slot);
+    return min(base->get_value_lower_bound(slot),
+	       delta->get_value_lower_bound(slot));
+}
+
+string
+InMemoryOverlayDatabase::get_value_upper_bound(Xapian::valueno slot) const
+{
+    if (is_closed()) throw_database_closed();
+    if (delta->get_value_freq(slot) == 0)
+	return base->get_value_upper_bound(slot);
+    if (get_value_freq(slot) == delta->get_value_freq(slot))
+	return delta->get_value_upper_bound(slot);
+    return max(base->get_value_upper_bound(slot),
+	       delta->get_value_upper_bound(slot));
+}
+
+Xapian::termcount
+InMemoryOverlayDatabase::get_doclength_lower_bound() const
+{
+    if (is_closed()) throw_database_closed();
+    if (delta->get_doccount() == 0)
+	return base->get_doclength_lower_bound();
+    if (base_doccount == 0)
+	return delta->get_doclength_lower_bound();
+    return min(base->get_doclength_lower_bound(),
+	       delta->get_doclength_lower_bound());
+}
+
+Xapian::termcount
+InMemoryOverlayDatabase::get_doclength_upper_bound() const
+{
+    if (is_closed()) throw_database_closed();
+    return max(base->get_doclength_upper_bound(),
+	       delta->get_doclength_upper_bound());
+}
+
+Xapian::termcount
+InMemoryOverlayDatabase::get_wdf_upper_bound(const string & term) const
+{
+    if (is_closed()) throw_database_closed();
+    return max(base->get_wdf_upper_bound(term),
+	       delta->get_wdf_upper_bound(term));
+}
+
+bool
+InMemoryOverlayDatabase::term_exists(const string & tname) const
+{
+    if (is_closed()) throw_database_closed();
+    if (delta->term_exists(tname)) return true;
+    Xapian::doccount tf;
+    get_freqs(tname, &tf, NULL);
+    return tf != 0;
+}
+
+bool
+InMemoryOverlayDatabase::has_positions() const
+{
+    if (is_closed()) throw_database_closed();
+    return base->has_positions() || delta->has_positions();
+}
+
+LeafPostList *
+InMemoryOverlayDatabase::open_post_list(const string & tname) const
+{
+    LOGCALL(DB, LeafPostList *, "InMemoryOverlayDatabase::open_post_list", tname);
+    if (is_closed()) throw_database_closed();
+    Xapian::doccount tf = doccount;
+    if (!tname.empty())
+	get_freqs(tname, &tf, NULL);
+    AutoPtr<LeafPostList> base_pl(base->open_post_list(tname));
+    AutoPtr<LeafPostList> delta_pl(delta->open_post_list(tname));
+    LeafPostList * pl = new InMemoryOverlayPostList(this, tname,
+						    base_pl.get(),
+						    delta_pl.get(), tf);
+    base_pl.release();
+    delta_pl.release();
+    RETURN(pl);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_term_list(Xapian::docid did) const
+{
+    Assert(did != 0);
+    Xapian::Database::Internal * db = get_db_for(did);
+    AutoPtr<TermList> tl(db->open_term_list(did));
+    TermList * res = new InMemoryOverlayTermList(this, tl.get(),
+						 db->get_doclength(did));
+    tl.release();
+    return res;
+}
+
+TermList *
+InMemoryOverlayDatabase::open_allterms(const string & prefix) const
+{
+    if (is_closed()) throw_database_closed();
+    AutoPtr<TermList> base_tl(base->open_allterms(prefix));
+    AutoPtr<TermList> delta_tl(delta->open_allterms(prefix));
+    TermList * tl = new InMemoryOverlayAllTermsList(this, base_tl.get(),
+						    delta_tl.get());
+    base_tl.release();
+    delta_tl.release();
+    return tl;
+}
+
+PositionList *
+InMemoryOverlayDatabase::open_position_list(Xapian::docid did,
+					    const string & tname) const
+{
+    Assert(did != 0);
+    return get_db_for(did)->open_position_list(did, tname);
+}
+
+Xapian::Document::Internal *
+InMemoryOverlayDatabase::open_document(Xapian::docid did, bool lazy) const
+{
+    Assert(did != 0);
+    Xapian::Document::Internal * doc = get_db_for(did)->open_document(did, lazy);
+    if (doc == NULL) return NULL;
+    return new InMemoryOverlayDocument(this, did, doc);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_spelling_termlist(const string & word) const
+{
+    if (is_closed()) throw_database_closed();
+    return base->open_spelling_termlist(word);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_spelling_wordlist() const
+{
+    if (is_closed()) throw_database_closed();
+    return base->open_spelling_wordlist();
+}
+
+Xapian::doccount
+InMemoryOverlayDatabase::get_spelling_frequency(const string & word) const
+{
+    if (is_closed()) throw_database_closed();
+    return base->get_spelling_frequency(word);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_synonym_termlist(const string & term) const
+{
+    if (is_closed()) throw_database_closed();
+    return base->open_synonym_termlist(term);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_synonym_keylist(const string & prefix) const
+{
+    if (is_closed()) throw_database_closed();
+    return base->open_synonym_keylist(prefix);
+}
+
+string
+InMemoryOverlayDatabase::get_metadata(const string & key) const
+{
+    if (is_closed()) throw_database_closed();
+    return delta->get_metadata(key);
+}
+
+TermList *
+InMemoryOverlayDatabase::open_metadata_keylist(const string & prefix) const
+{
+    if (is_closed()) throw_database_closed();
+    return delta->open_metadata_keylist(prefix);
+}
+
+//////////////
+// Postlist //
+//////////////
+
+InMemoryOverlayPostList::InMemoryOverlayPostList(
+	const InMemoryOverlayDatabase * db_, const string & term_,
+	LeafPostList * base_pl_, LeafPostList * delta_pl_,
+	Xapian::doccount termfreq_)
+    : LeafPostList(term_), db(db_), base_pl(base_pl_), delta_pl(delta_pl_),
+      current(NULL), termfreq(termfreq_), started(false)
+{
+}
+
+InMemoryOverlayPostList::~InMemoryOverlayPostList()
+{
+    delete base_pl;
+    delete delta_pl;
+}
+
+void
+InMemoryOverlayPostList::update()
+{
+    while (base_pl) {
+	if (base_pl->at_end()) {
+	    delete base_pl;
+	    base_pl = NULL;
+	    break;
+	}
+	if (!db->is_masked(base_pl->get_docid())) break;
+	(void)base_pl->next(0.0);
+    }
+    if (delta_pl && delta_pl->at_end()) {
+	delete delta_pl;
+	delta_pl = NULL;
+    }
+
+    if (!base_pl) {
+	current = delta_pl;
+    } else if (!delta_pl) {
+	current = base_pl;
+    } else {
+	// A docid is never in both, since changed docids are hidden in base.
+	AssertRel(base_pl->get_docid(),!=,delta_pl->get_docid());
+	if (base_pl->get_docid() < delta_pl->get_docid()) {
+	    current = base_pl;
+	} else {
+	    current = delta_pl;
+	}
+    }
+}
+
+Xapian::doccount
+InMemoryOverlayPostList::get_termfreq() const
+{
+    return termfreq;
+}
+
+Xapian::docid
+InMemoryOverlayPostList::get_docid() const
+{
+    Assert(started);
+    Assert(current);
+    return current->get_docid();
+}
+
+Xapian::termcount
+InMemoryOverlayPostList::get_doclength() const
+{
+    Assert(current);
+    return current->get_doclength();
+}
+
+Xapian::termcount
+InMemoryOverlayPostList::get_wdf() const
+{
+    Assert(current);
+    return current->get_wdf();
+}
+
+PositionList *
+InMemoryOverlayPostList::read_position_list()
+{
+    Assert(current);
+    return current->read_position_list();
+}
+
+PositionList *
+InMemoryOverlayPostList::open_position_list() const
+{
+    Assert(current);
+    return current->open_position_list();
+}
+
+PostList *
+InMemoryOverlayPostList::next(double)
+{
+    if (!started) {
+	started = true;
+	if (base_pl) (void)base_pl->next(0.0);
+	if (delta_pl) (void)delta_pl->next(0.0);
+    } else {
+	Assert(current);
+	(void)current->next(0.0);
+    }
+    update();
+    return NULL;
+}
+
+PostList *
+InMemoryOverlayPostList::skip_to(Xapian::docid did, double)
+{
+    if (started) {
+	// Don't skip backwards.
+	if (!current || did <= current->get_docid()) return NULL;
+    }
+    started = true;
+    if (base_pl) (void)base_pl->skip_to(did, 0.0);
+    if (delta_pl) (void)delta_pl->skip_to(did, 0.0);
+    update();
+    return NULL;
+}
+
+bool
+InMemoryOverlayPostList::at_end() const
+{
+    return started && current == NULL;
+}
+
+string
+InMemoryOverlayPostList::get_description() const
+{
+    return "InMemoryOverlayPostList(" + term + ")";
+}
+
+//////////////
+// Termlist //
+//////////////
+
+InMemoryOverlayTermList::~InMemoryOverlayTermList()
+{
+    delete tl;
+}
+
+Xapian::termcount
+InMemoryOverlayTermList::get_approx_size() const
+{
+    return tl->get_approx_size();
+}
+
+void
+InMemoryOverlayTermList::accumulate_stats(Xapian::Internal::ExpandStats & stats) const
+{
+    Assert(!at_end());
+    stats.accumulate(get_wdf(), doclen, get_termfreq(), db->get_doccount());
+}
+
+string
+InMemoryOverlayTermList::get_termname() const
+{
+    return tl->get_termname();
+}
+
+Xapian::termcount
+InMemoryOverlayTermList::get_wdf() const
+{
+    return tl->get_wdf();
+}
+
+Xapian::doccount
+InMemoryOverlayTermList::get_termfreq() const
+{
+    Xapian::doccount tf;
+    db->get_freqs(tl->get_termname(), &tf, NULL);
+    return tf;
+}
+
+Xapian::termcount
+InMemoryOverlayTermList::get_collection_freq() const
+{
+    Xapian::termcount cf;
+    db->get_freqs(tl->get_termname(), NULL, &cf);
+    return cf;
+}
+
+TermList *
+InMemoryOverlayTermList::next()
+{
+    (void)tl->next();
+    return NULL;
+}
+
+TermList *
+InMemoryOverlayTermList::skip_to(const string & term)
+{
+    (void)tl->skip_to(term);
+    return NULL;
+}
+
+bool
+InMemoryOverlayTermList::at_end() const
+{
+    return tl->at_end();
+}
+
+Xapian::termcount
+InMemoryOverlayTermList::positionlist_count() const
+{
+    return tl->positionlist_count();
+}
+
+Xapian::PositionIterator
+InMemoryOverlayTermList::positionlist_begin() const
+{
+    return tl->positionlist_begin();
+}
+
+////////////////////
+// All terms list //
+////////////////////
+
+InMemoryOverlayAllTermsList::InMemoryOverlayAllTermsList(
+	const InMemoryOverlayDatabase * db_,
+	TermList * base_tl_, TermList * delta_tl_)
+    : db(db_), base_tl(base_tl_), delta_tl(delta_tl_),
+      termfreq(0), collfreq(0), started(false)
+{
+}
+
+InMemoryOverlayAllTermsList::~InMemoryOverlayAllTermsList()
+{
+    delete base_tl;
+    delete delta_tl;
+}
+
+void
+InMemoryOverlayAllTermsList::update(bool skip)
+{
+    while (true) {
+	if (skip) {
+	    if (base_tl && base_tl->get_termname() == current_term)
+		(void)base_tl->next();
+	    if (delta_tl && delta_tl->get_termname() == current_term)
+		(void)delta_tl->next();
+	}
+	if (base_tl && base_tl->at_end()) {
+	    delete base_tl;
+	    base_tl = NULL;
+	}
+	if (delta_tl && delta_tl->at_end()) {
+	    delete delta_tl;
+	    delta_tl = NULL;
+	}
+	if (!base_tl && !delta_tl) {
+	    current_term.resize(0);
+	    return;
+	}
+
+	if (!base_tl) {
+	    current_term = delta_tl->get_termname();
+	} else if (!delta_tl) {
+	    current_term = base_tl->get_termname();
+	} else {
+	    current_term = min(base_tl->get_termname(),
+			       delta_tl->get_termname());
+	}
+
+	termfreq = 0;
+	collfreq = 0;
+	if (base_tl && base_tl->get_termname() == current_term) {
+	    termfreq = base_tl->get_termfreq();
+	    collfreq = base_tl->get_collection_freq();
+	    Xapian::doccount masked_tf = 0;
+	    Xapian::termcount masked_cf = 0;
+	    db->get_masked_freqs(current_term, masked_tf, masked_cf);
+	    termfreq -= masked_tf;
+	    collfreq -= masked_cf;
+	}
+	if (delta_tl && delta_tl->get_termname() == current_term) {
+	    termfreq += delta_tl->get_termfreq();
+	    collfreq += delta_tl->get_collection_freq();
+	}
+	// Skip terms which only index hidden documents.
+	if (termfreq) return;
+	skip = true;
+    }
+}
+
+string
+InMemoryOverlayAllTermsList::get_termname() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return current_term;
+}
+
+Xapian::doccount
+InMemoryOverlayAllTermsList::get_termfreq() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return termfreq;
+}
+
+Xapian::termcount
+InMemoryOverlayAllTermsList::get_collection_freq() const
+{
+    Assert(started);
+    Assert(!at_end());
+    return collfreq;
+}
+
+TermList *
+InMemoryOverlayAllTermsList::next()
+{
+    if (!started) {
+	started = true;
+	if (base_tl) (void)base_tl->next();
+	if (delta_tl) (void)delta_tl->next();
+	update(false);
+    } else {
+	Assert(!at_end());
+	update(true);
+    }
+    return NULL;
+}
+
+TermList *
+InMemoryOverlayAllTermsList::skip_to(const string & term)
+{
+    if (started) {
+	// Don't skip backwards.
+	if (at_end() || term <= current_term) return NULL;
+    }
+    started = true;
+    if (base_tl) (void)base_tl->skip_to(term);
+    if (delta_tl) (void)delta_tl->skip_to(term);
+    update(false);
+    return NULL;
+}
+
+bool
+InMemoryOverlayAllTermsList::at_end() const
+{
+    return started && !base_tl && !delta_tl;
+}
+
+//////////////
+// Document //
+//////////////
+
+string
+InMemoryOverlayDocument::do_get_value(Xapian::valueno slot) const
+{
+    return doc.get_value(slot);
+}
+
+void
+InMemoryOverlayDocument::do_get_all_values(map<Xapian::valueno, string> & values_) const
+{
+    values_.clear();
+    Xapian::ValueIterator v;
+    for (v = doc.values_begin(); v != doc.values_end(); ++v) {
+	values_.insert(make_pair(v.get_valueno(), *v));
+    }
+}
+
+string
+InMemoryOverlayDocument::do_get_data() const
+{
+    return doc.get_data();
+}
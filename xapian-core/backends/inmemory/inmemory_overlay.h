@@ -0,0 +1,345 @@
+/** @file inmemory_overlay.h
+ * @brief Read-only database with changed documents overlaid from memory.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_INMEMORY_OVERLAY_H
+#define XAPIAN_INCLUDED_INMEMORY_OVERLAY_H
+
+#include "api/leafpostlist.h"
+#include "api/termlist.h"
+#include "backends/alltermslist.h"
+#include "backends/database.h"
+#include "backends/document.h"
+
+#include "noreturn.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** A read-only database with some documents overlaid from memory.
+ *
+ *  This is used for WritableDatabase::get_snapshot().  The "base" database is
+ *  the last committed revision, and the "delta" database is a compact
+ *  in-memory copy of the documents which have been added, replaced or
+ *  deleted since.  All documents in the base database with a docid which has
+ *  changed are hidden, and those which still exist are supplied by the delta
+ *  database instead, so the two never both have a document with the same
+ *  docid.
+ */
+class InMemoryOverlayDatabase : public Xapian::Database::Internal {
+    /// Don't allow assignment.
+    void operator=(const InMemoryOverlayDatabase &);
+
+    /// Don't allow copying.
+    InMemoryOverlayDatabase(const InMemoryOverlayDatabase &);
+
+    /// The last committed revision, or NULL if we've been closed.
+    Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> base;
+
+    /// The changed documents, or NULL if we've been closed.
+    Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> delta;
+
+    /// The changed docids, in ascending order.
+    std::vector<Xapian::docid> masked;
+
+    /** The termfreq and collection freq of each term in the hidden documents.
+     *
+     *  These need to be subtracted from the statistics of the base database.
+     */
+    std::map<std::string,
+	     std::pair<Xapian::doccount, Xapian::termcount> > masked_freqs;
+
+    /// The number of hidden documents with a value in each slot.
+    std::map<Xapian::valueno, Xapian::doccount> masked_value_freqs;
+
+    Xapian::doccount doccount;
+
+    Xapian::docid lastdocid;
+
+    totlen_t total_length;
+
+    /// The number of documents in the base database which aren't hidden.
+    Xapian::doccount base_doccount;
+
+    InMemoryOverlayDatabase()
+	: doccount(0), lastdocid(0), total_length(0), base_doccount(0) { }
+
+    /// Return the database which has the current version of document @a did.
+    Xapian::Database::Internal * get_db_for(Xapian::docid did) const;
+
+  public:
+    /** Open a snapshot of @a source.
+     *
+     *  @param base_	The last committed revision of @a source.
+     *  @param source	The database to take the changed documents from.
+     *  @param changed	The docids which have changed in @a source since
+     *			@a base_.
+     */
+    static InMemoryOverlayDatabase *
+    open(Xapian::Database::Internal * base_,
+	 const Xapian::Database & source,
+	 const std::set<Xapian::docid> & changed);
+
+    ~InMemoryOverlayDatabase();
+
+    bool is_closed() const { return base.get() == NULL; }
+
+    XAPIAN_NORETURN(static void throw_database_closed());
+
+    /// Return true if document @a did in the base database is hidden.
+    bool is_masked(Xapian::docid did) const;
+
+    /** Get the termfreq and collection freq of @a term in hidden documents.
+     *
+     *  The values are added to @a termfreq and @a collfreq.
+     */
+    void get_masked_freqs(const std::string & term,
+			  Xapian::doccount & termfreq,
+			  Xapian::termcount & collfreq) const;
+
+    /** Implementation of virtual methods @{ */
+    bool reopen();
+    void close();
+    Xapian::doccount get_doccount() const;
+    Xapian::docid get_lastdocid() const;
+    totlen_t get_total_length() const;
+    Xapian::doclength get_avlength() const;
+    Xapian::termcount get_doclength(Xapian::docid did) const;
+    void get_freqs(const string & term,
+		   Xapian::doccount * termfreq_ptr,
+		   Xapian::termcount * collfreq_ptr) const;
+    Xapian::doccount get_value_freq(Xapian::valueno slot) const;
+    std::string get_value_lower_bound(Xapian::valueno slot) const;
+    std::string get_value_upper_bound(Xapian::valueno slot) const;
+    Xapian::termcount get_doclength_lower_bound() const;
+    Xapian::termcount get_doclength_upper_bound() const;
+    Xapian::termcount get_wdf_upper_bound(const std::string & term) const;
+    bool term_exists(const string & tname) const;
+    bool has_positions() const;
+    LeafPostList * open_post_list(const string & tname) const;
+    TermList * open_term_list(Xapian::docid did) const;
+    TermList * open_allterms(const string & prefix) const;
+    PositionList * open_position_list(Xapian::docid did,
+				      const string & tname) const;
+    Xapian::Document::Internal * open_document(Xapian::docid did,
+					       bool lazy) const;
+    TermList * open_spelling_termlist(const string & word) const;
+    TermList * open_spelling_wordlist() const;
+    Xapian::doccount get_spelling_frequency(const string & word) const;
+    TermList * open_synonym_termlist(const string & term) const;
+    TermList * open_synonym_keylist(const string & prefix) const;
+    std::string get_metadata(const std::string & key) const;
+    TermList * open_metadata_keylist(const std::string & prefix) const;
+    /** @} */
+};
+
+/** A postlist merging the base and delta postlists for a term.
+ *
+ *  Postings for hidden documents are skipped in the base postlist.
+ */
+class InMemoryOverlayPostList : public LeafPostList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryOverlayPostList &);
+
+    /// Don't allow copying.
+    InMemoryOverlayPostList(const InMemoryOverlayPostList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryOverlayDatabase> db;
+
+    /// The postlist from the base database, or NULL once it's at_end().
+    LeafPostList * base_pl;
+
+    /// The postlist from the delta database, or NULL once it's at_end().
+    LeafPostList * delta_pl;
+
+    /// The postlist positioned on the current document.
+    LeafPostList * current;
+
+    Xapian::doccount termfreq;
+
+    bool started;
+
+    /// Move base_pl past hidden documents, and set current.
+    void update();
+
+  public:
+    InMemoryOverlayPostList(const InMemoryOverlayDatabase * db_,
+			    const std::string & term_,
+			    LeafPostList * base_pl_,
+			    LeafPostList * delta_pl_,
+			    Xapian::doccount termfreq_);
+
+    ~InMemoryOverlayPostList();
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_wdf() const;
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    bool at_end() const;
+
+    std::string get_description() const;
+};
+
+/** A termlist for a document in an InMemoryOverlayDatabase.
+ *
+ *  This wraps the termlist from the base or delta database so that the term
+ *  statistics reported are those of the whole snapshot.
+ */
+class InMemoryOverlayTermList : public TermList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryOverlayTermList &);
+
+    /// Don't allow copying.
+    InMemoryOverlayTermList(const InMemoryOverlayTermList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryOverlayDatabase> db;
+
+    /// The termlist we're wrapping.
+    TermList * tl;
+
+    /// The length of the document.
+    Xapian::termcount doclen;
+
+  public:
+    InMemoryOverlayTermList(const InMemoryOverlayDatabase * db_,
+			    TermList * tl_, Xapian::termcount doclen_)
+	: db(db_), tl(tl_), doclen(doclen_) { }
+
+    ~InMemoryOverlayTermList();
+
+    Xapian::termcount get_approx_size() const;
+
+    void accumulate_stats(Xapian::Internal::ExpandStats & stats) const;
+
+    std::string get_termname() const;
+
+    Xapian::termcount get_wdf() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::termcount get_collection_freq() const;
+
+    TermList * next();
+
+    TermList * skip_to(const std::string & term);
+
+    bool at_end() const;
+
+    Xapian::termcount positionlist_count() const;
+
+    Xapian::PositionIterator positionlist_begin() const;
+};
+
+/** An alltermslist merging the base and delta alltermslists.
+ *
+ *  Terms which only index hidden documents are skipped.
+ */
+class InMemoryOverlayAllTermsList : public AllTermsList {
+    /// Don't allow assignment.
+    void operator=(const InMemoryOverlayAllTermsList &);
+
+    /// Don't allow copying.
+    InMemoryOverlayAllTermsList(const InMemoryOverlayAllTermsList &);
+
+    Xapian::Internal::intrusive_ptr<const InMemoryOverlayDatabase> db;
+
+    /// The alltermslist from the base database, or NULL once it's at_end().
+    TermList * base_tl;
+
+    /// The alltermslist from the delta database, or NULL once it's at_end().
+    TermList * delta_tl;
+
+    std::string current_term;
+
+    Xapian::doccount termfreq;
+
+    Xapian::termcount collfreq;
+
+    bool started;
+
+    /** Find the next term which isn't only in hidden documents.
+     *
+     *  @param skip	Advance past current_term first.
+     */
+    void update(bool skip);
+
+  public:
+    InMemoryOverlayAllTermsList(const InMemoryOverlayDatabase * db_,
+				TermList * base_tl_, TermList * delta_tl_);
+
+    ~InMemoryOverlayAllTermsList();
+
+    std::string get_termname() const;
+
+    Xapian::doccount get_termfreq() const;
+
+    Xapian::termcount get_collection_freq() const;
+
+    TermList * next();
+
+    TermList * skip_to(const std::string & term);
+
+    bool at_end() const;
+};
+
+/** A document in an InMemoryOverlayDatabase.
+ *
+ *  The data and values come from the document in the base or delta database,
+ *  but the terms are read via the InMemoryOverlayDatabase so that the term
+ *  statistics are those of the whole snapshot.
+ */
+class InMemoryOverlayDocument : public Xapian::Document::Internal {
+    /// Don't allow assignment.
+    void operator=(const InMemoryOverlayDocument &);
+
+    /// Don't allow copying.
+    InMemoryOverlayDocument(const InMemoryOverlayDocument &);
+
+    /// The document in the base or delta database.
+    Xapian::Document doc;
+
+  public:
+    InMemoryOverlayDocument(const InMemoryOverlayDatabase * db,
+			    Xapian::docid did_,
+			    Xapian::Document::Internal * doc_)
+	: Xapian::Document::Internal(db, did_), doc(doc_) { }
+
+    /** Implementation of virtual methods @{ */
+    std::string do_get_value(Xapian::valueno slot) const;
+    void do_get_all_values(std::map<Xapian::valueno, std::string> & values_) const;
+    std::string do_get_data() const;
+    /** @} */
+};
+
+#endif // XAPIAN_INCLUDED_INMEMORY_OVERLAY_H
@@ -0,0 +1,84 @@
+/** @file iostatistics.cc
+ * @brief Counters of the I/O done by a database.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "iostatistics.h"
+
+#include "str.h"
+
+using namespace std;
+
+void
+IOStatistics::add(const IOStatistics & o)
+{
+    map<string, TableIOStatistics>::const_iterator i;
+    for (i = o.tables.begin(); i != o.tables.end(); ++i) {
+	tables[i->first] += i->second;
+    }
+    postlist_chunk_reads += o.postlist_chunk_reads;
+    value_chunk_reads += o.value_chunk_reads;
+    flushes += o.flushes;
+    flush_time += o.flush_time;
+    commits += o.commits;
+    commit_time += o.commit_time;
+    if (o.max_commit_time > max_commit_time)
+	max_commit_time = o.max_commit_time;
+}
+
+string
+IOStatistics::get_json() const
+{
+    string result = "{\"tables\":{";
+    map<string, TableIOStatistics>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	if (i != tables.begin()) result += ',';
+	// Table names are plain identifiers, so don't need escaping.
+	result += '"';
+	result += i->first;
+	result += "\":{\"block_reads\":";
+	result += str(i->second.block_reads);
+	result += ",\"bytes_read\":";
+	result += str(i->second.bytes_read);
+	result += ",\"seeks\":";
+	result += str(i->second.seeks);
+	result += ",\"block_writes\":";
+	result += str(i->second.block_writes);
+	result += ",\"bytes_written\":";
+	result += str(i->second.bytes_written);
+	result += '}';
+    }
+    result += "},\"postlist_chunk_reads\":";
+    result += str(postlist_chunk_reads);
+    result += ",\"value_chunk_reads\":";
+    result += str(value_chunk_reads);
+    result += ",\"flushes\":";
+    result += str(flushes);
+    result += ",\"flush_time\":";
+    result += str(flush_time);
+    result += ",\"commits\":";
+    result += str(commits);
+    result += ",\"commit_time\":";
+    result += str(commit_time);
+    result += ",\"max_commit_time\":";
+    result += str(max_commit_time);
+    result += '}';
+    return result;
+}
@@ -0,0 +1,130 @@
+/** @file iostatistics.h
+ * @brief Counters of the I/O done by a database.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_IOSTATISTICS_H
+#define XAPIAN_INCLUDED_IOSTATISTICS_H
+
+#include <map>
+#include <string>
+
+#include "internaltypes.h"
+
+/** Counters of the I/O done by a B-tree table.
+ *
+ *  These are always collected, so updating them needs to stay cheap.
+ */
+struct TableIOStatistics {
+    /// The number of blocks read from disk.
+    uint8 block_reads;
+
+    /// The number of bytes read from disk.
+    uint8 bytes_read;
+
+    /// The number of times the B-tree was searched for a key.
+    uint8 seeks;
+
+    /// The number of blocks written to disk.
+    uint8 block_writes;
+
+    /// The number of bytes written to disk.
+    uint8 bytes_written;
+
+    TableIOStatistics()
+	: block_reads(0), bytes_read(0), seeks(0),
+	  block_writes(0), bytes_written(0) { }
+
+    void reset() {
+	block_reads = bytes_read = seeks = block_writes = bytes_written = 0;
+    }
+
+    TableIOStatistics & operator+=(const TableIOStatistics & o) {
+	block_reads += o.block_reads;
+	bytes_read += o.bytes_read;
+	seeks += o.seeks;
+	block_writes += o.block_writes;
+	bytes_written += o.bytes_written;
+	return *this;
+    }
+};
+
+/// Counters of the I/O done by a database, for Database::get_io_statistics().
+struct IOStatistics {
+    /// Counters for each table, keyed by the table's name.
+    std::map<std::string, TableIOStatistics> tables;
+
+    /// The number of chunks of postings read.
+    uint8 postlist_chunk_reads;
+
+    /// The number of chunks of values read.
+    uint8 value_chunk_reads;
+
+    /// The number of times buffered changes were flushed to the tables.
+    uint8 flushes;
+
+    /// The total time in seconds taken to flush changes.
+    double flush_time;
+
+    /// The number of times changes were committed to disk.
+    uint8 commits;
+
+    /// The total time in seconds taken to commit changes.
+    double commit_time;
+
+    /// The longest time in seconds taken by a single commit.
+    double max_commit_time;
+
+    IOStatistics()
+	: postlist_chunk_reads(0), value_chunk_reads(0),
+	  flushes(0), flush_time(0.0),
+	  commits(0), commit_time(0.0), max_commit_time(0.0) { }
+
+    void reset() {
+	tables.clear();
+	postlist_chunk_reads = value_chunk_reads = 0;
+	flushes = commits = 0;
+	flush_time = commit_time = max_commit_time = 0.0;
+    }
+
+    /// Add the counters from table @a name.
+    void add_table(const std::string & name, const TableIOStatistics & t) {
+	tables[name] += t;
+    }
+
+    /// Add the counters from @a o.
+    void add(const IOStatistics & o);
+
+    /// Record a flush which took @a elapsed seconds.
+    void flushed(double elapsed) {
+	++flushes;
+	flush_time += elapsed;
+    }
+
+    /// Record a commit which took @a elapsed seconds.
+    void committed(double elapsed) {
+	++commits;
+	commit_time += elapsed;
+	if (elapsed > max_commit_time) max_commit_time = elapsed;
+    }
+
+    /// Return the counters as a JSON object.
+    std::string get_json() const;
+};
+
+#endif // XAPIAN_INCLUDED_IOSTATISTICS_H
@@ -0,0 +1,72 @@
+/** @file memoryusage.cc
+ * @brief Estimates of the memory held by a database.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "memoryusage.h"
+
+#include "str.h"
+
+using namespace std;
+
+void
+MemoryUsage::add(const MemoryUsage & o)
+{
+    map<string, size_t>::const_iterator i;
+    for (i = o.tables.begin(); i != o.tables.end(); ++i) {
+	tables[i->first] += i->second;
+    }
+    value_stats += o.value_stats;
+    pending_changes += o.pending_changes;
+}
+
+size_t
+MemoryUsage::total() const
+{
+    size_t result = value_stats + pending_changes;
+    map<string, size_t>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	result += i->second;
+    }
+    return result;
+}
+
+string
+MemoryUsage::get_json() const
+{
+    string result = "{\"total\":";
+    result += str(total());
+    result += ",\"tables\":{";
+    map<string, size_t>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	if (i != tables.begin()) result += ',';
+	// Table names are plain identifiers, so don't need escaping.
+	result += '"';
+	result += i->first;
+	result += "\":";
+	result += str(i->second);
+    }
+    result += "},\"value_stats\":";
+    result += str(value_stats);
+    result += ",\"pending_changes\":";
+    result += str(pending_changes);
+    result += '}';
+    return result;
+}
@@ -0,0 +1,88 @@
+/** @file memoryusage.h
+ * @brief Estimates of the memory held by a database.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MEMORYUSAGE_H
+#define XAPIAN_INCLUDED_MEMORYUSAGE_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include "xapian/intrusive_ptr.h"
+
+/** Estimate of the bytes each entry in a std::map uses, besides its key and
+ *  value.
+ *
+ *  A node in the usual red-black tree implementation holds a colour and three
+ *  pointers.
+ */
+const size_t MAP_ENTRY_OVERHEAD = 4 * sizeof(void*);
+
+/// Estimate of the bytes used by a std::string holding @a len bytes.
+inline size_t
+string_memory_usage(size_t len)
+{
+    return sizeof(std::string) + len;
+}
+
+/** A count of the cursors open on a B-tree table.
+ *
+ *  This is reference counted since a cursor may be destroyed after its table.
+ */
+struct CursorCount : public Xapian::Internal::intrusive_base {
+    size_t count;
+
+    CursorCount() : count(0) { }
+};
+
+/** Estimates of the memory held by a database, for
+ *  Database::get_memory_usage().
+ *
+ *  These are estimates from bookkeeping rather than exact counts, as tracking
+ *  every allocation would be too costly.
+ */
+struct MemoryUsage {
+    /// Bytes of block buffers held by each table, keyed by the table's name.
+    std::map<std::string, size_t> tables;
+
+    /// Bytes held by cached value statistics.
+    size_t value_stats;
+
+    /// Bytes held by buffered changes which haven't been flushed yet.
+    size_t pending_changes;
+
+    MemoryUsage() : value_stats(0), pending_changes(0) { }
+
+    /// Add the usage of table @a name.
+    void add_table(const std::string & name, size_t bytes) {
+	tables[name] += bytes;
+    }
+
+    /// Add the usage from @a o.
+    void add(const MemoryUsage & o);
+
+    /// Return the total of all the usage.
+    size_t total() const;
+
+    /// Return the usage as a JSON object.
+    std::string get_json() const;
+};
+
+#endif // XAPIAN_INCLUDED_MEMORYUSAGE_H
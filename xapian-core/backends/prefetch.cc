@@ -0,0 +1,211 @@
+/** @file prefetch.cc
+ * @brief Read parts of a database into the page cache.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "prefetch.h"
+
+#include "xapian/error.h"
+
+#include "io_utils.h"
+#include "pack.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// The most bytes to read with a single read.
+const size_t MAX_READ_SIZE = 1024 * 1024;
+
+void
+prefetch_read(int fd, unsigned block_size, vector<uint4> & blocks,
+	      PrefetchBudget & budget, string * data)
+{
+    sort(blocks.begin(), blocks.end());
+    blocks.erase(unique(blocks.begin(), blocks.end()), blocks.end());
+    size_t max_blocks = budget.get_remaining() / block_size;
+    if (blocks.size() > max_blocks) blocks.resize(max_blocks);
+    if (blocks.empty()) return;
+
+    size_t max_run = max(MAX_READ_SIZE / block_size, size_t(1));
+    string buf;
+    if (data) {
+	data->resize(blocks.size() * block_size);
+    } else {
+	buf.resize(min(blocks.size(), max_run) * block_size);
+    }
+    size_t i = 0;
+    while (i != blocks.size()) {
+	size_t j = i + 1;
+	while (j != blocks.size() && j - i < max_run &&
+	       blocks[j] == blocks[j - 1] + 1) {
+	    ++j;
+	}
+	char * p = data ? &(*data)[i * block_size] : &buf[0];
+	io_read_blocks(fd, p, block_size, blocks[i], j - i);
+	budget.spend((j - i) * block_size);
+	i = j;
+    }
+}
+
+/// Compare a key with the lowest key which can be in a leaf block.
+struct LeafKeyLess {
+    bool operator()(const string & key,
+		    const pair<string, uint4> & leaf) const {
+	return key < leaf.first;
+    }
+};
+
+/** Find the leaf blocks which can contain keys in the range [lo, hi).
+ *
+ *  An empty @a hi means the range has no upper end.
+ */
+static void
+prefetch_leaves_in_range(const PrefetchLeaves & leaves,
+			 const string & lo, const string & hi,
+			 vector<uint4> & blocks)
+{
+    // Start from the last leaf whose lowest key is <= lo.
+    PrefetchLeaves::const_iterator i;
+    i = upper_bound(leaves.begin(), leaves.end(), lo, LeafKeyLess());
+    if (i != leaves.begin()) --i;
+    while (i != leaves.end() && (hi.empty() || i->first < hi)) {
+	blocks.push_back(i->second);
+	++i;
+    }
+}
+
+/** Return the lowest key greater than every key starting with @a prefix.
+ *
+ *  If there isn't one, an empty string is returned.
+ */
+static string
+prefix_successor(string prefix)
+{
+    while (!prefix.empty()) {
+	unsigned char ch = prefix[prefix.size() - 1];
+	if (ch != 0xff) {
+	    prefix[prefix.size() - 1] = char(ch + 1);
+	    break;
+	}
+	prefix.resize(prefix.size() - 1);
+    }
+    return prefix;
+}
+
+void
+prefetch_leaves_with_prefix(const PrefetchLeaves & leaves,
+			    const string & prefix,
+			    vector<uint4> & blocks)
+{
+    prefetch_leaves_in_range(leaves, prefix, prefix_successor(prefix), blocks);
+}
+
+/// Order terms by decreasing number of leaf blocks, then by term.
+struct MoreLeaves {
+    bool operator()(const pair<string, Xapian::termcount> & a,
+		    const pair<string, Xapian::termcount> & b) const {
+	if (a.second != b.second) return a.second > b.second;
+	return a.first < b.first;
+    }
+};
+
+void
+prefetch_longest_postlists(const PrefetchLeaves & leaves,
+			   Xapian::termcount max_terms,
+			   vector<uint4> & blocks)
+{
+    if (max_terms == 0) return;
+
+    // The key of each chunk of a postlist after the first is the term encoded
+    // by pack_string_preserving_sort() followed by the first docid in the
+    // chunk.  The keys in the internal levels are truncated to the shortest
+    // which separates them from the previous key, so if a leaf block starts
+    // inside a term's postlist its key will still have the whole term and at
+    // least one byte of the docid.  So we count the leaf blocks which start
+    // inside each postlist.
+    map<string, Xapian::termcount> counts;
+    PrefetchLeaves::const_iterator i;
+    for (i = leaves.begin(); i != leaves.end(); ++i) {
+	const string & key = i->first;
+	// Skip the keys of doclen, value and metadata entries, which start
+	// with a zero byte.  A term which starts with a zero byte has it
+	// followed by \xff.
+	if (key.empty() || (key[0] == '\0' && (key.size() == 1 ||
+					       key[1] != '\xff'))) {
+	    continue;
+	}
+	const char * p = key.data();
+	const char * end = p + key.size();
+	string term;
+	(void)unpack_string_preserving_sort(&p, end, term);
+	// If there's nothing left, the key was truncated inside the term.
+	if (p == end) continue;
+	++counts[term];
+    }
+
+    vector<pair<string, Xapian::termcount> > terms(counts.begin(),
+						   counts.end());
+    if (terms.size() > max_terms) {
+	partial_sort(terms.begin(), terms.begin() + max_terms, terms.end(),
+		     MoreLeaves());
+	terms.resize(max_terms);
+    }
+
+    vector<pair<string, Xapian::termcount> >::const_iterator t;
+    for (t = terms.begin(); t != terms.end(); ++t) {
+	// The first chunk's key is the term encoded without a terminator.
+	string lo;
+	pack_string_preserving_sort(lo, t->first, true);
+	string prefix;
+	pack_string_preserving_sort(prefix, t->first);
+	prefetch_leaves_in_range(leaves, lo, prefix_successor(prefix), blocks);
+    }
+}
+
+void
+parse_prefetch_list(const string & list, map<string, vector<uint4> > & blocks)
+{
+    string::size_type i = 0;
+    while (i < list.size()) {
+	string::size_type eol = list.find('\n', i);
+	if (eol == string::npos) eol = list.size();
+	string line(list, i, eol - i);
+	i = eol + 1;
+	if (line.empty() || line[0] == '#') continue;
+
+	string::size_type space = line.find(' ');
+	bool ok = (space != string::npos && space != 0 &&
+		   space + 1 != line.size());
+	uint4 n = 0;
+	for (string::size_type j = space + 1; ok && j != line.size(); ++j) {
+	    unsigned char ch = line[j];
+	    if (ch < '0' || ch > '9' || n > (uint4(-1) - 9) / 10) {
+		ok = false;
+	    } else {
+		n = n * 10 + (ch - '0');
+	    }
+	}
+	if (!ok)
+	    throw Xapian::InvalidArgumentError("Bad line in prefetch list: " +
+					       line);
+	blocks[line.substr(0, space)].push_back(n);
+    }
+}
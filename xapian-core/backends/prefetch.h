@@ -0,0 +1,111 @@
+/** @file prefetch.h
+ * @brief Read parts of a database into the page cache.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PREFETCH_H
+#define XAPIAN_INCLUDED_PREFETCH_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "internaltypes.h"
+#include "xapian/types.h"
+
+/// The number of bytes prefetched so far, and the most we're allowed to.
+class PrefetchBudget {
+    size_t max_bytes;
+
+    size_t used;
+
+  public:
+    explicit PrefetchBudget(size_t max_bytes_)
+	: max_bytes(max_bytes_), used(0) { }
+
+    /// Return the number of bytes which can still be read.
+    size_t get_remaining() const {
+	return used < max_bytes ? max_bytes - used : 0;
+    }
+
+    /// Return the number of bytes read so far.
+    size_t get_used() const { return used; }
+
+    /// Record that @a bytes have been read.
+    void spend(size_t bytes) { used += bytes; }
+};
+
+/** The leaf blocks of a B-tree table, as found from its internal levels.
+ *
+ *  Each entry gives the lowest key which can be in a leaf block, and the
+ *  number of that block.  The entries are in ascending order of key.
+ */
+typedef std::vector<std::pair<std::string, uint4> > PrefetchLeaves;
+
+/** Read blocks from a table file into the page cache.
+ *
+ *  Each run of consecutive blocks is read with a single read.
+ *
+ *  @param fd		The file descriptor of the table file.
+ *  @param block_size	The block size of the table.
+ *  @param blocks	The numbers of the blocks to read.  On return, these
+ *			are sorted with duplicates removed, and blocks which
+ *			didn't fit in @a budget have been dropped.
+ *  @param budget	The budget to spend the bytes read from.
+ *  @param data		If not NULL, the contents of the blocks read are
+ *			stored here, in the order of @a blocks on return.
+ */
+void prefetch_read(int fd, unsigned block_size, std::vector<uint4> & blocks,
+		   PrefetchBudget & budget, std::string * data = NULL);
+
+/** Find the leaf blocks which can contain keys starting with @a prefix.
+ *
+ *  The block numbers found are appended to @a blocks.
+ */
+void prefetch_leaves_with_prefix(const PrefetchLeaves & leaves,
+				 const std::string & prefix,
+				 std::vector<uint4> & blocks);
+
+/** Find the leaf blocks holding the longest postlists in a postlist table.
+ *
+ *  The length of a term's postlist is estimated from the number of leaf
+ *  blocks it spans, which can be found from @a leaves without reading
+ *  anything more.  Terms with postlists shorter than a block aren't found,
+ *  but these are cheap to read when they're needed anyway.
+ *
+ *  @param leaves	The leaf blocks of the postlist table.
+ *  @param max_terms	The number of terms to find the postlists of.
+ *  @param blocks	The block numbers found are appended to this.
+ */
+void prefetch_longest_postlists(const PrefetchLeaves & leaves,
+				Xapian::termcount max_terms,
+				std::vector<uint4> & blocks);
+
+/** Parse a list of blocks to prefetch.
+ *
+ *  See Database::prefetch_blocks() for the format.
+ *
+ *  @param list		The list to parse.
+ *  @param blocks	The block numbers in the list are appended to this,
+ *			keyed by table name.
+ */
+void parse_prefetch_list(const std::string & list,
+			 std::map<std::string, std::vector<uint4> > & blocks);
+
+#endif // XAPIAN_INCLUDED_PREFETCH_H
@@ -572,7 +572,8 @@ RemoteDatabase::set_query(const Xapian::Query& query,
 			 int percent_cutoff, double weight_cutoff,
 			 const Xapian::Weight *wtscheme,
 			 const Xapian::RSet &omrset,
-			 const vector<Xapian::MatchSpy *> & matchspies)
+			 const vector<Xapian::MatchSpy *> & matchspies,
+			 bool profiling)
 {
     string tmp = query.serialise();
     string message = encode_length(tmp.size());
@@ -589,6 +590,7 @@ RemoteDatabase::set_query(const Xapian::Query& query,
     message += serialise_double(time_limit);
     message += char(percent_cutoff);
     message += serialise_double(weight_cutoff);
+    message += char('0' + profiling);
 
     tmp = wtscheme->name();
     message += encode_length(tmp.size());
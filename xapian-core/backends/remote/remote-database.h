@@ -145,6 +145,7 @@ class RemoteDatabase : public Xapian::Database::Internal {
      * @param wtscheme			Weighting scheme.
      * @param omrset			The rset.
      * @param matchspies                The matchspies to use.  NULL if none.
+     * @param profiling			Should profiling counters be collected?
      */
     void set_query(const Xapian::Query& query,
 		   Xapian::termcount qlen,
@@ -158,7 +159,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 		   int percent_cutoff, double weight_cutoff,
 		   const Xapian::Weight *wtscheme,
 		   const Xapian::RSet &omrset,
-		   const vector<Xapian::MatchSpy *> & matchspies);
+		   const vector<Xapian::MatchSpy *> & matchspies,
+		   bool profiling);
 
     /** Get the stats from the remote server.
      *
@@ -3,7 +3,17 @@ EXTRA_DIST +=\
 	bin/Makefile
 
 bin_PROGRAMS +=\
-	bin/xapian-delve
+	bin/xapian-delve\
+	bin/xapian-replay\
+	bin/xapian-trace\
+	bin/xapian-warm
+
+if !MAINTAINER_NO_DOCS
+dist_man_MANS +=\
+	bin/xapian-replay.1\
+	bin/xapian-trace.1\
+	bin/xapian-warm.1
+endif
 
 if BUILD_BACKEND_BRASS_OR_CHERT
 bin_PROGRAMS +=\
@@ -52,6 +62,9 @@ bin_xapian_inspect_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 bin_xapian_progsrv_SOURCES = bin/xapian-progsrv.cc
 bin_xapian_progsrv_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
+bin_xapian_replay_SOURCES = bin/xapian-replay.cc
+bin_xapian_replay_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
+
 bin_xapian_replicate_SOURCES = bin/xapian-replicate.cc
 bin_xapian_replicate_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
@@ -61,6 +74,12 @@ bin_xapian_replicate_server_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 bin_xapian_tcpsrv_SOURCES = bin/xapian-tcpsrv.cc
 bin_xapian_tcpsrv_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
 
+bin_xapian_trace_SOURCES = bin/xapian-trace.cc
+bin_xapian_trace_LDADD = $(ldflags) libgetopt.la
+
+bin_xapian_warm_SOURCES = bin/xapian-warm.cc
+bin_xapian_warm_LDADD = $(ldflags) libgetopt.la $(libxapian_la)
+
 if DOCUMENTATION_RULES
 bin/xapian-check.1: bin/xapian-check$(EXEEXT) makemanpage
 	./makemanpage bin/xapian-check $(srcdir)/bin/xapian-check.cc bin/xapian-check.1
@@ -77,6 +96,9 @@ bin/xapian-inspect.1: bin/xapian-inspect$(EXEEXT) makemanpage
 bin/xapian-progsrv.1: bin/xapian-progsrv$(EXEEXT) makemanpage
 	./makemanpage bin/xapian-progsrv $(srcdir)/bin/xapian-progsrv.cc bin/xapian-progsrv.1
 
+bin/xapian-replay.1: bin/xapian-replay$(EXEEXT) makemanpage
+	./makemanpage bin/xapian-replay $(srcdir)/bin/xapian-replay.cc bin/xapian-replay.1
+
 bin/xapian-replicate.1: bin/xapian-replicate$(EXEEXT) makemanpage
 	./makemanpage bin/xapian-replicate $(srcdir)/bin/xapian-replicate.cc bin/xapian-replicate.1
 
@@ -85,4 +107,10 @@ bin/xapian-replicate-server.1: bin/xapian-replicate-server$(EXEEXT) makemanpage
 
 bin/xapian-tcpsrv.1: bin/xapian-tcpsrv$(EXEEXT) makemanpage
 	./makemanpage bin/xapian-tcpsrv $(srcdir)/bin/xapian-tcpsrv.cc bin/xapian-tcpsrv.1
+
+bin/xapian-trace.1: bin/xapian-trace$(EXEEXT) makemanpage
+	./makemanpage bin/xapian-trace $(srcdir)/bin/xapian-trace.cc bin/xapian-trace.1
+
+bin/xapian-warm.1: bin/xapian-warm$(EXEEXT) makemanpage
+	./makemanpage bin/xapian-warm $(srcdir)/bin/xapian-warm.cc bin/xapian-warm.1
 endif
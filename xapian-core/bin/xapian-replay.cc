@@ -0,0 +1,502 @@
+/** @file xapian-replay.cc
+ * @brief Rerun queries recorded in a Xapian slow query log.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian.h>
+
+#include <cstdio> // For sprintf().
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gnu_getopt.h"
+
+using namespace std;
+
+#define PROG_NAME "xapian-replay"
+#define PROG_DESC "Rerun queries recorded in a Xapian slow query log"
+
+#define OPT_HELP 1
+#define OPT_VERSION 2
+
+static void show_usage() {
+    cout << "Usage: "PROG_NAME" [OPTIONS] LOGFILE DATABASE...\n\n"
+"Rerun the queries recorded in LOGFILE, which is written by a slow query log\n"
+"set with Enquire::set_slow_query_log(), against the DATABASE(s) given, and\n"
+"show the time taken by each phase of the match when logged and when rerun.\n"
+"The databases should be given in the same order as when the query was\n"
+"logged.\n\n"
+"Options:\n"
+"  -r, --record=N   only rerun the Nth record in LOGFILE (starting from 1)\n"
+"  -n, --repeat=N   rerun each query N times (default 1) and show the fastest\n"
+"  --help           display this help and exit\n"
+"  --version        output version information and exit" << endl;
+}
+
+/// A JSON object, mapping each key to the unparsed text of its value.
+typedef map<string, string> JSONObject;
+
+static void
+skip_whitespace(const char *& p, const char * end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+	++p;
+}
+
+/// Skip over the JSON value starting at @a p, returning false if invalid.
+static bool
+skip_value(const char *& p, const char * end)
+{
+    skip_whitespace(p, end);
+    if (p == end) return false;
+    if (*p == '"') {
+	while (++p != end) {
+	    if (*p == '\\') {
+		if (++p == end) return false;
+	    } else if (*p == '"') {
+		++p;
+		return true;
+	    }
+	}
+	return false;
+    }
+    if (*p == '{' || *p == '[') {
+	char close = (*p == '{') ? '}' : ']';
+	++p;
+	skip_whitespace(p, end);
+	if (p != end && *p == close) {
+	    ++p;
+	    return true;
+	}
+	while (true) {
+	    if (close == '}') {
+		if (!skip_value(p, end)) return false;
+		skip_whitespace(p, end);
+		if (p == end || *p != ':') return false;
+		++p;
+	    }
+	    if (!skip_value(p, end)) return false;
+	    skip_whitespace(p, end);
+	    if (p == end) return false;
+	    if (*p == close) {
+		++p;
+		return true;
+	    }
+	    if (*p != ',') return false;
+	    ++p;
+	}
+    }
+    const char * start = p;
+    while (p != end && *p != ',' && *p != '}' && *p != ']' &&
+	   *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+	++p;
+    return p != start;
+}
+
+/// Decode the JSON string @a s (including its quotes).
+static string
+decode_string(const string & s)
+{
+    string result;
+    if (s.size() < 2 || s[0] != '"') return result;
+    for (size_t i = 1; i < s.size() - 1; ++i) {
+	char ch = s[i];
+	if (ch != '\\' || i + 1 == s.size() - 1) {
+	    result += ch;
+	    continue;
+	}
+	switch (s[++i]) {
+	    case 'n': result += '\n'; break;
+	    case 't': result += '\t'; break;
+	    case 'r': result += '\r'; break;
+	    case 'b': result += '\b'; break;
+	    case 'f': result += '\f'; break;
+	    case 'u':
+		// The slow query log only escapes control characters this way.
+		if (i + 4 < s.size()) {
+		    result += char(strtoul(s.substr(i + 1, 4).c_str(), NULL, 16));
+		    i += 4;
+		}
+		break;
+	    default:
+		result += s[i];
+	}
+    }
+    return result;
+}
+
+/// Decode a string of hex digits, as used for binary data in the log.
+static string
+decode_hex(const string & s)
+{
+    string hex = decode_string(s);
+    string result;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+	result += char(strtoul(hex.substr(i, 2).c_str(), NULL, 16));
+    }
+    return result;
+}
+
+/// Parse the JSON object @a s into @a obj, returning false if invalid.
+static bool
+parse_object(const string & s, JSONObject & obj)
+{
+    const char * p = s.data();
+    const char * end = p + s.size();
+    skip_whitespace(p, end);
+    if (p == end || *p != '{') return false;
+    ++p;
+    skip_whitespace(p, end);
+    if (p != end && *p == '}') return true;
+    while (true) {
+	const char * start = p;
+	if (!skip_value(p, end)) return false;
+	string key = decode_string(string(start, p - start));
+	skip_whitespace(p, end);
+	if (p == end || *p != ':') return false;
+	++p;
+	skip_whitespace(p, end);
+	start = p;
+	if (!skip_value(p, end)) return false;
+	obj[key] = string(start, p - start);
+	skip_whitespace(p, end);
+	if (p == end) return false;
+	if (*p == '}') return true;
+	if (*p != ',') return false;
+	++p;
+	skip_whitespace(p, end);
+    }
+}
+
+/// Split the JSON array @a s into the unparsed text of its elements.
+static bool
+parse_array(const string & s, vector<string> & elements)
+{
+    const char * p = s.data();
+    const char * end = p + s.size();
+    skip_whitespace(p, end);
+    if (p == end || *p != '[') return false;
+    ++p;
+    skip_whitespace(p, end);
+    if (p != end && *p == ']') return true;
+    while (true) {
+	const char * start = p;
+	if (!skip_value(p, end)) return false;
+	elements.push_back(string(start, p - start));
+	skip_whitespace(p, end);
+	if (p == end) return false;
+	if (*p == ']') return true;
+	if (*p != ',') return false;
+	++p;
+	skip_whitespace(p, end);
+    }
+}
+
+static double
+get_number(const JSONObject & obj, const char * key)
+{
+    JSONObject::const_iterator i = obj.find(key);
+    if (i == obj.end()) return 0;
+    return strtod(i->second.c_str(), NULL);
+}
+
+static bool
+get_bool(const JSONObject & obj, const char * key)
+{
+    JSONObject::const_iterator i = obj.find(key);
+    return i != obj.end() && i->second == "true";
+}
+
+static string
+get_string(const JSONObject & obj, const char * key)
+{
+    JSONObject::const_iterator i = obj.find(key);
+    if (i == obj.end()) return string();
+    return decode_string(i->second);
+}
+
+/// The time taken by each phase of a match.
+struct Phases {
+    double total, stats, postlists, loop, remote;
+
+    Phases() : total(0), stats(0), postlists(0), loop(0), remote(0) { }
+
+    explicit Phases(const JSONObject & record) {
+	total = get_number(record, "time");
+	JSONObject phases;
+	JSONObject::const_iterator i = record.find("phases");
+	if (i != record.end()) parse_object(i->second, phases);
+	stats = get_number(phases, "stats");
+	postlists = get_number(phases, "postlists");
+	loop = get_number(phases, "loop");
+	remote = get_number(phases, "remote");
+    }
+};
+
+static void
+show_phases(const char * label, const Phases & p)
+{
+    char buf[256];
+    sprintf(buf, "  %-8s total %.6f  stats %.6f  postlists %.6f  "
+		 "loop %.6f  remote %.6f",
+	    label, p.total, p.stats, p.postlists, p.loop, p.remote);
+    cout << buf << '\n';
+}
+
+/// Keep the record of the last query run, to find the time of each phase.
+class CaptureLogger : public Xapian::SlowQueryLogger {
+  public:
+    string record;
+
+    void operator()(const string & record_) { record = record_; }
+};
+
+/// Rerun the query in @a record against @a db, returning false on error.
+static bool
+replay(const JSONObject & record, const Xapian::Database & db,
+       const vector<Xapian::Database> & shards, int repeat)
+{
+    const string & query_hex = record.find("query")->second;
+    if (query_hex == "null") {
+	cout << "  the query couldn't be serialised, so can't be rerun\n";
+	return false;
+    }
+    string query_serialised = decode_hex(query_hex);
+    Xapian::Query query = Xapian::Query::unserialise(query_serialised);
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query, Xapian::termcount(get_number(record, "qlen")));
+
+    Xapian::Registry registry;
+    string scheme = get_string(record, "weighting_scheme");
+    const Xapian::Weight * weight_type = registry.get_weighting_scheme(scheme);
+    if (!weight_type) {
+	cerr << "Weighting scheme '" << scheme << "' isn't registered" << endl;
+	return false;
+    }
+    JSONObject::const_iterator i = record.find("weighting_params");
+    if (i != record.end() && i->second == "null") {
+	cout << "  the weighting scheme couldn't be serialised, so the query "
+		"can't be rerun\n";
+	return false;
+    }
+    Xapian::Weight * weight =
+	weight_type->unserialise(i == record.end() ? string() :
+				 decode_hex(i->second));
+    enquire.set_weighting_scheme(*weight);
+    delete weight;
+
+    string order = get_string(record, "docid_order");
+    if (order == "descending") {
+	enquire.set_docid_order(Xapian::Enquire::DESCENDING);
+    } else if (order == "dont_care") {
+	enquire.set_docid_order(Xapian::Enquire::DONT_CARE);
+    }
+    enquire.set_cutoff(int(get_number(record, "percent_cutoff")),
+		       get_number(record, "weight_cutoff"));
+
+    Xapian::valueno sort_key = Xapian::valueno(get_number(record, "sort_key"));
+    bool forward = get_bool(record, "sort_value_forward");
+    string sort_by = get_string(record, "sort_by");
+    if (get_bool(record, "sorter")) {
+	cout << "  warning: the query was sorted with a KeyMaker, which can't "
+		"be replayed - sorting by relevance instead\n";
+    } else if (sort_by == "value") {
+	enquire.set_sort_by_value(sort_key, forward);
+    } else if (sort_by == "value_then_relevance") {
+	enquire.set_sort_by_value_then_relevance(sort_key, forward);
+    } else if (sort_by == "relevance_then_value") {
+	enquire.set_sort_by_relevance_then_value(sort_key, forward);
+    }
+
+    Xapian::doccount collapse_max =
+	Xapian::doccount(get_number(record, "collapse_max"));
+    if (collapse_max) {
+	enquire.set_collapse_key(Xapian::valueno(get_number(record, "collapse_key")),
+				 collapse_max);
+    }
+    enquire.set_time_limit(get_number(record, "time_limit"));
+
+    if (get_bool(record, "match_decider"))
+	cout << "  warning: the query used a MatchDecider, which can't be "
+		"replayed\n";
+    if (get_number(record, "matchspies") != 0)
+	cout << "  warning: the query used MatchSpy objects, which can't be "
+		"replayed\n";
+    if (get_bool(record, "reranker"))
+	cout << "  warning: the query used a Reranker, which can't be "
+		"replayed\n";
+
+    Xapian::RSet rset;
+    i = record.find("rset");
+    if (i != record.end()) {
+	vector<string> docids;
+	parse_array(i->second, docids);
+	for (size_t j = 0; j != docids.size(); ++j) {
+	    rset.add_document(Xapian::docid(strtoul(docids[j].c_str(), NULL, 10)));
+	}
+    }
+
+    // Check that the databases are the ones the query was logged against.
+    i = record.find("databases");
+    if (i != record.end()) {
+	vector<string> dbs;
+	parse_array(i->second, dbs);
+	if (dbs.size() != shards.size()) {
+	    cout << "  warning: query was logged against " << dbs.size()
+		 << " databases, but " << shards.size() << " given\n";
+	}
+	for (size_t j = 0; j != dbs.size() && j != shards.size(); ++j) {
+	    JSONObject info;
+	    parse_object(dbs[j], info);
+	    string uuid = get_string(info, "uuid");
+	    if (!uuid.empty() && uuid != shards[j].get_uuid()) {
+		cout << "  warning: database " << j + 1 << " has a different "
+			"UUID from when the query was logged\n";
+	    }
+	    Xapian::doccount doccount =
+		Xapian::doccount(get_number(info, "doccount"));
+	    if (doccount != shards[j].get_doccount()) {
+		cout << "  warning: database " << j + 1 << " had " << doccount
+		     << " documents (revision " << info["revision"]
+		     << ") when the query was logged, but now has "
+		     << shards[j].get_doccount() << "\n";
+	    }
+	}
+    }
+
+    CaptureLogger logger;
+    enquire.set_slow_query_log(0, &logger);
+    Xapian::doccount first = Xapian::doccount(get_number(record, "first"));
+    Xapian::doccount maxitems = Xapian::doccount(get_number(record, "maxitems"));
+    Xapian::doccount check_at_least =
+	Xapian::doccount(get_number(record, "check_at_least"));
+    Phases best;
+    Xapian::MSet mset;
+    for (int n = 0; n < repeat; ++n) {
+	mset = enquire.get_mset(first, maxitems, check_at_least,
+				rset.empty() ? NULL : &rset);
+	JSONObject replayed;
+	parse_object(logger.record, replayed);
+	Phases phases(replayed);
+	if (n == 0 || phases.total < best.total) best = phases;
+    }
+
+    show_phases("logged", Phases(record));
+    show_phases("replayed", best);
+    cout << "  matches estimated: logged "
+	 << get_number(record, "matches_estimated") << ", replayed "
+	 << mset.get_matches_estimated() << '\n';
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    const struct option long_opts[] = {
+	{"record",	required_argument, 0, 'r'},
+	{"repeat",	required_argument, 0, 'n'},
+	{"help",	no_argument, 0, OPT_HELP},
+	{"version",	no_argument, 0, OPT_VERSION},
+	{NULL,		0, 0, 0}
+    };
+
+    int only_record = 0;
+    int repeat = 1;
+    int c;
+    while ((c = gnu_getopt_long(argc, argv, "r:n:", long_opts, 0)) != -1) {
+	switch (c) {
+	    case 'r':
+		only_record = atoi(optarg);
+		break;
+	    case 'n':
+		repeat = atoi(optarg);
+		if (repeat < 1) repeat = 1;
+		break;
+	    case OPT_HELP:
+		cout << PROG_NAME" - "PROG_DESC"\n\n";
+		show_usage();
+		exit(0);
+	    case OPT_VERSION:
+		cout << PROG_NAME" - "PACKAGE_STRING << endl;
+		exit(0);
+	    default:
+		show_usage();
+		exit(1);
+	}
+    }
+
+    if (argc - optind < 2) {
+	show_usage();
+	exit(1);
+    }
+
+    const char * filename = argv[optind];
+    ifstream in(filename);
+    if (!in) {
+	cerr << argv[0] << ": Couldn't open '" << filename << "'" << endl;
+	exit(1);
+    }
+
+    try {
+	Xapian::Database db;
+	vector<Xapian::Database> shards;
+	for (int i = optind + 1; i < argc; ++i) {
+	    shards.push_back(Xapian::Database(argv[i]));
+	    db.add_database(shards.back());
+	}
+
+	int record_number = 0;
+	bool ok = true;
+	string line;
+	while (getline(in, line)) {
+	    if (line.empty()) continue;
+	    ++record_number;
+	    if (only_record && record_number != only_record) continue;
+
+	    JSONObject record;
+	    if (!parse_object(line, record) ||
+		record.find("query") == record.end()) {
+		cerr << argv[0] << ": Record " << record_number
+		     << " isn't a valid slow query record" << endl;
+		ok = false;
+		continue;
+	    }
+	    cout << "Record " << record_number << ": "
+		 << get_string(record, "query_description") << '\n';
+	    if (!replay(record, db, shards, repeat)) ok = false;
+	}
+	if (only_record && record_number < only_record) {
+	    cerr << argv[0] << ": '" << filename << "' only has "
+		 << record_number << " records" << endl;
+	    exit(1);
+	}
+	if (!ok) exit(1);
+    } catch (const Xapian::Error & e) {
+	cerr << argv[0] << ": " << e.get_description() << endl;
+	exit(1);
+    }
+}
@@ -0,0 +1,262 @@
+/** @file xapian-trace.cc
+ * @brief Decode the events in a Xapian trace file.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <algorithm>
+#include <cstdio> // For sprintf().
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tracepoint.h"
+
+#include "gnu_getopt.h"
+
+using namespace std;
+
+#define PROG_NAME "xapian-trace"
+#define PROG_DESC "Decode the events in a Xapian trace file"
+
+#define OPT_HELP 1
+#define OPT_VERSION 2
+
+static void show_usage() {
+    cout << "Usage: "PROG_NAME" [OPTIONS] TRACE_FILE\n\n"
+"Decode the events recorded in TRACE_FILE, which is written by a process\n"
+"using Xapian if the environment variable XAPIAN_TRACE_FILE is set.  The file\n"
+"can be decoded while the process is still running.\n\n"
+"Options:\n"
+"  -t, --thread=N   only show events from thread slot N\n"
+"  --help           display this help and exit\n"
+"  --version        output version information and exit" << endl;
+}
+
+/// A decoded event, and the thread slot which recorded it.
+struct Event {
+    TraceEvent e;
+
+    unsigned thread;
+
+    bool operator<(const Event & o) const { return e.time < o.e.time; }
+};
+
+/// Return @a s with unprintable characters escaped.
+static string
+escape(const string & s)
+{
+    string result;
+    for (string::const_iterator i = s.begin(); i != s.end(); ++i) {
+	unsigned char ch = *i;
+	if (ch < 32 || ch >= 127 || ch == '\\') {
+	    char buf[8];
+	    sprintf(buf, "\\x%02x", int(ch));
+	    result += buf;
+	} else {
+	    result += ch;
+	}
+    }
+    return result;
+}
+
+/// Describe the arguments of event @a e.
+static string
+describe_args(const TraceEvent & e)
+{
+    ostringstream out;
+    switch (e.type) {
+	case TRACE_postlist_open: {
+	    string term;
+	    trace_unpack(e.arg1, term);
+	    if (term.size() == 8) trace_unpack(e.arg2, term);
+	    if (term.empty()) {
+		out << "(all documents)";
+	    } else {
+		out << "term=" << escape(term);
+		if (term.size() == 16) out << "...";
+	    }
+	    break;
+	}
+	case TRACE_block_read: {
+	    string table;
+	    trace_unpack(e.arg2, table);
+	    out << "table=" << table << " block=" << e.arg1;
+	    break;
+	}
+	case TRACE_match_start:
+	    out << "shards=" << e.arg1 << " check_at_least=" << e.arg2;
+	    break;
+	case TRACE_match_postlists:
+	    out << "subqueries=" << e.arg1;
+	    break;
+	case TRACE_match_loop_end:
+	    out << "matched=" << e.arg1 << " kept=" << e.arg2;
+	    break;
+	case TRACE_match_end:
+	    out << "items=" << e.arg1;
+	    break;
+	case TRACE_postlist_flush_start:
+	    out << "documents=" << e.arg1;
+	    break;
+	case TRACE_fsync_start:
+	case TRACE_fsync_end:
+	    out << "fd=" << e.arg1;
+	    break;
+	case TRACE_remote_send:
+	case TRACE_remote_receive:
+	    out << "type=" << e.arg1 << " length=" << e.arg2;
+	    break;
+    }
+    return out.str();
+}
+
+int
+main(int argc, char **argv)
+{
+    const struct option long_opts[] = {
+	{"thread",	required_argument, 0, 't'},
+	{"help",	no_argument, 0, OPT_HELP},
+	{"version",	no_argument, 0, OPT_VERSION},
+	{NULL,		0, 0, 0}
+    };
+
+    int only_thread = -1;
+    int c;
+    while ((c = gnu_getopt_long(argc, argv, "t:", long_opts, 0)) != -1) {
+	switch (c) {
+	    case 't':
+		only_thread = atoi(optarg);
+		break;
+	    case OPT_HELP:
+		cout << PROG_NAME" - "PROG_DESC"\n\n";
+		show_usage();
+		exit(0);
+	    case OPT_VERSION:
+		cout << PROG_NAME" - "PACKAGE_STRING << endl;
+		exit(0);
+	    default:
+		show_usage();
+		exit(1);
+	}
+    }
+
+    if (argc - optind != 1) {
+	show_usage();
+	exit(1);
+    }
+
+    const char * filename = argv[optind];
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in) {
+	cerr << argv[0] << ": Couldn't open '" << filename << "'" << endl;
+	exit(1);
+    }
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    TraceFileHeader header;
+    if (data.size() < sizeof(header)) {
+	cerr << argv[0] << ": '" << filename << "' is not a trace file" << endl;
+	exit(1);
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+	header.version != TRACE_FILE_VERSION) {
+	cerr << argv[0] << ": '" << filename << "' is not a trace file, or "
+		"uses an unsupported version of the format" << endl;
+	exit(1);
+    }
+    size_t slot_size = sizeof(TraceThread) +
+	size_t(header.events_per_thread) * sizeof(TraceEvent);
+    if (data.size() < sizeof(header) + header.threads * slot_size) {
+	cerr << argv[0] << ": '" << filename << "' is truncated" << endl;
+	exit(1);
+    }
+
+    vector<Event> events;
+    unsigned threads_used = 0;
+    uint8 overwritten = 0;
+    for (unsigned t = 0; t != header.threads; ++t) {
+	const char * p = data.data() + sizeof(header) + t * slot_size;
+	TraceThread thread;
+	memcpy(&thread, p, sizeof(thread));
+	if (thread.count == 0) continue;
+	++threads_used;
+	if (only_thread >= 0 && unsigned(only_thread) != t) continue;
+
+	// Once the ring buffer has wrapped, the oldest events are lost.
+	uint8 first = 0;
+	if (thread.count > header.events_per_thread) {
+	    first = thread.count - header.events_per_thread;
+	    overwritten += first;
+	}
+	p += sizeof(thread);
+	for (uint8 i = first; i != thread.count; ++i) {
+	    Event event;
+	    event.thread = t;
+	    memcpy(&event.e, p + (i % header.events_per_thread) * sizeof(TraceEvent),
+		   sizeof(TraceEvent));
+	    events.push_back(event);
+	}
+    }
+    // Interleave the events from different threads.
+    stable_sort(events.begin(), events.end());
+
+    cout << "pid " << header.pid << ", " << threads_used << " of "
+	 << header.threads << " thread slots used, " << events.size()
+	 << " events";
+    if (overwritten)
+	cout << " (" << overwritten << " older events overwritten)";
+    cout << "\n";
+    if (header.dropped_threads) {
+	cout << "events from " << header.dropped_threads << " threads not "
+		"recorded as no thread slot was free\n";
+    }
+    if (events.empty()) return 0;
+
+    // Show the time of each event relative to the first, and the time since
+    // the previous event in the same thread.
+    double start = events.front().e.time;
+    vector<double> last_time(header.threads, 0.0);
+    vector<Event>::const_iterator i;
+    for (i = events.begin(); i != events.end(); ++i) {
+	const TraceEvent & e = i->e;
+	const char * name = trace_event_name(e.type);
+	char buf[64];
+	double & last = last_time[i->thread];
+	sprintf(buf, "%12.6f %+11.6f %3u ", e.time - start,
+		last == 0.0 ? 0.0 : e.time - last, i->thread);
+	last = e.time;
+	cout << buf;
+	if (name) {
+	    cout << name;
+	    string args = describe_args(e);
+	    if (!args.empty()) cout << ' ' << args;
+	} else {
+	    cout << "unknown event " << e.type << " arg1=" << e.arg1
+		 << " arg2=" << e.arg2;
+	}
+	cout << '\n';
+    }
+}
@@ -0,0 +1,262 @@
+/** @file xapian-warm.cc
+ * @brief Read the most useful parts of Xapian databases into the page cache.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "realtime.h"
+#include "tracepoint.h"
+
+#include "gnu_getopt.h"
+
+using namespace std;
+
+#define PROG_NAME "xapian-warm"
+#define PROG_DESC "Read the most useful parts of Xapian databases into the page cache"
+
+#define OPT_HELP 1
+#define OPT_VERSION 2
+
+static void show_usage() {
+    cout << "Usage: "PROG_NAME" [OPTIONS] DATABASE...\n"
+"       "PROG_NAME" --record=TRACE_FILE > BLOCK_LIST\n\n"
+"Read the parts of each DATABASE which most searches need into the operating\n"
+"system's page cache, with large sequential reads, so that searches are fast\n"
+"straight after a restart.  In order, these are the internal levels of each\n"
+"table, the document lengths, the values, and the longest postlists.\n\n"
+"With --record, write a list of the blocks read in TRACE_FILE instead, which\n"
+"is written by a process using Xapian if the environment variable\n"
+"XAPIAN_TRACE_FILE is set.  The process should only search one database, and\n"
+"XAPIAN_TRACE_EVENTS should be large enough that no events are overwritten.\n"
+"The list can be read first with --blocks.\n\n"
+"Options:\n"
+"  -b, --budget=SIZE      read at most SIZE bytes from each database (a\n"
+"                         suffix of K, M or G may be used; default no limit)\n"
+"  -t, --terms=N          read the postlists of N terms (default 100)\n"
+"  -s, --slot=SLOT        read the values in SLOT (may be given more than\n"
+"                         once; default every slot with values)\n"
+"  -l, --blocks=FILE      first read the blocks listed in FILE (only if a\n"
+"                         single DATABASE is given)\n"
+"  -r, --record=TRACE     write a list of the blocks read in TRACE\n"
+"  --help                 display this help and exit\n"
+"  --version              output version information and exit" << endl;
+}
+
+/// Parse a size in bytes with an optional K, M or G suffix.
+static bool
+parse_size(const char * s, size_t & result)
+{
+    char * end;
+    double size = strtod(s, &end);
+    if (end == s || size < 0) return false;
+    switch (*end) {
+	case 'G': case 'g':
+	    size *= 1024.0;
+	    // Fall through.
+	case 'M': case 'm':
+	    size *= 1024.0;
+	    // Fall through.
+	case 'K': case 'k':
+	    size *= 1024.0;
+	    ++end;
+	    break;
+    }
+    if (*end) return false;
+    result = size > double(size_t(-1)) ? size_t(-1) : size_t(size);
+    return true;
+}
+
+/// Write the list of blocks read in trace file @a filename to stdout.
+static bool
+record(const char * filename)
+{
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in) {
+	cerr << PROG_NAME": Couldn't open '" << filename << "'" << endl;
+	return false;
+    }
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    TraceFileHeader header;
+    bool ok = (data.size() >= sizeof(header));
+    if (ok) {
+	memcpy(&header, data.data(), sizeof(header));
+	ok = (memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+	      header.version == TRACE_FILE_VERSION);
+    }
+    if (!ok) {
+	cerr << PROG_NAME": '" << filename << "' is not a trace file, or "
+		"uses an unsupported version of the format" << endl;
+	return false;
+    }
+    size_t slot_size = sizeof(TraceThread) +
+	size_t(header.events_per_thread) * sizeof(TraceEvent);
+    if (data.size() < sizeof(header) + header.threads * slot_size) {
+	cerr << PROG_NAME": '" << filename << "' is truncated" << endl;
+	return false;
+    }
+
+    set<pair<string, uint8> > blocks;
+    uint8 overwritten = 0;
+    for (unsigned t = 0; t != header.threads; ++t) {
+	const char * p = data.data() + sizeof(header) + t * slot_size;
+	TraceThread thread;
+	memcpy(&thread, p, sizeof(thread));
+	p += sizeof(thread);
+	uint8 first = 0;
+	if (thread.count > header.events_per_thread) {
+	    first = thread.count - header.events_per_thread;
+	    overwritten += first;
+	}
+	for (uint8 i = first; i != thread.count; ++i) {
+	    TraceEvent e;
+	    memcpy(&e, p + (i % header.events_per_thread) * sizeof(TraceEvent),
+		   sizeof(TraceEvent));
+	    if (e.type != TRACE_block_read) continue;
+	    string table;
+	    trace_unpack(e.arg2, table);
+	    blocks.insert(make_pair(table, e.arg1));
+	}
+    }
+    if (overwritten) {
+	cerr << PROG_NAME": Warning: " << overwritten << " older events in '"
+	     << filename << "' were overwritten" << endl;
+    }
+
+    cout << "# Blocks read in " << filename << "\n";
+    set<pair<string, uint8> >::const_iterator i;
+    for (i = blocks.begin(); i != blocks.end(); ++i) {
+	cout << i->first << ' ' << i->second << '\n';
+    }
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    const struct option long_opts[] = {
+	{"budget",	required_argument, 0, 'b'},
+	{"terms",	required_argument, 0, 't'},
+	{"slot",	required_argument, 0, 's'},
+	{"blocks",	required_argument, 0, 'l'},
+	{"record",	required_argument, 0, 'r'},
+	{"help",	no_argument, 0, OPT_HELP},
+	{"version",	no_argument, 0, OPT_VERSION},
+	{NULL,		0, 0, 0}
+    };
+
+    size_t budget = size_t(-1);
+    Xapian::termcount terms = 100;
+    vector<Xapian::valueno> slots;
+    const char * blocks_file = NULL;
+    const char * trace_file = NULL;
+    int c;
+    while ((c = gnu_getopt_long(argc, argv, "b:t:s:l:r:", long_opts, 0)) != -1) {
+	switch (c) {
+	    case 'b':
+		if (!parse_size(optarg, budget)) {
+		    cerr << argv[0] << ": Bad size '" << optarg << "'" << endl;
+		    exit(1);
+		}
+		break;
+	    case 't':
+		terms = atoi(optarg);
+		break;
+	    case 's':
+		slots.push_back(atoi(optarg));
+		break;
+	    case 'l':
+		blocks_file = optarg;
+		break;
+	    case 'r':
+		trace_file = optarg;
+		break;
+	    case OPT_HELP:
+		cout << PROG_NAME" - "PROG_DESC"\n\n";
+		show_usage();
+		exit(0);
+	    case OPT_VERSION:
+		cout << PROG_NAME" - "PACKAGE_STRING << endl;
+		exit(0);
+	    default:
+		show_usage();
+		exit(1);
+	}
+    }
+
+    if (trace_file) {
+	if (argc != optind) {
+	    show_usage();
+	    exit(1);
+	}
+	exit(record(trace_file) ? 0 : 1);
+    }
+
+    if (argc - optind < 1) {
+	show_usage();
+	exit(1);
+    }
+
+    if (blocks_file && argc - optind > 1) {
+	// A block list is recorded from searches of one database, and the
+	// block numbers mean nothing in another.
+	cerr << argv[0] << ": --blocks can only be used with a single database"
+	     << endl;
+	exit(1);
+    }
+
+    string block_list;
+    if (blocks_file) {
+	ifstream in(blocks_file);
+	if (!in) {
+	    cerr << argv[0] << ": Couldn't open '" << blocks_file << "'"
+		 << endl;
+	    exit(1);
+	}
+	block_list.assign(istreambuf_iterator<char>(in),
+			  istreambuf_iterator<char>());
+    }
+
+    try {
+	for (int i = optind; i < argc; ++i) {
+	    double start = RealTime::now();
+	    Xapian::Database db(argv[i]);
+	    size_t bytes = 0;
+	    if (blocks_file) bytes = db.prefetch_blocks(block_list, budget);
+	    bytes += db.prefetch(budget - bytes, terms, slots);
+	    cout << argv[i] << ": read " << bytes << " bytes in "
+		 << RealTime::now() - start << " seconds" << endl;
+	}
+    } catch (const Xapian::Error & e) {
+	cerr << argv[0] << ": " << e.get_description() << endl;
+	exit(1);
+    }
+}
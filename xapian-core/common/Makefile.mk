@@ -1,5 +1,6 @@
 noinst_HEADERS +=\
 	common/append_filename_arg.h\
+	common/atomiccount.h\
 	common/autoptr.h\
 	common/bitstream.h\
 	common/closefrom.h\
@@ -11,9 +12,11 @@ noinst_HEADERS +=\
 	common/gnu_getopt.h\
 	common/internaltypes.h\
 	common/io_utils.h\
+	common/jsonescape.h\
 	common/keyword.h\
 	common/log2.h\
 	common/msvc_dirent.h\
+	common/mutex.h\
 	common/noreturn.h\
 	common/omassert.h\
 	common/output.h\
@@ -38,10 +41,12 @@ noinst_HEADERS +=\
 	common/safewindows.h\
 	common/safewinsock2.h\
 	common/serialise-double.h\
+	common/sharedfd.h\
 	common/socket_utils.h\
 	common/str.h\
 	common/stringutils.h\
 	common/submatch.h\
+	common/tracepoint.h\
 	common/unaligned.h
 
 EXTRA_DIST +=\
@@ -52,11 +57,13 @@ EXTRA_DIST +=\
 	common/Tokeniseise.pm
 
 lib_src +=\
+	common/atomiccount.cc\
 	common/bitstream.cc\
 	common/closefrom.cc\
 	common/debuglog.cc\
 	common/fileutils.cc\
 	common/io_utils.cc\
+	common/jsonescape.cc\
 	common/keyword.cc\
 	common/msvc_dirent.cc\
 	common/omassert.cc\
@@ -66,7 +73,8 @@ lib_src +=\
 	common/serialise-double.cc\
 	common/socket_utils.cc\
 	common/str.cc\
-	common/stringutils.cc
+	common/stringutils.cc\
+	common/tracepoint.cc
 
 if BUILD_BACKEND_BRASS_OR_CHERT
 lib_src +=\
@@ -0,0 +1,70 @@
+/** @file atomiccount.h
+ * @brief Update reference counts atomically.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_ATOMICCOUNT_H
+#define XAPIAN_INCLUDED_ATOMICCOUNT_H
+
+#if defined __GNUC__
+// Use the __sync builtins.
+#elif defined _MSC_VER
+# include "safewindows.h"
+#else
+# include "mutex.h"
+/// Serialises updates to counts for compilers without atomic builtins.
+extern Mutex atomic_count_mutex;
+#endif
+
+/** Increment @a count.
+ *
+ *  This is atomic, so objects which use it for their reference count can be
+ *  shared between threads.  With compilers other than GCC-compatible ones
+ *  and MSVC, a global mutex is used.
+ */
+inline void
+atomic_increment(long & count)
+{
+#if defined __GNUC__
+    (void)__sync_add_and_fetch(&count, 1);
+#elif defined _MSC_VER
+    (void)InterlockedIncrement(&count);
+#else
+    MutexLock lock(atomic_count_mutex);
+    ++count;
+#endif
+}
+
+/** Decrement @a count, returning the new value.
+ *
+ *  This is atomic, like atomic_increment().
+ */
+inline long
+atomic_decrement(long & count)
+{
+#if defined __GNUC__
+    return __sync_sub_and_fetch(&count, 1);
+#elif defined _MSC_VER
+    return InterlockedDecrement(&count);
+#else
+    MutexLock lock(atomic_count_mutex);
+    return --count;
+#endif
+}
+
+#endif // XAPIAN_INCLUDED_ATOMICCOUNT_H
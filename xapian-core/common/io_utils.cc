@@ -105,9 +105,10 @@ throw_block_error(const char * s, off_t b, int e)
 }
 
 void
-io_read_block(int fd, char * p, size_t n, off_t b)
+io_read_blocks(int fd, char * p, size_t n, off_t b, size_t count)
 {
     off_t o = b * n;
+    n *= count;
 #ifdef HAVE_PREAD
     while (n) {
 	ssize_t c = pread(fd, p, n, o);
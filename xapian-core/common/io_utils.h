@@ -78,8 +78,15 @@ inline void io_write(int fd, const unsigned char * p, size_t n) {
     io_write(fd, reinterpret_cast<const char *>(p), n);
 }
 
+/** Read count blocks starting at block b, each of size n bytes, into buffer p
+ *  from file descriptor fd.
+ */
+void io_read_blocks(int fd, char * p, size_t n, off_t b, size_t count);
+
 /// Read block b size n bytes into buffer p from file descriptor fd.
-void io_read_block(int fd, char * p, size_t n, off_t b);
+inline void io_read_block(int fd, char * p, size_t n, off_t b) {
+    io_read_blocks(fd, p, n, b, 1);
+}
 
 /// Write block b size n bytes from buffer p to file descriptor fd.
 void io_write_block(int fd, const char * p, size_t n, off_t b);
@@ -0,0 +1,46 @@
+/** @file jsonescape.cc
+ * @brief Escape strings for output as JSON.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "jsonescape.h"
+
+using namespace std;
+
+void
+append_json_string(string & result, const string & s)
+{
+    result += '"';
+    for (string::const_iterator i = s.begin(); i != s.end(); ++i) {
+	unsigned char ch = *i;
+	if (ch == '"' || ch == '\\') {
+	    result += '\\';
+	    result += char(ch);
+	} else if (ch < 32 || ch == 127) {
+	    static const char hex[] = "0123456789abcdef";
+	    result += "\\u00";
+	    result += hex[ch >> 4];
+	    result += hex[ch & 0x0f];
+	} else {
+	    result += char(ch);
+	}
+    }
+    result += '"';
+}
@@ -0,0 +1,33 @@
+/** @file jsonescape.h
+ * @brief Escape strings for output as JSON.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_JSONESCAPE_H
+#define XAPIAN_INCLUDED_JSONESCAPE_H
+
+#include <string>
+
+/** Append @a s to @a result as a quoted JSON string.
+ *
+ *  Control characters are escaped as \\u00XX, and other bytes are copied
+ *  as they are, so @a s should be UTF-8.
+ */
+void append_json_string(std::string & result, const std::string & s);
+
+#endif // XAPIAN_INCLUDED_JSONESCAPE_H
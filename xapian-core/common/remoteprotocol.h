@@ -48,7 +48,8 @@
 // 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, and more...
 // 37: 1.3.1 Prefix-compress termlists.
 // 38: 1.3.2 Stats serialisation now includes collection freq, and more...
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 38
+// 39: 1.3.3 Support for match profiling, compact serialisation of term lists.
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 39
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
@@ -0,0 +1,65 @@
+/** @file sharedfd.h
+ * @brief A file descriptor shared by objects used from different threads.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SHAREDFD_H
+#define XAPIAN_INCLUDED_SHAREDFD_H
+
+#include "atomiccount.h"
+#include "safeunistd.h"
+
+/** A reference counted file descriptor.
+ *
+ *  The file descriptor is closed when the last reference is removed.  The
+ *  reference count is updated atomically, so several objects used from
+ *  different threads can share the file descriptor as long as they only
+ *  access the file with pread() and pwrite().
+ */
+class SharedFD {
+    /// Don't allow assignment.
+    void operator=(const SharedFD &);
+
+    /// Don't allow copying.
+    SharedFD(const SharedFD &);
+
+    /// The file descriptor.
+    int fd;
+
+    /// Reference count.
+    mutable long refs;
+
+    /// Only unref() should delete this object.
+    ~SharedFD() { (void)::close(fd); }
+
+  public:
+    /// Take ownership of @a fd_, with a reference count of 1.
+    explicit SharedFD(int fd_) : fd(fd_), refs(1) { }
+
+    operator int() const { return fd; }
+
+    /// Add a reference.
+    void ref() const { atomic_increment(refs); }
+
+    /// Remove a reference, closing the file descriptor if it was the last.
+    void unref() const {
+	if (atomic_decrement(refs) == 0) delete this;
+    }
+};
+
+#endif // XAPIAN_INCLUDED_SHAREDFD_H
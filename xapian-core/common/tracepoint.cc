@@ -0,0 +1,259 @@
+/** @file tracepoint.cc
+ * @brief Low-overhead tracing of events on hot paths.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "tracepoint.h"
+
+#ifdef XAPIAN_TRACING
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include "safeerrno.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include <cstdlib> // For getenv().
+#include <cstring>
+#include <string>
+
+#include "realtime.h"
+#include "str.h"
+
+using namespace std;
+
+/// The default number of thread slots in the trace file.
+static const uint4 DEFAULT_TRACE_THREADS = 16;
+
+/// The default size of each thread's ring buffer.
+static const uint4 DEFAULT_TRACE_EVENTS = 8192;
+
+int xapian_trace_state_ = -1;
+
+/// Value of xapian_trace_state_ while one thread sets up the trace file.
+static const int TRACE_STATE_INITIALISING = 2;
+
+/// The mapped trace file.
+static TraceFileHeader * trace_file = NULL;
+
+/// The size of the mapped trace file.
+static size_t trace_file_size = 0;
+
+/// Does the trace filename include the process id?
+static bool trace_file_per_process = false;
+
+/** Which thread slots are in use (1) or free (0).
+ *
+ *  A slot is released when its thread exits, so a later thread can reuse
+ *  it.  The events already in the slot's ring buffer are kept until the new
+ *  thread overwrites them.
+ */
+static unsigned char * trace_slot_used = NULL;
+
+/// Key whose destructor releases a thread's slot when the thread exits.
+static pthread_key_t trace_slot_key;
+
+/// Have trace_slot_key and the fork handler been set up?
+static bool trace_process_setup_done = false;
+
+/// The current thread's ring buffer, or NULL if it hasn't been assigned one.
+static __thread TraceThread * trace_thread = NULL;
+
+/// Set if there was no free slot for the current thread.
+static __thread bool trace_thread_dropped = false;
+
+static uint4
+get_env_uint4(const char * name, uint4 default_value)
+{
+    const char * p = getenv(name);
+    if (p && *p) {
+	long value = atol(p);
+	if (value > 0) return uint4(value);
+    }
+    return default_value;
+}
+
+/// Release the slot of a thread which is exiting.
+static void
+release_trace_thread(void * slot_plus_one)
+{
+    size_t slot = reinterpret_cast<size_t>(slot_plus_one) - 1;
+    trace_thread = NULL;
+    // The thread may have been started before a fork.
+    if (trace_slot_used && slot < trace_file->threads)
+	__sync_lock_release(&trace_slot_used[slot]);
+}
+
+/** Reset the tracing state in the child after fork().
+ *
+ *  Otherwise the child would write to the parent's ring buffers.  If the
+ *  trace filename includes %p the child writes its own trace file, and
+ *  otherwise it doesn't trace.
+ */
+static void
+reset_trace_after_fork()
+{
+    if (trace_file) {
+	munmap(static_cast<void *>(trace_file), trace_file_size);
+	trace_file = NULL;
+	free(trace_slot_used);
+	trace_slot_used = NULL;
+    }
+    // Only the thread which called fork() exists in the child.
+    trace_thread = NULL;
+    trace_thread_dropped = false;
+    if (trace_process_setup_done)
+	(void)pthread_setspecific(trace_slot_key, NULL);
+    if (xapian_trace_state_ == 1 && !trace_file_per_process) {
+	xapian_trace_state_ = 0;
+    } else if (xapian_trace_state_ != 0) {
+	xapian_trace_state_ = -1;
+    }
+}
+
+/// Create and map the trace file, returning true if tracing is enabled.
+static bool
+open_trace_file()
+{
+    const char * f = getenv("XAPIAN_TRACE_FILE");
+    if (!f || !*f) return false;
+
+    string fnm, pid;
+    trace_file_per_process = false;
+    while (*f) {
+	if (*f == '%' && f[1] == 'p') {
+	    // Replace %p in the filename with the process id.
+	    if (pid.empty()) pid = str(getpid());
+	    fnm += pid;
+	    trace_file_per_process = true;
+	    f += 2;
+	} else {
+	    fnm += *f++;
+	}
+    }
+
+    // These are inherited by child processes, so only need setting up once.
+    if (!trace_process_setup_done) {
+	if (pthread_key_create(&trace_slot_key, release_trace_thread) != 0)
+	    return false;
+	(void)pthread_atfork(NULL, NULL, reset_trace_after_fork);
+	trace_process_setup_done = true;
+    }
+
+    uint4 threads = get_env_uint4("XAPIAN_TRACE_THREADS",
+				  DEFAULT_TRACE_THREADS);
+    uint4 events = get_env_uint4("XAPIAN_TRACE_EVENTS", DEFAULT_TRACE_EVENTS);
+    size_t size = sizeof(TraceFileHeader) +
+	size_t(threads) * (sizeof(TraceThread) + events * sizeof(TraceEvent));
+
+    trace_slot_used = static_cast<unsigned char *>(calloc(threads, 1));
+    if (!trace_slot_used) return false;
+
+    int fd = open(fnm.c_str(), O_CREAT|O_RDWR|O_TRUNC|O_CLOEXEC, 0644);
+    if (fd < 0) {
+	free(trace_slot_used);
+	trace_slot_used = NULL;
+	return false;
+    }
+    void * p = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+	p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    // The mapping remains valid after the file descriptor is closed.
+    close(fd);
+    if (p == MAP_FAILED) {
+	free(trace_slot_used);
+	trace_slot_used = NULL;
+	return false;
+    }
+
+    // The file was extended with zero bytes, so every slot starts unused.
+    trace_file = static_cast<TraceFileHeader *>(p);
+    trace_file_size = size;
+    memcpy(trace_file->magic, TRACE_FILE_MAGIC, sizeof(trace_file->magic));
+    trace_file->version = TRACE_FILE_VERSION;
+    trace_file->pid = uint4(getpid());
+    trace_file->threads = threads;
+    trace_file->events_per_thread = events;
+    return true;
+}
+
+/** Assign the current thread a slot, returning false if there's none free.
+ *
+ *  A thread which doesn't get a slot drops its events, and is counted in the
+ *  trace file header.
+ */
+static bool
+assign_trace_thread()
+{
+    if (trace_thread_dropped) return false;
+    uint4 slot = 0;
+    while (!__sync_bool_compare_and_swap(&trace_slot_used[slot], 0, 1)) {
+	if (++slot == trace_file->threads) {
+	    trace_thread_dropped = true;
+	    (void)__sync_fetch_and_add(&trace_file->dropped_threads, 1);
+	    return false;
+	}
+    }
+    if (pthread_setspecific(trace_slot_key,
+			    reinterpret_cast<void *>(size_t(slot) + 1)) != 0) {
+	__sync_lock_release(&trace_slot_used[slot]);
+	trace_thread_dropped = true;
+	(void)__sync_fetch_and_add(&trace_file->dropped_threads, 1);
+	return false;
+    }
+    size_t slot_size = sizeof(TraceThread) +
+	trace_file->events_per_thread * sizeof(TraceEvent);
+    char * p = reinterpret_cast<char *>(trace_file + 1) + slot * slot_size;
+    trace_thread = reinterpret_cast<TraceThread *>(p);
+    // A reused slot keeps the start time of the first thread to use it.
+    if (trace_thread->count == 0) trace_thread->start_time = RealTime::now();
+    return true;
+}
+
+void
+xapian_trace_event_(trace_event_type type, uint8 arg1, uint8 arg2)
+{
+    if (rare(xapian_trace_state_ < 0)) {
+	// Only the first thread here sets up the trace file - any others just
+	// drop their events until it has finished.
+	if (!__sync_bool_compare_and_swap(&xapian_trace_state_, -1,
+					  TRACE_STATE_INITIALISING))
+	    return;
+	xapian_trace_state_ = open_trace_file() ? 1 : 0;
+    }
+    if (xapian_trace_state_ != 1) return;
+
+    if (rare(trace_thread == NULL) && !assign_trace_thread()) return;
+
+    // Only this thread writes to its ring buffer, so no locking is needed.
+    // If the file is read while we're running, the newest event may be only
+    // partly written.
+    uint8 count = trace_thread->count;
+    TraceEvent * events = reinterpret_cast<TraceEvent *>(trace_thread + 1);
+    TraceEvent & event = events[count % trace_file->events_per_thread];
+    event.type = type;
+    event.arg1 = arg1;
+    event.arg2 = arg2;
+    event.time = RealTime::now();
+    trace_thread->count = count + 1;
+}
+
+#endif
@@ -0,0 +1,228 @@
+/** @file tracepoint.h
+ * @brief Low-overhead tracing of events on hot paths.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_TRACEPOINT_H
+#define XAPIAN_INCLUDED_TRACEPOINT_H
+
+#include <cstring>
+#include <string>
+
+#include "internaltypes.h"
+
+/** The events which can be traced.
+ *
+ *  The values are stored in trace files, so only add new events at the end,
+ *  and update trace_event_name() to match.
+ */
+enum trace_event_type {
+    /// MultiMatch::get_mset() started: arg1 = #shards, arg2 = check_at_least.
+    TRACE_match_start,
+
+    /// The postlist tree has been built: arg1 = #subqueries.
+    TRACE_match_postlists,
+
+    /// The match loop has finished: arg1 = #docs matched, arg2 = #items kept.
+    TRACE_match_loop_end,
+
+    /// MultiMatch::get_mset() finished: arg1 = #items in the MSet.
+    TRACE_match_end,
+
+    /// A postlist was opened: arg1, arg2 = the term (see trace_pack()).
+    TRACE_postlist_open,
+
+    /// A B-tree block was read: arg1 = block number, arg2 = table name.
+    TRACE_block_read,
+
+    /// Buffered postlist changes are being flushed: arg1 = #documents.
+    TRACE_postlist_flush_start,
+
+    /// Buffered postlist changes have been flushed.
+    TRACE_postlist_flush_end,
+
+    /// An fsync of a database file started: arg1 = file descriptor.
+    TRACE_fsync_start,
+
+    /// An fsync of a database file finished: arg1 = file descriptor.
+    TRACE_fsync_end,
+
+    /// A remote protocol message was sent: arg1 = type, arg2 = length.
+    TRACE_remote_send,
+
+    /// A remote protocol message was received: arg1 = type, arg2 = length.
+    TRACE_remote_receive,
+
+    TRACE_EVENT_TYPES
+};
+
+/// Return the name of trace event @a type, or NULL if it isn't known.
+inline const char *
+trace_event_name(unsigned type)
+{
+    static const char * const names[TRACE_EVENT_TYPES] = {
+	"match_start",
+	"match_postlists",
+	"match_loop_end",
+	"match_end",
+	"postlist_open",
+	"block_read",
+	"postlist_flush_start",
+	"postlist_flush_end",
+	"fsync_start",
+	"fsync_end",
+	"remote_send",
+	"remote_receive"
+    };
+    return type < TRACE_EVENT_TYPES ? names[type] : NULL;
+}
+
+/** Pack up to 8 bytes of @a s starting at @a offset into an event argument.
+ *
+ *  The bytes are packed most significant first, so the argument can be
+ *  unpacked by trace_unpack() on any platform.
+ */
+inline uint8
+trace_pack(const std::string & s, std::string::size_type offset = 0)
+{
+    uint8 result = 0;
+    for (int i = 0; i != 8; ++i) {
+	result <<= 8;
+	if (offset + i < s.size())
+	    result |= static_cast<unsigned char>(s[offset + i]);
+    }
+    return result;
+}
+
+/// Pack up to 8 bytes of nul-terminated string @a s into an event argument.
+inline uint8
+trace_pack(const char * s)
+{
+    uint8 result = 0;
+    for (int i = 0; i != 8; ++i) {
+	result <<= 8;
+	if (*s) result |= static_cast<unsigned char>(*s++);
+    }
+    return result;
+}
+
+/// Append the bytes packed into @a arg by trace_pack() to @a s.
+inline void
+trace_unpack(uint8 arg, std::string & s)
+{
+    for (int shift = 56; shift >= 0; shift -= 8) {
+	char ch = static_cast<char>((arg >> shift) & 0xff);
+	if (ch == '\0') break;
+	s += ch;
+    }
+}
+
+/** The layout of a trace file.
+ *
+ *  A trace file starts with a TraceFileHeader, which is followed by one
+ *  TraceThread for each slot, each of which is followed by its ring buffer of
+ *  events_per_thread TraceEvent entries.  All values are in the native byte
+ *  order, so trace files should be decoded on the machine which wrote them.
+ */
+#define TRACE_FILE_MAGIC "XAPTRACE"
+
+/// Version of the trace file format.
+#define TRACE_FILE_VERSION 2
+
+struct TraceFileHeader {
+    char magic[8];
+
+    uint4 version;
+
+    /// The process id of the process which wrote the file.
+    uint4 pid;
+
+    /// The number of thread slots.
+    uint4 threads;
+
+    /// The size of each thread's ring buffer.
+    uint4 events_per_thread;
+
+    /// The number of threads whose events were dropped as no slot was free.
+    uint4 dropped_threads;
+
+    uint4 reserved;
+};
+
+struct TraceThread {
+    /// The number of events this thread has recorded (0 for an unused slot).
+    uint8 count;
+
+    /// The time this thread recorded its first event.
+    double start_time;
+};
+
+struct TraceEvent {
+    /// The time of the event, in seconds since the epoch.
+    double time;
+
+    uint4 type;
+
+    uint4 reserved;
+
+    uint8 arg1;
+
+    uint8 arg2;
+};
+
+#ifdef XAPIAN_TRACING
+
+# ifdef HAVE_SYS_SDT_H
+#  include <sys/sdt.h>
+#  define XAPIAN_TRACE_PROBE_(NAME, ARG1, ARG2) \
+    DTRACE_PROBE2(xapian, NAME, ARG1, ARG2)
+# else
+#  define XAPIAN_TRACE_PROBE_(NAME, ARG1, ARG2) (void)0
+# endif
+
+/** Whether events should be recorded in the trace file.
+ *
+ *  This is negative until the first event checks the environment, then
+ *  either 0 or 1.
+ */
+extern int xapian_trace_state_;
+
+/// Record an event in the current thread's ring buffer.
+void xapian_trace_event_(trace_event_type type, uint8 arg1, uint8 arg2);
+
+/** Trace event NAME (one of the trace_event_type values without "TRACE_").
+ *
+ *  If tracing to a file isn't enabled, the cost is a single test of a global
+ *  variable.  If the platform supports USDT probes, a probe xapian:NAME is
+ *  also compiled in, which costs a "nop" instruction (plus evaluating the
+ *  arguments) unless a tool such as perf or bpftrace attaches to it.
+ */
+# define XAPIAN_TRACE(NAME, ARG1, ARG2) \
+    do { \
+	XAPIAN_TRACE_PROBE_(NAME, ARG1, ARG2); \
+	if (rare(xapian_trace_state_ != 0)) \
+	    xapian_trace_event_(TRACE_##NAME, uint8(ARG1), uint8(ARG2)); \
+    } while (false)
+
+#else
+
+# define XAPIAN_TRACE(NAME, ARG1, ARG2) (void)0
+
+#endif
+
+#endif // XAPIAN_INCLUDED_TRACEPOINT_H
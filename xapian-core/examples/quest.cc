@@ -71,6 +71,7 @@ inline bool operator<(const qp_flag & f1, const qp_flag & f2) {
 
 struct qp_op { const char * s; unsigned f; };
 static qp_op op_tab[] = {
+    { "adaptive_or", Xapian::Query::OP_ADAPTIVE_OR },
     { "and", Xapian::Query::OP_AND },
     { "elite_set", Xapian::Query::OP_ELITE_SET },
     { "max", Xapian::Query::OP_MAX },
@@ -162,6 +162,36 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	 */
 	virtual void close();
 
+	/** Open a new handle on the same revision of the database(s).
+	 *
+	 *  Xapian objects can't be used from more than one thread at once,
+	 *  so a multi-threaded application needs a separate Database object
+	 *  for each thread.  This method provides one which is open at
+	 *  exactly the same revision as this object (so all the threads see
+	 *  the same data, even if the database has been updated since this
+	 *  object was opened), without the caller needing to know the paths
+	 *  or backend types involved.
+	 *
+	 *  The returned object can be passed to another thread and used,
+	 *  reopened, closed and destroyed independently of this one.  It
+	 *  shares only immutable data with this object, using atomic
+	 *  reference counts: for brass and chert, the open table files where
+	 *  the platform supports pread(), so clones don't need more file
+	 *  descriptors; for an inmemory snapshot, its data.  This method
+	 *  itself must be called from the thread which is using this object.
+	 *
+	 *  If this object is a WritableDatabase, the returned object is
+	 *  read-only and open at the last committed revision.
+	 *
+	 *  @exception Xapian::DatabaseModifiedError may be thrown if the
+	 *	       revision this object is open at is no longer available.
+	 *
+	 *  @exception Xapian::UnimplementedError will be thrown if this
+	 *	       isn't supported by the backend (currently it's supported
+	 *	       by brass, chert and inmemory databases).
+	 */
+	Database clone_for_thread() const;
+
 	/// Return a string describing this object.
 	virtual std::string get_description() const;
 
@@ -469,6 +499,124 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	 */
 	std::string get_uuid() const;
 
+	/** Return counters of the I/O done by this database.
+	 *
+	 *  The counters are always collected, and are cheap to maintain.  They
+	 *  count the work done since the database was opened, or since the
+	 *  last call to reset_io_statistics() - so to find the work done by a
+	 *  single query, call reset_io_statistics() before running it.
+	 *
+	 *  The result is a JSON object.  Its "tables" member gives, for each
+	 *  table, the number of blocks read from disk ("block_reads", each of
+	 *  which is a single read system call), the number of bytes read
+	 *  ("bytes_read"), the number of times the table was searched for a
+	 *  key ("seeks"), and the number of blocks and bytes written
+	 *  ("block_writes" and "bytes_written").  The other members are the
+	 *  number of chunks of postings ("postlist_chunk_reads") and of values
+	 *  ("value_chunk_reads") read, and for a WritableDatabase the number
+	 *  of times buffered changes were flushed to the tables ("flushes")
+	 *  and committed ("commits"), the total time in seconds these took
+	 *  ("flush_time" and "commit_time") and the longest time taken by a
+	 *  single commit ("max_commit_time").
+	 *
+	 *  If this database has multiple sub-databases, the counters are
+	 *  summed over them.  Backends without B-tree tables (inmemory and
+	 *  remote) don't currently report any counters.
+	 *
+	 *  The exact details of the format may change between releases.
+	 */
+	std::string get_io_statistics() const;
+
+	/// Reset the counters returned by get_io_statistics().
+	void reset_io_statistics();
+
+	/** Return an estimate of the memory this database is using.
+	 *
+	 *  The result is a JSON object.  Its "tables" member gives, for each
+	 *  table, the bytes of B-tree blocks held in memory (by the table
+	 *  itself and by any open cursors on it).  The other members are the
+	 *  bytes held by cached value slot statistics ("value_stats") and,
+	 *  for a WritableDatabase, by changes which are buffered in memory
+	 *  waiting to be flushed ("pending_changes"), and the sum of all
+	 *  these ("total").
+	 *
+	 *  The figures are estimates kept by cheap bookkeeping as the memory
+	 *  is used, rather than by tracking every allocation, but they should
+	 *  be good enough to compare with a memory budget or to spot which
+	 *  part of a process is growing.
+	 *
+	 *  If this database has multiple sub-databases, the figures are summed
+	 *  over them.  Backends without B-tree tables (inmemory and remote)
+	 *  don't currently report any usage.
+	 *
+	 *  The exact details of the format may change between releases.
+	 */
+	std::string get_memory_usage() const;
+
+	/** Read the most useful parts of the database into the page cache.
+	 *
+	 *  When a database is first opened (for example after a restart, or
+	 *  a switch to a new replica) searches are slow until the blocks they
+	 *  need have been read from disk, which happens in essentially random
+	 *  order.  This method reads the parts of the database most searches
+	 *  need with large sequential reads, in this order, until @a max_bytes
+	 *  have been read:
+	 *
+	 *   - The internal levels of the B-tree of each table.
+	 *   - The document lengths.
+	 *   - The values in each of @a slots.
+	 *   - The postlists of the @a max_terms terms with the longest
+	 *     postlists.
+	 *
+	 *  The blocks are only read into the operating system's page cache -
+	 *  this doesn't increase the memory used by this object.
+	 *
+	 *  Backends without B-tree tables (inmemory and remote) don't
+	 *  currently read anything.
+	 *
+	 *  @param max_bytes	The most bytes to read.
+	 *  @param max_terms	The number of terms to read the postlists of
+	 *			(default 100).  The lengths of postlists are
+	 *			estimated from the internal levels of the B-tree.
+	 *  @param slots	The value slots to read the values of.  If empty
+	 *			(the default), every slot which has values is
+	 *			read, starting with the one set in most
+	 *			documents.
+	 *
+	 *  @return	The number of bytes read.
+	 */
+	size_t prefetch(size_t max_bytes, Xapian::termcount max_terms = 100,
+			const std::vector<Xapian::valueno> & slots =
+			    std::vector<Xapian::valueno>()) const;
+
+	/** Read a list of blocks into the page cache.
+	 *
+	 *  This allows the blocks which a typical workload reads to be
+	 *  recorded, and read with large sequential reads when the database
+	 *  is next opened.  The list has a line for each block, giving the
+	 *  name of the table (e.g. "postlist") and the block number, separated
+	 *  by a space.  Blank lines and lines starting with "#" are ignored.
+	 *  The xapian-warm tool can make such a list from the "block_read"
+	 *  events in a trace file.
+	 *
+	 *  Blocks which are no longer in use by the database are ignored, but
+	 *  if the database has been modified since the list was made it may
+	 *  not be very useful.
+	 *
+	 *  @param blocks	The list of blocks to read.
+	 *  @param max_bytes	The most bytes to read.
+	 *
+	 *  @return	The number of bytes read.
+	 *
+	 *  @exception Xapian::InvalidArgumentError will be thrown if the list
+	 *	       isn't in the format described above.
+	 *  @exception Xapian::InvalidOperationError will be thrown if this
+	 *	       database has more than one sub-database, since block
+	 *	       numbers are only meaningful for a single database.
+	 */
+	size_t prefetch_blocks(const std::string & blocks,
+			       size_t max_bytes) const;
+
 	/** Check the integrity of a database or database table.
 	 *
 	 *  This method is currently experimental, and may change incompatibly
@@ -616,6 +764,53 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	void flush() { commit(); }
 
+	/** Set a soft limit on the memory used to buffer changes.
+	 *
+	 *  Changes are buffered in memory and automatically flushed after a
+	 *  number of documents have been changed (10000 by default, or the
+	 *  value of the XAPIAN_FLUSH_THRESHOLD environment variable).  If a
+	 *  memory limit is set, changes are also flushed when the memory
+	 *  used to buffer them (as reported by the "pending_changes" member of
+	 *  get_memory_usage()) reaches the limit, which is useful when the
+	 *  size of the documents being indexed varies a lot.
+	 *
+	 *  The limit is soft - it's checked after each document is added,
+	 *  replaced or deleted, so a large document can take the usage over
+	 *  the limit.  During a transaction, only the buffered postlist
+	 *  changes are counted.
+	 *
+	 *  Backends which don't buffer changes ignore the limit.
+	 *
+	 *  @param bytes	The limit in bytes (0 means no limit, which is the
+	 *			default).
+	 */
+	void set_memory_limit(size_t bytes);
+
+	/** Return a read-only snapshot of the current state of this database.
+	 *
+	 *  The snapshot includes modifications which haven't been committed
+	 *  yet, but unlike commit() it doesn't write anything to disk.  Later
+	 *  changes to this database aren't seen by the snapshot - to see them,
+	 *  call get_snapshot() again.
+	 *
+	 *  For a disk-based database, the snapshot is the last committed
+	 *  revision with copies of the documents added, replaced or deleted
+	 *  since then held in memory, so the cost is proportional to the
+	 *  number of uncommitted changes.  Spelling and synonym data which
+	 *  hasn't been committed isn't included.  For an inmemory database,
+	 *  a compact copy of the whole database is taken, and later
+	 *  snapshots share its data and copy just the documents which have
+	 *  changed since, until enough have changed to make a fresh copy
+	 *  worthwhile.
+	 *
+	 *  The snapshot doesn't share any state with this object, so it may be
+	 *  searched in a different thread to the one modifying this database.
+	 *
+	 *  @exception Xapian::UnimplementedError will be thrown if the
+	 *             database backend in use doesn't support snapshots.
+	 */
+	Database get_snapshot() const;
+
 	/** Begin a transaction.
 	 *
 	 *  In Xapian a transaction is a group of modifications to the database
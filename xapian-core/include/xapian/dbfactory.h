@@ -101,6 +101,27 @@ namespace InMemory {
 XAPIAN_VISIBILITY_DEFAULT
 WritableDatabase open();
 
+/** Construct a Database object for a compact read-only copy of a database.
+ *
+ *  The contents of @a db are copied into a compact in-memory form: terms are
+ *  held in a sorted array, and postings, positions and termlists are
+ *  delta-coded into a few large blocks of memory rather than allocated
+ *  individually.  The copy is a snapshot - later changes to @a db aren't
+ *  seen by it.
+ *
+ *  The copy's data is never modified, so it can be searched by several
+ *  threads at once, while another thread continues to update @a db.
+ *  Each thread needs its own Database object for this - calling this
+ *  function on a compact copy gives a new Database object which shares the
+ *  same data, so is cheap.
+ *
+ *  Spelling and synonym data isn't copied.
+ *
+ *  @param db	The database to copy.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+Database open_compact(const Database & db);
+
 }
 #endif
 
@@ -32,6 +32,7 @@
 
 #include "xapian/deprecated.h"
 #include <string>
+#include <vector>
 
 #include <xapian/attributes.h>
 #include <xapian/intrusive_ptr.h>
@@ -213,6 +214,48 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
 	 */
 	double get_max_attained() const;
 
+	/** Return profiling information for the match which produced this
+	 *  MSet.
+	 *
+	 *  This is only available if Enquire::set_profiling(true) was called
+	 *  before the match - otherwise an empty string is returned.
+	 *
+	 *  The profile is a JSON object giving the number of documents
+	 *  accepted by the matcher ("accepted"), the time taken in seconds
+	 *  ("time") and a "shards" array with an entry for each subdatabase.
+	 *  For a local subdatabase the entry's "roots" member holds the tree
+	 *  of postlists which were used, each with its "label" (the operator
+	 *  name, or the term for a leaf), counts of calls to "next", "skip_to",
+	 *  "check" and "get_weight", "docs_examined", "docs_accepted" (the
+	 *  number of documents the matcher accepted while the postlist was
+	 *  positioned on them), "chunk_reads" (the number of chunks of posting
+	 *  data read from disk, for backends which store postings in chunks),
+	 *  "time" (seconds, including time in children, estimated from a sample
+	 *  of the calls) and "children".  For a remote subdatabase the entry's
+	 *  "remote" member holds the profile returned by the server.
+	 *
+	 *  The exact details of the format may change between releases.
+	 */
+	std::string get_profile() const;
+
+	/** Return an estimate of the memory used by the match which produced
+	 *  this MSet.
+	 *
+	 *  The result is a JSON object giving the bytes used by the candidate
+	 *  items the matcher kept ("items"), by the table used for collapsing
+	 *  ("collapse") and by the results of any match spies
+	 *  ("matchspies"), and the sum of these ("total").  If a limit was set
+	 *  with Enquire::set_memory_limit(), it is given ("limit"), along with
+	 *  whether it was reached ("limit_exceeded").
+	 *
+	 *  The figures are estimates kept by cheap bookkeeping, and are taken
+	 *  at the end of the match.  If the match was against a single remote
+	 *  database, an empty string is returned.
+	 *
+	 *  The exact details of the format may change between releases.
+	 */
+	std::string get_memory_usage() const;
+
 	/** The number of items in this MSet */
 	Xapian::doccount size() const;
 
@@ -659,6 +702,51 @@ class XAPIAN_VISIBILITY_DEFAULT MatchDecider {
 	virtual ~MatchDecider();
 };
 
+/** Base class for functors which rerank the top documents of a match.
+ *
+ *  A reranker is given the best documents found by the match (ranked by the
+ *  weighting scheme set with Enquire::set_weighting_scheme(), which can
+ *  therefore be a cheap one) and can calculate a new score for each using
+ *  whatever information it wants - typically a learned model over features
+ *  of the query and document.  See Enquire::set_reranker().
+ */
+class XAPIAN_VISIBILITY_DEFAULT Reranker {
+    public:
+	/** Calculate new scores for the candidate documents.
+	 *
+	 *  @param query	The query which was run.
+	 *  @param candidates	The documents to rerank, in the order the
+	 *			match ranked them.
+	 *  @param[out] scores	Should be set to the new score for each
+	 *			document in @a candidates, in the same order
+	 *			(higher scores are better).
+	 */
+	virtual void operator()(const Xapian::Query & query,
+				const Xapian::MSet & candidates,
+				std::vector<double> & scores) = 0;
+
+	/// Destructor.
+	virtual ~Reranker();
+};
+
+/** Abstract base class for slow query loggers.
+ *
+ *  See Enquire::set_slow_query_log().
+ */
+class XAPIAN_VISIBILITY_DEFAULT SlowQueryLogger {
+    public:
+	/** Record a slow query.
+	 *
+	 *  @param record	A description of the query as a JSON object,
+	 *			on a single line.  The xapian-replay tool can
+	 *			rerun a query from such a record.
+	 */
+	virtual void operator()(const std::string & record) = 0;
+
+	/// Destructor.
+	virtual ~SlowQueryLogger();
+};
+
 /** This class provides an interface to the information retrieval
  *  system for the purpose of searching.
  *
@@ -990,6 +1078,92 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_time_limit(double time_limit);
 
+	/** Set a soft limit on the memory used by the match.
+	 *
+	 *  The memory used by a match is mostly fixed by the number of results
+	 *  asked for, but collapsing and match spies such as
+	 *  ValueCountMatchSpy use memory in proportion to the number of
+	 *  different values they see, which is hard to bound in advance when
+	 *  check_at_least is set high.  If the estimated memory in use (as
+	 *  reported by MSet::get_memory_usage()) reaches this limit,
+	 *  check_at_least is turned off, in the same way as for
+	 *  set_time_limit().  The match still returns the best results, but
+	 *  the statistics and match spy results will cover fewer documents.
+	 *
+	 *  The usage is checked periodically during the match, so can end up a
+	 *  little over the limit.  The limit isn't applied on remote servers.
+	 *
+	 *  @param bytes	The limit in bytes (default: 0 which means no limit)
+	 */
+	void set_memory_limit(size_t bytes);
+
+	/** Enable collection of profiling information for the match.
+	 *
+	 *  If enabled, get_mset() counts and times calls to each postlist in
+	 *  the tree built for the query, and the results are available from
+	 *  MSet::get_profile().  This adds overhead to the match, so is off by
+	 *  default.
+	 *
+	 *  @param profiling  true to collect profiling information
+	 *		      (default: false).
+	 */
+	void set_profiling(bool profiling);
+
+	/** Rerank the top documents of each match.
+	 *
+	 *  If set, get_mset() first runs the match to find the best
+	 *  @a rerank_size documents (or first + maxitems if that's more),
+	 *  then passes them to @a reranker to calculate a new score for
+	 *  each, and returns the requested portion of the candidates sorted
+	 *  by these scores (documents with equal scores keep the order the
+	 *  match gave them).
+	 *
+	 *  The weight of each document in the returned MSet is the score
+	 *  from @a reranker, and get_max_possible() and get_max_attained()
+	 *  both return the highest score.  Percentages aren't meaningful for
+	 *  reranked results, so get_percent() always returns 100.
+	 *
+	 *  @param reranker	The reranker to use, or NULL to disable
+	 *			reranking (the default).  The object is not
+	 *			copied, so must remain valid while this
+	 *			Enquire uses it.
+	 *  @param rerank_size	The number of documents to rerank.
+	 */
+	void set_reranker(Xapian::Reranker * reranker,
+			  Xapian::doccount rerank_size);
+
+	/** Log queries which take longer than a threshold.
+	 *
+	 *  If get_mset() takes at least @a threshold seconds, a record of the
+	 *  query is passed to @a logger.  The record is a JSON object giving
+	 *  the serialised query, the weighting scheme and its parameters, the
+	 *  sort, collapse and cutoff settings, the time spent in each phase of
+	 *  the match (gathering statistics, building the postlist tree, the
+	 *  match loop, and waiting for remote servers) and the revision of each
+	 *  database searched.  The xapian-replay tool can rerun the query from
+	 *  this record, which helps to tell a query which is slow in itself
+	 *  from one which was slow because of the load at the time.
+	 *
+	 *  @param threshold	The time in seconds (0 logs every query).
+	 *  @param logger	The logger to use, or NULL to disable logging
+	 *			(the default).  The object is not copied, so
+	 *			must remain valid while this Enquire uses it.
+	 */
+	void set_slow_query_log(double threshold,
+				Xapian::SlowQueryLogger * logger);
+
+	/** Log queries which take longer than a threshold to a file.
+	 *
+	 *  Like the other form of set_slow_query_log(), but each record is
+	 *  appended to @a filename as a single line.  The file is opened for
+	 *  each record, so can safely be rotated, and several processes can
+	 *  log to the same file.  Any error writing to the file is ignored.
+	 *
+	 *  @param threshold	The time in seconds (0 logs every query).
+	 *  @param filename	The file to append records to.
+	 */
+	void set_slow_query_log(double threshold, const std::string & filename);
+
 	/** Get (a portion of) the match set for the current query.
 	 *
 	 *  @param first     the first item in the result set to return.
@@ -173,6 +173,18 @@ class XAPIAN_VISIBILITY_DEFAULT MatchSpy {
      *  subclass).
      */
     virtual std::string get_description() const;
+
+    /** Return an estimate of the bytes of memory used by the results.
+     *
+     *  This is used to report the memory used by a match (see
+     *  MSet::get_memory_usage()), and to enforce any limit set by
+     *  Enquire::set_memory_limit(), so it is called periodically during the
+     *  match and should be cheap.
+     *
+     *  This default implementation returns 0, which is appropriate for
+     *  subclasses which only use a fixed amount of memory.
+     */
+    virtual size_t get_memory_usage() const;
 };
 
 
@@ -195,8 +207,12 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
 	/// The values seen so far, together with their frequency.
 	std::map<std::string, Xapian::doccount> values;
 
-	Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
-	Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
+	/// Estimate of the bytes used by values.
+	size_t values_memory;
+
+	Internal() : slot(Xapian::BAD_VALUENO), total(0), values_memory(0) {}
+	Internal(Xapian::valueno slot_)
+	    : slot(slot_), total(0), values_memory(0) {}
     };
 #endif
 
@@ -264,6 +280,7 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
     virtual std::string serialise_results() const;
     virtual void merge_results(const std::string & serialised);
     virtual std::string get_description() const;
+    virtual size_t get_memory_usage() const;
 };
 
 }
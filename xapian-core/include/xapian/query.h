@@ -27,6 +27,7 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include <xapian/attributes.h>
 #include <xapian/intrusive_ptr.h>
@@ -110,6 +111,24 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
 	OP_SYNONYM = 13,
 	OP_MAX = 14,
 
+	/** Like OP_OR, but optimised for queries with many subqueries.
+	 *
+	 *  This matches the same documents with the same weights as OP_OR,
+	 *  but instead of combining the subqueries in a tree it keeps them
+	 *  ordered by the maximum weight each can contribute.  As the
+	 *  minimum weight needed to get into the results rises during the
+	 *  match, subqueries which can't get a document into the results
+	 *  without help from the others stop being used to find candidate
+	 *  documents, and are only checked for candidates found by the
+	 *  others which could still make it.
+	 *
+	 *  For long queries (e.g. built from natural language text) this
+	 *  gives speed similar to OP_ELITE_SET once the results have filled
+	 *  up, without having to pick how many terms to use, and without
+	 *  ignoring the other terms entirely.
+	 */
+	OP_ADAPTIVE_OR = 15,
+
 	LEAF_TERM = 100,
 	LEAF_POSTING_SOURCE,
 	LEAF_MATCH_ALL,
@@ -174,6 +193,23 @@ class XAPIAN_VISIBILITY_DEFAULT Query {
     Query(op op_, Xapian::valueno slot,
 	  const std::string & begin, const std::string & end);
 
+    /** Construct a query combining a list of terms.
+     *
+     *  This gives the same results as passing the list's begin and end
+     *  iterators, but the terms are held in a single node rather than a
+     *  subquery object being built for each, which is much cheaper for
+     *  machine-generated queries with many terms.  Such a query also
+     *  serialises more compactly.
+     *
+     *  The terms may be reordered, so the description of the query may not
+     *  list them in the order given.
+     *
+     *  @param op_	OP_AND, OP_OR or OP_SYNONYM.
+     *  @param terms	The terms to combine (each with wqf 1 and no
+     *			position).
+     */
+    Query(op op_, const std::vector<std::string> & terms);
+
     template<typename I>
     Query(op op_, I begin, I end, Xapian::termcount window = 0)
     {
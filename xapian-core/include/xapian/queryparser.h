@@ -551,7 +551,8 @@ class XAPIAN_VISIBILITY_DEFAULT QueryParser {
      *
      *				The most useful values for this are OP_OR (the
      *				default) and OP_AND.  OP_NEAR, OP_PHRASE,
-     *				OP_ELITE_SET and OP_SYNONYM are also permitted.
+     *				OP_ELITE_SET, OP_SYNONYM, OP_MAX and
+     *				OP_ADAPTIVE_OR are also permitted.
      *				Passing other values will result in
      *				InvalidArgumentError being thrown.
      */
@@ -578,6 +579,38 @@ class XAPIAN_VISIBILITY_DEFAULT QueryParser {
      */
     void set_max_wildcard_expansion(Xapian::termcount limit);
 
+    /** Set the number of parsed queries to cache.
+     *
+     *  If this is non-zero, parse_query() keeps the results of the most
+     *  recently used @a size calls, keyed on the query string, flags,
+     *  default prefix and the revision of the database set with
+     *  set_database().  Repeating a call returns the cached query (and
+     *  restores the stoplist, unstem and corrected query string) without
+     *  parsing it again.
+     *
+     *  The cache is emptied if any of the other settings of this object
+     *  are changed.  It isn't used if the database is of a type which
+     *  doesn't report its revision (e.g. inmemory or remote), and changes
+     *  which haven't been committed don't affect the revision.  Changes
+     *  to objects passed to this object (such as Stopper or
+     *  ValueRangeProcessor objects) aren't noticed, so call this method
+     *  again with 0 to empty the cache after making any.
+     *
+     *  The cache is protected by a lock and holds queries in serialised
+     *  form, so threads can share a single QueryParser object and its
+     *  cache: parse_query() calls from different threads are serialised,
+     *  and each returns its own Query object.  Pass the same object
+     *  between threads by reference rather than copying it, and don't
+     *  change its settings while other threads are parsing.  The stoplist,
+     *  unstem and corrected query string reflect the most recent call to
+     *  parse_query() from any thread, so a thread which needs them should
+     *  use its own QueryParser object.
+     *
+     *  @param size	The maximum number of parsed queries to cache, or 0
+     *			to disable caching (which is the default).
+     */
+    void set_cache_size(unsigned size);
+
     /** Parse a query.
      *
      *  @param query_string  A free-text query as entered by a user
@@ -35,7 +35,9 @@
 
 namespace Xapian {
 
+class Document;
 class MSet;
+class Query;
 class Stem;
 
 /** Class used to generate snippets from a given text.
@@ -75,6 +77,19 @@ class XAPIAN_VISIBILITY_DEFAULT Snipper {
     void set_mset(const MSet & mset,
 		  Xapian::doccount rm_docno = 10);
 
+    /** Set the query which snippets are being generated for.
+     *
+     *  Once a window of terms (of the size passed to generate_snippet())
+     *  containing all the terms from @a query has been found, the snippet
+     *  is taken from there without looking at the rest of the text.
+     *
+     *  Terms with a prefix are ignored.  Pass an empty Query to turn this
+     *  off again.
+     *
+     * @param query	The query.
+     */
+    void set_query(const Xapian::Query & query);
+
     /** Generate snippet from given text.
      *
      * @param text	    The text from which to generate the snippet
@@ -90,6 +105,30 @@ class XAPIAN_VISIBILITY_DEFAULT Snipper {
 				 Xapian::termcount window_size = 25,
 				 double smoothing = 0.5);
 
+    /** Generate snippet from given text, using stored positional information.
+     *
+     *  The terms and positions are read from @a doc rather than by
+     *  tokenising @a text, and @a text only needs to be tokenised as far as
+     *  the start of the snippet.  This assumes the unprefixed terms with
+     *  positional information in @a doc were generated by indexing @a text
+     *  (e.g. with TermGenerator::index_text()).  If @a doc has no such
+     *  positional information, this falls back to tokenising @a text.
+     *
+     * @param text	    The text from which to generate the snippet
+     * @param doc	    Document with positional information for @a text
+     * @param length	    Maximum length of the result in bytes
+     *			    (default: 200)
+     * @param window_size   Size of the window (default: 25)
+     * @param smoothing	    Smoothing coefficient (default: 0.5)
+     *
+     * @return	    Text of the snippet relevant to the model from input.
+     */
+    std::string generate_snippet(const std::string & text,
+				 const Xapian::Document & doc,
+				 size_t length = 200,
+				 Xapian::termcount window_size = 25,
+				 double smoothing = 0.5);
+
     /// Return a string describing this object.
     std::string get_description() const XAPIAN_PURE_FUNCTION;
 };
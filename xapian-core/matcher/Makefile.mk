@@ -1,4 +1,5 @@
 noinst_HEADERS +=\
+	matcher/adaptiveorpostlist.h\
 	matcher/andmaybepostlist.h\
 	matcher/andnotpostlist.h\
 	matcher/branchpostlist.h\
@@ -8,6 +9,7 @@ noinst_HEADERS +=\
 	matcher/externalpostlist.h\
 	matcher/extraweightpostlist.h\
 	matcher/localsubmatch.h\
+	matcher/matchprofile.h\
 	matcher/maxpostlist.h\
 	matcher/mergepostlist.h\
 	matcher/msetcmp.h\
@@ -17,6 +19,7 @@ noinst_HEADERS +=\
 	matcher/multixorpostlist.h\
 	matcher/orpostlist.h\
 	matcher/phrasepostlist.h\
+	matcher/profilepostlist.h\
 	matcher/queryoptimiser.h\
 	matcher/remotesubmatch.h\
 	matcher/selectpostlist.h\
@@ -38,6 +41,7 @@ EXTRA_DIST +=\
 	matcher/remotesubmatch.cc
 
 lib_src +=\
+	matcher/adaptiveorpostlist.cc\
 	matcher/andmaybepostlist.cc\
 	matcher/andnotpostlist.cc\
 	matcher/branchpostlist.cc\
@@ -46,6 +50,7 @@ lib_src +=\
 	matcher/exactphrasepostlist.cc\
 	matcher/externalpostlist.cc\
 	matcher/localsubmatch.cc\
+	matcher/matchprofile.cc\
 	matcher/maxpostlist.cc\
 	matcher/mergepostlist.cc\
 	matcher/msetcmp.cc\
@@ -55,6 +60,8 @@ lib_src +=\
 	matcher/multixorpostlist.cc\
 	matcher/orpostlist.cc\
 	matcher/phrasepostlist.cc\
+	matcher/profilepostlist.cc\
+	matcher/queryoptimiser.cc\
 	matcher/selectpostlist.cc\
 	matcher/synonympostlist.cc\
 	matcher/valuegepostlist.cc\
@@ -0,0 +1,365 @@
+/** @file adaptiveorpostlist.cc
+ * @brief N-way OR postlist which stops driving from low-weight sub-postlists
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "adaptiveorpostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+AdaptiveOrPostList::~AdaptiveOrPostList()
+{
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	delete i->pl;
+    }
+}
+
+void
+AdaptiveOrPostList::calc_bounds()
+{
+    // Use a stable sort so the order (and so the order the weights get
+    // summed in) doesn't depend on the sort implementation.
+    stable_sort(plist.begin(), plist.end());
+    bound.resize(plist.size());
+    double total = 0.0;
+    for (size_t i = 0; i != plist.size(); ++i) {
+	total += plist[i].max_wt;
+	bound[i] = total;
+    }
+    partition_w_min = -1.0;
+}
+
+void
+AdaptiveOrPostList::update_active_set(double w_min)
+{
+    if (w_min == partition_w_min)
+	return;
+    partition_w_min = w_min;
+    size_t n = 0;
+    while (n != bound.size() && bound[n] < w_min) ++n;
+    if (n != n_dropped) {
+	LOGLINE(MATCH, "AdaptiveOrPostList: w_min = " << w_min << ", dropping " <<
+		       n << " of " << plist.size() << " sub-postlists");
+	n_dropped = n;
+    }
+}
+
+bool
+AdaptiveOrPostList::advance_sublist(size_t i, Xapian::docid did_min,
+				    double w_min)
+{
+    PostList * pl = plist[i].pl;
+    Xapian::docid cur_did = started ? pl->get_docid() : 0;
+    if (cur_did >= did_min)
+	return true;
+
+    // Documents where this sub-postlist's weight is less than this can't
+    // reach w_min, whatever the other sub-postlists contribute.
+    double sub_w_min = w_min - (bound.back() - plist[i].max_wt);
+    if (sub_w_min < 0.0)
+	sub_w_min = 0.0;
+
+    PostList * res;
+    if (cur_did + 1 == did_min) {
+	res = pl->next(sub_w_min);
+    } else {
+	res = pl->skip_to(did_min, sub_w_min);
+    }
+    if (res) {
+	delete pl;
+	plist[i].pl = pl = res;
+	matcher->recalc_maxweight();
+    }
+
+    if (pl->at_end()) {
+	delete pl;
+	plist.erase(plist.begin() + i);
+	if (i < n_dropped) --n_dropped;
+	// The maxweights of the remaining sub-postlists haven't changed, so
+	// we just need to recalculate the bounds.
+	calc_bounds();
+	matcher->recalc_maxweight();
+	return false;
+    }
+    return true;
+}
+
+PostList *
+AdaptiveOrPostList::find_next(Xapian::docid did_min, double w_min)
+{
+    if (!started) {
+	for (size_t i = 0; i < plist.size(); ) {
+	    if (advance_sublist(i, did_min, w_min)) ++i;
+	}
+	started = true;
+    }
+
+    while (true) {
+	update_active_set(w_min);
+	if (n_dropped == plist.size()) {
+	    // Any documents left only match sub-postlists which we've
+	    // dropped, so can't reach w_min.
+	    did = 0;
+	    return NULL;
+	}
+
+	// Advance the active sub-postlists to did_min and find the lowest
+	// docid any of them are on.
+	bool removed = false;
+	did = 0;
+	for (size_t i = n_dropped; i < plist.size(); ) {
+	    if (!advance_sublist(i, did_min, w_min)) {
+		removed = true;
+		continue;
+	    }
+	    Xapian::docid cur_did = plist[i].pl->get_docid();
+	    if (did == 0 || cur_did < did)
+		did = cur_did;
+	    ++i;
+	}
+	// Removing a sub-postlist changes the bounds and so maybe which
+	// sub-postlists are active.
+	if (removed) continue;
+
+	double wt = 0.0;
+	for (size_t i = n_dropped; i != plist.size(); ++i) {
+	    PostList * pl = plist[i].pl;
+	    if (pl->get_docid() == did)
+		wt += pl->get_weight();
+	}
+
+	// Check the dropped sub-postlists, highest maxweight first, stopping
+	// as soon as the rest can't lift the weight to w_min.
+	size_t j = n_dropped;
+	while (j != 0 && wt + bound[j - 1] >= w_min) {
+	    --j;
+	    if (!advance_sublist(j, did, w_min)) {
+		removed = true;
+		break;
+	    }
+	    PostList * pl = plist[j].pl;
+	    if (pl->get_docid() == did)
+		wt += pl->get_weight();
+	}
+	if (removed) {
+	    did_min = did;
+	    continue;
+	}
+
+	if (j == 0 && wt >= w_min) {
+	    current_wt = wt;
+	    break;
+	}
+	did_min = did + 1;
+    }
+
+    if (plist.size() == 1) {
+	// Only one sub-postlist left (which must be active and on did), so
+	// replace ourselves with it.
+	PostList * pl = plist[0].pl;
+	plist.clear();
+	return pl;
+    }
+
+    return NULL;
+}
+
+Xapian::doccount
+AdaptiveOrPostList::get_termfreq_min() const
+{
+    Xapian::doccount res = 0;
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	res = max(res, i->pl->get_termfreq_min());
+    }
+    return res;
+}
+
+Xapian::doccount
+AdaptiveOrPostList::get_termfreq_max() const
+{
+    Xapian::doccount res = 0;
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	Xapian::doccount c = i->pl->get_termfreq_max();
+	if (db_size - res <= c)
+	    return db_size;
+	res += c;
+    }
+    return res;
+}
+
+Xapian::doccount
+AdaptiveOrPostList::get_termfreq_est() const
+{
+    if (rare(db_size == 0))
+	return 0;
+
+    // We calculate the estimate assuming independence.  The simplest
+    // way to calculate this seems to be a series of pairwise
+    // calculations, which gives the same answer regardless of the order.
+    double scale = 1.0 / db_size;
+    double P_est = 0.0;
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	double P_i = i->pl->get_termfreq_est() * scale;
+	P_est += P_i - P_est * P_i;
+    }
+    return static_cast<Xapian::doccount>(P_est * db_size + 0.5);
+}
+
+TermFreqs
+AdaptiveOrPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double scale = 1.0 / stats.collection_size;
+    double P_est = 0.0;
+    double Pr_est = 0.0;
+    double Pc_est = 0.0;
+
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	TermFreqs freqs(i->pl->get_termfreq_est_using_stats(stats));
+	double P_i = freqs.termfreq * scale;
+	P_est += P_i - P_est * P_i;
+	double Pc_i = freqs.collfreq * scale;
+	Pc_est += Pc_i - Pc_est * Pc_i;
+	// If the rset is empty, Pr_est should be 0 already, so leave
+	// it alone.
+	if (stats.rset_size != 0) {
+	    double Pr_i = freqs.reltermfreq / stats.rset_size;
+	    Pr_est += Pr_i - Pr_est * Pr_i;
+	}
+    }
+    return TermFreqs(Xapian::doccount(P_est * stats.collection_size + 0.5),
+		     Xapian::doccount(Pr_est * stats.rset_size + 0.5),
+		     Xapian::termcount(Pc_est * stats.total_term_count));
+}
+
+double
+AdaptiveOrPostList::get_maxweight() const
+{
+    return bound.empty() ? 0.0 : bound.back();
+}
+
+Xapian::docid
+AdaptiveOrPostList::get_docid() const
+{
+    return did;
+}
+
+Xapian::termcount
+AdaptiveOrPostList::get_doclength() const
+{
+    Assert(did);
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	if (i->pl->get_docid() == did)
+	    return i->pl->get_doclength();
+    }
+    Assert(false);
+    return 0;
+}
+
+double
+AdaptiveOrPostList::get_weight() const
+{
+    Assert(did);
+    return current_wt;
+}
+
+bool
+AdaptiveOrPostList::at_end() const
+{
+    return (did == 0);
+}
+
+double
+AdaptiveOrPostList::recalc_maxweight()
+{
+    vector<SubPostList>::iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	i->max_wt = i->pl->recalc_maxweight();
+    }
+    calc_bounds();
+    return get_maxweight();
+}
+
+PostList *
+AdaptiveOrPostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "AdaptiveOrPostList::next", w_min);
+    RETURN(find_next(did + 1, w_min));
+}
+
+PostList *
+AdaptiveOrPostList::skip_to(Xapian::docid did_min, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "AdaptiveOrPostList::skip_to", did_min | w_min);
+    if (started && did_min <= did)
+	RETURN(NULL);
+    RETURN(find_next(did_min, w_min));
+}
+
+string
+AdaptiveOrPostList::get_description() const
+{
+    string desc("(");
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	if (i != plist.begin()) desc += " ADAPTIVE_OR ";
+	desc += i->pl->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+AdaptiveOrPostList::get_wdf() const
+{
+    Xapian::termcount totwdf = 0;
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	if (i->pl->get_docid() == did)
+	    totwdf += i->pl->get_wdf();
+    }
+    return totwdf;
+}
+
+Xapian::termcount
+AdaptiveOrPostList::count_matching_subqs() const
+{
+    Xapian::termcount total = 0;
+    vector<SubPostList>::const_iterator i;
+    for (i = plist.begin(); i != plist.end(); ++i) {
+	if (i->pl->get_docid() == did)
+	    total += i->pl->count_matching_subqs();
+    }
+    return total;
+}
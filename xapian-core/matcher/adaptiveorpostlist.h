@@ -0,0 +1,172 @@
+/** @file adaptiveorpostlist.h
+ * @brief N-way OR postlist which stops driving from low-weight sub-postlists
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_ADAPTIVEORPOSTLIST_H
+#define XAPIAN_INCLUDED_ADAPTIVEORPOSTLIST_H
+
+#include "api/postlist.h"
+
+#include <vector>
+
+class MultiMatch;
+
+/** N-way OR postlist with wt=sum(wt_i) for use with many sub-postlists.
+ *
+ *  The sub-postlists are kept in ascending order of maxweight.  Whenever
+ *  w_min increases, we find the longest run of sub-postlists at the start of
+ *  this order whose combined maxweight is less than w_min - a document which
+ *  only matches these can't reach w_min, so they are no longer used to find
+ *  candidate documents.  Since w_min never decreases, once a sub-postlist has
+ *  been dropped from the active set in this way it stays dropped.
+ *
+ *  A dropped sub-postlist is only moved (with skip_to()) when a candidate
+ *  found by the active sub-postlists might still reach w_min, and we give up
+ *  on a candidate as soon as the weight so far plus the maxweight of the
+ *  dropped sub-postlists not yet checked can't reach w_min.
+ *
+ *  This gives the same results as OrPostList but, like OP_ELITE_SET, ends up
+ *  only looking at the higher weighted terms once w_min is high enough, and
+ *  without needing to be told how many terms to use.
+ */
+class AdaptiveOrPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const AdaptiveOrPostList &);
+
+    /// Don't allow copying.
+    AdaptiveOrPostList(const AdaptiveOrPostList &);
+
+    /// A sub-postlist and its maxweight.
+    struct SubPostList {
+	PostList * pl;
+
+	double max_wt;
+
+	SubPostList(PostList * pl_) : pl(pl_), max_wt(0.0) { }
+
+	bool operator<(const SubPostList & o) const { return max_wt < o.max_wt; }
+    };
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// Have the sub-postlists been started?
+    bool started;
+
+    /// The weight of the current document.
+    double current_wt;
+
+    /// The sub-postlists, in ascending order of maxweight.
+    std::vector<SubPostList> plist;
+
+    /// bound[i] is the sum of the maxweights of plist[0] to plist[i].
+    std::vector<double> bound;
+
+    /** The number of sub-postlists dropped from the active set.
+     *
+     *  These are plist[0] to plist[n_dropped - 1].
+     */
+    size_t n_dropped;
+
+    /** The w_min which n_dropped was calculated for.
+     *
+     *  Negative if n_dropped needs recalculating.
+     */
+    double partition_w_min;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    MultiMatch *matcher;
+
+    /// Sort plist by maxweight and recalculate bound.
+    void calc_bounds();
+
+    /// Recalculate n_dropped for @a w_min if necessary.
+    void update_active_set(double w_min);
+
+    /** Call next() or skip_to() on sub-postlist @a i.
+     *
+     *  If it runs off the end, it is removed.
+     *
+     *  @return false if sub-postlist @a i was removed.
+     */
+    bool advance_sublist(size_t i, Xapian::docid did_min, double w_min);
+
+    /** Find the first document >= @a did_min which could reach @a w_min.
+     *
+     *  @return A replacement postlist, or NULL.
+     */
+    PostList * find_next(Xapian::docid did_min, double w_min);
+
+  public:
+    /** Construct from 2 random-access iterators to a container of PostList*,
+     *  a pointer to the matcher, and the document collection size.
+     */
+    template <class RandomItor>
+    AdaptiveOrPostList(RandomItor pl_begin, RandomItor pl_end,
+		       MultiMatch * matcher_, Xapian::doccount db_size_)
+	: did(0), started(false), current_wt(0.0), plist(pl_begin, pl_end),
+	  n_dropped(0), partition_w_min(-1.0), db_size(db_size_),
+	  matcher(matcher_)
+    {
+	recalc_maxweight();
+    }
+
+    ~AdaptiveOrPostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    double get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    double get_weight() const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    PositionList * read_position_list() {
+	return NULL;
+    }
+
+    Internal *next(double w_min);
+
+    Internal *skip_to(Xapian::docid, double w_min);
+
+    std::string get_description() const;
+
+    /// Return the sum of the wdfs of the sub-postlists matching the document.
+    Xapian::termcount get_wdf() const;
+
+    Xapian::termcount count_matching_subqs() const;
+};
+
+#endif // XAPIAN_INCLUDED_ADAPTIVEORPOSTLIST_H
@@ -94,6 +94,9 @@ Collapser::process(Xapian::Internal::MSetItem & item,
 	// We've not seen this collapse key before.
 	table.insert(make_pair(item.collapse_key, CollapseData(item)));
 	++entry_count;
+	key_bytes += MAP_ENTRY_OVERHEAD +
+		     string_memory_usage(item.collapse_key.size()) +
+		     sizeof(CollapseData);
 	return ADDED;
     }
 
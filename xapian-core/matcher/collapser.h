@@ -22,6 +22,7 @@
 #define XAPIAN_INCLUDED_COLLAPSER_H
 
 #include "backends/document.h"
+#include "backends/memoryusage.h"
 #include "msetcmp.h"
 #include "api/omenquireinternal.h"
 #include "api/postlist.h"
@@ -91,6 +92,9 @@ class Collapser {
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count;
 
+    /// Estimate of the bytes used by the keys in @a table.
+    size_t key_bytes;
+
     /** How many documents have we seen without a collapse key?
      *
      *  We use this statistic to improve matches_lower_bound.
@@ -122,7 +126,7 @@ class Collapser {
     Xapian::Internal::MSetItem old_item;
 
     Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_)
-	: entry_count(0), no_collapse_key(0), dups_ignored(0),
+	: entry_count(0), key_bytes(0), no_collapse_key(0), dups_ignored(0),
 	  docs_considered(0), slot(slot_), collapse_max(collapse_max_),
 	  old_item(0, 0) { }
 
@@ -157,6 +161,11 @@ class Collapser {
     Xapian::doccount get_matches_lower_bound() const;
 
     bool empty() const { return table.empty(); }
+
+    /// Return an estimate of the bytes used by the collapse table.
+    size_t get_memory_usage() const {
+	return key_bytes + entry_count * sizeof(Xapian::Internal::MSetItem);
+    }
 };
 
 #endif // XAPIAN_INCLUDED_COLLAPSER_H
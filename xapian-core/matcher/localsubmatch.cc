@@ -77,11 +77,9 @@ LocalSubMatch::get_postlist(MultiMatch * matcher,
     // Build the postlist tree for the query.  This calls
     // LocalSubMatch::open_post_list() for each term in the query.
     PostList * pl;
-    {
-	QueryOptimiser opt(*db, *this, matcher);
-	pl = query.internal->postlist(&opt, 1.0);
-	*total_subqs_ptr = opt.get_total_subqs();
-    }
+    QueryOptimiser opt(*db, *this, matcher, matcher->get_profile());
+    pl = query.internal->postlist(&opt, 1.0);
+    *total_subqs_ptr = opt.get_total_subqs();
 
     AutoPtr<Xapian::Weight> extra_wt(wt_factory->clone());
     extra_wt->init_(*stats, qlen);
@@ -90,6 +88,7 @@ LocalSubMatch::get_postlist(MultiMatch * matcher,
 	// postlist tree with an ExtraWeightPostList which adds in this
 	// contribution.
 	pl = new ExtraWeightPostList(pl, extra_wt.release(), matcher);
+	pl = opt.profile(pl, "EXTRA_WEIGHT");
     }
 
     RETURN(pl);
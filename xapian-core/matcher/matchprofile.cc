@@ -0,0 +1,144 @@
+/** @file matchprofile.cc
+ * @brief Collect per-postlist counters for a profiled match.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "matchprofile.h"
+
+#include "autoptr.h"
+#include "jsonescape.h"
+#include "str.h"
+
+using namespace std;
+
+MatchProfile::~MatchProfile()
+{
+    vector<Node *>::const_iterator i;
+    for (i = nodes.begin(); i != nodes.end(); ++i) {
+	delete *i;
+    }
+}
+
+MatchProfile::Node *
+MatchProfile::add_node(const string & label)
+{
+    AutoPtr<Node> node(new Node(label, shard));
+    nodes.push_back(node.get());
+    return node.release();
+}
+
+void
+MatchProfile::set_remote_profile(const string & json)
+{
+    if (remote_profiles.size() <= shard)
+	remote_profiles.resize(shard + 1);
+    remote_profiles[shard] = json;
+}
+
+void
+MatchProfile::note_accepted(Xapian::docid did, unsigned n_shards)
+{
+    unsigned shard_ = (did - 1) % n_shards;
+    Xapian::docid local_did = (did - 1) / n_shards + 1;
+    vector<Node *>::const_iterator i;
+    for (i = nodes.begin(); i != nodes.end(); ++i) {
+	Node * node = *i;
+	if (node->docid == local_did && node->shard == shard_)
+	    ++node->docs_accepted;
+    }
+}
+
+void
+MatchProfile::append_node(string & result, const Node * node) const
+{
+    result += "{\"label\":";
+    append_json_string(result, node->label);
+    result += ",\"next\":";
+    result += str(node->next_calls);
+    result += ",\"skip_to\":";
+    result += str(node->skip_to_calls);
+    result += ",\"check\":";
+    result += str(node->check_calls);
+    result += ",\"get_weight\":";
+    result += str(node->weight_calls);
+    result += ",\"docs_examined\":";
+    result += str(node->docs_examined);
+    result += ",\"docs_accepted\":";
+    result += str(node->docs_accepted);
+    result += ",\"chunk_reads\":";
+    result += str(node->chunk_reads);
+    result += ",\"time\":";
+    result += str(node->get_time());
+    if (!node->children.empty()) {
+	result += ",\"children\":[";
+	vector<Node *>::const_iterator i;
+	for (i = node->children.begin(); i != node->children.end(); ++i) {
+	    if (i != node->children.begin()) result += ',';
+	    append_node(result, *i);
+	}
+	result += ']';
+    }
+    result += '}';
+}
+
+string
+MatchProfile::get_json(Xapian::doccount accepted, double elapsed) const
+{
+    // Find the highest shard number we've seen.
+    size_t n_shards = remote_profiles.size();
+    vector<Node *>::const_iterator i;
+    for (i = nodes.begin(); i != nodes.end(); ++i) {
+	if ((*i)->shard >= n_shards) n_shards = (*i)->shard + 1;
+    }
+
+    string result = "{\"accepted\":";
+    result += str(accepted);
+    result += ",\"time\":";
+    result += str(elapsed);
+    result += ",\"shards\":[";
+    for (unsigned shard_ = 0; shard_ != n_shards; ++shard_) {
+	if (shard_) result += ',';
+	result += "{\"shard\":";
+	result += str(shard_);
+	if (shard_ < remote_profiles.size() &&
+	    !remote_profiles[shard_].empty()) {
+	    // The remote server already produced JSON for its match.
+	    result += ",\"remote\":";
+	    result += remote_profiles[shard_];
+	} else {
+	    // Nodes which were never called (e.g. those discarded by
+	    // OP_ELITE_SET) don't appear in the tree.
+	    result += ",\"roots\":[";
+	    bool first = true;
+	    for (i = nodes.begin(); i != nodes.end(); ++i) {
+		const Node * node = *i;
+		if (node->shard != shard_ || !node->called || node->parent)
+		    continue;
+		if (!first) result += ',';
+		first = false;
+		append_node(result, node);
+	    }
+	    result += ']';
+	}
+	result += '}';
+    }
+    result += "]}";
+    return result;
+}
@@ -0,0 +1,171 @@
+/** @file matchprofile.h
+ * @brief Collect per-postlist counters for a profiled match.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MATCHPROFILE_H
+#define XAPIAN_INCLUDED_MATCHPROFILE_H
+
+#include <string>
+#include <vector>
+
+#include "xapian/types.h"
+
+/** Counters for a match run with Enquire::set_profiling() enabled.
+ *
+ *  Each ProfilePostList in the postlist tree owns a Node here.  The shape of
+ *  the tree isn't known when the postlists are built (the contexts in
+ *  queryinternal.cc combine them in various ways), so instead we note which
+ *  node was active when each node is first called, which gives us its parent.
+ */
+class MatchProfile {
+    /// Don't allow assignment.
+    void operator=(const MatchProfile &);
+
+    /// Don't allow copying.
+    MatchProfile(const MatchProfile &);
+
+  public:
+    /// Counters for a single postlist in the tree.
+    struct Node {
+	/// Operator name, or the term for a leaf.
+	std::string label;
+
+	/// The subdatabase this node was built for.
+	unsigned shard;
+
+	/// Has this node been called yet?
+	bool called;
+
+	/// The node which first called this node (NULL for a root).
+	Node * parent;
+
+	/// Nodes which this node has called, in order of first call.
+	std::vector<Node *> children;
+
+	Xapian::doccount next_calls;
+
+	Xapian::doccount skip_to_calls;
+
+	Xapian::doccount check_calls;
+
+	Xapian::doccount weight_calls;
+
+	/// Number of documents this postlist was left positioned on.
+	Xapian::doccount docs_examined;
+
+	/** Number of documents the matcher accepted while this postlist was
+	 *  positioned on them.
+	 */
+	Xapian::doccount docs_accepted;
+
+	/// The docid this postlist is positioned on, or 0 if not known.
+	Xapian::docid docid;
+
+	/// Number of chunks of posting data read (leaf postlists only).
+	Xapian::termcount chunk_reads;
+
+	/// Time spent in the calls which were timed.
+	double time;
+
+	/// Number of calls which were timed.
+	Xapian::doccount timed_calls;
+
+	/// Number of calls until the next one to time.
+	unsigned calls_to_next_timing;
+
+	Node(const std::string & label_, unsigned shard_)
+	    : label(label_), shard(shard_), called(false), parent(NULL),
+	      next_calls(0), skip_to_calls(0), check_calls(0),
+	      weight_calls(0), docs_examined(0), docs_accepted(0), docid(0),
+	      chunk_reads(0), time(0.0), timed_calls(0),
+	      calls_to_next_timing(1) { }
+
+	/// Estimate the time spent in all the calls, from those timed.
+	double get_time() const {
+	    if (timed_calls == 0) return 0.0;
+	    Xapian::doccount calls =
+		next_calls + skip_to_calls + check_calls + weight_calls;
+	    return time * calls / timed_calls;
+	}
+    };
+
+  private:
+    /// All the nodes (owned by us).
+    std::vector<Node *> nodes;
+
+    /// Profile JSON returned by each remote subdatabase (indexed by shard).
+    std::vector<std::string> remote_profiles;
+
+    /// The node currently being called, or NULL.
+    Node * current;
+
+    /// The subdatabase postlists are currently being built for.
+    unsigned shard;
+
+    /// Append JSON for @a node and its children to @a result.
+    void append_node(std::string & result, const Node * node) const;
+
+  public:
+    MatchProfile() : current(NULL), shard(0) { }
+
+    ~MatchProfile();
+
+    /// Set the subdatabase which subsequently added nodes belong to.
+    void set_shard(unsigned shard_) { shard = shard_; }
+
+    /// Add a node for a postlist (owned by this object).
+    Node * add_node(const std::string & label);
+
+    /// Record the profile returned by the current (remote) subdatabase.
+    void set_remote_profile(const std::string & json);
+
+    /** Note that the matcher accepted document @a did.
+     *
+     *  @param did	The docid in the combined database.
+     *  @param n_shards	The number of subdatabases.
+     */
+    void note_accepted(Xapian::docid did, unsigned n_shards);
+
+    /** Note that @a node is being called.
+     *
+     *  @return The previously active node, to pass to leave().
+     */
+    Node * enter(Node * node) {
+	if (!node->called) {
+	    node->called = true;
+	    node->parent = current;
+	    if (current) current->children.push_back(node);
+	}
+	Node * saved = current;
+	current = node;
+	return saved;
+    }
+
+    /// Note that the call which entered @a saved's child has returned.
+    void leave(Node * saved) { current = saved; }
+
+    /** Return the profile as JSON.
+     *
+     *  @param accepted	Number of documents the matcher accepted.
+     *  @param elapsed	Time taken by the whole match.
+     */
+    std::string get_json(Xapian::doccount accepted, double elapsed) const;
+};
+
+#endif // XAPIAN_INCLUDED_MATCHPROFILE_H
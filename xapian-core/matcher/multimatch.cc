@@ -35,6 +35,9 @@
 #include "omassert.h"
 #include "api/omenquireinternal.h"
 #include "realtime.h"
+#include "str.h"
+#include "stringutils.h"
+#include "tracepoint.h"
 
 #include "api/emptypostlist.h"
 #include "branchpostlist.h"
@@ -59,6 +62,7 @@
 #include <algorithm>
 #include <cfloat> // For DBL_EPSILON.
 #include <climits> // For UINT_MAX.
+#include <cstdlib> // For strtoul().
 #include <vector>
 #include <map>
 #include <set>
@@ -205,7 +209,8 @@ split_rset_by_db(const Xapian::RSet * rset,
 static void
 prepare_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
 		    Xapian::ErrorHandler * errorhandler,
-		    Xapian::Weight::Internal & stats)
+		    Xapian::Weight::Internal & stats,
+		    double & remote_wait)
 {
     LOGCALL_STATIC_VOID(MATCH, "prepare_sub_matches", leaves | errorhandler | stats);
     // We use a vector<bool> to track which SubMatches we're already prepared.
@@ -218,10 +223,13 @@ prepare_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
 	    if (prepared[leaf]) continue;
 	    try {
 		SubMatch * submatch = leaves[leaf].get();
+		// Only remote submatches block when nowait is false.
+		double start = nowait ? 0.0 : RealTime::now();
 		if (!submatch || submatch->prepare_match(nowait, stats)) {
 		    prepared[leaf] = true;
 		    --unprepared;
 		}
+		if (!nowait) remote_wait += RealTime::now() - start;
 	    } catch (Xapian::Error & e) {
 		if (!errorhandler) throw;
 
@@ -265,6 +273,43 @@ MultipleMatchSpy::operator()(const Xapian::Document &doc, double wt) {
     }
 }
 
+/// Bytes of key data held by an MSetItem, beyond sizeof(MSetItem).
+static inline size_t
+item_key_bytes(const Xapian::Internal::MSetItem & item)
+{
+    return item.sort_key.size() + item.collapse_key.size();
+}
+
+/** Estimate the memory used by a match.
+ *
+ *  @param key_bytes	Total of item_key_bytes() over @a items - the match
+ *			loop keeps a running total so that we don't need to
+ *			walk @a items on every check.
+ */
+static void
+measure_memory_usage(Xapian::Internal::MatchMemoryUsage & usage,
+		     const vector<Xapian::Internal::MSetItem> & items,
+		     size_t key_bytes,
+		     const Collapser * collapser,
+		     const vector<Xapian::MatchSpy *> & spies)
+{
+    usage.items = items.capacity() * sizeof(Xapian::Internal::MSetItem);
+    usage.items += key_bytes;
+    usage.collapse = collapser ? collapser->get_memory_usage() : 0;
+    usage.matchspies = 0;
+    vector<Xapian::MatchSpy *>::const_iterator j;
+    for (j = spies.begin(); j != spies.end(); ++j) {
+	usage.matchspies += (*j)->get_memory_usage();
+    }
+    usage.known = true;
+}
+
+/** How many candidates to consider between checks of the memory used.
+ *
+ *  Must be a power of 2.
+ */
+static const Xapian::doccount MEMORY_CHECK_INTERVAL = 256;
+
 ////////////////////////////////////
 // Initialisation and cleaning up //
 ////////////////////////////////////
@@ -280,11 +325,13 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       Xapian::Enquire::Internal::sort_setting sort_by_,
 		       bool sort_value_forward_,
 		       double time_limit_,
+		       size_t memory_limit_,
 		       Xapian::ErrorHandler * errorhandler_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
 		       const vector<Xapian::MatchSpy *> & matchspies_,
-		       bool have_sorter, bool have_mdecider)
+		       bool have_sorter, bool have_mdecider,
+		       bool profiling)
 	: db(db_), query(query_),
 	  collapse_max(collapse_max_), collapse_key(collapse_key_),
 	  percent_cutoff(percent_cutoff_), weight_cutoff(weight_cutoff_),
@@ -292,14 +339,17 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 	  sort_key(sort_key_), sort_by(sort_by_),
 	  sort_value_forward(sort_value_forward_),
 	  time_limit(time_limit_),
+	  memory_limit(memory_limit_),
 	  errorhandler(errorhandler_), weight(weight_),
 	  is_remote(db.internal.size()),
-	  matchspies(matchspies_)
+	  matchspies(matchspies_),
+	  profile(profiling ? new MatchProfile : NULL)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_| errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_ | memory_limit_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider | profiling);
 
     if (query.empty()) return;
 
+    double start_time = RealTime::now();
     Xapian::doccount number_of_subdbs = db.internal.size();
     vector<Xapian::RSet> subrsets;
     split_rset_by_db(omrset, number_of_subdbs, subrsets);
@@ -325,7 +375,7 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 				  order, sort_key, sort_by, sort_value_forward,
 				  time_limit,
 				  percent_cutoff, weight_cutoff, weight,
-				  subrsets[i], matchspies);
+				  subrsets[i], matchspies, profiling);
 		bool decreasing_relevance =
 		    (sort_by == REL || sort_by == REL_VAL);
 		smatch = new RemoteSubMatch(rem_db, decreasing_relevance, matchspies);
@@ -350,8 +400,9 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     }
 
     stats.mark_wanted_terms(query);
-    prepare_sub_matches(leaves, errorhandler, stats);
+    prepare_sub_matches(leaves, errorhandler, stats, timings.remote);
     stats.set_bounds_from_db(db);
+    timings.stats = RealTime::now() - start_time;
 }
 
 double
@@ -393,14 +444,33 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 
     TimeOut timeout(time_limit);
 
+    double start_time = RealTime::now();
+
+    XAPIAN_TRACE(match_start, leaves.size(), check_at_least);
+
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     // If there's only one database and it's remote, we can just unserialise
-    // its MSet and return that.
+    // its MSet and return that.  If profiling, the remote server's profile
+    // is wrapped up in the same way as when there are several shards.
     if (leaves.size() == 1 && is_remote[0]) {
 	RemoteSubMatch * rem_match;
 	rem_match = static_cast<RemoteSubMatch*>(leaves[0].get());
 	rem_match->start_match(first, maxitems, check_at_least, stats);
 	rem_match->get_mset(mset);
+	// All the time was spent waiting for the remote server.
+	timings.loop = RealTime::now() - start_time;
+	timings.remote += timings.loop;
+	if (profile.get()) {
+	    // The documents the server accepted are the only ones accepted.
+	    const string & remote_profile = mset.internal->profile;
+	    Xapian::doccount accepted = 0;
+	    if (startswith(remote_profile, "{\"accepted\":"))
+		accepted = strtoul(remote_profile.c_str() + 12, NULL, 10);
+	    profile->set_shard(0);
+	    profile->set_remote_profile(remote_profile);
+	    mset.internal->profile = profile->get_json(accepted, timings.loop);
+	}
+	XAPIAN_TRACE(match_end, mset.size(), 0);
 	return;
     }
 #endif
@@ -435,8 +505,12 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
 	try {
+	    if (profile.get()) profile->set_shard(i);
+	    // For a remote submatch, this waits for the server's results.
+	    double leaf_start = is_remote[i] ? RealTime::now() : 0.0;
 	    pl = leaves[i]->get_postlist(this, &total_subqs);
 	    if (is_remote[i]) {
+		timings.remote += RealTime::now() - leaf_start;
 		if (pl->get_termfreq_min() > first + maxitems) {
 		    LOGLINE(MATCH, "Found " <<
 				   pl->get_termfreq_min() - (first + maxitems)
@@ -473,6 +547,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     }
 
     LOGLINE(MATCH, "pl = (" << pl->get_description() << ")");
+    XAPIAN_TRACE(match_postlists, total_subqs, 0);
+    double loop_start_time = RealTime::now();
+    timings.postlists = loop_start_time - start_time;
 
     // Empty result set
     Xapian::doccount docs_matched = 0;
@@ -515,6 +592,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // maxweight).
     if (check_at_least == 0) {
 	pl.reset(NULL);
+	double elapsed = profile.get() ? RealTime::now() - start_time : 0.0;
 	Xapian::doccount uncollapsed_lower_bound = matches_lower_bound;
 	if (collapse_max) {
 	    // Lower bound must be set to no more than collapse_max, since it's
@@ -524,6 +602,16 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		matches_lower_bound = collapse_max;
 	}
 
+	// The MSet::Internal constructor takes the contents of items.
+	Xapian::Internal::MatchMemoryUsage memory_usage;
+	size_t key_bytes = 0;
+	vector<Xapian::Internal::MSetItem>::const_iterator i;
+	for (i = items.begin(); i != items.end(); ++i) {
+	    key_bytes += item_key_bytes(*i);
+	}
+	measure_memory_usage(memory_usage, items, key_bytes, NULL, matchspies);
+	memory_usage.limit = memory_limit;
+
 	mset = Xapian::MSet(new Xapian::MSet::Internal(
 					   first,
 					   matches_upper_bound,
@@ -534,6 +622,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 					   matches_estimated,
 					   max_possible, greatest_wt, items,
 					   0));
+	if (profile.get())
+	    mset.internal->profile = profile->get_json(0, elapsed);
+	mset.internal->memory_usage = memory_usage;
+	XAPIAN_TRACE(match_end, mset.size(), 0);
 	return;
     }
 
@@ -547,6 +639,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount max_msize = first + maxitems;
     items.reserve(max_msize + 1);
 
+    // Running total of item_key_bytes() over items, for measuring the
+    // memory used.
+    size_t items_key_bytes = 0;
+
     // Tracks the minimum item currently eligible for the MSet - we compare
     // candidate items against this.
     Xapian::Internal::MSetItem min_item(0.0, 0);
@@ -582,6 +678,11 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Number of candidates considered, used to decide when to check the
+    // memory used if there's a memory limit.
+    Xapian::doccount candidates = 0;
+    bool memory_limit_exceeded = false;
+
     while (true) {
 	bool pushback;
 
@@ -637,6 +738,17 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (check_at_least > maxitems && timeout.timed_out()) {
 	    check_at_least = maxitems;
 	}
+	if (rare(memory_limit != 0) && check_at_least > maxitems &&
+	    (++candidates & (MEMORY_CHECK_INTERVAL - 1)) == 0) {
+	    Xapian::Internal::MatchMemoryUsage usage;
+	    measure_memory_usage(usage, items, items_key_bytes, &collapser,
+				 matchspies);
+	    if (usage.total() >= memory_limit) {
+		LOGLINE(MATCH, "Memory limit reached, reducing check_at_least");
+		check_at_least = maxitems;
+		memory_limit_exceeded = true;
+	    }
+	}
 
 	if (sort_by != REL) {
 	    if (sorter) {
@@ -655,6 +767,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		    // processing needed.
 		    LOGLINE(MATCH, "Making note of match item which sorts lower than min_item");
 		    ++docs_matched;
+		    if (rare(profile.get()))
+			profile->note_accepted(did, db.internal.size());
 		    if (!calculated_weight) wt = pl->get_weight();
 		    if (matchspy) {
 			matchspy->operator()(doc, wt);
@@ -750,6 +864,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    // elt is bigger, so we just swap down the tree).
 			    // FIXME: implement this, and clean up is_heap
 			    // handling
+			    items_key_bytes -= item_key_bytes(*i);
+			    items_key_bytes += item_key_bytes(new_item);
 			    *i = new_item;
 			    pushback = false;
 			    is_heap = false;
@@ -763,6 +879,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	// OK, actually add the item to the mset.
 	if (pushback) {
 	    ++docs_matched;
+	    if (rare(profile.get()))
+		profile->note_accepted(did, db.internal.size());
+	    items_key_bytes += item_key_bytes(new_item);
 	    if (items.size() >= max_msize) {
 		items.push_back(new_item);
 		if (!is_heap) {
@@ -774,6 +893,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		}
 		pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
 			 MSetCmp>(items.begin(), items.end(), mcmp);
+		items_key_bytes -= item_key_bytes(items.back());
 		items.pop_back();
 
 		min_item = items.front();
@@ -856,6 +976,7 @@ new_greatest_weight:
 			pop_heap<vector<Xapian::Internal::MSetItem>::iterator,
 				 MSetCmp>(items.begin(), items.end(), mcmp);
 			Assert(items.back().wt < min_weight);
+			items_key_bytes -= item_key_bytes(items.back());
 			items.pop_back();
 		    }
 #ifdef XAPIAN_ASSERTIONS_PARANOID
@@ -871,6 +992,19 @@ new_greatest_weight:
 
     // done with posting list tree
     pl.reset(NULL);
+    XAPIAN_TRACE(match_loop_end, docs_matched, items.size());
+    timings.loop = RealTime::now() - loop_start_time;
+
+    // Note the memory used now, before the unwanted items are discarded.
+    Xapian::Internal::MatchMemoryUsage memory_usage;
+    measure_memory_usage(memory_usage, items, items_key_bytes, &collapser,
+			 matchspies);
+    memory_usage.limit = memory_limit;
+    memory_usage.limit_exceeded = memory_limit_exceeded;
+
+    // Only report documents we actually considered here, not those which
+    // matched remotely but weren't returned.
+    Xapian::doccount docs_accepted = docs_matched;
 
     double percent_scale = 0;
     if (!items.empty() && greatest_wt > 0) {
@@ -1157,4 +1291,10 @@ new_greatest_weight:
 				       uncollapsed_estimated,
 				       max_possible, greatest_wt, items,
 				       percent_scale * 100.0));
+    if (profile.get()) {
+	double elapsed = RealTime::now() - start_time;
+	mset.internal->profile = profile->get_json(docs_accepted, elapsed);
+    }
+    mset.internal->memory_usage = memory_usage;
+    XAPIAN_TRACE(match_end, mset.size(), 0);
 }
@@ -26,11 +26,31 @@
 
 #include "submatch.h"
 
+#include "autoptr.h"
+#include "matchprofile.h"
+
 #include <vector>
 
 #include "xapian/query.h"
 #include "xapian/weight.h"
 
+/// The time in seconds spent in each phase of a match.
+struct MatchTimings {
+    /// Gathering the statistics (in the MultiMatch constructor).
+    double stats;
+
+    /// Starting the submatches and building the postlist tree.
+    double postlists;
+
+    /// The match loop.
+    double loop;
+
+    /// Waiting for remote servers (which is included in the above).
+    double remote;
+
+    MatchTimings() : stats(0), postlists(0), loop(0), remote(0) { }
+};
+
 class MultiMatch
 {
     private:
@@ -59,6 +79,9 @@ class MultiMatch
 
 	double time_limit;
 
+	/// Bytes of memory to reduce check_at_least after (0 for no limit).
+	size_t memory_limit;
+
 	/// ErrorHandler
 	Xapian::ErrorHandler * errorhandler;
 
@@ -76,6 +99,12 @@ class MultiMatch
 	/// The matchspies to use.
 	const vector<Xapian::MatchSpy *> & matchspies;
 
+	/// Profiling counters, or NULL if profiling isn't enabled.
+	AutoPtr<MatchProfile> profile;
+
+	/// The time spent in each phase of the match.
+	MatchTimings timings;
+
 	/** get the maxweight that the postlist pl may return, calling
 	 *  recalc_maxweight if recalculate_w_max is set, and unsetting it.
 	 *  Must only be called on the top of the postlist tree.
@@ -97,12 +126,15 @@ class MultiMatch
 	 *  @param omrset    The relevance set (or NULL for no RSet)
 	 *  @param time_limit_ Seconds to reduce check_at_least after (or <= 0
 	 *                     for no limit)
+	 *  @param memory_limit_ Estimated bytes of memory used by the match to
+	 *                       reduce check_at_least after (or 0 for no limit)
 	 *  @param errorhandler Errorhandler object
 	 *  @param stats     The stats object to add our stats to.
 	 *  @param wtscheme  Weighting scheme
 	 *  @param matchspies_ Any the MatchSpy objects in use.
 	 *  @param have_sorter Is there a sorter in use?
 	 *  @param have_mdecider Is there a Xapian::MatchDecider in use?
+	 *  @param profiling Should we collect profiling counters?
 	 */
 	MultiMatch(const Xapian::Database &db_,
 		   const Xapian::Query & query,
@@ -117,11 +149,13 @@ class MultiMatch
 		   Xapian::Enquire::Internal::sort_setting sort_by_,
 		   bool sort_value_forward_,
 		   double time_limit_,
+		   size_t memory_limit_,
 		   Xapian::ErrorHandler * errorhandler,
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
 		   const vector<Xapian::MatchSpy *> & matchspies_,
-		   bool have_sorter, bool have_mdecider);
+		   bool have_sorter, bool have_mdecider,
+		   bool profiling = false);
 
 	/** Run the match and generate an MSet object.
 	 *
@@ -141,6 +175,12 @@ class MultiMatch
 	void recalc_maxweight() {
 	    recalculate_w_max = true;
 	}
+
+	/// Return the profile to record in, or NULL if not profiling.
+	MatchProfile * get_profile() { return profile.get(); }
+
+	/// Return the time spent in each phase of the match.
+	const MatchTimings & get_timings() const { return timings; }
 };
 
 #endif /* OM_HGUARD_MULTIMATCH_H */
@@ -0,0 +1,237 @@
+/** @file profilepostlist.cc
+ * @brief PostList which counts and times calls to the postlist it wraps.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "profilepostlist.h"
+
+#include "api/leafpostlist.h"
+#include "debuglog.h"
+#include "multimatch.h"
+#include "realtime.h"
+
+using namespace std;
+
+/** Time one call to each postlist in this many.
+ *
+ *  Reading the clock costs about as much as a call to a leaf postlist does,
+ *  so timing every call would make profiling too expensive to enable for a
+ *  sample of queries in production, and would distort the times.  The time
+ *  reported for each node is scaled up from the calls which were timed.
+ */
+static const unsigned PROFILE_TIMING_INTERVAL = 16;
+
+/// Time a call (sometimes) and make its node the active one while it runs.
+class ProfileTimer {
+    MatchProfile * profile;
+
+    MatchProfile::Node * node;
+
+    MatchProfile::Node * saved;
+
+    double start;
+
+  public:
+    ProfileTimer(MatchProfile * profile_, MatchProfile::Node * node_)
+	: profile(profile_), node(node_), saved(profile->enter(node)),
+	  start(0.0)
+    {
+	if (--node->calls_to_next_timing == 0) {
+	    node->calls_to_next_timing = PROFILE_TIMING_INTERVAL;
+	    start = RealTime::now();
+	}
+    }
+
+    ~ProfileTimer() {
+	if (start != 0.0) {
+	    node->time += RealTime::now() - start;
+	    ++node->timed_calls;
+	}
+	profile->leave(saved);
+    }
+};
+
+ProfilePostList::~ProfilePostList()
+{
+    if (leaf) node->chunk_reads = leaf->get_chunk_reads();
+    // Don't count documents accepted after we've gone.
+    node->docid = 0;
+    delete pl;
+}
+
+void
+ProfilePostList::handle_prune(PostList * p)
+{
+    if (p) {
+	// Once pruned we can no longer see the leaf's counter, so take a
+	// final reading now.
+	if (leaf) {
+	    node->chunk_reads = leaf->get_chunk_reads();
+	    leaf = NULL;
+	}
+	delete pl;
+	pl = p;
+	if (matcher) matcher->recalc_maxweight();
+    }
+}
+
+Xapian::doccount
+ProfilePostList::get_termfreq_min() const
+{
+    return pl->get_termfreq_min();
+}
+
+Xapian::doccount
+ProfilePostList::get_termfreq_max() const
+{
+    return pl->get_termfreq_max();
+}
+
+Xapian::doccount
+ProfilePostList::get_termfreq_est() const
+{
+    return pl->get_termfreq_est();
+}
+
+TermFreqs
+ProfilePostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    return pl->get_termfreq_est_using_stats(stats);
+}
+
+double
+ProfilePostList::get_maxweight() const
+{
+    return pl->get_maxweight();
+}
+
+Xapian::docid
+ProfilePostList::get_docid() const
+{
+    return pl->get_docid();
+}
+
+Xapian::termcount
+ProfilePostList::get_doclength() const
+{
+    return pl->get_doclength();
+}
+
+Xapian::termcount
+ProfilePostList::get_wdf() const
+{
+    return pl->get_wdf();
+}
+
+double
+ProfilePostList::get_weight() const
+{
+    ++node->weight_calls;
+    ProfileTimer timer(profile, node);
+    return pl->get_weight();
+}
+
+const string *
+ProfilePostList::get_collapse_key() const
+{
+    return pl->get_collapse_key();
+}
+
+bool
+ProfilePostList::at_end() const
+{
+    return pl->at_end();
+}
+
+double
+ProfilePostList::recalc_maxweight()
+{
+    return pl->recalc_maxweight();
+}
+
+PositionList *
+ProfilePostList::read_position_list()
+{
+    return pl->read_position_list();
+}
+
+PositionList *
+ProfilePostList::open_position_list() const
+{
+    return pl->open_position_list();
+}
+
+PostList *
+ProfilePostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::next", w_min);
+    ++node->next_calls;
+    {
+	ProfileTimer timer(profile, node);
+	handle_prune(pl->next(w_min));
+    }
+    note_position();
+    RETURN(NULL);
+}
+
+PostList *
+ProfilePostList::skip_to(Xapian::docid did, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::skip_to", did | w_min);
+    ++node->skip_to_calls;
+    {
+	ProfileTimer timer(profile, node);
+	handle_prune(pl->skip_to(did, w_min));
+    }
+    note_position();
+    RETURN(NULL);
+}
+
+PostList *
+ProfilePostList::check(Xapian::docid did, double w_min, bool &valid)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::check", did | w_min | valid);
+    ++node->check_calls;
+    {
+	ProfileTimer timer(profile, node);
+	handle_prune(pl->check(did, w_min, valid));
+    }
+    if (valid) {
+	note_position();
+    } else {
+	node->docid = 0;
+    }
+    RETURN(NULL);
+}
+
+Xapian::termcount
+ProfilePostList::count_matching_subqs() const
+{
+    return pl->count_matching_subqs();
+}
+
+string
+ProfilePostList::get_description() const
+{
+    // Don't mark ourselves in the description - profiling shouldn't change
+    // the output of things like get_description() on the top postlist.
+    return pl->get_description();
+}
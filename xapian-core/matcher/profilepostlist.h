@@ -0,0 +1,124 @@
+/** @file profilepostlist.h
+ * @brief PostList which counts and times calls to the postlist it wraps.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PROFILEPOSTLIST_H
+#define XAPIAN_INCLUDED_PROFILEPOSTLIST_H
+
+#include "api/postlist.h"
+#include "matchprofile.h"
+
+class LeafPostList;
+class MultiMatch;
+
+/** PostList which counts and times calls to the postlist it wraps.
+ *
+ *  These are only inserted into the postlist tree when profiling has been
+ *  requested with Enquire::set_profiling().  The time recorded for a node
+ *  includes the time spent in its children.
+ *
+ *  If the wrapped postlist prunes itself we take ownership of the
+ *  replacement (like ExtraWeightPostList does), so the counters for this
+ *  node continue to accumulate under the original label.
+ */
+class ProfilePostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const ProfilePostList &);
+
+    /// Don't allow copying.
+    ProfilePostList(const ProfilePostList &);
+
+    /// The postlist we're wrapping.
+    PostList * pl;
+
+    /// The profile we're recording in.
+    MatchProfile * profile;
+
+    /// Our counters (owned by @a profile).
+    MatchProfile::Node * node;
+
+    /// The leaf postlist we wrap, if any (to read chunk_reads from).
+    const LeafPostList * leaf;
+
+    /// The matcher (to tell when we prune).
+    MultiMatch * matcher;
+
+    /// Update our node's counters and position after moving.
+    void note_position() {
+	if (pl->at_end()) {
+	    node->docid = 0;
+	} else {
+	    ++node->docs_examined;
+	    node->docid = pl->get_docid();
+	}
+    }
+
+    /// Take ownership of @a p if @a pl pruned itself.
+    void handle_prune(PostList * p);
+
+  public:
+    ProfilePostList(PostList * pl_, MatchProfile * profile_,
+		    const std::string & label,
+		    const LeafPostList * leaf_, MultiMatch * matcher_)
+	: pl(pl_), profile(profile_), node(profile->add_node(label)),
+	  leaf(leaf_), matcher(matcher_) { }
+
+    ~ProfilePostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    double get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_wdf() const;
+
+    double get_weight() const;
+
+    const std::string * get_collapse_key() const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    PostList * check(Xapian::docid did, double w_min, bool &valid);
+
+    Xapian::termcount count_matching_subqs() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_PROFILEPOSTLIST_H
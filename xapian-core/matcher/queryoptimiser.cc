@@ -0,0 +1,39 @@
+/** @file queryoptimiser.cc
+ * @brief Details passed around while building PostList tree from Query tree
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "queryoptimiser.h"
+
+#include "autoptr.h"
+#include "profilepostlist.h"
+
+using namespace std;
+
+PostList *
+QueryOptimiser::add_profiling(PostList * pl, const string & label,
+			      const LeafPostList * leaf)
+{
+    AutoPtr<PostList> pl_guard(pl);
+    PostList * res = new ProfilePostList(pl, match_profile, label, leaf,
+					 matcher);
+    (void)pl_guard.release();
+    return res;
+}
@@ -24,9 +24,10 @@
 
 #include "backends/database.h"
 #include "localsubmatch.h"
+#include "api/leafpostlist.h"
 #include "api/postlist.h"
+#include "matchprofile.h"
 
-class LeafPostList;
 class MultiMatch;
 namespace Xapian {
 class Weight;
@@ -57,11 +58,16 @@ class QueryOptimiser {
 
     MultiMatch * matcher;
 
+    /// The profile to record in, or NULL if profiling isn't enabled.
+    MatchProfile * match_profile;
+
     QueryOptimiser(const Xapian::Database::Internal & db_,
 		   LocalSubMatch & localsubmatch_,
-		   MultiMatch * matcher_)
+		   MultiMatch * matcher_,
+		   MatchProfile * match_profile_)
 	: localsubmatch(localsubmatch_), total_subqs(0), hint(0),
-	  db(db_), db_size(db.get_doccount()), matcher(matcher_) { }
+	  db(db_), db_size(db.get_doccount()), matcher(matcher_),
+	  match_profile(match_profile_) { }
 
     void inc_total_subqs() { ++total_subqs; }
 
@@ -78,6 +84,27 @@ class QueryOptimiser {
     PostList * make_synonym_postlist(PostList * pl, double factor) {
 	return localsubmatch.make_synonym_postlist(pl, matcher, factor);
     }
+
+    /** Wrap @a pl to record profiling counters, if profiling is enabled.
+     *
+     *  @param pl	The postlist to wrap (ownership is taken - if an
+     *			exception is thrown, @a pl is deleted).
+     *  @param label	Label for @a pl in the profile.
+     */
+    PostList * profile(PostList * pl, const char * label) {
+	if (usual(!match_profile)) return pl;
+	return add_profiling(pl, label, NULL);
+    }
+
+    /// Wrap leaf postlist @a pl to record profiling counters, if enabled.
+    PostList * profile_leaf(LeafPostList * pl, const std::string & label) {
+	if (usual(!match_profile)) return pl;
+	return add_profiling(pl, label, pl);
+    }
+
+    /// Wrap @a pl in a ProfilePostList.
+    PostList * add_profiling(PostList * pl, const std::string & label,
+			     const LeafPostList * leaf);
 };
 
 #endif // XAPIAN_INCLUDED_QUERYOPTIMISER_H
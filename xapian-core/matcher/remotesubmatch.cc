@@ -25,6 +25,7 @@
 
 #include "debuglog.h"
 #include "msetpostlist.h"
+#include "multimatch.h"
 #include "backends/remote/remote-database.h"
 #include "weight/weightinternal.h"
 
@@ -64,10 +65,11 @@ RemoteSubMatch::get_postlist(MultiMatch * matcher,
 			     Xapian::termcount * total_subqs_ptr)
 {
     LOGCALL(MATCH, PostList *, "RemoteSubMatch::get_postlist", matcher | total_subqs_ptr);
-    (void)matcher;
     Xapian::MSet mset;
     db->get_mset(mset, matchspies);
     percent_factor = mset.internal->percent_factor;
+    MatchProfile * profile = matcher->get_profile();
+    if (profile) profile->set_remote_profile(mset.internal->profile);
     // For remote databases we report percent_factor rather than counting the
     // number of subqueries.
     (void)total_subqs_ptr;
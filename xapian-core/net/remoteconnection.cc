@@ -41,6 +41,7 @@
 #include "realtime.h"
 #include "length.h"
 #include "socket_utils.h"
+#include "tracepoint.h"
 
 using namespace std;
 
@@ -211,6 +212,9 @@ RemoteConnection::send_message(char type, const string &message,
     if (fdout == -1)
 	throw_database_closed();
 
+    XAPIAN_TRACE(remote_send, static_cast<unsigned char>(type),
+		 message.size());
+
     string header;
     header += type;
     header += encode_length(message.size());
@@ -472,6 +476,7 @@ RemoteConnection::get_message(string &result, double end_time)
 	result.assign(buffer.data() + 2, len);
 	char type = buffer[0];
 	buffer.erase(0, len + 2);
+	XAPIAN_TRACE(remote_receive, static_cast<unsigned char>(type), len);
 	RETURN(type);
     }
     len = 0;
@@ -493,6 +498,7 @@ RemoteConnection::get_message(string &result, double end_time)
     result.assign(buffer.data() + header_len, len);
     char type = buffer[0];
     buffer.erase(0, header_len + len);
+    XAPIAN_TRACE(remote_receive, static_cast<unsigned char>(type), len);
     RETURN(type);
 }
 
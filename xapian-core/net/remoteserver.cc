@@ -435,6 +435,11 @@ RemoteServer::msg_query(const string &message_in)
 	throw Xapian::NetworkError("bad message (weight_cutoff)");
     }
 
+    if (p == p_end || *p < '0' || *p > '1') {
+	throw Xapian::NetworkError("bad message (profiling)");
+    }
+    bool profiling(*p++ != '0');
+
     // Unserialise the Weight object.
     len = decode_length(&p, p_end, true);
     string wtname(p, len);
@@ -478,8 +483,9 @@ RemoteServer::msg_query(const string &message_in)
     Xapian::Weight::Internal local_stats;
     MultiMatch match(*db, query, qlen, &rset, collapse_max, collapse_key,
 		     percent_cutoff, weight_cutoff, order,
-		     sort_key, sort_by, sort_value_forward, time_limit, NULL,
-		     local_stats, wt.get(), matchspies.spies, false, false);
+		     sort_key, sort_by, sort_value_forward, time_limit, 0, NULL,
+		     local_stats, wt.get(), matchspies.spies, false, false,
+		     profiling);
 
     send_message(REPLY_STATS, serialise_stats(local_stats));
 
@@ -180,6 +180,9 @@ serialise_mset(const Xapian::MSet &mset)
 	result += encode_length(i.get_collapse_count());
     }
 
+    result += encode_length(mset.internal->profile.size());
+    result += mset.internal->profile;
+
     if (mset.internal->stats)
 	result += serialise_stats(*(mset.internal->stats));
 
@@ -213,6 +216,10 @@ unserialise_mset(const char * p, const char * p_end)
 	items.push_back(Xapian::Internal::MSetItem(wt, did, key, collapse_cnt));
     }
 
+    size_t profile_len = decode_length(&p, p_end, true);
+    string profile(p, profile_len);
+    p += profile_len;
+
     AutoPtr<Xapian::Weight::Internal> stats;
     if (p != p_end) {
 	stats.reset(new Xapian::Weight::Internal());
@@ -230,6 +237,7 @@ unserialise_mset(const char * p, const char * p_end)
 				       max_possible, max_attained,
 				       items, percent_factor));
     mset.internal->stats = stats.release();
+    mset.internal->profile = profile;
     return mset;
 }
 
@@ -27,8 +27,10 @@
 #include <xapian/termiterator.h>
 
 #include "api/vectortermlist.h"
+#include "backends/database.h"
 #include "omassert.h"
 #include "queryparser_internal.h"
+#include "str.h"
 
 #include <cstring>
 
@@ -76,18 +78,21 @@ QueryParser::~QueryParser() { }
 void
 QueryParser::set_stemmer(const Xapian::Stem & stemmer)
 {
+    internal->clear_cache();
     internal->stemmer = stemmer;
 }
 
 void
 QueryParser::set_stemming_strategy(stem_strategy strategy)
 {
+    internal->clear_cache();
     internal->stem_action = strategy;
 }
 
 void
 QueryParser::set_stopper(const Stopper * stopper)
 {
+    internal->clear_cache();
     internal->stopper = stopper;
 }
 
@@ -102,6 +107,7 @@ QueryParser::set_default_op(Query::op default_op)
 	case Query::OP_ELITE_SET:
 	case Query::OP_SYNONYM:
 	case Query::OP_MAX:
+	case Query::OP_ADAPTIVE_OR:
 	    // These are OK.
 	    break;
 	default:
@@ -118,9 +124,12 @@ QueryParser::set_default_op(Query::op default_op)
 		    "OP_ELITE_SET"
 		    ", "
 		    "OP_SYNONYM"
+		    ", "
+		    "OP_MAX"
 		    " or "
-		    "OP_MAX");
+		    "OP_ADAPTIVE_OR");
     }
+    internal->clear_cache();
     internal->default_op = default_op;
 }
 
@@ -132,12 +141,14 @@ QueryParser::get_default_op() const
 
 void
 QueryParser::set_database(const Database &db) {
+    internal->clear_cache();
     internal->db = db;
 }
 
 void
 QueryParser::set_max_wildcard_expansion(Xapian::termcount max)
 {
+    internal->clear_cache();
     internal->max_wildcard_expansion = max;
 }
 
@@ -145,21 +156,38 @@ Query
 QueryParser::parse_query(const string &query_string, unsigned flags,
 			 const string &default_prefix)
 {
+    MutexLock lock(internal->mutex);
     internal->stoplist.clear();
     internal->unstem.clear();
     internal->errmsg = NULL;
 
     if (query_string.empty()) return Query();
 
-    Query result = internal->parse_query(query_string, flags, default_prefix);
+    string key;
+    bool use_cache = internal->cache_size &&
+	internal->make_cache_key(query_string, flags, default_prefix, key);
+    Query result;
+    if (use_cache && internal->cache_lookup(key, result))
+	return result;
+
+    result = internal->parse_query(query_string, flags, default_prefix);
     if (internal->errmsg && strcmp(internal->errmsg, "parse error") == 0) {
 	result = internal->parse_query(query_string, 0, default_prefix);
     }
 
     if (internal->errmsg) throw Xapian::QueryParserError(internal->errmsg);
+    if (use_cache) internal->cache_store(key, result);
     return result;
 }
 
+void
+QueryParser::set_cache_size(unsigned size)
+{
+    MutexLock lock(internal->mutex);
+    internal->cache_size = size;
+    internal->cache_trim();
+}
+
 void
 QueryParser::add_prefix(const string &field, const string &prefix)
 {
@@ -203,6 +231,7 @@ QueryParser::add_boolean_prefix(const string &field, Xapian::FieldProcessor * pr
 TermIterator
 QueryParser::stoplist_begin() const
 {
+    MutexLock lock(internal->mutex);
     const list<string> & sl = internal->stoplist;
     return TermIterator(new VectorTermList(sl.begin(), sl.end()));
 }
@@ -210,6 +239,7 @@ QueryParser::stoplist_begin() const
 TermIterator
 QueryParser::unstem_begin(const string &term) const
 {
+    MutexLock lock(internal->mutex);
     pair<multimap<string, string>::iterator,
 	 multimap<string, string>::iterator> range;
     range = internal->unstem.equal_range(term);
@@ -226,15 +256,105 @@ void
 QueryParser::add_valuerangeprocessor(Xapian::ValueRangeProcessor * vrproc)
 {
     Assert(internal.get());
+    internal->clear_cache();
     internal->valrangeprocs.push_back(vrproc);
 }
 
 string
 QueryParser::get_corrected_query_string() const
 {
+    MutexLock lock(internal->mutex);
     return internal->corrected_query;
 }
 
+bool
+QueryParser::Internal::make_cache_key(const string & query_string,
+				      unsigned flags,
+				      const string & default_prefix,
+				      string & key) const
+{
+    // Each variable length part is preceded by its length so the key is
+    // unambiguous.
+    key = str(flags);
+    key += ' ';
+    key += str(default_prefix.size());
+    key += ' ';
+    key += default_prefix;
+    // The parsed query can depend on the database contents (e.g. wildcards,
+    // spelling and synonyms), so include the revision of each subdatabase.
+    for (size_t i = 0; i != db.internal.size(); ++i) {
+	string rev;
+	try {
+	    rev = db.internal[i]->get_uuid();
+	    rev += db.internal[i]->get_revision_info();
+	} catch (const Xapian::UnimplementedError &) {
+	    return false;
+	}
+	key += str(rev.size());
+	key += ' ';
+	key += rev;
+    }
+    key += query_string;
+    return true;
+}
+
+bool
+QueryParser::Internal::cache_lookup(const string & key, Query & result)
+{
+    map<string, list<CachedQuery>::iterator>::const_iterator i;
+    i = cache_index.find(key);
+    if (i == cache_index.end())
+	return false;
+    list<CachedQuery>::iterator entry = i->second;
+    if (!registry.get()) registry.reset(new Registry);
+    try {
+	result = Query::unserialise(entry->serialised_query, *registry);
+    } catch (const Xapian::Error &) {
+	// Shouldn't happen as we only cache queries which serialised, but
+	// treat it as a miss rather than failing the parse.
+	cache_index.erase(entry->key);
+	cache.erase(entry);
+	return false;
+    }
+    // Move the entry to the front to mark it as the most recently used.
+    cache.splice(cache.begin(), cache, entry);
+    stoplist = entry->stoplist;
+    unstem = entry->unstem;
+    corrected_query = entry->corrected_query;
+    return true;
+}
+
+void
+QueryParser::Internal::cache_store(const string & key, const Query & result)
+{
+    string serialised;
+    try {
+	serialised = result.serialise();
+    } catch (const Xapian::UnimplementedError &) {
+	// E.g. a FieldProcessor returned a query using a PostingSource which
+	// doesn't support serialisation, so we can't cache it.
+	return;
+    }
+    cache.push_front(CachedQuery());
+    CachedQuery & entry = cache.front();
+    entry.key = key;
+    entry.serialised_query.swap(serialised);
+    entry.stoplist = stoplist;
+    entry.unstem = unstem;
+    entry.corrected_query = corrected_query;
+    cache_index[key] = cache.begin();
+    cache_trim();
+}
+
+void
+QueryParser::Internal::cache_trim()
+{
+    while (cache.size() > cache_size) {
+	cache_index.erase(cache.back().key);
+	cache.pop_back();
+    }
+}
+
 string
 QueryParser::get_description() const
 {
@@ -27,8 +27,12 @@
 #include <xapian/database.h>
 #include <xapian/query.h>
 #include <xapian/queryparser.h>
+#include <xapian/registry.h>
 #include <xapian/stem.h>
 
+#include "autoptr.h"
+#include "mutex.h"
+
 #include <list>
 #include <map>
 
@@ -88,6 +92,73 @@ class QueryParser::Internal : public Xapian::Internal::intrusive_base {
 
     Xapian::termcount max_wildcard_expansion;
 
+    /** A parsed query, and the side outputs from parsing it.
+     *
+     *  The query is stored serialised so that each caller gets its own copy
+     *  - Query's reference count isn't safe to share between threads.
+     */
+    struct CachedQuery {
+	/// The key this entry is stored under in cache_index.
+	string key;
+
+	string serialised_query;
+
+	list<string> stoplist;
+
+	multimap<string, string> unstem;
+
+	string corrected_query;
+    };
+
+    /// Maximum number of parsed queries to cache (0 means no caching).
+    unsigned cache_size;
+
+    /// Cached parsed queries, most recently used first.
+    list<CachedQuery> cache;
+
+    /// Map from key to entry in cache.
+    map<string, list<CachedQuery>::iterator> cache_index;
+
+    /// Registry used to unserialise cached queries (created on first use).
+    AutoPtr<Registry> registry;
+
+    /** Serialises calls to parse_query() and access to the side outputs.
+     *
+     *  Parsing updates stoplist, unstem, errmsg and corrected_query as well
+     *  as the cache, so the lock is held for the whole parse.
+     */
+    Mutex mutex;
+
+    /** Build the cache key for a call to parse_query().
+     *
+     *  @return false if we can't determine the revision of the database, in
+     *		which case the parsed query shouldn't be cached.
+     */
+    bool make_cache_key(const string & query_string, unsigned flags,
+			const string & default_prefix, string & key) const;
+
+    /** Look up @a key in the cache.
+     *
+     *  If found, the side outputs are restored and the entry is marked as
+     *  the most recently used.
+     *
+     *  @return true if @a key was found, with the parsed query in @a result.
+     */
+    bool cache_lookup(const string & key, Query & result);
+
+    /// Add the query just parsed to the cache, evicting if it's full.
+    void cache_store(const string & key, const Query & result);
+
+    /// Evict entries until the cache is no larger than cache_size.
+    void cache_trim();
+
+    /// Discard all cached parsed queries.
+    void clear_cache() {
+	MutexLock lock(mutex);
+	cache.clear();
+	cache_index.clear();
+    }
+
     void add_prefix(const string &field, const string &prefix,
 		    filter_type type);
 
@@ -100,7 +171,8 @@ class QueryParser::Internal : public Xapian::Internal::intrusive_base {
 
   public:
     Internal() : stem_action(STEM_SOME), stopper(NULL),
-	default_op(Query::OP_OR), errmsg(NULL), max_wildcard_expansion(0) { }
+	default_op(Query::OP_OR), errmsg(NULL), max_wildcard_expansion(0),
+	cache_size(0) { }
 
     Query parse_query(const string & query_string, unsigned int flags, const string & default_prefix);
 };
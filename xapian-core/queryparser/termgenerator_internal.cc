@@ -117,16 +117,18 @@ inline unsigned check_suffix(unsigned ch) {
 #define STOPWORDS_IGNORE 1
 #define STOPWORDS_INDEX_UNSTEMMED_ONLY 2
 
-void
-TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
-				    const string & prefix, bool with_positions)
+/** Split text into terms, calling @a action for each.
+ *
+ *  @a action is called as action(term, positional, start) where @a term is the
+ *  (lowercased) term, @a positional is false for terms which aren't given a
+ *  position (CJK n-grams longer than one character), and @a start is the
+ *  position in the text at which the term starts.  If it returns false we
+ *  stop.
+ */
+template<class ACTION>
+static void
+parse_terms(Utf8Iterator itor, bool cjk_ngram, ACTION & action)
 {
-    bool cjk_ngram = CJK::is_cjk_enabled();
-
-    int stop_mode = STOPWORDS_INDEX_UNSTEMMED_ONLY;
-
-    if (!stopper) stop_mode = STOPWORDS_NONE;
-
     while (true) {
 	// Advance to the start of the next term.
 	unsigned ch;
@@ -137,6 +139,7 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	    ++itor;
 	}
 
+	const Utf8Iterator start(itor);
 	string term;
 	// Look for initials separated by '.' (e.g. P.T.O., U.N.C.L.E).
 	// Don't worry if there's a trailing '.' or not.
@@ -163,53 +166,12 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	    if (cjk_ngram &&
 		CJK::codepoint_is_cjk(*itor) &&
 		Unicode::is_wordchar(*itor)) {
+		const Utf8Iterator cjk_start(itor);
 		const string & cjk = CJK::get_cjk(itor);
 		for (CJKTokenIterator tk(cjk); tk != CJKTokenIterator(); ++tk) {
 		    const string & cjk_token = *tk;
-		    if (cjk_token.size() > max_word_length) continue;
-
-		    if (stop_mode == STOPWORDS_IGNORE && (*stopper)(cjk_token))
-			continue;
-
-		    if (strategy == TermGenerator::STEM_SOME ||
-			strategy == TermGenerator::STEM_NONE) {
-			if (with_positions && tk.get_length() == 1) {
-			    doc.add_posting(prefix + cjk_token, ++termpos, wdf_inc);
-			} else {
-			    doc.add_term(prefix + cjk_token, wdf_inc);
-			}
-		    }
-
-		    if ((flags & FLAG_SPELLING) && prefix.empty())
-			db.add_spelling(cjk_token);
-
-		    if (strategy == TermGenerator::STEM_NONE ||
-			!stemmer.internal.get()) continue;
-
-		    if (strategy == TermGenerator::STEM_SOME) {
-			if (stop_mode == STOPWORDS_INDEX_UNSTEMMED_ONLY &&
-			    (*stopper)(cjk_token))
-			    continue;
-
-			// Note, this uses the lowercased term, but that's OK
-			// as we only want to avoid stemming terms starting
-			// with a digit.
-			if (!should_stem(cjk_token)) continue;
-		    }
-
-		    // Add stemmed form without positional information.
-		    string stem;
-		    if (strategy != TermGenerator::STEM_ALL) {
-			stem += "Z";
-		    }
-		    stem += prefix;
-		    stem += stemmer(cjk_token);
-		    if (strategy != TermGenerator::STEM_SOME &&
-			with_positions) {
-			doc.add_posting(stem, ++termpos, wdf_inc);
-		    } else {
-			doc.add_term(stem, wdf_inc);
-		    }
+		    if (!action(cjk_token, tk.get_length() == 1, cjk_start))
+			return;
 		}
 		while (true) {
 		    if (itor == Utf8Iterator()) return;
@@ -265,46 +227,119 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	}
 
 endofterm:
-	if (term.size() > max_word_length) continue;
+	if (!action(term, true, start))
+	    return;
+    }
+}
 
-	if (stop_mode == STOPWORDS_IGNORE && (*stopper)(term)) continue;
+/// Action for parse_terms() which indexes each term.
+class IndexTextAction {
+    TermGenerator::Internal & tg;
 
-	if (strategy == TermGenerator::STEM_SOME ||
-	    strategy == TermGenerator::STEM_NONE) {
-	    if (with_positions) {
-		doc.add_posting(prefix + term, ++termpos, wdf_inc);
-	    } else {
-		doc.add_term(prefix + term, wdf_inc);
-	    }
-	}
-	if ((flags & FLAG_SPELLING) && prefix.empty()) db.add_spelling(term);
+    termcount wdf_inc;
 
-	if (strategy == TermGenerator::STEM_NONE ||
-	    !stemmer.internal.get()) continue;
+    const string & prefix;
 
-	if (strategy == TermGenerator::STEM_SOME) {
-	    if (stop_mode == STOPWORDS_INDEX_UNSTEMMED_ONLY && (*stopper)(term))
-		continue;
+    bool with_positions;
 
-	    // Note, this uses the lowercased term, but that's OK as we only
-	    // want to avoid stemming terms starting with a digit.
-	    if (!should_stem(term)) continue;
-	}
+  public:
+    IndexTextAction(TermGenerator::Internal & tg_, termcount wdf_inc_,
+		    const string & prefix_, bool with_positions_)
+	: tg(tg_), wdf_inc(wdf_inc_), prefix(prefix_),
+	  with_positions(with_positions_) { }
 
-	// Add stemmed form without positional information.
-	string stem;
-	if (strategy != TermGenerator::STEM_ALL) {
-	    stem += "Z";
-	}
-	stem += prefix;
-	stem += stemmer(term);
-	if (strategy != TermGenerator::STEM_SOME &&
-	    with_positions) {
-	    doc.add_posting(stem, ++termpos, wdf_inc);
+    bool operator()(const string & term, bool positional, const Utf8Iterator &) {
+	tg.index_term(term, positional, wdf_inc, prefix, with_positions);
+	return true;
+    }
+};
+
+void
+TermGenerator::Internal::index_term(const string & term, bool positional,
+				    termcount wdf_inc, const string & prefix,
+				    bool with_positions)
+{
+    if (term.size() > max_word_length) return;
+
+    int stop_mode = STOPWORDS_INDEX_UNSTEMMED_ONLY;
+
+    if (!stopper) stop_mode = STOPWORDS_NONE;
+
+    if (stop_mode == STOPWORDS_IGNORE && (*stopper)(term)) return;
+
+    if (strategy == TermGenerator::STEM_SOME ||
+	strategy == TermGenerator::STEM_NONE) {
+	if (with_positions && positional) {
+	    doc.add_posting(prefix + term, ++termpos, wdf_inc);
 	} else {
-	    doc.add_term(stem, wdf_inc);
+	    doc.add_term(prefix + term, wdf_inc);
 	}
     }
+    if ((flags & FLAG_SPELLING) && prefix.empty()) db.add_spelling(term);
+
+    if (strategy == TermGenerator::STEM_NONE ||
+	!stemmer.internal.get()) return;
+
+    if (strategy == TermGenerator::STEM_SOME) {
+	if (stop_mode == STOPWORDS_INDEX_UNSTEMMED_ONLY && (*stopper)(term))
+	    return;
+
+	// Note, this uses the lowercased term, but that's OK as we only
+	// want to avoid stemming terms starting with a digit.
+	if (!should_stem(term)) return;
+    }
+
+    // Add stemmed form without positional information.
+    string stem;
+    if (strategy != TermGenerator::STEM_ALL) {
+	stem += "Z";
+    }
+    stem += prefix;
+    stem += stemmer(term);
+    if (strategy != TermGenerator::STEM_SOME &&
+	with_positions) {
+	doc.add_posting(stem, ++termpos, wdf_inc);
+    } else {
+	doc.add_term(stem, wdf_inc);
+    }
+}
+
+void
+TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
+				    const string & prefix, bool with_positions)
+{
+    IndexTextAction action(*this, wdf_inc, prefix, with_positions);
+    parse_terms(itor, CJK::is_cjk_enabled(), action);
+}
+
+/// Action for parse_terms() which passes terms to a TermSink.
+class TokeniseAction {
+    const char * text_start;
+
+    unsigned max_word_length;
+
+    TermSink & sink;
+
+  public:
+    TokeniseAction(const char * text_start_, unsigned max_word_length_,
+		   TermSink & sink_)
+	: text_start(text_start_), max_word_length(max_word_length_),
+	  sink(sink_) { }
+
+    bool operator()(const string & term, bool positional,
+		    const Utf8Iterator & start) {
+	// Only pass on the terms which TermGenerator would give a position.
+	if (!positional || term.size() > max_word_length)
+	    return true;
+	return sink(term, start.raw() - text_start);
+    }
+};
+
+void
+tokenise_text(const string & text, TermSink & sink, unsigned max_word_length)
+{
+    TokeniseAction action(text.data(), max_word_length, sink);
+    parse_terms(Utf8Iterator(text), CJK::is_cjk_enabled(), action);
 }
 
 }
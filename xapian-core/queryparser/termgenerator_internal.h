@@ -49,8 +49,41 @@ class TermGenerator::Internal : public Xapian::Internal::intrusive_base {
 		    termcount weight,
 		    const std::string & prefix,
 		    bool with_positions);
+
+    /// Index a single term found by index_text().
+    void index_term(const std::string & term, bool positional,
+		    termcount wdf_inc, const std::string & prefix,
+		    bool with_positions);
+};
+
+/// Interface for receiving the terms found by tokenise_text().
+class TermSink {
+  public:
+    virtual ~TermSink() { }
+
+    /** Called for each term.
+     *
+     *  @param term	The term (lowercased, unstemmed and unprefixed).
+     *  @param offset	Byte offset in the text at which the term starts.
+     *
+     *  @return false to stop tokenising, true to continue.
+     */
+    virtual bool operator()(const std::string & term, size_t offset) = 0;
 };
 
+/** Split text into terms in the same way TermGenerator does.
+ *
+ *  Only the terms which TermGenerator would index with positional
+ *  information are passed to @a sink, so the n-th call corresponds to term
+ *  position n (counting from 1) if the text were indexed by itself.
+ *
+ *  @param text		The text to tokenise.
+ *  @param sink		Object to pass the terms to.
+ *  @param max_word_length	Ignore terms longer than this (default 64).
+ */
+void tokenise_text(const std::string & text, TermSink & sink,
+		   unsigned max_word_length = 64);
+
 }
 
 #endif // XAPIAN_INCLUDED_TERMGENERATOR_INTERNAL_H
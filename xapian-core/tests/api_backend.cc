@@ -27,8 +27,13 @@
 #define XAPIAN_DEPRECATED(X) X
 #include <xapian.h>
 
+#include <cstdlib>
+#include <fstream>
+
+#include "fdtracker.h"
 #include "filetests.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
@@ -958,3 +963,705 @@ DEFINE_TESTCASE(newfreelistblock1, writable) {
 
     return true;
 }
+
+/// Regression test for bugs moving between brass freelist blocks.
+DEFINE_TESTCASE(freelistchain1, brass) {
+    // With the 2K blocks the testsuite uses, a freelist block holds about 500
+    // entries, so rewriting all the postlists a few times needs several
+    // freelist blocks, and the freelist being read and the freelist being
+    // written regularly reach the end of a block together.
+    Xapian::WritableDatabase db =
+	get_named_writable_database("freelistchain1", string());
+    for (int rep = 0; rep != 4; ++rep) {
+	for (Xapian::docid did = 1; did <= 1000; ++did) {
+	    Xapian::Document doc;
+	    for (int t = 0; t != 40; ++t) {
+		doc.add_posting("t" + str((did * 7 + t * 13 + rep) % 2000), t + 1);
+	    }
+	    db.replace_document(did, doc);
+	}
+	db.commit();
+    }
+    db.close();
+
+    const string & db_path = get_named_writable_database_path("freelistchain1");
+    TEST_EQUAL(Xapian::Database::check(db_path), 0);
+    return true;
+}
+
+/// Check Enquire::set_profiling() and MSet::get_profile().
+DEFINE_TESTCASE(profile1, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query("this"),
+				    Xapian::Query(Xapian::Query::OP_OR,
+						  Xapian::Query("paragraph"),
+						  Xapian::Query("word"))));
+
+    Xapian::MSet mset1 = enquire.get_mset(0, 10);
+    TEST(mset1.get_profile().empty());
+
+    enquire.set_profiling(true);
+    Xapian::MSet mset2 = enquire.get_mset(0, 10);
+    // Profiling shouldn't change the results.
+    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+    TEST_EQUAL(mset1.get_matches_estimated(), mset2.get_matches_estimated());
+
+    const string & profile = mset2.get_profile();
+    tout << profile << endl;
+    TEST(startswith(profile, "{\"accepted\":"));
+    TEST_EQUAL(profile[profile.size() - 1], '}');
+    TEST(profile.find("\"shards\":[") != string::npos);
+    // For a remote database, the server's profile is included.
+    TEST(profile.find("\"label\":\"AND\"") != string::npos);
+    TEST(profile.find("\"label\":\"OR\"") != string::npos);
+    TEST(profile.find("\"label\":\"this\"") != string::npos);
+    TEST(profile.find("\"label\":\"paragraph\"") != string::npos);
+    TEST(profile.find("\"label\":\"word\"") != string::npos);
+
+    // Every document accepted was accepted while the AND at the root of
+    // each shard's tree was positioned on it.
+    Xapian::doccount accepted = atoi(profile.c_str() + 12);
+    TEST_REL(accepted,>=,mset2.size());
+    Xapian::doccount and_accepted = 0;
+    const string and_label = "{\"label\":\"AND\",";
+    string::size_type i = 0;
+    while ((i = profile.find(and_label, i)) != string::npos) {
+	i = profile.find("\"docs_accepted\":", i);
+	TEST_NOT_EQUAL(i, string::npos);
+	and_accepted += atoi(profile.c_str() + i + 16);
+    }
+    TEST_EQUAL(and_accepted, accepted);
+
+    // A profile isn't produced unless asked for.
+    enquire.set_profiling(false);
+    TEST(enquire.get_mset(0, 10).get_profile().empty());
+
+    return true;
+}
+
+/// Check InMemory::open_compact() gives an unchanging snapshot.
+DEFINE_TESTCASE(inmemorycompact1, inmemory && writable) {
+    Xapian::WritableDatabase db = get_writable_database("apitest_simpledata");
+    db.set_metadata("foo", "bar");
+
+    Xapian::Database snap = Xapian::InMemory::open_compact(db);
+    TEST_EQUAL(snap.get_doccount(), db.get_doccount());
+    TEST_EQUAL(snap.get_lastdocid(), db.get_lastdocid());
+    TEST_EQUAL(snap.get_avlength(), db.get_avlength());
+    TEST_EQUAL(snap.get_termfreq("word"), db.get_termfreq("word"));
+    TEST_EQUAL(snap.get_collection_freq("word"), db.get_collection_freq("word"));
+    TEST_EQUAL(snap.get_metadata("foo"), "bar");
+
+    Xapian::Enquire enq1(db), enq2(snap);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("word"));
+    enq1.set_query(query);
+    enq2.set_query(query);
+    Xapian::MSet mset1 = enq1.get_mset(0, 10);
+    Xapian::MSet mset2 = enq2.get_mset(0, 10);
+    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+
+    // A copy of the snapshot shares the same data.
+    Xapian::Database snap2 = Xapian::InMemory::open_compact(snap);
+    TEST_EQUAL(snap2.get_doccount(), snap.get_doccount());
+
+    // Changes to the source aren't seen by the snapshot.
+    Xapian::doccount old_doccount = db.get_doccount();
+    Xapian::Document doc;
+    doc.add_term("word");
+    doc.add_term("xyzzy");
+    db.add_document(doc);
+    db.set_metadata("foo", "baz");
+    db.commit();
+    TEST_EQUAL(snap.get_doccount(), old_doccount);
+    TEST_EQUAL(snap.get_termfreq("xyzzy"), 0);
+    TEST_EQUAL(snap.get_metadata("foo"), "bar");
+    TEST(!snap.reopen());
+
+    // Closing one handle doesn't affect another sharing the data.
+    snap.close();
+    TEST_EXCEPTION(Xapian::DatabaseError, snap.get_doccount());
+    TEST_EQUAL(snap2.get_doccount(), old_doccount);
+    TEST_EQUAL(snap2.get_metadata("foo"), "bar");
+
+    return true;
+}
+
+/// Check Database::clone_for_thread() gives an independent equivalent handle.
+DEFINE_TESTCASE(clonedb1, backend && !remote) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Database clone = db.clone_for_thread();
+    TEST_EQUAL(clone.get_doccount(), db.get_doccount());
+    TEST_EQUAL(clone.get_lastdocid(), db.get_lastdocid());
+    TEST_EQUAL(clone.get_avlength(), db.get_avlength());
+    TEST_EQUAL(clone.get_termfreq("word"), db.get_termfreq("word"));
+    TEST_EQUAL(clone.get_collection_freq("word"), db.get_collection_freq("word"));
+
+    Xapian::Enquire enq1(db), enq2(clone);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("word"));
+    enq1.set_query(query);
+    enq2.set_query(query);
+    Xapian::MSet mset1 = enq1.get_mset(0, 10);
+    Xapian::MSet mset2 = enq2.get_mset(0, 10);
+    TEST(!mset1.empty());
+    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+
+    // Closing the original doesn't affect the clone.
+    Xapian::doccount doccount = db.get_doccount();
+    db.close();
+    TEST_EXCEPTION(Xapian::DatabaseError, db.clone_for_thread());
+    TEST_EQUAL(clone.get_doccount(), doccount);
+    TEST_EQUAL(clone.get_document(1).get_data(),
+	       get_database("apitest_simpledata").get_document(1).get_data());
+
+    return true;
+}
+
+/// Check Database::clone_for_thread() opens the same revision.
+DEFINE_TESTCASE(clonedb2, writable && (brass || chert)) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::Database rodb = get_writable_database_as_database();
+    db.add_document(doc);
+    db.commit();
+    db.add_document(doc);
+
+    // The clone is at the same revision as rodb, even though there's a newer
+    // one available.
+    Xapian::Database clone = rodb.clone_for_thread();
+    TEST_EQUAL(clone.get_doccount(), 1);
+    TEST_EQUAL(clone.get_termfreq("foo"), 1);
+    TEST(clone.reopen());
+    TEST_EQUAL(clone.get_doccount(), 2);
+    TEST_EQUAL(rodb.get_doccount(), 1);
+
+    // A clone of a WritableDatabase sees the last committed revision.
+    Xapian::Database wclone = db.clone_for_thread();
+    TEST_EQUAL(wclone.get_doccount(), 2);
+    TEST_EQUAL(db.get_doccount(), 3);
+
+    return true;
+}
+
+/// Check clones of a database share its file descriptors.
+DEFINE_TESTCASE(clonedb3, brass || chert) {
+#ifndef HAVE_PREAD
+    SKIP_TEST("File descriptors are only shared if pread() is available");
+#endif
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::doccount doccount = db.get_doccount();
+    string data = db.get_document(1).get_data();
+
+    FDTracker fdtracker;
+    fdtracker.init();
+    vector<Xapian::Database> clones;
+    for (int i = 0; i != 5; ++i) {
+	clones.push_back(db.clone_for_thread());
+    }
+    TEST_EQUAL(clones.back().get_termfreq("word"), db.get_termfreq("word"));
+    TEST_AND_EXPLAIN(fdtracker.check(),
+		     "Clones opened files:" << fdtracker.get_message());
+
+    // The file descriptors stay open until the last handle using them is
+    // closed.
+    db.close();
+    TEST_EQUAL(clones[0].get_doccount(), doccount);
+    clones.erase(clones.begin());
+    TEST_EQUAL(clones.back().get_document(1).get_data(), data);
+
+    return true;
+}
+
+/// Reranker which prefers documents with higher docids.
+class DocidReranker : public Xapian::Reranker {
+  public:
+    size_t calls;
+
+    /// If non-zero, return this many scores instead of the right number.
+    size_t bad_size;
+
+    DocidReranker() : calls(0), bad_size(0) { }
+
+    void operator()(const Xapian::Query &, const Xapian::MSet & candidates,
+		    vector<double> & scores) {
+	++calls;
+	Xapian::MSetIterator i;
+	for (i = candidates.begin(); i != candidates.end(); ++i) {
+	    scores.push_back(*i);
+	}
+	if (bad_size) scores.resize(bad_size);
+    }
+};
+
+/// Check Enquire::set_reranker().
+DEFINE_TESTCASE(rerank1, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("this"),
+				    Xapian::Query("word")));
+    Xapian::MSet plain = enquire.get_mset(0, 10);
+    TEST_REL(plain.size(),>,3);
+
+    DocidReranker reranker;
+    enquire.set_reranker(&reranker, 100);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(reranker.calls, 1);
+    TEST_EQUAL(mset.size(), plain.size());
+    TEST_EQUAL(mset.get_matches_estimated(), plain.get_matches_estimated());
+    TEST_EQUAL(mset.get_max_attained(), *mset.begin());
+    Xapian::docid prev = Xapian::docid(-1);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	TEST_REL(*i,<,prev);
+	TEST_EQUAL(i.get_weight(), *i);
+	TEST_EQUAL(i.get_percent(), 100);
+	TEST_EQUAL(i.get_document().get_data(),
+		   db.get_document(*i).get_data());
+	prev = *i;
+    }
+
+    // Asking for a later portion gives the matching part of the reranked
+    // results.
+    Xapian::MSet portion = enquire.get_mset(2, 2);
+    TEST_EQUAL(portion.size(), 2);
+    TEST(mset_range_is_same(mset, 2, portion, 0, 2));
+    TEST_EQUAL(portion.begin().get_rank(), 2);
+
+    // Only the top rerank_size documents found by the match are reranked.
+    enquire.set_reranker(&reranker, 3);
+    Xapian::MSet top3 = enquire.get_mset(0, 3);
+    TEST_EQUAL(top3.size(), 3);
+    for (Xapian::MSetIterator i = top3.begin(); i != top3.end(); ++i) {
+	Xapian::docid did = *i;
+	TEST(did == *plain[0] || did == *plain[1] || did == *plain[2]);
+    }
+
+    reranker.bad_size = 1;
+    TEST_EXCEPTION(Xapian::InvalidOperationError, enquire.get_mset(0, 10));
+
+    enquire.set_reranker(NULL, 0);
+    TEST(mset_range_is_same(plain, 0, enquire.get_mset(0, 10), 0, plain.size()));
+
+    return true;
+}
+
+/** Return the counter @a key from the JSON returned by get_io_statistics().
+ *
+ *  If @a table is non-empty, the counter for that table is returned.
+ */
+static double
+io_counter(const string & json, const string & key,
+	   const string & table = string())
+{
+    string::size_type i = 0;
+    if (!table.empty()) {
+	i = json.find("\"" + table + "\":{");
+	if (i == string::npos) FAIL_TEST("No table " << table << " in " << json);
+    }
+    i = json.find("\"" + key + "\":", i);
+    if (i == string::npos) FAIL_TEST("No counter " << key << " in " << json);
+    return atof(json.c_str() + i + key.size() + 3);
+}
+
+/// Check Database::get_io_statistics() for a read-only database.
+DEFINE_TESTCASE(iostatistics1, backend && !remote && !inmemory) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("this"),
+				    Xapian::Query("word")));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST(!mset.empty());
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	(void)i.get_document().get_data();
+    }
+
+    string stats = db.get_io_statistics();
+    tout << stats << '\n';
+    double chunk_reads = io_counter(stats, "postlist_chunk_reads");
+    TEST_REL(chunk_reads,>=,2);
+    TEST_REL(io_counter(stats, "seeks", "postlist"),>=,2);
+    TEST_REL(io_counter(stats, "seeks", "record"),>=,1);
+    TEST_EQUAL(io_counter(stats, "commits"), 0);
+
+    db.reset_io_statistics();
+    stats = db.get_io_statistics();
+    TEST_EQUAL(io_counter(stats, "postlist_chunk_reads"), 0);
+    TEST_EQUAL(io_counter(stats, "seeks", "postlist"), 0);
+    TEST_EQUAL(io_counter(stats, "block_reads", "record"), 0);
+
+    // Counters only cover the work done since the reset.
+    Xapian::Enquire enquire2(db);
+    enquire2.set_query(Xapian::Query("this"));
+    (void)enquire2.get_mset(0, 10);
+    stats = db.get_io_statistics();
+    TEST_REL(io_counter(stats, "postlist_chunk_reads"),>=,1);
+    TEST_REL(io_counter(stats, "postlist_chunk_reads"),<,chunk_reads);
+
+    return true;
+}
+
+/// Check Database::get_io_statistics() counts commits and value reads.
+DEFINE_TESTCASE(iostatistics2, writable && (brass || chert)) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 0; i != 100; ++i) {
+	Xapian::Document doc;
+	doc.add_term("foo");
+	doc.add_value(1, str(i % 7));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    string stats = db.get_io_statistics();
+    tout << stats << '\n';
+    TEST_EQUAL(io_counter(stats, "flushes"), 1);
+    TEST_EQUAL(io_counter(stats, "commits"), 1);
+    TEST_REL(io_counter(stats, "commit_time"),>=,0);
+    TEST_REL(io_counter(stats, "max_commit_time"),<=,
+	     io_counter(stats, "commit_time"));
+
+    db.reset_io_statistics();
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("foo"));
+    enquire.set_sort_by_value(1, false);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    stats = db.get_io_statistics();
+    TEST_REL(io_counter(stats, "value_chunk_reads"),>=,1);
+    TEST_EQUAL(io_counter(stats, "commits"), 0);
+
+    return true;
+}
+
+/// Check Database::get_memory_usage() for a read-only database.
+DEFINE_TESTCASE(memoryusage1, backend && !remote && !inmemory) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST(!mset.empty());
+
+    string usage = db.get_memory_usage();
+    tout << usage << '\n';
+    TEST_REL(io_counter(usage, "postlist"),>,0);
+    TEST_REL(io_counter(usage, "total"),>=,io_counter(usage, "postlist"));
+    TEST_EQUAL(io_counter(usage, "pending_changes"), 0);
+
+    usage = mset.get_memory_usage();
+    tout << usage << '\n';
+    TEST_REL(io_counter(usage, "items"),>,0);
+    TEST_EQUAL(io_counter(usage, "collapse"), 0);
+    TEST_EQUAL(io_counter(usage, "matchspies"), 0);
+    TEST_EQUAL(usage.find("limit"), string::npos);
+
+    return true;
+}
+
+/// Check WritableDatabase::set_memory_limit() flushes buffered changes.
+DEFINE_TESTCASE(memoryusage2, writable && (brass || chert)) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    doc.add_term("bar" + str(0));
+    db.add_document(doc);
+    string usage = db.get_memory_usage();
+    tout << usage << '\n';
+    double pending = io_counter(usage, "pending_changes");
+    TEST_REL(pending,>,0);
+
+    // With a limit of a few documents' worth of changes, adding documents
+    // should flush the changes before they're committed.
+    db.set_memory_limit(size_t(pending * 4));
+    for (int i = 1; i != 100; ++i) {
+	Xapian::Document d;
+	d.add_term("foo");
+	d.add_term("bar" + str(i));
+	db.add_document(d);
+    }
+    string stats = db.get_io_statistics();
+    TEST_REL(io_counter(stats, "flushes"),>=,10);
+    TEST_EQUAL(io_counter(stats, "commits"), io_counter(stats, "flushes"));
+    usage = db.get_memory_usage();
+    tout << usage << '\n';
+    TEST_REL(io_counter(usage, "pending_changes"),<,pending * 5);
+
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 100);
+    TEST_EQUAL(db.get_termfreq("foo"), 100);
+    TEST_EQUAL(io_counter(db.get_memory_usage(), "pending_changes"), 0);
+
+    return true;
+}
+
+/// Check Enquire::set_memory_limit() turns off check_at_least.
+DEFINE_TESTCASE(memoryusage3, writable && !remote) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 0; i != 1000; ++i) {
+	// Make the weights decrease with docid, so once check_at_least is
+	// turned off the later documents can be rejected without being seen by
+	// the matchspy.
+	Xapian::Document doc;
+	doc.add_term("foo", 1000 - i);
+	doc.add_term("pad", i + 1);
+	doc.add_value(0, "value " + str(i));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("foo"));
+    Xapian::ValueCountMatchSpy spy(0);
+    enquire.add_matchspy(&spy);
+    Xapian::MSet mset = enquire.get_mset(0, 10, 1000);
+    TEST_EQUAL(spy.get_total(), 1000);
+    string usage = mset.get_memory_usage();
+    tout << usage << '\n';
+    double spy_bytes = io_counter(usage, "matchspies");
+    TEST_REL(spy_bytes,>,1000 * 6);
+
+    Xapian::ValueCountMatchSpy spy2(0);
+    enquire.clear_matchspies();
+    enquire.add_matchspy(&spy2);
+    enquire.set_memory_limit(size_t(spy_bytes / 8));
+    mset = enquire.get_mset(0, 10, 1000);
+    TEST_EQUAL(mset.size(), 10);
+    TEST_REL(spy2.get_total(),<,1000);
+    usage = mset.get_memory_usage();
+    tout << usage << '\n';
+    TEST_EQUAL(io_counter(usage, "limit"), size_t(spy_bytes / 8));
+    TEST_NOT_EQUAL(usage.find("\"limit_exceeded\":true"), string::npos);
+
+    return true;
+}
+
+/// Keep the records passed to a SlowQueryLogger.
+class SlowQueryCapture : public Xapian::SlowQueryLogger {
+  public:
+    vector<string> records;
+
+    void operator()(const string & record) { records.push_back(record); }
+};
+
+/// Check the records written by Enquire::set_slow_query_log().
+DEFINE_TESTCASE(slowquerylog1, backend) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("paragraph"));
+    enquire.set_query(query);
+    enquire.set_collapse_key(1, 2);
+    enquire.set_sort_by_relevance_then_value(2, false);
+
+    SlowQueryCapture capture;
+    // Nothing should take this long.
+    enquire.set_slow_query_log(1e6, &capture);
+    enquire.get_mset(0, 10);
+    TEST(capture.records.empty());
+
+    enquire.set_slow_query_log(0, &capture);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(capture.records.size(), 1);
+    const string & record = capture.records[0];
+    tout << record << '\n';
+    TEST(startswith(record, "{\"time\":"));
+    TEST_EQUAL(record.find('\n'), string::npos);
+    TEST_NOT_EQUAL(record.find("\"weighting_scheme\":\"Xapian::BM25Weight\""),
+		   string::npos);
+    TEST_NOT_EQUAL(record.find("\"sort_by\":\"relevance_then_value\""),
+		   string::npos);
+    TEST_NOT_EQUAL(record.find("\"collapse_key\":1,\"collapse_max\":2"),
+		   string::npos);
+    TEST_NOT_EQUAL(record.find("\"phases\":{\"stats\":"), string::npos);
+    TEST_NOT_EQUAL(record.find("\"matches_estimated\":" +
+			       str(mset.get_matches_estimated())),
+		   string::npos);
+
+    // The serialised query is logged in hex, and should round trip.
+    const string key = "\"query\":\"";
+    string::size_type start = record.find(key);
+    TEST_NOT_EQUAL(start, string::npos);
+    start += key.size();
+    string::size_type end = record.find('"', start);
+    TEST_NOT_EQUAL(end, string::npos);
+    string serialised;
+    for (string::size_type i = start; i + 1 < end; i += 2) {
+	serialised += char(strtoul(record.substr(i, 2).c_str(), NULL, 16));
+    }
+    TEST_EQUAL(Xapian::Query::unserialise(serialised).get_description(),
+	       query.get_description());
+
+    // Disable logging.
+    enquire.set_slow_query_log(0, NULL);
+    enquire.get_mset(0, 10);
+    TEST_EQUAL(capture.records.size(), 1);
+
+    // Check logging to a file appends a line for each query.
+    const char * logfile = ".slowquerylog1";
+    unlink(logfile);
+    enquire.set_slow_query_log(0, logfile);
+    enquire.get_mset(0, 10);
+    enquire.get_mset(0, 5);
+    ifstream in(logfile);
+    string line;
+    int lines = 0;
+    while (getline(in, line)) {
+	TEST(startswith(line, "{\"time\":"));
+	++lines;
+    }
+    in.close();
+    unlink(logfile);
+    TEST_EQUAL(lines, 2);
+
+    return true;
+}
+
+/// A PostingSource which matches every document but can't be serialised.
+class UnserialisablePostingSource : public Xapian::PostingSource {
+    Xapian::doccount num_docs;
+
+    Xapian::docid last_docid;
+
+    Xapian::docid did;
+
+  public:
+    UnserialisablePostingSource() : num_docs(0), last_docid(0), did(0) { }
+
+    PostingSource * clone() const { return new UnserialisablePostingSource; }
+
+    void init(const Xapian::Database & db) {
+	num_docs = db.get_doccount();
+	last_docid = db.get_lastdocid();
+	did = 0;
+    }
+
+    Xapian::doccount get_termfreq_min() const { return num_docs; }
+
+    Xapian::doccount get_termfreq_est() const { return num_docs; }
+
+    Xapian::doccount get_termfreq_max() const { return num_docs; }
+
+    void next(double) { ++did; }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+};
+
+/// A weighting scheme which can't be serialised.
+class UnserialisableWeight : public Xapian::Weight {
+  public:
+    string name() const { return "UnserialisableWeight"; }
+
+    Weight * clone() const { return new UnserialisableWeight; }
+
+    void init(double) { }
+
+    double get_sumpart(Xapian::termcount, Xapian::termcount) const {
+	return 1;
+    }
+    double get_maxpart() const { return 1; }
+
+    double get_sumextra(Xapian::termcount) const { return 0; }
+    double get_maxextra() const { return 0; }
+};
+
+/// Check queries which can't be serialised are still logged.
+DEFINE_TESTCASE(slowquerylog2, backend && !remote) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    UnserialisablePostingSource source;
+    Xapian::Query query(Xapian::Query::OP_AND_MAYBE,
+			Xapian::Query(&source), Xapian::Query("this"));
+    enquire.set_query(query);
+    UnserialisableWeight weight;
+    enquire.set_weighting_scheme(weight);
+
+    SlowQueryCapture capture;
+    enquire.set_slow_query_log(0, &capture);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), db.get_doccount());
+    TEST_EQUAL(capture.records.size(), 1);
+    const string & record = capture.records[0];
+    tout << record << '\n';
+    TEST_NOT_EQUAL(record.find("\"query\":null,"
+			       "\"query_description\":\"Query("),
+		   string::npos);
+    TEST_NOT_EQUAL(record.find("\"weighting_scheme\":\"UnserialisableWeight\","
+			       "\"weighting_params\":null,"),
+		   string::npos);
+
+    return true;
+}
+
+/// Check Database::prefetch() for a read-only database.
+DEFINE_TESTCASE(prefetch1, backend && !remote && !inmemory) {
+    Xapian::Database db = get_database("etext");
+    // Nothing is read with a budget of zero.
+    TEST_EQUAL(db.prefetch(0), 0);
+    size_t all = db.prefetch(size_t(-1));
+    tout << "prefetched " << all << " bytes\n";
+    TEST_REL(all,>,0);
+    // Only whole blocks are read, and never more than the budget.
+    size_t part = db.prefetch(all / 2);
+    TEST_REL(part,>,0);
+    TEST_REL(part,<=,all / 2);
+
+    // Searches aren't affected.
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("the"));
+    TEST_REL(enquire.get_mset(0, 10).size(),>,0);
+
+    return true;
+}
+
+/// Check which parts of the database Database::prefetch() reads.
+DEFINE_TESTCASE(prefetch2, writable && (brass || chert)) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 0; i != 5000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("common");
+	doc.add_term("unique" + str(i));
+	doc.add_value(0, str(i * 37));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    vector<Xapian::valueno> no_slots(1, 99);
+    size_t base = db.prefetch(size_t(-1), 0, no_slots);
+    TEST_REL(base,>,0);
+    // The postlist for "common" spans several blocks, as do the values in
+    // slot 0.
+    TEST_REL(db.prefetch(size_t(-1), 1, no_slots),>,base);
+    TEST_REL(db.prefetch(size_t(-1), 0, vector<Xapian::valueno>(1, 0)),>,base);
+    TEST_REL(db.prefetch(size_t(-1)),>,base);
+
+    size_t one = db.prefetch_blocks("postlist 0\n", size_t(-1));
+    TEST_REL(one,>,0);
+    // Repeated blocks, blank lines, comments and unknown tables are ignored,
+    // as are blocks which aren't in use.
+    TEST_EQUAL(db.prefetch_blocks("# comment\n\npostlist 0\npostlist 0\n"
+				  "nosuchtable 0\npostlist 4000000000",
+				  size_t(-1)), one);
+    TEST_EQUAL(db.prefetch_blocks("postlist 0\n", one - 1), 0);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.prefetch_blocks("postlist\n", size_t(-1)));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.prefetch_blocks("postlist x\n", size_t(-1)));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.prefetch_blocks(" 0\n", size_t(-1)));
+
+    // Block numbers are only meaningful for a single database.
+    Xapian::Database multi(db);
+    multi.add_database(db);
+    TEST_EXCEPTION(Xapian::InvalidOperationError,
+		   multi.prefetch_blocks("postlist 0\n", size_t(-1)));
+
+    return true;
+}
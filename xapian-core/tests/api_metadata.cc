@@ -145,10 +145,6 @@ DEFINE_TESTCASE(metadata5, writable) {
     iter = db.metadata_keys_begin();
     TEST_EQUAL(iter, db.metadata_keys_end());
 
-    // FIXME: inmemory doesn't implement metadata iterators yet, except in the
-    // trivial case of there being no keys to iterate.
-    SKIP_TEST_FOR_BACKEND("inmemory");
-
     try {
 	db.set_metadata("foo", "val");
     } catch (const Xapian::UnimplementedError &) {
@@ -103,6 +103,7 @@ DEFINE_TESTCASE(emptyquery4, !backend) {
     TEST(Xapian::Query(q.OP_ELITE_SET, &q, &q).empty());
     TEST(Xapian::Query(q.OP_SYNONYM, &q, &q).empty());
     TEST(Xapian::Query(q.OP_MAX, &q, &q).empty());
+    TEST(Xapian::Query(q.OP_ADAPTIVE_OR, &q, &q).empty());
     return true;
 }
 
@@ -124,6 +125,7 @@ DEFINE_TESTCASE(singlesubquery1, !backend) {
     singlesubquery1_(OP_ELITE_SET);
     singlesubquery1_(OP_SYNONYM);
     singlesubquery1_(OP_MAX);
+    singlesubquery1_(OP_ADAPTIVE_OR);
     return true;
 }
 
@@ -144,6 +146,7 @@ DEFINE_TESTCASE(singlesubquery2, !backend) {
     singlesubquery2_(OP_ELITE_SET);
     singlesubquery2_(OP_SYNONYM);
     singlesubquery2_(OP_MAX);
+    singlesubquery2_(OP_ADAPTIVE_OR);
     return true;
 }
 
@@ -164,6 +167,7 @@ DEFINE_TESTCASE(singlesubquery3, !backend) {
     singlesubquery3_(OP_ELITE_SET);
     singlesubquery3_(OP_SYNONYM);
     singlesubquery3_(OP_MAX);
+    singlesubquery3_(OP_ADAPTIVE_OR);
     return true;
 }
 
@@ -25,6 +25,8 @@
 
 #include <xapian.h>
 
+#include <cmath>
+
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -247,3 +249,147 @@ DEFINE_TESTCASE(queryintro1, !backend) {
 
     return true;
 }
+
+/// Test constructing a query from a vector of terms.
+DEFINE_TESTCASE(querytermlist1, !backend) {
+    vector<string> terms;
+    TEST(Xapian::Query(Xapian::Query::OP_OR, terms).empty());
+    terms.push_back("foo");
+    Xapian::Query q(Xapian::Query::OP_AND, terms);
+    TEST_EQUAL(q.get_description(), "Query(foo)");
+    terms.push_back("Qexample2");
+    terms.push_back("Qexample10");
+    terms.push_back("");
+    q = Xapian::Query(Xapian::Query::OP_SYNONYM, terms);
+    TEST_EQUAL(q.get_type(), q.OP_SYNONYM);
+    TEST_EQUAL(q.get_num_subqueries(), 4);
+    TEST_EQUAL(q.get_length(), 4);
+    TEST_EQUAL(q.get_subquery(1).get_type(), q.LEAF_TERM);
+    TEST_EQUAL(q.get_description(),
+	       "Query((<alldocuments> SYNONYM Qexample10 SYNONYM Qexample2 SYNONYM foo))");
+
+    string s = q.serialise();
+    Xapian::Query q2 = Xapian::Query::unserialise(s);
+    TEST_EQUAL(q.get_description(), q2.get_description());
+    // The shared "Qexample" prefix should only be stored once.
+    TEST_REL(s.size(),<,
+	     Xapian::Query(Xapian::Query::OP_SYNONYM,
+			   terms.begin(), terms.end()).serialise().size());
+
+    string all_terms;
+    for (Xapian::TermIterator t = q.get_terms_begin(); t != q.get_terms_end();
+	 ++t) {
+	all_terms += *t;
+	all_terms += ' ';
+    }
+    TEST_EQUAL(all_terms, "Qexample10 Qexample2 foo ");
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+	Xapian::Query(Xapian::Query::OP_XOR, terms));
+
+    return true;
+}
+
+/// Check Query(op, terms) gives the same results as building subqueries.
+DEFINE_TESTCASE(querytermlist2, backend) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+
+    vector<string> terms;
+    terms.push_back("this");
+    terms.push_back("paragraph");
+    terms.push_back("word");
+    terms.push_back("nosuchterm");
+
+    static const Xapian::Query::op ops[] = {
+	Xapian::Query::OP_OR,
+	Xapian::Query::OP_AND,
+	Xapian::Query::OP_SYNONYM
+    };
+    for (size_t i = 0; i != sizeof(ops) / sizeof(ops[0]); ++i) {
+	tout << "op " << ops[i] << endl;
+	Xapian::Query q(ops[i], terms);
+	enq.set_query(q);
+	Xapian::MSet mset1 = enq.get_mset(0, 10);
+	enq.set_query(Xapian::Query(ops[i], terms.begin(), terms.end()));
+	Xapian::MSet mset2 = enq.get_mset(0, 10);
+	TEST_EQUAL(mset1.get_matches_estimated(),
+		   mset2.get_matches_estimated());
+	TEST_EQUAL(mset1.size(), mset2.size());
+	if (!mset1.empty())
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+	// Nested in another OR, the terms should be flattened in.
+	enq.set_query(Xapian::Query("hack") | q);
+	mset1 = enq.get_mset(0, 10);
+	enq.set_query(Xapian::Query("hack") |
+		      Xapian::Query(ops[i], terms.begin(), terms.end()));
+	mset2 = enq.get_mset(0, 10);
+	TEST_EQUAL(mset1.size(), mset2.size());
+	TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+    }
+
+    return true;
+}
+
+/// Check two MSets have the same weights, and the same docids where the
+//  weights aren't tied (the order of summing the weights may differ).
+static void
+check_same_results(const Xapian::MSet & mset1, const Xapian::MSet & mset2)
+{
+    TEST_EQUAL(mset1.size(), mset2.size());
+    for (Xapian::doccount i = 0; i != mset1.size(); ++i) {
+	double wt = mset1[i].get_weight();
+	TEST_EQUAL_DOUBLE(wt, mset2[i].get_weight());
+	if (i > 0 && fabs(mset1[i - 1].get_weight() - wt) < 1e-9)
+	    continue;
+	if (i + 1 < mset1.size() && fabs(mset1[i + 1].get_weight() - wt) < 1e-9)
+	    continue;
+	TEST_EQUAL(*mset1[i], *mset2[i]);
+    }
+}
+
+/// Check OP_ADAPTIVE_OR gives the same results as OP_OR.
+DEFINE_TESTCASE(adaptiveor1, backend) {
+    Xapian::Database db = get_database("etext");
+    Xapian::Enquire enq(db);
+
+    static const char * const terms[] = {
+	"the", "of", "and", "prussian", "war", "king", "sky", "gutenberg",
+	"blockhead", "date", "army", "peace", "time", "nosuchterm"
+    };
+    const size_t n_terms = sizeof(terms) / sizeof(terms[0]);
+    Xapian::Query q_or(Xapian::Query::OP_OR, terms, terms + n_terms);
+    Xapian::Query q(Xapian::Query::OP_ADAPTIVE_OR, terms, terms + n_terms);
+    TEST_EQUAL(q.get_type(), q.OP_ADAPTIVE_OR);
+    TEST_EQUAL(Xapian::Query::unserialise(q.serialise()).get_description(),
+	       q.get_description());
+
+    static const Xapian::doccount sizes[] = { 1, 5, 10, 100 };
+    for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+	tout << "size " << sizes[i] << endl;
+	enq.set_query(q_or);
+	Xapian::MSet mset1 = enq.get_mset(0, sizes[i]);
+	enq.set_query(q);
+	Xapian::MSet mset2 = enq.get_mset(0, sizes[i]);
+	check_same_results(mset1, mset2);
+	TEST_EQUAL(mset1.get_matches_lower_bound(),
+		   mset2.get_matches_lower_bound());
+
+	// Check skip_to() gets used correctly by nesting in OP_AND.
+	enq.set_query(Xapian::Query("peace") & q_or);
+	mset1 = enq.get_mset(0, sizes[i]);
+	enq.set_query(Xapian::Query("peace") & q);
+	mset2 = enq.get_mset(0, sizes[i]);
+	check_same_results(mset1, mset2);
+    }
+
+    // With a weight cutoff, the sub-postlists get dropped straight away.
+    enq.set_cutoff(0, 5.0);
+    enq.set_query(q_or);
+    Xapian::MSet mset1 = enq.get_mset(0, 1000);
+    enq.set_query(q);
+    Xapian::MSet mset2 = enq.get_mset(0, 1000);
+    check_same_results(mset1, mset2);
+
+    return true;
+}
@@ -73,3 +73,64 @@ DEFINE_TESTCASE(snipper2, backend) {
     TEST(snipper.get_description().find("rm_doccount=2,") != string::npos);
     return true;
 }
+
+// tests generating snippets using stored positions and query term coverage
+DEFINE_TESTCASE(snipper3, backend) {
+    Xapian::Enquire enquire(get_database("apitest_simpledata"));
+    enquire.set_query(Xapian::Query("word"));
+    Xapian::MSet mymset = enquire.get_mset(0, 10);
+
+    Xapian::Snipper snipper;
+    snipper.set_stemmer(Xapian::Stem("en"));
+    snipper.set_mset(mymset);
+
+    const string text = "The first sentence is here. "
+	"Some more words in a sentence. "
+	"This one mentions zebras and a word or two. "
+	"The last sentence is at the end.";
+    const string snippet = snipper.generate_snippet(text, 200, 5);
+
+    // Using positions stored in a document should give the same snippet.
+    Xapian::TermGenerator termgen;
+    termgen.set_stemmer(Xapian::Stem("en"));
+    Xapian::Document doc;
+    termgen.set_document(doc);
+    termgen.index_text(text);
+    TEST_EQUAL(snipper.generate_snippet(text, doc, 200, 5), snippet);
+
+    // A document without positional information should fall back to
+    // tokenising the text.
+    Xapian::Document doc_nopos;
+    termgen.set_document(doc_nopos);
+    termgen.index_text_without_positions(text);
+    TEST_EQUAL(snipper.generate_snippet(text, doc_nopos, 200, 5), snippet);
+
+    // The snippet should start at the sentence with the window covering the
+    // query terms.
+    snipper.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("Zzebra"),
+				    Xapian::Query("word")));
+    const string expect = " This one mentions zebras and a word or two. "
+			  "The last sentence is at the end.";
+    TEST_EQUAL(snipper.generate_snippet(text, 200, 5), expect);
+    TEST_EQUAL(snipper.generate_snippet(text, doc, 200, 5), expect);
+    TEST_EQUAL(snipper.generate_snippet(text, 20, 5), " This one mention...");
+
+    // The stored positions should still be matched up with the text if
+    // another field was indexed first and there's a gap in the positions.
+    Xapian::Document doc_title;
+    termgen.set_document(doc_title);
+    termgen.index_text("A rather long title which has lots of terms in it");
+    termgen.increase_termpos();
+    termgen.index_text(text);
+    TEST_EQUAL(snipper.generate_snippet(text, doc_title, 200, 5), expect);
+
+    // No window of 3 terms covers both query terms, so the relevance model
+    // should be used.
+    TEST_EQUAL(snipper.generate_snippet(text, 200, 3),
+	       snipper.generate_snippet(text, doc, 200, 3));
+
+    snipper.set_query(Xapian::Query());
+    TEST_EQUAL(snipper.generate_snippet(text, 200, 5), snippet);
+    return true;
+}
@@ -29,6 +29,8 @@
 
 #include <xapian.h>
 
+#include "dbcheck.h"
+
 #include "filetests.h"
 #include "omassert.h"
 #include "str.h"
@@ -2014,3 +2016,134 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+/// Check that @a snap has the same contents as @a db.
+static void
+check_snapshot(const Xapian::Database & db, const Xapian::Database & snap)
+{
+    TEST_EQUAL(dbstats_to_string(snap), dbstats_to_string(db));
+    TEST_EQUAL(snap.get_lastdocid(), db.get_lastdocid());
+    Xapian::TermIterator t = db.allterms_begin();
+    Xapian::TermIterator s = snap.allterms_begin();
+    for ( ; t != db.allterms_end(); ++t, ++s) {
+	TEST(s != snap.allterms_end());
+	TEST_EQUAL(*s, *t);
+	TEST_EQUAL(s.get_termfreq(), db.get_termfreq(*t));
+	TEST_EQUAL(termstats_to_string(snap, *t), termstats_to_string(db, *t));
+	TEST_EQUAL(postlist_to_string(snap, *t), postlist_to_string(db, *t));
+    }
+    TEST(s == snap.allterms_end());
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	string doc_terms;
+	try {
+	    doc_terms = docterms_to_string(db, did);
+	} catch (const Xapian::DocNotFoundError &) {
+	    TEST_EXCEPTION(Xapian::DocNotFoundError, snap.get_document(did));
+	    continue;
+	}
+	TEST_EQUAL(docterms_to_string(snap, did), doc_terms);
+	TEST_EQUAL(docstats_to_string(snap, did), docstats_to_string(db, did));
+	TEST_EQUAL(snap.get_document(did).get_data(),
+		   db.get_document(did).get_data());
+	TEST_EQUAL(snap.get_document(did).get_value(1),
+		   db.get_document(did).get_value(1));
+    }
+    TEST_EQUAL(snap.get_value_freq(1), db.get_value_freq(1));
+    dbcheck(snap, db.get_doccount(), db.get_lastdocid());
+}
+
+/// Test WritableDatabase::get_snapshot().
+DEFINE_TESTCASE(snapshot1, writable && (brass || chert || inmemory)) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.set_data("one");
+    doc.add_posting("old", 1);
+    doc.add_posting("common", 2);
+    doc.add_value(1, "b");
+    db.add_document(doc);
+    doc.set_data("two");
+    doc.add_term("deleted", 3);
+    doc.add_value(1, "c");
+    db.add_document(doc);
+    doc.set_data("three");
+    db.add_document(doc);
+    db.set_metadata("key", "committed");
+    db.commit();
+
+    Xapian::Database snap = db.get_snapshot();
+    check_snapshot(db, snap);
+
+    // Now make some changes without committing.
+    db.delete_document(2);
+    doc = Xapian::Document();
+    doc.set_data("new three");
+    doc.add_posting("new", 1);
+    doc.add_posting("common", 2);
+    doc.add_posting("common", 3);
+    doc.add_value(1, "a");
+    db.replace_document(3, doc);
+    doc.set_data("six");
+    doc.add_term("fresh");
+    db.replace_document(6, doc);
+    db.set_metadata("key", "uncommitted");
+
+    // The old snapshot doesn't see the changes.
+    TEST_EQUAL(snap.get_doccount(), 3);
+    TEST_EQUAL(snap.get_termfreq("deleted"), 2);
+    TEST_EQUAL(snap.get_termfreq("fresh"), 0);
+    TEST_EQUAL(snap.get_metadata("key"), "committed");
+    TEST(!snap.reopen());
+
+    Xapian::Database snap2 = db.get_snapshot();
+    check_snapshot(db, snap2);
+    TEST_EQUAL(snap2.get_doccount(), 3);
+    TEST_EQUAL(snap2.get_termfreq("deleted"), 0);
+    TEST_EQUAL(snap2.get_termfreq("fresh"), 1);
+    TEST_EQUAL(snap2.get_metadata("key"), "uncommitted");
+    TEST_EQUAL(snap2.get_value_lower_bound(1), "a");
+
+    // Searching the snapshot should give the same results.
+    Xapian::Enquire enq1(db), enq2(snap2);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("common"), Xapian::Query("new"));
+    enq1.set_query(query);
+    enq2.set_query(query);
+    Xapian::MSet mset1 = enq1.get_mset(0, 10);
+    Xapian::MSet mset2 = enq2.get_mset(0, 10);
+    TEST_EQUAL(mset1.size(), 3);
+    TEST(mset_range_is_same_weights(mset1, 0, mset2, 0, mset1.size()));
+
+    // A phrase search needs positions from both parts.
+    enq2.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+				 Xapian::Query("old"), Xapian::Query("common")));
+    mset_expect_order(enq2.get_mset(0, 10), 1);
+
+    db.commit();
+    check_snapshot(db, db.get_snapshot());
+    check_snapshot(db, snap2);
+
+    // Check snapshots taken after a few changes to a larger database, which
+    // for inmemory overlay the changes on the previous snapshot's data.
+    for (int i = 0; i != 20; ++i) {
+	doc = Xapian::Document();
+	doc.set_data(str(i));
+	doc.add_posting("common", 1);
+	doc.add_term("n" + str(i));
+	doc.add_value(1, str(i));
+	db.add_document(doc);
+    }
+    check_snapshot(db, db.get_snapshot());
+    db.delete_document(8);
+    doc.add_term("changed");
+    db.replace_document(9, doc);
+    Xapian::Database snap3 = db.get_snapshot();
+    check_snapshot(db, snap3);
+    db.add_document(doc);
+    check_snapshot(db, db.get_snapshot());
+    TEST_EQUAL(snap3.get_termfreq("changed"), 1);
+
+    snap2.close();
+    TEST_EXCEPTION(Xapian::DatabaseError, snap2.get_doccount());
+
+    return true;
+}
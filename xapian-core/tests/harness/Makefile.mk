@@ -7,6 +7,7 @@ noinst_HEADERS +=\
 	harness/backendmanager_brass.h\
 	harness/backendmanager_chert.h\
 	harness/backendmanager_inmemory.h\
+	harness/backendmanager_inmemorycompact.h\
 	harness/backendmanager_local.h\
 	harness/backendmanager_multi.h\
 	harness/backendmanager_remote.h\
@@ -47,7 +48,9 @@ testharness_sources += harness/backendmanager_chert.cc
 endif
 
 if BUILD_BACKEND_INMEMORY
-testharness_sources += harness/backendmanager_inmemory.cc
+testharness_sources +=\
+	harness/backendmanager_inmemory.cc\
+	harness/backendmanager_inmemorycompact.cc
 endif
 
 if BUILD_BACKEND_REMOTE
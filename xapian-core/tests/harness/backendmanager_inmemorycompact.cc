@@ -0,0 +1,39 @@
+/** @file backendmanager_inmemorycompact.cc
+ * @brief BackendManager subclass for compact inmemory databases.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "backendmanager_inmemorycompact.h"
+
+#include <xapian/dbfactory.h>
+
+using namespace std;
+
+std::string
+BackendManagerInMemoryCompact::get_dbtype() const
+{
+    return "inmemory_compact";
+}
+
+Xapian::Database
+BackendManagerInMemoryCompact::do_get_database(const vector<string> & files)
+{
+    return Xapian::InMemory::open_compact(getwritedb_inmemory(files));
+}
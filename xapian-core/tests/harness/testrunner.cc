@@ -29,6 +29,7 @@
 #include "backendmanager_brass.h"
 #include "backendmanager_chert.h"
 #include "backendmanager_inmemory.h"
+#include "backendmanager_inmemorycompact.h"
 #include "backendmanager_multi.h"
 #include "backendmanager_remoteprog.h"
 #include "backendmanager_remotetcp.h"
@@ -52,6 +53,7 @@ struct BackendProperties {
 static BackendProperties backend_properties[] = {
     { "none", "" },
     { "inmemory", "backend,positional,writable,metadata,valuestats,inmemory" },
+    { "inmemory_compact", "backend,positional,valuestats,inmemory" },
     { "brass", "backend,transactions,positional,writable,spelling,metadata,"
 	       "synonyms,replicas,valuestats,generated,brass" },
     { "chert", "backend,transactions,positional,writable,spelling,metadata,"
@@ -194,6 +196,11 @@ TestRunner::run_tests(int argc, char ** argv)
 	    BackendManagerInMemory m;
 	    do_tests_for_backend(&m);
 	}
+
+	{
+	    BackendManagerInMemoryCompact m;
+	    do_tests_for_backend(&m);
+	}
 #endif
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
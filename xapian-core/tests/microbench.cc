@@ -0,0 +1,624 @@
+/** @file microbench.cc
+ * @brief Microbenchmarks of encoding and text processing code.
+ */
+/* Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cputimer.h"
+#include "pack.h"
+#include "str.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+// Code we're benchmarking which the library doesn't export:
+#include "../api/editdistance.cc"
+#include "../common/bitstream.cc"
+
+/// How many times to time each kernel (the fastest run is used).
+static string opt_repetitions = "5";
+
+/// File to read baseline timings from.
+static string opt_baseline;
+
+/// File to write the timings to, for use as a future baseline.
+static string opt_save;
+
+/// Percentage slowdown from the baseline which counts as a regression.
+static string opt_threshold = "10";
+
+/// Baseline timings in nanoseconds per operation, keyed by kernel name.
+static map<string, double> baseline;
+
+/// Timings from this run, in nanoseconds per operation.
+static map<string, double> results;
+
+/** Time a kernel over several repetitions.
+ *
+ *  Use like so:
+ *
+ *	Benchmark b("kernel", ops);
+ *	while (b.next()) {
+ *	    // Code to time, which performs ops operations.
+ *	}
+ *
+ *  Once all the repetitions have been run, the time of the fastest is
+ *  recorded in results.
+ */
+class Benchmark {
+    string name;
+
+    double ops;
+
+    unsigned runs_left;
+
+    double best;
+
+    CPUTimer timer;
+
+    void finish();
+
+  public:
+    Benchmark(const string & name_, double ops_)
+	: name(name_), ops(ops_),
+	  runs_left(atoi(opt_repetitions.c_str()) + 1), best(HUGE_VAL) { }
+
+    bool next() {
+	if (runs_left <= unsigned(atoi(opt_repetitions.c_str())))
+	    best = min(best, timer.get_time());
+	if (--runs_left == 0) {
+	    finish();
+	    return false;
+	}
+	timer = CPUTimer();
+	return true;
+    }
+};
+
+void
+Benchmark::finish()
+{
+    double ns = best * 1e9 / ops;
+    results[name] = ns;
+    tout << name << ": " << ns << " ns/op\n";
+}
+
+/** A fixed pseudo-random sequence.
+ *
+ *  We don't use rand() as we want the same inputs on every platform, so that
+ *  baselines are comparable.
+ */
+static unsigned
+next_random()
+{
+    static unsigned seed = 42;
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) & 0xffffff;
+}
+
+/// Return a pseudo-random integer from 0 to n - 1.
+static unsigned
+random_below(unsigned n)
+{
+    return unsigned(next_random() / double(0x1000000) * n);
+}
+
+/** Generate values with the distribution of those pack_uint() encodes.
+ *
+ *  Most are small (docid deltas, wdfs), with a tail of larger values
+ *  (document lengths and termfreqs).
+ */
+static unsigned
+realistic_uint()
+{
+    unsigned r = random_below(100);
+    if (r < 60) return 1 + random_below(127);
+    if (r < 90) return 128 + random_below(16384 - 128);
+    if (r < 99) return 16384 + random_below(1 << 21);
+    return (next_random() << 8) ^ next_random();
+}
+
+// English words, including a variety of inflections.
+static const char * const english_words[] = {
+    "the", "information", "retrieval", "searching", "searched", "indexes",
+    "indexing", "databases", "documents", "relevance", "probabilistic",
+    "happily", "happiness", "generalisations", "generously", "running",
+    "ran", "runner", "connection", "connected", "connecting", "connective",
+    "hopeful", "hopefulness", "formality", "formalities", "sensibility",
+    "electrical", "electricity", "adjustable", "adjustment", "dependent",
+    "communism", "activate", "activated", "activities", "effective",
+    "bowdlerize", "caresses", "ponies", "ties", "cats", "agreed", "plastered",
+    "motoring", "sing", "conflated", "troubled", "sized", "hopping", "tanned",
+    "falling", "hissing", "fizzed", "failing", "filing", "happy", "sky",
+    "relational", "conditional", "rational", "valenci", "hesitanci",
+    "digitizer", "conformabli", "radicalli", "differentli", "vileli",
+    "analogousli", "vietnamization", "predication", "operator", "feudalism",
+    "decisiveness", "callousness", "formaliti", "sensitiviti", "triplicate",
+    "formative", "formalize", "electriciti", "electrical", "hopeful",
+    "goodness", "revival", "allowance", "inference", "airliner", "gyroscopic",
+    "adjustable", "defensible", "irritant", "replacement", "homologou",
+    "angulariti", "homologous", "effective", "bowdlerize", "probate", "rate",
+    "cease", "controll", "roll", "generous", "generously", "queries",
+    "weighting", "frequencies", "statistics", "approximately", "sorting"
+};
+
+static const char * const french_words[] = {
+    "continuellement", "recherches", "documentation", "informatique",
+    "nationalité", "généralement", "chevaux", "heureusement", "finissaient",
+    "mangeons", "établissements", "développement", "pratiquement",
+    "intéressantes", "considérablement", "l'utilisation", "déjà", "été"
+};
+
+static const char * const german_words[] = {
+    "aufeinanderfolgenden", "Informationen", "Suchmaschinen", "Häuser",
+    "gegangen", "schönsten", "Datenbanken", "Zusammenfassungen",
+    "Verwaltung", "möglicherweise", "Übersetzungen", "größeren", "laufend",
+    "Bücher", "Straße", "zurückgekehrt", "Wirtschaftlichkeit", "vielleicht"
+};
+
+#define ARRAY_SIZE(A) (sizeof(A) / sizeof((A)[0]))
+
+// Text which mixes ASCII, accented Latin, Greek, Cyrillic and CJK, as a
+// multilingual corpus would.
+static const char mixed_text[] =
+    "The quick brown fox jumps over the lazy dog. "
+    "Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter. "
+    "Falsches Üben von Xylophonmusik quält jeden größeren Zwerg. "
+    "Ταχίστη αλώπηξ βαφής ψημένη γη, δρασκελίζει υπέρ νωθρού κυνός. "
+    "Съешь же ещё этих мягких французских булок да выпей чаю. "
+    "いろはにほへと ちりぬるを わかよたれそ つねならむ "
+    "天地玄黄，宇宙洪荒。日月盈昃，辰宿列张。 "
+    "Price: 42.50 € or £37, 100% guaranteed! (See §3.2) ";
+
+DEFINE_TESTCASE_(packuint1) {
+    const size_t N = 10000;
+    const unsigned PASSES = 500;
+    vector<unsigned> values;
+    unsigned long long total = 0;
+    for (size_t i = 0; i != N; ++i) {
+	values.push_back(realistic_uint());
+	total += values.back();
+    }
+
+    string s;
+    Benchmark pack("pack_uint", double(N) * PASSES);
+    while (pack.next()) {
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    s.resize(0);
+	    for (size_t i = 0; i != N; ++i) {
+		pack_uint(s, values[i]);
+	    }
+	}
+    }
+
+    unsigned long long check = 0;
+    Benchmark unpack("unpack_uint", double(N) * PASSES);
+    while (unpack.next()) {
+	check = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    const char * p = s.data();
+	    const char * end = p + s.size();
+	    unsigned value;
+	    while (p != end) {
+		if (!unpack_uint(&p, end, &value))
+		    FAIL_TEST("unpack_uint() failed");
+		check += value;
+	    }
+	}
+    }
+    TEST_EQUAL(check, total * PASSES);
+    return true;
+}
+
+DEFINE_TESTCASE_(packuintpreservingsort1) {
+    const size_t N = 10000;
+    const unsigned PASSES = 500;
+    // Docids, as encoded in postlist and positionlist keys.
+    vector<unsigned> values;
+    unsigned long long total = 0;
+    for (size_t i = 0; i != N; ++i) {
+	values.push_back(1 + random_below(10000000));
+	total += values.back();
+    }
+
+    string s;
+    Benchmark pack("pack_uint_preserving_sort", double(N) * PASSES);
+    while (pack.next()) {
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    s.resize(0);
+	    for (size_t i = 0; i != N; ++i) {
+		pack_uint_preserving_sort(s, values[i]);
+	    }
+	}
+    }
+
+    unsigned long long check = 0;
+    Benchmark unpack("unpack_uint_preserving_sort", double(N) * PASSES);
+    while (unpack.next()) {
+	check = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    const char * p = s.data();
+	    const char * end = p + s.size();
+	    unsigned value;
+	    while (p != end) {
+		if (!unpack_uint_preserving_sort(&p, end, &value))
+		    FAIL_TEST("unpack_uint_preserving_sort() failed");
+		check += value;
+	    }
+	}
+    }
+    TEST_EQUAL(check, total * PASSES);
+    return true;
+}
+
+DEFINE_TESTCASE_(interpolative1) {
+    const size_t N = 2000;
+    const unsigned PASSES = 20;
+    // Positional data for terms in documents between 50 and 1000 words
+    // long.  Most terms occur only a few times, but a few occur many times.
+    vector<vector<Xapian::termpos> > lists;
+    size_t positions = 0;
+    unsigned long long total = 0;
+    for (size_t i = 0; i != N; ++i) {
+	unsigned doclen = 50 + random_below(951);
+	unsigned wdf = 2;
+	while (wdf < doclen / 4 && random_below(2) == 0)
+	    wdf += 1 + wdf / 2;
+	vector<Xapian::termpos> pos;
+	for (Xapian::termpos p = 1; p <= doclen; ++p) {
+	    // Choose each position with probability of those left to choose
+	    // over those left to consider, giving wdf distinct positions.
+	    if (random_below(doclen - p + 1) < wdf - pos.size()) {
+		pos.push_back(p);
+		total += p;
+	    }
+	}
+	positions += pos.size();
+	lists.push_back(pos);
+    }
+
+    // Encode the same way as the brass and chert backends.
+    vector<string> encoded(N);
+    Benchmark encode("BitWriter::encode_interpolative", double(positions) * PASSES);
+    while (encode.next()) {
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != N; ++i) {
+		const vector<Xapian::termpos> & pos = lists[i];
+		BitWriter wr;
+		wr.encode(pos[0], pos.back());
+		wr.encode(pos.size() - 2, pos.back() - pos[0]);
+		wr.encode_interpolative(pos, 0, pos.size() - 1);
+		swap(encoded[i], wr.freeze());
+	    }
+	}
+    }
+
+    unsigned long long check = 0;
+    Benchmark decode("BitReader::decode_interpolative", double(positions) * PASSES);
+    while (decode.next()) {
+	check = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != N; ++i) {
+		Xapian::termpos pos_last = lists[i].back();
+		BitReader rd(encoded[i]);
+		Xapian::termpos pos_first = rd.decode(pos_last);
+		Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
+		rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
+		check += pos_first + pos_last;
+		for (Xapian::termpos j = 2; j < pos_size; ++j) {
+		    check += rd.decode_interpolative_next();
+		}
+	    }
+	}
+    }
+    TEST_EQUAL(check, total * PASSES);
+    return true;
+}
+
+DEFINE_TESTCASE_(sortableserialise1) {
+    const size_t N = 10000;
+    const unsigned PASSES = 50;
+    // Timestamps, prices, small integers and signed measurements.
+    vector<double> values;
+    for (size_t i = 0; i != N; ++i) {
+	switch (i % 4) {
+	    case 0:
+		values.push_back(1000000000.0 + random_below(400000000));
+		break;
+	    case 1:
+		values.push_back(random_below(100000) / 100.0);
+		break;
+	    case 2:
+		values.push_back(random_below(1000));
+		break;
+	    default:
+		values.push_back((random_below(2000001) - 1000000.0) / 1e3);
+		break;
+	}
+    }
+
+    vector<string> serialised(N);
+    Benchmark serialise("sortable_serialise", double(N) * PASSES);
+    while (serialise.next()) {
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != N; ++i) {
+		serialised[i] = Xapian::sortable_serialise(values[i]);
+	    }
+	}
+    }
+
+    size_t mismatches = 0;
+    Benchmark unserialise("sortable_unserialise", double(N) * PASSES);
+    while (unserialise.next()) {
+	mismatches = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != N; ++i) {
+		if (Xapian::sortable_unserialise(serialised[i]) != values[i])
+		    ++mismatches;
+	    }
+	}
+    }
+    TEST_EQUAL(mismatches, 0);
+    return true;
+}
+
+DEFINE_TESTCASE_(utf8iterator1) {
+    const unsigned PASSES = 5;
+    string text;
+    while (text.size() < 1000000) text += mixed_text;
+
+    size_t chars = 0;
+    for (Xapian::Utf8Iterator i(text); i != Xapian::Utf8Iterator(); ++i)
+	++chars;
+
+    unsigned long long check = 0;
+    Benchmark iterate("Utf8Iterator", double(chars) * PASSES);
+    while (iterate.next()) {
+	check = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    Xapian::Utf8Iterator i(text);
+	    for ( ; i != Xapian::Utf8Iterator(); ++i) {
+		check += *i;
+	    }
+	}
+    }
+    TEST_NOT_EQUAL(check, 0);
+    return true;
+}
+
+DEFINE_TESTCASE_(unicodecategory1) {
+    const unsigned PASSES = 20;
+    vector<unsigned> chars;
+    while (chars.size() < 100000) {
+	Xapian::Utf8Iterator i(mixed_text);
+	chars.insert(chars.end(), i, Xapian::Utf8Iterator());
+    }
+
+    size_t wordchars = 0;
+    Benchmark category("Unicode::get_category", double(chars.size()) * PASSES);
+    while (category.next()) {
+	wordchars = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != chars.size(); ++i) {
+		if (Xapian::Unicode::get_category(chars[i]) <=
+		    Xapian::Unicode::OTHER_LETTER)
+		    ++wordchars;
+	    }
+	}
+    }
+    TEST_NOT_EQUAL(wordchars, 0);
+    return true;
+}
+
+// Convert a UTF-8 string to a vector of Unicode characters.
+static vector<unsigned>
+utf32(const string & s)
+{
+    Xapian::Utf8Iterator i(s);
+    return vector<unsigned>(i, Xapian::Utf8Iterator());
+}
+
+DEFINE_TESTCASE_(editdistance1) {
+    const unsigned PASSES = 20;
+    // Compare misspellings against a vocabulary, as spelling correction does.
+    vector<vector<unsigned> > vocab;
+    for (size_t i = 0; i != ARRAY_SIZE(english_words); ++i)
+	vocab.push_back(utf32(english_words[i]));
+    for (size_t i = 0; i != ARRAY_SIZE(french_words); ++i)
+	vocab.push_back(utf32(french_words[i]));
+    for (size_t i = 0; i != ARRAY_SIZE(german_words); ++i)
+	vocab.push_back(utf32(german_words[i]));
+
+    vector<vector<unsigned> > misspelt;
+    for (size_t i = 0; i != vocab.size(); ++i) {
+	vector<unsigned> word = vocab[i];
+	size_t j = random_below(word.size());
+	switch (i % 4) {
+	    case 0:
+		// Transpose two characters.
+		if (j + 1 < word.size()) swap(word[j], word[j + 1]);
+		break;
+	    case 1:
+		// Drop a character.
+		word.erase(word.begin() + j);
+		break;
+	    case 2:
+		// Insert a character.
+		word.insert(word.begin() + j, 'a' + random_below(26));
+		break;
+	    default:
+		// Substitute a character.
+		word[j] = 'a' + random_below(26);
+		break;
+	}
+	misspelt.push_back(word);
+    }
+
+    size_t close = 0;
+    double ops = double(vocab.size()) * misspelt.size() * PASSES;
+    Benchmark distance("edit_distance", ops);
+    while (distance.next()) {
+	close = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != misspelt.size(); ++i) {
+		const vector<unsigned> & a = misspelt[i];
+		for (size_t j = 0; j != vocab.size(); ++j) {
+		    const vector<unsigned> & b = vocab[j];
+		    if (edit_distance_unsigned(&a[0], int(a.size()),
+					       &b[0], int(b.size()), 2) <= 2)
+			++close;
+		}
+	    }
+	}
+    }
+    // Every misspelling should at least match the word it came from.
+    TEST_REL(close, >=, misspelt.size() * PASSES);
+    return true;
+}
+
+// Time stemming @a n words from @a words with the stemmer for @a language.
+static void
+time_stemmer(const char * language, const char * const * words, size_t n)
+{
+    const unsigned PASSES = 1000;
+    Xapian::Stem stemmer(language);
+    size_t total = 0;
+    Benchmark stem(string("Stem(\"") + language + "\")", double(n) * PASSES);
+    while (stem.next()) {
+	total = 0;
+	for (unsigned pass = 0; pass != PASSES; ++pass) {
+	    for (size_t i = 0; i != n; ++i) {
+		total += stemmer(words[i]).size();
+	    }
+	}
+    }
+    TEST_NOT_EQUAL(total, 0);
+}
+
+DEFINE_TESTCASE_(stem1) {
+    time_stemmer("english", english_words, ARRAY_SIZE(english_words));
+    time_stemmer("french", french_words, ARRAY_SIZE(french_words));
+    time_stemmer("german", german_words, ARRAY_SIZE(german_words));
+    return true;
+}
+
+static const test_desc tests[] = {
+    TESTCASE(packuint1),
+    TESTCASE(packuintpreservingsort1),
+    TESTCASE(interpolative1),
+    TESTCASE(sortableserialise1),
+    TESTCASE(utf8iterator1),
+    TESTCASE(unicodecategory1),
+    TESTCASE(editdistance1),
+    TESTCASE(stem1),
+    END_OF_TESTCASES
+};
+
+/** Read baseline timings from @a file.
+ *
+ *  Each line gives the number of nanoseconds per operation, then the name of
+ *  the kernel.
+ */
+static void
+load_baseline(const string & file)
+{
+    ifstream in(file.c_str());
+    if (!in) throw "Couldn't open baseline file '" + file + "'";
+    double ns;
+    string name;
+    while (in >> ns && getline(in >> ws, name)) {
+	baseline[name] = ns;
+    }
+}
+
+/// Write the timings from this run to @a file, in load_baseline()'s format.
+static void
+save_results(const string & file)
+{
+    ofstream out(file.c_str());
+    map<string, double>::const_iterator i;
+    for (i = results.begin(); i != results.end(); ++i) {
+	out << setprecision(6) << i->second << ' ' << i->first << '\n';
+    }
+    out.close();
+    if (!out) throw "Couldn't write results to '" + file + "'";
+}
+
+// To check a change for speed regressions, run "microbench -s base.txt"
+// before the change, then "microbench -b base.txt" after it.
+int main(int argc, char **argv)
+try {
+    test_driver::add_command_line_option("repetitions", 'r', &opt_repetitions);
+    test_driver::add_command_line_option("baseline", 'b', &opt_baseline);
+    test_driver::add_command_line_option("threshold", 't', &opt_threshold);
+    test_driver::add_command_line_option("save", 's', &opt_save);
+    test_driver::parse_command_line(argc, argv);
+    if (!opt_baseline.empty()) load_baseline(opt_baseline);
+
+    int result = test_driver::run(tests);
+
+    // Report the timings, flagging any kernel which is slower than the
+    // baseline by more than the threshold.
+    double threshold = atof(opt_threshold.c_str());
+    int regressions = 0;
+    map<string, double>::const_iterator i;
+    for (i = results.begin(); i != results.end(); ++i) {
+	cout << setw(36) << left << i->first
+	     << setw(10) << right << setprecision(4) << i->second << " ns/op";
+	map<string, double>::const_iterator b = baseline.find(i->first);
+	if (b != baseline.end()) {
+	    double change = (i->second / b->second - 1.0) * 100.0;
+	    cout << showpos << fixed << setw(8) << setprecision(1) << change
+		 << '%' << noshowpos << resetiosflags(ios::fixed);
+	    if (change > threshold) {
+		cout << "  REGRESSION";
+		++regressions;
+	    }
+	}
+	cout << endl;
+    }
+    if (regressions) {
+	cout << regressions << " kernel(s) more than " << opt_threshold
+	     << "% slower than the baseline" << endl;
+	if (result == 0) result = 1;
+    }
+
+    if (!opt_save.empty()) save_results(opt_save);
+    return result;
+} catch (const char * e) {
+    cout << e << endl;
+    return 1;
+} catch (const string & e) {
+    cout << e << endl;
+    return 1;
+}
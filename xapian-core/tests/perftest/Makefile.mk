@@ -18,16 +18,23 @@ perftest/get_machine_info: perftest/get_machine_info.in
 noinst_HEADERS += perftest/perftest.h
 
 collated_perftest_sources = \
+ perftest/perftest_coldcache.cc \
+ perftest/perftest_concurrency.cc \
+ perftest/perftest_indexing.cc \
  perftest/perftest_matchdecider.cc \
- perftest/perftest_randomidx.cc
+ perftest/perftest_randomidx.cc \
+ perftest/perftest_skewedand.cc \
+ perftest/perftest_zipfsearch.cc
 
 perftest_perftest_SOURCES = perftest/perftest.cc $(collated_perftest_sources) \
  perftest/perftest_all.h perftest/perftest_collated.h \
  perftest/freemem.cc perftest/freemem.h \
+ perftest/randomgen.cc perftest/randomgen.h \
  perftest/runprocess.cc perftest/runprocess.h \
+ perftest/zipfcorpus.h \
  $(testharness_sources)
 perftest_perftest_LDFLAGS = @NO_INSTALL@ $(ldflags)
-perftest_perftest_LDADD = ../libgetopt.la ../$(libxapian_la)
+perftest_perftest_LDADD = ../libgetopt.la ../$(libxapian_la) $(PTHREAD_LIBS)
 
 if MAINTAINER_MODE
 BUILT_SOURCES += perftest/perftest_all.h perftest/perftest_collated.h \
@@ -34,6 +34,8 @@
 #include "testrunner.h"
 #include "testsuite.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 
@@ -338,6 +340,25 @@ PerfTestLogger::indexing_end()
     }
 }
 
+void
+PerfTestLogger::indexing_results(const string & io_statistics,
+				 const map<string, string> & table_sizes)
+{
+    Assert(indexing_started);
+    double elapsed = RealTime::now() - indexing_timer;
+    write("   <indexresults>"
+	  "<docspersec>" +
+	  str(elapsed > 0 ? indexing_addcount / elapsed : 0.0) +
+	  "</docspersec>"
+	  "<iostatistics>" + escape_xml(io_statistics) + "</iostatistics>"
+	  "<tablesizes>");
+    map<string, string>::const_iterator i;
+    for (i = table_sizes.begin(); i != table_sizes.end(); ++i) {
+	write("<table name=\"" + i->first + "\">" + i->second + "</table>");
+    }
+    write("</tablesizes></indexresults>\n");
+}
+
 void
 PerfTestLogger::searching_start(const string & description)
 {
@@ -374,15 +395,149 @@ PerfTestLogger::search_end(const Xapian::Query & query,
     search_start();
 }
 
+void
+PerfTestLogger::search_end(const Xapian::Query & query,
+			   const Xapian::MSet & mset,
+			   const string & query_class,
+			   Xapian::doccount examined)
+{
+    Assert(searching_started);
+    double elapsed(RealTime::now() - searching_timer);
+    class_times[query_class].push_back(elapsed);
+    class_examined[query_class].push_back(examined);
+    write("    <search>"
+	  "<class>" + escape_xml(query_class) + "</class>"
+	  "<time>" + str(elapsed) + "</time>"
+	  "<examined>" + str(examined) + "</examined>"
+	  "<query>" + escape_xml(query.get_description()) + "</query>"
+	  "<mset>"
+	  "<size>" + str(mset.size()) + "</size>"
+	  "<lb>" + str(mset.get_matches_lower_bound()) + "</lb>"
+	  "<est>" + str(mset.get_matches_estimated()) + "</est>"
+	  "<ub>" + str(mset.get_matches_upper_bound()) + "</ub>"
+	  "</mset>"
+	  "</search>\n");
+    search_start();
+}
+
+void
+PerfTestLogger::first_search_end(const Xapian::Query & query,
+				 const Xapian::MSet & mset,
+				 const string & query_class,
+				 double open_time,
+				 const string & io_statistics,
+				 long long read_syscalls,
+				 long long storage_bytes)
+{
+    Assert(searching_started);
+    double elapsed(RealTime::now() - searching_timer);
+    first_search_times.push_back(elapsed);
+    string process_io;
+    if (read_syscalls >= 0) {
+	first_search_syscalls.push_back(read_syscalls);
+	process_io = "<readsyscalls>" + str(read_syscalls) + "</readsyscalls>";
+    }
+    if (storage_bytes >= 0)
+	process_io += "<storagebytes>" + str(storage_bytes) + "</storagebytes>";
+    write("    <firstsearch>"
+	  "<class>" + escape_xml(query_class) + "</class>"
+	  "<time>" + str(elapsed) + "</time>"
+	  "<opentime>" + str(open_time) + "</opentime>" +
+	  process_io +
+	  "<iostatistics>" + escape_xml(io_statistics) + "</iostatistics>"
+	  "<query>" + escape_xml(query.get_description()) + "</query>"
+	  "<mset>"
+	  "<size>" + str(mset.size()) + "</size>"
+	  "<est>" + str(mset.get_matches_estimated()) + "</est>"
+	  "</mset>"
+	  "</firstsearch>\n");
+    search_start();
+}
+
+/** Return the p-th percentile of @a values, using the nearest-rank method.
+ *
+ *  @a values is sorted by this function.
+ */
+template<typename T>
+static T
+percentile(vector<T> & values, double p)
+{
+    Assert(!values.empty());
+    sort(values.begin(), values.end());
+    size_t rank = size_t(ceil(p / 100.0 * values.size()));
+    if (rank == 0) rank = 1;
+    return values[rank - 1];
+}
+
+/// Format the 50th, 95th and 99th percentiles of @a values as XML.
+template<typename T>
+static string
+percentiles_xml(vector<T> & values)
+{
+    if (values.empty()) return string();
+    return "<p50>" + str(percentile(values, 50)) + "</p50>"
+	   "<p95>" + str(percentile(values, 95)) + "</p95>"
+	   "<p99>" + str(percentile(values, 99)) + "</p99>";
+}
+
 void
 PerfTestLogger::searching_end()
 {
     if (searching_started) {
+	map<string, vector<double> >::iterator i;
+	for (i = class_times.begin(); i != class_times.end(); ++i) {
+	    vector<Xapian::doccount> & examined = class_examined[i->first];
+	    write("    <classsummary>"
+		  "<class>" + escape_xml(i->first) + "</class>"
+		  "<searches>" + str(i->second.size()) + "</searches>"
+		  "<time>" + percentiles_xml(i->second) + "</time>"
+		  "<examined>" + percentiles_xml(examined) + "</examined>"
+		  "</classsummary>\n");
+	}
+	class_times.clear();
+	class_examined.clear();
+	if (!first_search_times.empty()) {
+	    write("    <firstsearchsummary>"
+		  "<searches>" + str(first_search_times.size()) + "</searches>"
+		  "<time>" + percentiles_xml(first_search_times) + "</time>"
+		  "<readsyscalls>" + percentiles_xml(first_search_syscalls) +
+		  "</readsyscalls>"
+		  "</firstsearchsummary>\n");
+	    first_search_times.clear();
+	    first_search_syscalls.clear();
+	}
 	write("   </searchrun>\n");
 	searching_started = false;
     }
 }
 
+void
+PerfTestLogger::concurrent_run(const string & description,
+			       unsigned threads, double elapsed,
+			       vector<double> & latencies,
+			       vector<double> & reopen_times,
+			       unsigned modified_errors, unsigned commits)
+{
+    indexing_end();
+    searching_end();
+    size_t searches = latencies.size();
+    write("   <concurrentrun>"
+	  "<description>" + escape_xml(description) + "</description>"
+	  "<threads>" + str(threads) + "</threads>"
+	  "<time>" + str(elapsed) + "</time>"
+	  "<searches>" + str(searches) + "</searches>"
+	  "<qps>" + str(elapsed > 0 ? searches / elapsed : 0.0) + "</qps>"
+	  "<latency>" + percentiles_xml(latencies) + "</latency>"
+	  "<modifiederrors>" + str(modified_errors) + "</modifiederrors>"
+	  "<modifiedrate>" +
+	  str(searches ? double(modified_errors) / searches : 0.0) +
+	  "</modifiedrate>"
+	  "<reopens>" + str(reopen_times.size()) + "</reopens>"
+	  "<reopentime>" + percentiles_xml(reopen_times) + "</reopentime>"
+	  "<commits>" + str(commits) + "</commits>"
+	  "</concurrentrun>\n");
+}
+
 void
 PerfTestLogger::testcase_begin(const string & testcase)
 {
@@ -28,6 +28,7 @@
 #include <fstream>
 #include <map>
 #include <string>
+#include <vector>
 
 class PerfTestLogger {
     std::ofstream out;
@@ -45,6 +46,18 @@ class PerfTestLogger {
     bool searching_started;
     double searching_timer;
 
+    /// Times of the searches in the current search run, by query class.
+    std::map<std::string, std::vector<double> > class_times;
+
+    /// Documents examined by each search in the current run, by query class.
+    std::map<std::string, std::vector<Xapian::doccount> > class_examined;
+
+    /// Times of the first searches in the current search run.
+    std::vector<double> first_search_times;
+
+    /// Read system calls made by each first search in the current run.
+    std::vector<long long> first_search_syscalls;
+
     /** Write a log entry for the current indexing run.
      */
     void indexing_log();
@@ -78,6 +91,20 @@ class PerfTestLogger {
      */
     void indexing_end();
 
+    /** Log the results of an indexing run.
+     *
+     *  This logs the rate at which documents were added since the start of
+     *  the run, so should be called once the changes have been committed,
+     *  and before indexing_end().
+     *
+     *  @param io_statistics	Database::get_io_statistics() for the
+     *				database built.
+     *  @param table_sizes	The size in bytes of each table's file, keyed
+     *				by the table's name.
+     */
+    void indexing_results(const std::string & io_statistics,
+			  const std::map<std::string, std::string> & table_sizes);
+
     /** Log the start of a search run.
      */
     void searching_start(const std::string & description);
@@ -91,10 +118,66 @@ class PerfTestLogger {
     void search_end(const Xapian::Query & query,
 		    const Xapian::MSet & mset);
 
+    /** Log the completion of a search which is part of a class of queries.
+     *
+     *  The latency percentiles for each class, and of the number of
+     *  documents examined, are logged at the end of the search run.
+     *
+     *  @param query_class	The name of the class the query belongs to.
+     *  @param examined	The number of documents the matcher examined.
+     */
+    void search_end(const Xapian::Query & query,
+		    const Xapian::MSet & mset,
+		    const std::string & query_class,
+		    Xapian::doccount examined);
+
+    /** Log the completion of the first search on a newly opened database.
+     *
+     *  The time logged is measured from search_start(), so includes opening
+     *  the database.  The percentiles of the times, and of the number of read
+     *  system calls, are logged at the end of the search run.
+     *
+     *  @param query_class	The name of the class the query belongs to.
+     *  @param open_time	How long opening the database took.
+     *  @param io_statistics	The I/O statistics for the database after the
+     *				search, as returned by
+     *				Database::get_io_statistics().
+     *  @param read_syscalls	The number of read system calls made, or -1
+     *				if this isn't known on this platform.
+     *  @param storage_bytes	The number of bytes read from storage rather
+     *				than the page cache, or -1 if this isn't known
+     *				on this platform.
+     */
+    void first_search_end(const Xapian::Query & query,
+			  const Xapian::MSet & mset,
+			  const std::string & query_class,
+			  double open_time,
+			  const std::string & io_statistics,
+			  long long read_syscalls,
+			  long long storage_bytes);
+
     /** Log the end of a search run.
      */
     void searching_end();
 
+    /** Log the results of a run of concurrent searches.
+     *
+     *  @param description	Description of the run.
+     *  @param threads		The number of threads searching.
+     *  @param elapsed		How long the run took.
+     *  @param latencies	The time each search took.
+     *  @param reopen_times	The time each call to reopen() took.
+     *  @param modified_errors	The number of DatabaseModifiedError exceptions
+     *				the searches got.
+     *  @param commits		The number of commits made by a concurrent
+     *				writer during the run.
+     */
+    void concurrent_run(const std::string & description,
+			unsigned threads, double elapsed,
+			std::vector<double> & latencies,
+			std::vector<double> & reopen_times,
+			unsigned modified_errors, unsigned commits);
+
     /** Start a testcase.
      */
     void testcase_begin(const std::string & testcase);
@@ -0,0 +1,210 @@
+/** @file perftest_coldcache.cc
+ * @brief Performance tests of searching with a cold page cache
+ */
+/* Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_coldcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "safedirent.h"
+#include "safeerrno.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "realtime.h"
+#include "str.h"
+#include "stringutils.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "zipfcorpus.h"
+
+using namespace std;
+
+/// The number of queries from the log to run the first search for.
+static const size_t first_search_queries = 2 * QUERY_CLASSES;
+
+/// Drop the files of the database at @a path from the page cache.
+static void
+drop_from_page_cache(const string & path)
+{
+#ifdef HAVE_POSIX_FADVISE
+    DIR * dir = opendir(path.c_str());
+    if (dir == NULL)
+	FAIL_TEST("Couldn't read directory '" + path + "': " + strerror(errno));
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL) {
+	if (entry->d_name[0] == '.') continue;
+	string file = path;
+	file += '/';
+	file += entry->d_name;
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0) continue;
+#ifdef HAVE_FSYNC
+	// Dirty pages can't be dropped, so make sure there aren't any.
+	(void)fsync(fd);
+#endif
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+    }
+    closedir(dir);
+#else
+    (void)path;
+#endif
+}
+
+/** Read the I/O counters of this process.
+ *
+ *  These are only available on Linux, from /proc/self/io.
+ *
+ *  @param[out] read_syscalls	The number of read system calls made.
+ *  @param[out] storage_bytes	The number of bytes fetched from storage.
+ *
+ *  @return	true if the counters were read.
+ */
+static bool
+get_process_io(long long & read_syscalls, long long & storage_bytes)
+{
+    ifstream in("/proc/self/io");
+    if (!in) return false;
+    int found = 0;
+    string line;
+    while (getline(in, line)) {
+	long long * counter;
+	if (startswith(line, "syscr:")) {
+	    counter = &read_syscalls;
+	} else if (startswith(line, "read_bytes:")) {
+	    counter = &storage_bytes;
+	} else {
+	    continue;
+	}
+	istringstream value(line.substr(line.find(':') + 1));
+	if (value >> *counter) ++found;
+    }
+    return found == 2;
+}
+
+/// Run logged query @a q against @a db, returning the MSet.
+static Xapian::MSet
+run_logged_query(Xapian::Enquire & enquire, const Xapian::Database & db,
+		 const LoggedQuery & q)
+{
+    Xapian::QueryParser qp;
+    qp.set_database(db);
+    Xapian::ValueCountMatchSpy spy(SLOT_CATEGORY);
+    Xapian::doccount check_at_least;
+    check_at_least = prepare_logged_query(enquire, q, qp, spy);
+    return enquire.get_mset(0, 10, check_at_least);
+}
+
+/// The state of the page cache before each first search.
+enum page_cache_state {
+    /// The database's files are dropped from the page cache.
+    COLD,
+    /// As COLD, and then the database is read with Database::prefetch().
+    PREFETCHED,
+    /// The query is run once first, so the blocks it needs are cached.
+    WARM
+};
+
+/** Time the first search on a newly opened database for queries from @a log.
+ *
+ *  The page cache is set up before each search as described by @a state.
+ *  A COLD page cache is what searches see after a deployment or failover.
+ *  In every case, the database's own caches are empty.
+ */
+static void
+first_searches(const string & path, const vector<LoggedQuery> & log,
+	       page_cache_state state)
+{
+    static const char * const descriptions[] = {
+	"first search, cold page cache",
+	"first search, cold page cache after prefetch()",
+	"first search, warm page cache"
+    };
+    logger.searching_start(descriptions[state]);
+    size_t n = min(log.size(), first_search_queries);
+    for (size_t i = 0; i != n; ++i) {
+	const LoggedQuery & q = log[i];
+	if (state == WARM) {
+	    Xapian::Database db(path);
+	    Xapian::Enquire enquire(db);
+	    (void)run_logged_query(enquire, db, q);
+	} else {
+	    drop_from_page_cache(path);
+	    if (state == PREFETCHED)
+		(void)Xapian::Database(path).prefetch(size_t(-1));
+	}
+
+	long long syscalls = -1, storage_bytes = -1;
+	long long syscalls_before, storage_bytes_before;
+	bool have_process_io = get_process_io(syscalls_before,
+					      storage_bytes_before);
+	logger.search_start();
+	double start = RealTime::now();
+	Xapian::Database db(path);
+	double open_time = RealTime::now() - start;
+	Xapian::Enquire enquire(db);
+	Xapian::MSet mset = run_logged_query(enquire, db, q);
+	if (have_process_io &&
+	    get_process_io(syscalls, storage_bytes)) {
+	    syscalls -= syscalls_before;
+	    storage_bytes -= storage_bytes_before;
+	} else {
+	    syscalls = storage_bytes = -1;
+	}
+	logger.first_search_end(enquire.get_query(), mset,
+				query_class_names[q.cls], open_time,
+				db.get_io_statistics(),
+				syscalls, storage_bytes);
+    }
+    logger.searching_end();
+}
+
+// Test the latency of the first search after opening a database, with a
+// cold page cache, after prefetching, and with a warm page cache.
+DEFINE_TESTCASE(coldsearch1, generated) {
+#ifndef HAVE_POSIX_FADVISE
+    SKIP_TEST("posix_fadvise() isn't available to drop the page cache");
+#endif
+    vector<LoggedQuery> log;
+    generate_query_log(log);
+
+    // Use the same database as zipfsearch1, so it only needs building once.
+    string path = backendmanager->get_database_path("zipfsearch1",
+						    builddb_zipfsearch1, "");
+
+    logger.testcase_begin("coldsearch1");
+    first_searches(path, log, COLD);
+    first_searches(path, log, PREFETCHED);
+    first_searches(path, log, WARM);
+    logger.testcase_end();
+    return true;
+}
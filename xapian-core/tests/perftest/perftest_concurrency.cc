@@ -0,0 +1,303 @@
+/** @file perftest_concurrency.cc
+ * @brief Performance tests of concurrent searching and updating
+ */
+/* Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_concurrency.h"
+
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "randomgen.h"
+#include "realtime.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "unixcmds.h"
+#include "zipfcorpus.h"
+
+using namespace std;
+
+#ifdef HAVE_PTHREAD_H
+
+/// The maximum number of reader threads to try.
+static const unsigned int max_readers = 8;
+
+/// The number of searches each reader thread runs.
+static const unsigned int searches_per_reader = 200;
+
+/// How often (in searches) readers reopen the database to see updates.
+static const unsigned int reopen_interval = 20;
+
+/// The number of documents the writer adds or replaces in each commit.
+static const unsigned int writer_batch = 100;
+
+/// The state of a reader thread.
+struct ReaderState {
+    string path;
+
+    /** This thread's own copy of the query log.
+     *
+     *  Copying a Query object isn't thread-safe (the reference counts aren't
+     *  atomic), so the threads can't share the Query objects in one log.
+     */
+    vector<LoggedQuery> log;
+
+    /// The index in the log of the first query to run.
+    size_t first;
+
+    vector<double> latencies;
+
+    vector<double> reopen_times;
+
+    unsigned modified_errors;
+
+    /// Description of the error which stopped the thread, if any.
+    string error;
+
+    ReaderState() : first(0), modified_errors(0) { }
+};
+
+// Reopen @a db, recording the time it takes.
+static void
+timed_reopen(Xapian::Database & db, ReaderState & state)
+{
+    double start = RealTime::now();
+    db.reopen();
+    state.reopen_times.push_back(RealTime::now() - start);
+}
+
+extern "C" {
+static void *
+reader_thread(void * arg)
+{
+    ReaderState & state = *static_cast<ReaderState *>(arg);
+    try {
+	// Each thread must have its own Database object.
+	Xapian::Database db(state.path);
+	Xapian::QueryParser qp;
+	qp.set_database(db);
+	const vector<LoggedQuery> & log = state.log;
+	for (unsigned n = 0; n != searches_per_reader; ++n) {
+	    if (n && n % reopen_interval == 0)
+		timed_reopen(db, state);
+	    const LoggedQuery & q = log[(state.first + n) % log.size()];
+	    double start = RealTime::now();
+	    while (true) {
+		try {
+		    Xapian::Enquire enquire(db);
+		    Xapian::ValueCountMatchSpy spy(SLOT_CATEGORY);
+		    Xapian::doccount check_at_least;
+		    check_at_least = prepare_logged_query(enquire, q, qp, spy);
+		    Xapian::MSet mset = enquire.get_mset(0, 10, check_at_least);
+		    // Fetch the documents, as a real search would to display
+		    // them.
+		    Xapian::MSetIterator i;
+		    for (i = mset.begin(); i != mset.end(); ++i) {
+			(void)i.get_document().get_data();
+		    }
+		    break;
+		} catch (const Xapian::DatabaseModifiedError &) {
+		    // The revision we were reading has been overwritten, so
+		    // reopen and run the search again.
+		    ++state.modified_errors;
+		    timed_reopen(db, state);
+		}
+	    }
+	    state.latencies.push_back(RealTime::now() - start);
+	}
+    } catch (const Xapian::Error & e) {
+	state.error = e.get_description();
+    }
+    return NULL;
+}
+}
+
+/// The state of the writer thread.
+struct WriterState {
+    string path;
+
+    const ZipfVocabulary * vocab;
+
+    pthread_mutex_t mutex;
+
+    /// Set to true to tell the writer to stop (protected by mutex).
+    bool stop;
+
+    unsigned commits;
+
+    /// Description of the error which stopped the thread, if any.
+    string error;
+
+    WriterState() : vocab(NULL), stop(false), commits(0) {
+	pthread_mutex_init(&mutex, NULL);
+    }
+
+    ~WriterState() {
+	pthread_mutex_destroy(&mutex);
+    }
+
+    bool should_stop() {
+	pthread_mutex_lock(&mutex);
+	bool result = stop;
+	pthread_mutex_unlock(&mutex);
+	return result;
+    }
+
+    void set_stop() {
+	pthread_mutex_lock(&mutex);
+	stop = true;
+	pthread_mutex_unlock(&mutex);
+    }
+};
+
+extern "C" {
+static void *
+writer_thread(void * arg)
+{
+    WriterState & state = *static_cast<WriterState *>(arg);
+    try {
+	Xapian::WritableDatabase db(state.path, Xapian::DB_OPEN);
+	// Only this thread calls rand() while the readers are running.
+	unsigned int i = ZIPF_CORPUS_SIZE;
+	while (!state.should_stop()) {
+	    for (unsigned j = 0; j != writer_batch; ++j) {
+		Xapian::Document doc = zipf_document(*state.vocab, i++);
+		// Replace an existing document half the time, otherwise add a
+		// new one.
+		if (rand_int(2)) {
+		    db.replace_document(rand_int(1, ZIPF_CORPUS_SIZE), doc);
+		} else {
+		    db.add_document(doc);
+		}
+	    }
+	    db.commit();
+	    ++state.commits;
+	}
+    } catch (const Xapian::Error & e) {
+	state.error = e.get_description();
+    }
+    return NULL;
+}
+}
+
+/** Run @a readers reader threads, and a writer thread if @a writer is true.
+ *
+ *  @param src	Path to the corpus to use, which is copied first so the
+ *		writer doesn't modify it.
+ */
+static void
+concurrent_searches(const string & src, const string & path,
+		    const ZipfVocabulary & vocab,
+		    unsigned readers, bool writer)
+{
+    rm_rf(path);
+    cp_R(src, path);
+
+    // Generating the query log uses rand(), so do it before the writer
+    // starts.
+    vector<ReaderState> reader_states(readers);
+    for (unsigned t = 0; t != readers; ++t) {
+	vector<LoggedQuery> & log = reader_states[t].log;
+	generate_query_log(log);
+	reader_states[t].path = path;
+	// Start each reader at a different point in the log.
+	reader_states[t].first = t * log.size() / readers;
+    }
+
+    WriterState writer_state;
+    writer_state.path = path;
+    writer_state.vocab = &vocab;
+    pthread_t writer_tid;
+    if (writer) {
+	TEST_EQUAL(pthread_create(&writer_tid, NULL, writer_thread,
+				  &writer_state), 0);
+    }
+
+    vector<pthread_t> reader_tids(readers);
+    double start = RealTime::now();
+    for (unsigned t = 0; t != readers; ++t) {
+	TEST_EQUAL(pthread_create(&reader_tids[t], NULL, reader_thread,
+				  &reader_states[t]), 0);
+    }
+    for (unsigned t = 0; t != readers; ++t) {
+	pthread_join(reader_tids[t], NULL);
+    }
+    double elapsed = RealTime::now() - start;
+
+    if (writer) {
+	writer_state.set_stop();
+	pthread_join(writer_tid, NULL);
+	TEST_EQUAL(writer_state.error, "");
+    }
+
+    vector<double> latencies, reopen_times;
+    unsigned modified_errors = 0;
+    for (unsigned t = 0; t != readers; ++t) {
+	const ReaderState & state = reader_states[t];
+	TEST_EQUAL(state.error, "");
+	latencies.insert(latencies.end(),
+			 state.latencies.begin(), state.latencies.end());
+	reopen_times.insert(reopen_times.end(),
+			    state.reopen_times.begin(),
+			    state.reopen_times.end());
+	modified_errors += state.modified_errors;
+    }
+
+    string description = str(readers) + " readers";
+    if (writer) description += ", with writer";
+    logger.concurrent_run(description, readers, elapsed,
+			  latencies, reopen_times,
+			  modified_errors, writer_state.commits);
+}
+
+#endif
+
+// Test the throughput of searches as the number of reader threads increases,
+// with and without a writer updating the database at the same time.
+DEFINE_TESTCASE(concurrentsearch1, generated) {
+#ifndef HAVE_PTHREAD_H
+    SKIP_TEST("Threads not supported");
+#else
+    ZipfVocabulary vocab;
+
+    string src = backendmanager->get_database_path("zipfsearch1",
+						   builddb_zipfsearch1, "");
+    string path = backendmanager->get_writable_database_path("concurrentsearch1");
+
+    logger.testcase_begin("concurrentsearch1");
+    for (unsigned readers = 1; readers <= max_readers; readers *= 2) {
+	concurrent_searches(src, path, vocab, readers, false);
+	concurrent_searches(src, path, vocab, readers, true);
+    }
+    logger.testcase_end();
+    rm_rf(path);
+#endif
+    return true;
+}
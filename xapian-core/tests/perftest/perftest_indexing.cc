@@ -0,0 +1,268 @@
+/** @file perftest_indexing.cc
+ * @brief Performance tests of indexing realistic text
+ */
+/* Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_indexing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio> // For sprintf().
+#include <cstdlib>
+#include <stdlib.h> // For setenv() or putenv()
+#include <map>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "safesysstat.h"
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "randomgen.h"
+#include "stringutils.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "unixcmds.h"
+#include "zipfcorpus.h"
+
+using namespace std;
+
+// Parameters used to control generation of the text corpus.
+static const unsigned int text_seed = 314159;
+static const double heaps_k = 20.0;
+static const double heaps_beta = 0.5;
+static const unsigned int authors = 500;
+static const unsigned int body_minwords = 50;
+static const unsigned int body_maxwords = 300;
+
+/// The flush thresholds to build the corpus with.
+static const unsigned int flush_thresholds[] = { 1000, 5000, 20000 };
+
+/// The tables to report the size of.
+static const char * const tables[] = {
+    "postlist", "position", "termlist", "synonym", "spelling", "record"
+};
+
+static void
+set_flush_threshold(unsigned int threshold)
+{
+#ifdef HAVE__PUTENV_S
+    _putenv_s("XAPIAN_FLUSH_THRESHOLD", str(threshold).c_str());
+#elif defined HAVE_SETENV
+    setenv("XAPIAN_FLUSH_THRESHOLD", str(threshold).c_str(), 1);
+#else
+    static char buf[64] = "XAPIAN_FLUSH_THRESHOLD=";
+    sprintf(buf + CONST_STRLEN("XAPIAN_FLUSH_THRESHOLD="), "%u", threshold);
+    putenv(buf);
+#endif
+}
+
+/** A generated document with text fields, for indexing with TermGenerator.
+ *
+ *  The documents are generated as text so that indexing them exercises
+ *  tokenisation, stemming and positions as real text would.
+ */
+struct TextDocument {
+    string title;
+
+    string author;
+
+    string body;
+
+    /// Tags, to be added as boolean terms.
+    vector<string> tags;
+
+    /// The date, as a number of days (for SLOT_NUMBER).
+    unsigned int day;
+
+    /// A single letter category (for SLOT_CATEGORY).
+    string category;
+};
+
+/// Generate text for the text corpus.
+class TextGenerator {
+    const ZipfVocabulary & vocab;
+
+    /// The number of words generated so far, for Heaps' law.
+    double words_generated;
+
+  public:
+    explicit TextGenerator(const ZipfVocabulary & vocab_)
+	: vocab(vocab_), words_generated(0) { }
+
+    /// Pick a random word, with a random suffix.
+    string word();
+
+    /// Generate @a n words of text, split into sentences if @a sentences.
+    string text(unsigned int n, bool sentences);
+};
+
+string
+TextGenerator::word()
+{
+    // Heaps' law: the vocabulary size grows as K * n ^ beta.
+    words_generated += 1;
+    double limit = heaps_k * pow(words_generated, heaps_beta);
+    string result = vocab.sample(max(1u, unsigned(limit)));
+    static const char * const suffixes[] = {
+	"s", "ed", "ing", "ly", "ness", "ation"
+    };
+    // Most words appear without a suffix.
+    unsigned int r = rand_int(20);
+    if (r < sizeof(suffixes) / sizeof(suffixes[0])) result += suffixes[r];
+    return result;
+}
+
+string
+TextGenerator::text(unsigned int n, bool sentences)
+{
+    string result;
+    unsigned int sentence_left = 0;
+    for (unsigned int i = 0; i != n; ++i) {
+	string w = word();
+	if (sentences && sentence_left == 0) {
+	    if (!result.empty()) result += ". ";
+	    w[0] = char(w[0] - 'a' + 'A');
+	    sentence_left = rand_int(5, 20);
+	} else if (!result.empty()) {
+	    result += (sentences && rand_int(10) == 0) ? ", " : " ";
+	}
+	result += w;
+	if (sentence_left) --sentence_left;
+    }
+    if (sentences && !result.empty()) result += '.';
+    return result;
+}
+
+/** Generate a corpus of text documents.
+ *
+ *  The words are drawn from a ZipfVocabulary, and the number of distinct
+ *  words in use grows with the size of the corpus following Heaps' law, as
+ *  it does in real text.  Words are given common English suffixes so that
+ *  stemming has some work to do.
+ *
+ *  @param docs	The vector to append the documents to.
+ *  @param n	The number of documents to generate.
+ */
+static void
+generate_text_corpus(vector<TextDocument> & docs, unsigned int n)
+{
+    ZipfVocabulary vocab;
+    srand(text_seed);
+    TextGenerator gen(vocab);
+    docs.reserve(docs.size() + n);
+    for (unsigned int i = 0; i != n; ++i) {
+	TextDocument doc;
+	doc.title = gen.text(rand_int(3, 10), false);
+	// Author names come from a smaller set of words.
+	doc.author = vocab.sample(authors);
+	doc.author += ' ';
+	doc.author += vocab.sample(authors);
+	doc.author[0] = char(doc.author[0] - 'a' + 'A');
+	doc.body = gen.text(rand_int(body_minwords, body_maxwords), true);
+	unsigned int tags = rand_int(4);
+	for (unsigned int t = 0; t != tags; ++t) {
+	    doc.tags.push_back(vocab.sample(100));
+	}
+	doc.day = rand_int(3650);
+	doc.category = gen_word(1, 10);
+	docs.push_back(doc);
+    }
+}
+
+/// Index @a doc in the way a typical application would.
+static Xapian::Document
+index_document(Xapian::TermGenerator & indexer, const TextDocument & doc,
+	       unsigned int i)
+{
+    Xapian::Document result;
+    indexer.set_document(result);
+    indexer.index_text(doc.title, 1, "S");
+    indexer.index_text(doc.author, 1, "A");
+    // Index the title and body without a prefix too, for general searches.
+    indexer.index_text(doc.title, 5);
+    indexer.increase_termpos();
+    indexer.index_text(doc.body);
+    vector<string>::const_iterator t;
+    for (t = doc.tags.begin(); t != doc.tags.end(); ++t) {
+	result.add_boolean_term("K" + *t);
+    }
+    result.add_value(SLOT_NUMBER, Xapian::sortable_serialise(doc.day));
+    result.add_value(SLOT_CATEGORY, doc.category);
+    result.add_value(SLOT_GROUP, doc.author);
+    result.set_data("id=" + str(i) + "\ntitle=" + doc.title +
+		    "\nauthor=" + doc.author + "\nsample=" +
+		    doc.body.substr(0, 200));
+    return result;
+}
+
+// Test the performance of indexing text at several flush thresholds.
+DEFINE_TESTCASE(zipfindex1, writable && !remote && !inmemory) {
+    vector<TextDocument> docs;
+    generate_text_corpus(docs, ZIPF_CORPUS_SIZE);
+
+    const char * p = getenv("XAPIAN_FLUSH_THRESHOLD");
+    unsigned int old_threshold = p ? atoi(p) : 0;
+
+    logger.testcase_begin("zipfindex1");
+    for (size_t n = 0;
+	 n != sizeof(flush_thresholds) / sizeof(flush_thresholds[0]); ++n) {
+	unsigned int threshold = flush_thresholds[n];
+	// The flush threshold is read when the database is opened.
+	set_flush_threshold(threshold);
+	string dbname = "zipfindex1_" + str(threshold);
+	Xapian::WritableDatabase db =
+	    backendmanager->get_writable_database(dbname, string());
+
+	map<string, string> params;
+	params["runsize"] = str(docs.size());
+	params["flush_threshold"] = str(threshold);
+	logger.indexing_begin(dbname, params);
+
+	Xapian::TermGenerator indexer;
+	indexer.set_stemmer(Xapian::Stem("english"));
+	for (size_t i = 0; i != docs.size(); ++i) {
+	    db.add_document(index_document(indexer, docs[i], i));
+	    logger.indexing_add();
+	}
+	db.commit();
+
+	string io_statistics = db.get_io_statistics();
+	db.close();
+	string path = backendmanager->get_writable_database_path(dbname);
+	map<string, string> table_sizes;
+	for (size_t t = 0; t != sizeof(tables) / sizeof(tables[0]); ++t) {
+	    struct stat sb;
+	    if (stat((path + "/" + tables[t] + ".DB").c_str(), &sb) == 0)
+		table_sizes[tables[t]] = str(sb.st_size);
+	}
+	logger.indexing_results(io_statistics, table_sizes);
+	logger.indexing_end();
+	rm_rf(path);
+    }
+    logger.testcase_end();
+
+    set_flush_threshold(old_threshold);
+    return true;
+}
@@ -29,6 +29,7 @@
 
 #include "backendmanager.h"
 #include "perftest.h"
+#include "randomgen.h"
 #include "testrunner.h"
 #include "testsuite.h"
 #include "testutils.h"
@@ -36,49 +37,6 @@
 
 using namespace std;
 
-/** Generate a random integer from 0 to "range" - 1.
- */
-static unsigned int
-rand_int(unsigned int range)
-{
-    return (unsigned int)(range * (rand() / (RAND_MAX + 1.0)));
-}
-
-/** Generate a random integer from min to max.
- */
-static unsigned int
-rand_int(unsigned int min, unsigned int max)
-{
-    return min + (unsigned int)((max + 1 - min) * (rand() / (RAND_MAX + 1.0)));
-}
-
-
-
-/** Generate a random double in range 0.0 <= v < 1.0
- */
-static double
-rand_01()
-{
-    return rand() / (RAND_MAX + 1.0);
-}
-
-/** Generate a "word", of the specified length.
- *
- *  @param length     The length of the word to generate.
- *  @param char_range The range of characters to use in the word.
- */
-static string
-gen_word(unsigned int length, unsigned int char_range)
-{
-    string result;
-    result.reserve(length);
-    for (unsigned int i = 0; i != length; ++i) {
-	char ch = char('a' + rand_int(char_range));
-	result.append(1, ch);
-    }
-    return result;
-}
-
 // Test the performance using randomly generated data.
 DEFINE_TESTCASE(randomidx1, writable && !inmemory) {
     logger.testcase_begin("randomidx1");
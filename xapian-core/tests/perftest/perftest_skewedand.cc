@@ -0,0 +1,111 @@
+/* perftest_skewedand.cc: performance tests for AND with skewed term frequencies
+ *
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_skewedand.h"
+
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+/** Terms and the interval between documents which they index.
+ *
+ *  The intervals are chosen to be coprime so that the intersections aren't
+ *  trivially aligned with chunk boundaries.
+ */
+static const struct { const char * term; unsigned interval; } skew_terms[] = {
+    { "all", 1 },
+    { "half", 2 },
+    { "tenth", 11 },
+    { "hundredth", 101 },
+    { "thousandth", 1009 },
+    { "rare", 10007 },
+    { NULL, 0 }
+};
+
+static void
+builddb_skewedand1(Xapian::WritableDatabase &db, const string & dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 1000000;
+
+    // Rebuild the database.
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    logger.indexing_begin(dbname, params);
+    for (unsigned int i = 1; i <= runsize; ++i) {
+	Xapian::Document doc;
+	doc.set_data("test document " + str(i));
+	for (int t = 0; skew_terms[t].term; ++t) {
+	    if (i % skew_terms[t].interval == 0)
+		doc.add_term(skew_terms[t].term);
+	}
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Test the performance of AND queries between terms of very different
+// frequencies, which exercise skip_to() on the more frequent terms.
+DEFINE_TESTCASE(skewedand1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("skewedand1", builddb_skewedand1,
+				      "skewedand1");
+
+    logger.testcase_begin("skewedand1");
+    Xapian::Enquire enquire(db);
+
+    for (int a = 0; skew_terms[a].term; ++a) {
+	for (int b = a + 1; skew_terms[b].term; ++b) {
+	    Xapian::Query query(Xapian::Query::OP_AND,
+				Xapian::Query(skew_terms[a].term),
+				Xapian::Query(skew_terms[b].term));
+	    // The intervals are coprime, so every multiple of both matches.
+	    Xapian::doccount expected = db.get_doccount() /
+		(skew_terms[a].interval * skew_terms[b].interval);
+	    enquire.set_query(query);
+
+	    logger.searching_start(string(skew_terms[a].term) + " AND " +
+				   skew_terms[b].term);
+	    for (int repeat = 0; repeat != 5; ++repeat) {
+		logger.search_start();
+		// Ask for all the matches so the whole intersection is found.
+		Xapian::MSet mset = enquire.get_mset(0, 10, db.get_doccount());
+		logger.search_end(query, mset);
+		TEST_EQUAL(mset.get_matches_estimated(), expected);
+	    }
+	    logger.searching_end();
+	}
+    }
+
+    logger.testcase_end();
+    return true;
+}
@@ -0,0 +1,318 @@
+/** @file perftest_zipfsearch.cc
+ * @brief Performance tests of searching a corpus with Zipfian term frequencies
+ */
+/* Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_zipfsearch.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "randomgen.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+#include "zipfcorpus.h"
+
+using namespace std;
+
+// Parameters used to control generation of the corpus.
+static const unsigned int corpus_seed = 42;
+static const unsigned int vocab_size = 20000;
+static const unsigned int minwords = 50;
+static const unsigned int maxwords = 300;
+
+// Parameters used to control generation of the query log.
+static const unsigned int querylog_seed = 1729;
+static const unsigned int queries_per_class = 50;
+
+ZipfVocabulary::ZipfVocabulary()
+{
+    srand(corpus_seed);
+    set<string> seen;
+    double total = 0;
+    while (words.size() != vocab_size) {
+	string word = gen_word(rand_int(2, 8), 26);
+	if (!seen.insert(word).second) continue;
+	words.push_back(word);
+	total += 1.0 / words.size();
+	cumulative.push_back(total);
+    }
+}
+
+const string &
+ZipfVocabulary::sample(unsigned int limit) const
+{
+    size_t n = (limit && limit < words.size()) ? limit : words.size();
+    double r = rand_01() * cumulative[n - 1];
+    size_t i = upper_bound(cumulative.begin(), cumulative.begin() + n, r) -
+	       cumulative.begin();
+    return words[min(i, n - 1)];
+}
+
+Xapian::Document
+zipf_document(const ZipfVocabulary & vocab, unsigned int i)
+{
+    Xapian::Document doc;
+    doc.set_data("zipf document " + str(i));
+    unsigned int words = rand_int(minwords, maxwords);
+    for (unsigned int pos = 1; pos <= words; ++pos) {
+	doc.add_posting(vocab.sample(), pos);
+    }
+    doc.add_value(SLOT_NUMBER, Xapian::sortable_serialise(rand_int(100000)));
+    doc.add_value(SLOT_CATEGORY, gen_word(1, 10));
+    doc.add_value(SLOT_GROUP, str(rand_int(1000)));
+    return doc;
+}
+
+void
+builddb_zipfsearch1(Xapian::WritableDatabase &db, const string & arg)
+{
+    unsigned int shard = 0, shards = 1;
+    if (!arg.empty()) {
+	shard = atoi(arg.c_str());
+	shards = atoi(arg.c_str() + arg.find('/') + 1);
+    }
+
+    string dbname = "zipfsearch1";
+    if (shards > 1) dbname += "_" + str(shard);
+    logger.testcase_begin(dbname);
+
+    ZipfVocabulary vocab;
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(ZIPF_CORPUS_SIZE);
+    params["seed"] = str(corpus_seed);
+    params["vocab_size"] = str(vocab_size);
+    params["minwords"] = str(minwords);
+    params["maxwords"] = str(maxwords);
+    params["shard"] = str(shard);
+    params["shards"] = str(shards);
+    logger.indexing_begin(dbname, params);
+
+    for (unsigned int i = 0; i < ZIPF_CORPUS_SIZE; ++i) {
+	Xapian::Document doc = zipf_document(vocab, i);
+
+	// Generate every document so the random sequence is the same whichever
+	// shard we're building.
+	if (i % shards != shard) continue;
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+const char * const query_class_names[QUERY_CLASSES] = {
+    "short OR", "long OR", "AND", "phrase", "wildcard", "value range",
+    "sorted", "collapsed", "faceted"
+};
+
+/// Build a query combining @a n random words with @a op.
+static Xapian::Query
+random_query(const ZipfVocabulary & vocab, Xapian::Query::op op, unsigned int n,
+	     unsigned int limit = 0)
+{
+    vector<string> terms;
+    for (unsigned int i = 0; i != n; ++i) {
+	terms.push_back(vocab.sample(limit));
+    }
+    return Xapian::Query(op, terms.begin(), terms.end());
+}
+
+void
+generate_query_log(vector<LoggedQuery> & log)
+{
+    ZipfVocabulary vocab;
+    srand(querylog_seed);
+    for (unsigned int n = 0; n != queries_per_class; ++n) {
+	for (int c = 0; c != QUERY_CLASSES; ++c) {
+	    LoggedQuery q;
+	    q.cls = query_class(c);
+	    switch (q.cls) {
+		case SHORT_OR:
+		case SORTED:
+		case COLLAPSED:
+		case FACETED:
+		    q.query = random_query(vocab, Xapian::Query::OP_OR, 2);
+		    break;
+		case LONG_OR:
+		    q.query = random_query(vocab, Xapian::Query::OP_OR, 20);
+		    break;
+		case AND:
+		    // Use commoner words so that there are usually matches.
+		    q.query = random_query(vocab, Xapian::Query::OP_AND, 3, 1000);
+		    break;
+		case PHRASE:
+		    q.query = random_query(vocab, Xapian::Query::OP_PHRASE,
+					   rand_int(2, 3), 20);
+		    break;
+		case WILDCARD: {
+		    const string & word = vocab.sample(1000);
+		    q.wildcard = word.substr(0, 2) + "*";
+		    break;
+		}
+		case VALUE_RANGE: {
+		    unsigned int lo = rand_int(100000);
+		    unsigned int hi = lo + rand_int(1000, 20000);
+		    q.query = Xapian::Query(Xapian::Query::OP_VALUE_RANGE,
+					    SLOT_NUMBER,
+					    Xapian::sortable_serialise(lo),
+					    Xapian::sortable_serialise(hi));
+		    break;
+		}
+		case QUERY_CLASSES:
+		    break;
+	    }
+	    log.push_back(q);
+	}
+    }
+}
+
+Xapian::doccount
+prepare_logged_query(Xapian::Enquire & enquire, const LoggedQuery & q,
+		     Xapian::QueryParser & qp, Xapian::MatchSpy & spy)
+{
+    Xapian::doccount check_at_least = 0;
+    switch (q.cls) {
+	case SORTED:
+	    enquire.set_sort_by_value(SLOT_NUMBER, true);
+	    break;
+	case COLLAPSED:
+	    enquire.set_collapse_key(SLOT_GROUP);
+	    break;
+	case FACETED:
+	    // Count the categories of all the matching documents.
+	    enquire.clear_matchspies();
+	    enquire.add_matchspy(&spy);
+	    check_at_least = ZIPF_CORPUS_SIZE;
+	    break;
+	default:
+	    break;
+    }
+
+    if (q.cls == WILDCARD) {
+	// Expanding the wildcard is part of the cost of the query.
+	enquire.set_query(qp.parse_query(q.wildcard, qp.FLAG_WILDCARD));
+    } else {
+	enquire.set_query(q.query);
+    }
+    return check_at_least;
+}
+
+/** Find the number of documents examined from a match profile.
+ *
+ *  This is the total of the "accepted" counts, which includes those of any
+ *  remote shards.
+ */
+static Xapian::doccount
+docs_examined(const string & profile)
+{
+    const string key = "\"accepted\":";
+    Xapian::doccount total = 0;
+    string::size_type i = 0;
+    while ((i = profile.find(key, i)) != string::npos) {
+	i += key.size();
+	total += atoi(profile.c_str() + i);
+    }
+    return total;
+}
+
+/// Run the queries in @a log against @a db, logging the results.
+static void
+replay_query_log(const Xapian::Database & db, const vector<LoggedQuery> & log,
+		 const string & description)
+{
+    Xapian::QueryParser qp;
+    qp.set_database(db);
+
+    logger.searching_start(description);
+    vector<LoggedQuery>::const_iterator q;
+    for (q = log.begin(); q != log.end(); ++q) {
+	Xapian::Enquire enquire(db);
+	Xapian::ValueCountMatchSpy spy(SLOT_CATEGORY);
+
+	// Run the query with profiling once to count the documents examined,
+	// then time it without (as profiling adds overhead).
+	Xapian::doccount check_at_least;
+	check_at_least = prepare_logged_query(enquire, *q, qp, spy);
+	enquire.set_profiling(true);
+	Xapian::doccount examined =
+	    docs_examined(enquire.get_mset(0, 10, check_at_least).get_profile());
+	enquire.set_profiling(false);
+
+	logger.search_start();
+	check_at_least = prepare_logged_query(enquire, *q, qp, spy);
+	Xapian::MSet mset = enquire.get_mset(0, 10, check_at_least);
+	logger.search_end(enquire.get_query(), mset, query_class_names[q->cls],
+			  examined);
+    }
+    logger.searching_end();
+}
+
+// Test the latency of a log of mixed queries, on a single database and on
+// the same documents split into shards.
+DEFINE_TESTCASE(zipfsearch1, generated) {
+    vector<LoggedQuery> log;
+    generate_query_log(log);
+
+    Xapian::Database db;
+    db = backendmanager->get_database("zipfsearch1", builddb_zipfsearch1, "");
+    Xapian::Database shards;
+    for (int i = 0; i != 2; ++i) {
+	string arg = str(i) + "/2";
+	shards.add_database(backendmanager->get_database("zipfsearch1_" + str(i),
+							 builddb_zipfsearch1,
+							 arg));
+    }
+    TEST_EQUAL(db.get_doccount(), ZIPF_CORPUS_SIZE);
+    TEST_EQUAL(shards.get_doccount(), ZIPF_CORPUS_SIZE);
+
+    logger.testcase_begin("zipfsearch1");
+    replay_query_log(db, log, "query log");
+    replay_query_log(shards, log, "query log, 2 shards");
+    logger.testcase_end();
+    return true;
+}
+
+// Test the latency of a log of mixed queries on a remote database.
+DEFINE_TESTCASE(zipfsearch2, remote && writable) {
+    vector<LoggedQuery> log;
+    generate_query_log(log);
+
+    Xapian::WritableDatabase db =
+	backendmanager->get_writable_database("zipfsearch2", "");
+    builddb_zipfsearch1(db, string());
+    TEST_EQUAL(db.get_doccount(), ZIPF_CORPUS_SIZE);
+
+    logger.testcase_begin("zipfsearch2");
+    replay_query_log(db, log, "query log, remote");
+    logger.testcase_end();
+    return true;
+}
@@ -0,0 +1,61 @@
+/** @file randomgen.cc
+ * @brief Generate random data for performance tests.
+ */
+/* Copyright 2008 Lemur Consulting Ltd
+ * Copyright 2009 Olly Betts
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "randomgen.h"
+
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+unsigned int
+rand_int(unsigned int range)
+{
+    return (unsigned int)(range * (rand() / (RAND_MAX + 1.0)));
+}
+
+unsigned int
+rand_int(unsigned int min, unsigned int max)
+{
+    return min + (unsigned int)((max + 1 - min) * (rand() / (RAND_MAX + 1.0)));
+}
+
+double
+rand_01()
+{
+    return rand() / (RAND_MAX + 1.0);
+}
+
+string
+gen_word(unsigned int length, unsigned int char_range)
+{
+    string result;
+    result.reserve(length);
+    for (unsigned int i = 0; i != length; ++i) {
+	char ch = char('a' + rand_int(char_range));
+	result.append(1, ch);
+    }
+    return result;
+}
@@ -0,0 +1,51 @@
+/** @file randomgen.h
+ * @brief Generate random data for performance tests.
+ */
+/* Copyright 2008 Lemur Consulting Ltd
+ * Copyright 2009 Olly Betts
+ * Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_RANDOMGEN_H
+#define XAPIAN_INCLUDED_RANDOMGEN_H
+
+#include <string>
+
+// These all use rand(), so the data generated is reproducible if srand() is
+// called with the same seed first.
+
+/** Generate a random integer from 0 to "range" - 1.
+ */
+unsigned int rand_int(unsigned int range);
+
+/** Generate a random integer from min to max.
+ */
+unsigned int rand_int(unsigned int min, unsigned int max);
+
+/** Generate a random double in range 0.0 <= v < 1.0
+ */
+double rand_01();
+
+/** Generate a "word", of the specified length.
+ *
+ *  @param length     The length of the word to generate.
+ *  @param char_range The range of characters to use in the word.
+ */
+std::string gen_word(unsigned int length, unsigned int char_range);
+
+#endif // XAPIAN_INCLUDED_RANDOMGEN_H
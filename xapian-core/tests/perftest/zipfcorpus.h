@@ -0,0 +1,116 @@
+/** @file zipfcorpus.h
+ * @brief The corpus with Zipfian term frequencies, and its query log.
+ *
+ * These are defined in perftest_zipfsearch.cc, and shared with other tests.
+ */
+/* Copyright 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_ZIPFCORPUS_H
+#define XAPIAN_INCLUDED_ZIPFCORPUS_H
+
+#include <string>
+#include <vector>
+
+#include <xapian.h>
+
+/// The number of documents in the corpus.
+const unsigned int ZIPF_CORPUS_SIZE = 20000;
+
+/// Value slots in the generated documents.
+enum {
+    SLOT_NUMBER,	// sortable_serialise()d number from 0 to 99999.
+    SLOT_CATEGORY,	// One of 10 single letter categories.
+    SLOT_GROUP		// One of 1000 groups, for collapsing.
+};
+
+/** The vocabulary, with the Zipfian distribution of the words.
+ *
+ *  The word at index r has frequency proportional to 1 / (r + 1).
+ */
+struct ZipfVocabulary {
+    std::vector<std::string> words;
+
+    /// Running total of the frequencies of the words.
+    std::vector<double> cumulative;
+
+    /// Generate the vocabulary (which calls srand()).
+    ZipfVocabulary();
+
+    /** Pick a random word.
+     *
+     *  @param limit	Only pick from the most frequent @a limit words (or
+     *			any word if 0).
+     */
+    const std::string & sample(unsigned int limit = 0) const;
+};
+
+/** Generate a random document.
+ *
+ *  @param vocab	The vocabulary to use.
+ *  @param i		The number of the document, which is used in its data.
+ */
+Xapian::Document zipf_document(const ZipfVocabulary & vocab, unsigned int i);
+
+/** Build the corpus (or one shard of it).
+ *
+ *  @a arg is empty to build the whole corpus, or "<shard>/<shards>" to build
+ *  shard number <shard> of <shards>.  The documents are dealt out round-robin,
+ *  so the shards combined have the same documents with the same docids as the
+ *  whole corpus.
+ */
+void builddb_zipfsearch1(Xapian::WritableDatabase &db, const std::string & arg);
+
+/// The classes of query in the query log.
+enum query_class {
+    SHORT_OR, LONG_OR, AND, PHRASE, WILDCARD, VALUE_RANGE, SORTED, COLLAPSED,
+    FACETED, QUERY_CLASSES
+};
+
+/// The name of each class of query.
+extern const char * const query_class_names[QUERY_CLASSES];
+
+struct LoggedQuery {
+    query_class cls;
+
+    /// The query (unused for WILDCARD).
+    Xapian::Query query;
+
+    /// The pattern to expand for WILDCARD.
+    std::string wildcard;
+};
+
+/** Generate the query log.
+ *
+ *  The classes of query are interleaved, as they would be in a real log.
+ */
+void generate_query_log(std::vector<LoggedQuery> & log);
+
+/** Set up @a enquire to run the logged query @a q.
+ *
+ *  @param qp	QueryParser to expand wildcards with.
+ *  @param spy	The matchspy to use for faceted queries.
+ *
+ *  @return	The check_at_least value to pass to Enquire::get_mset().
+ */
+Xapian::doccount prepare_logged_query(Xapian::Enquire & enquire,
+				      const LoggedQuery & q,
+				      Xapian::QueryParser & qp,
+				      Xapian::MatchSpy & spy);
+
+#endif // XAPIAN_INCLUDED_ZIPFCORPUS_H
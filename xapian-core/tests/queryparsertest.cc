@@ -34,6 +34,9 @@
 #include "safesysstat.h" // For mkdir().
 
 #include <stdlib.h> // For setenv() or putenv()
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
 
 using namespace std;
 
@@ -2759,6 +2762,131 @@ static bool test_qp_defaultstrategysome1()
     return true;
 }
 
+/// Test caching of parsed queries.
+static bool test_qp_cache1()
+{
+    mkdir(".chert", 0755);
+    string dbdir = ".chert/qp_cache1";
+    Xapian::WritableDatabase db(dbdir, Xapian::DB_CREATE_OR_OVERWRITE);
+    Xapian::Document doc;
+    doc.add_term("document");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::QueryParser qp;
+    qp.set_cache_size(2);
+    qp.set_stemmer(Xapian::Stem("en"));
+    Xapian::SimpleStopper stopper;
+    stopper.add("the");
+    qp.set_stopper(&stopper);
+    qp.set_database(db);
+
+    const unsigned flags = qp.FLAG_DEFAULT | qp.FLAG_WILDCARD;
+    for (int i = 0; i != 2; ++i) {
+	TEST_EQUAL(qp.parse_query("the testing", flags).get_description(),
+		   "Query(Ztest@2)");
+	TEST_EQUAL(*qp.stoplist_begin(), "the");
+	TEST_EQUAL(*qp.unstem_begin("Ztest"), "testing");
+	// Check the side outputs get restored when we hit the cache.
+	TEST_EQUAL(qp.parse_query("doc*", flags).get_description(),
+		   "Query(document@1)");
+	TEST(qp.stoplist_begin() == qp.stoplist_end());
+    }
+
+    // Check that changes to the database are noticed once committed.
+    doc.add_term("docs");
+    db.add_document(doc);
+    db.commit();
+    TEST_EQUAL(qp.parse_query("doc*", flags).get_description(),
+	       "Query((docs@1 SYNONYM document@1))");
+
+    // Check that adding a prefix empties the cache.
+    TEST_EQUAL(qp.parse_query("title:foo", flags).get_description(),
+	       "Query((title@1 PHRASE 2 foo@2))");
+    qp.add_prefix("title", "S");
+    TEST_EQUAL(qp.parse_query("title:foo", flags).get_description(),
+	       "Query(ZSfoo@1)");
+
+    // Changes to the stopper aren't noticed until the cache is emptied.
+    TEST_EQUAL(qp.parse_query("one two", flags).get_description(),
+	       "Query((Zone@1 OR Ztwo@2))");
+    stopper.add("one");
+    TEST_EQUAL(qp.parse_query("one two", flags).get_description(),
+	       "Query((Zone@1 OR Ztwo@2))");
+    qp.set_cache_size(0);
+    TEST_EQUAL(qp.parse_query("one two", flags).get_description(),
+	       "Query(Ztwo@2)");
+
+    return true;
+}
+
+#ifdef HAVE_PTHREAD_H
+struct qp_cache2_args {
+    Xapian::QueryParser * qp;
+    unsigned mismatches;
+};
+
+static void *
+qp_cache2_thread(void * p)
+{
+    qp_cache2_args * args = static_cast<qp_cache2_args *>(p);
+    static const char * const queries[][2] = {
+	{ "the testing", "Query(Ztest@2)" },
+	{ "doc*", "Query(document@1)" },
+	{ "one two", "Query((Zone@1 OR Ztwo@2))" }
+    };
+    const unsigned flags = Xapian::QueryParser::FLAG_DEFAULT |
+			   Xapian::QueryParser::FLAG_WILDCARD;
+    for (int i = 0; i != 1000; ++i) {
+	for (size_t j = 0; j != sizeof(queries) / sizeof(queries[0]); ++j) {
+	    Xapian::Query q = args->qp->parse_query(queries[j][0], flags);
+	    if (q.get_description() != queries[j][1])
+		++args->mismatches;
+	}
+    }
+    return NULL;
+}
+#endif
+
+/// Test sharing a caching QueryParser between threads.
+static bool test_qp_cache2()
+{
+#ifdef HAVE_PTHREAD_H
+    mkdir(".chert", 0755);
+    string dbdir = ".chert/qp_cache2";
+    Xapian::WritableDatabase db(dbdir, Xapian::DB_CREATE_OR_OVERWRITE);
+    Xapian::Document doc;
+    doc.add_term("document");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::QueryParser qp;
+    qp.set_cache_size(2);
+    qp.set_stemmer(Xapian::Stem("en"));
+    Xapian::SimpleStopper stopper;
+    stopper.add("the");
+    qp.set_stopper(&stopper);
+    qp.set_database(db);
+
+    const int N_THREADS = 4;
+    pthread_t threads[N_THREADS];
+    qp_cache2_args args[N_THREADS];
+    for (int i = 0; i != N_THREADS; ++i) {
+	args[i].qp = &qp;
+	args[i].mismatches = 0;
+	TEST_EQUAL(pthread_create(&threads[i], NULL, qp_cache2_thread,
+				  &args[i]), 0);
+    }
+    for (int i = 0; i != N_THREADS; ++i) {
+	TEST_EQUAL(pthread_join(threads[i], NULL), 0);
+	TEST_EQUAL(args[i].mismatches, 0);
+    }
+    return true;
+#else
+    SKIP_TEST("Test needs pthreads");
+#endif
+}
+
 /// Test cases for the QueryParser.
 static const test_desc tests[] = {
     TESTCASE(queryparser1),
@@ -2802,6 +2930,8 @@ static const test_desc tests[] = {
     TESTCASE(qp_default_op2),
     TESTCASE(qp_default_op3),
     TESTCASE(qp_defaultstrategysome1),
+    TESTCASE(qp_cache1),
+    TESTCASE(qp_cache2),
     END_OF_TESTCASES
 };
 
@@ -49,6 +49,14 @@ using namespace std;
 #include "../common/fileutils.cc"
 #include "../common/serialise-double.cc"
 #include "../net/length.cc"
+#ifdef XAPIAN_TRACING
+# include "../common/tracepoint.cc"
+# include <cstdio>
+# include <fstream>
+# include <iterator>
+# include <pthread.h>
+# include "safesyswait.h"
+#endif
 
 DEFINE_TESTCASE_(simple_exceptions_work1) {
     try {
@@ -300,6 +308,106 @@ static bool test_serialiselength2()
 }
 #endif
 
+#ifdef XAPIAN_TRACING
+static void *
+trace_from_thread(void *)
+{
+    XAPIAN_TRACE(match_end, 1, 0);
+    return NULL;
+}
+
+/** Read trace file @a filename, checking its header.
+ *
+ *  @return the number of events recorded by each thread slot.
+ */
+static vector<uint8>
+read_trace_file(const string & filename, TraceFileHeader & header)
+{
+    ifstream in(filename.c_str(), ios::in | ios::binary);
+    TEST(in);
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    TEST(data.size() >= sizeof(header));
+    memcpy(&header, data.data(), sizeof(header));
+    TEST(memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) == 0);
+    TEST_EQUAL(header.version, TRACE_FILE_VERSION);
+    size_t slot_size = sizeof(TraceThread) +
+	header.events_per_thread * sizeof(TraceEvent);
+    TEST_EQUAL(data.size(), sizeof(header) + header.threads * slot_size);
+    vector<uint8> counts;
+    for (unsigned t = 0; t != header.threads; ++t) {
+	TraceThread thread;
+	memcpy(&thread, data.data() + sizeof(header) + t * slot_size,
+	       sizeof(thread));
+	counts.push_back(thread.count);
+    }
+    return counts;
+}
+
+// Test writing a trace file, and decoding it with xapian-trace.
+static bool test_tracefile1()
+{
+    setenv("XAPIAN_TRACE_FILE", ".tracefile1.%p", 1);
+    setenv("XAPIAN_TRACE_THREADS", "2", 1);
+    setenv("XAPIAN_TRACE_EVENTS", "4", 1);
+    XAPIAN_TRACE(match_start, 2, 10);
+    string filename = ".tracefile1." + str(getpid());
+
+    // Each thread should reuse the slot released by the one before.
+    for (int i = 0; i != 3; ++i) {
+	pthread_t thread;
+	TEST_EQUAL(pthread_create(&thread, NULL, trace_from_thread, NULL), 0);
+	TEST_EQUAL(pthread_join(thread, NULL), 0);
+    }
+
+    // A child process should write its own trace file, not our one.
+    pid_t child = fork();
+    if (child == 0) {
+	XAPIAN_TRACE(match_end, 2, 0);
+	_exit(0);
+    }
+    TEST(child > 0);
+    int status;
+    TEST_EQUAL(waitpid(child, &status, 0), child);
+    TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    string child_filename = ".tracefile1." + str(child);
+
+    XAPIAN_TRACE(match_end, 3, 0);
+
+    TraceFileHeader header;
+    vector<uint8> counts = read_trace_file(filename, header);
+    TEST_EQUAL(header.pid, uint4(getpid()));
+    TEST_EQUAL(header.dropped_threads, 0);
+    TEST_EQUAL(counts.size(), 2);
+    TEST_EQUAL(counts[0], 2);
+    TEST_EQUAL(counts[1], 3);
+
+    counts = read_trace_file(child_filename, header);
+    TEST_EQUAL(header.pid, uint4(child));
+    TEST_EQUAL(counts[0], 1);
+    TEST_EQUAL(counts[1], 0);
+    unlink(child_filename.c_str());
+
+    string cmd = "../bin/xapian-trace " + filename;
+    FILE * f = popen(cmd.c_str(), "r");
+    TEST(f);
+    string output;
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) output.append(buf, n);
+    TEST_EQUAL(pclose(f), 0);
+    unlink(filename.c_str());
+    tout << output;
+    TEST(startswith(output, "pid " + str(getpid()) + ", "
+			    "2 of 2 thread slots used, 5 events\n"));
+    TEST(output.find(" 0 match_start shards=2 check_at_least=10\n") !=
+	 string::npos);
+    TEST(output.find(" 1 match_end items=1\n") != string::npos);
+    TEST(output.find(" 0 match_end items=3\n") != string::npos);
+    TEST(output.find("items=2") == string::npos);
+    return true;
+}
+#endif
+
 // Test log2() (which might be our replacement version).
 static bool test_log2()
 {
@@ -320,6 +428,9 @@ static const test_desc tests[] = {
     TESTCASE(serialiselength2),
 #endif
     TESTCASE(log2),
+#ifdef XAPIAN_TRACING
+    TESTCASE(tracefile1),
+#endif
     END_OF_TESTCASES
 };
 
@@ -28,6 +28,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 namespace Xapian {
 
@@ -187,6 +188,62 @@ class XAPIAN_VISIBILITY_DEFAULT Letor {
      *          and database size.
      */
     void prepare_training_file(const std::string & query_file, const std::string & qrel_file, Xapian::doccount msetsize);
+
+    /** Prepare training data in memory, without writing a training file.
+     *
+     *  Each query is run against the database and the features of the
+     *  judged documents in the top @a msetsize results are calculated and
+     *  normalised, in the same way as prepare_training_file() does.  The
+     *  data is kept by this object (replacing any prepared previously) for
+     *  use by learn_model().
+     *
+     *  @param  queries     The training queries.
+     *  @param  qrels       The relevance judgements for each query in
+     *          @a queries, as a map from docid to relevance label.
+     *  @param  msetsize    The mset size used for the first retrieval for
+     *          each training query.
+     *  @param  threads     The number of threads to use (default 1).  The
+     *          queries are shared between the threads, each using its own
+     *          copy of the database from Database::clone_for_thread().
+     *          The training data is the same whatever the number of
+     *          threads.
+     */
+    void prepare_training_data(const std::vector<Xapian::Query> & queries,
+			       const std::vector<std::map<Xapian::docid, int> > & qrels,
+			       Xapian::doccount msetsize,
+			       unsigned threads = 1);
+
+    /** Learn a model from the data from prepare_training_data().
+     *
+     *  The model is kept in memory and used by letor_score() and
+     *  LetorReranker, instead of 'model.txt'.  The parameters are as for
+     *  letor_learn_model().
+     *
+     *  @exception Xapian::InvalidOperationError will be thrown if there's
+     *             no training data.
+     *  @exception Xapian::InvalidArgumentError will be thrown if @a s or
+     *             @a k isn't valid for the training data.
+     */
+    void learn_model(int s, int k);
+};
+
+/** Rerank the top documents of a match using a Letor model.
+ *
+ *  For use with Xapian::Enquire::set_reranker().  The Letor object must have
+ *  its database set to the database being searched, and either have learnt
+ *  a model with learn_model() or be able to load one from 'model.txt'.
+ */
+class XAPIAN_VISIBILITY_DEFAULT LetorReranker : public Xapian::Reranker {
+    /// The Letor object to score documents with.
+    Letor letor;
+
+  public:
+    /// Construct a reranker using @a letor_.
+    explicit LetorReranker(const Letor & letor_) : letor(letor_) { }
+
+    void operator()(const Xapian::Query & query,
+		    const Xapian::MSet & candidates,
+		    std::vector<double> & scores);
 };
 
 }
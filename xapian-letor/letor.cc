@@ -26,6 +26,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -124,4 +125,22 @@ Letor::prepare_training_file(const string & query_file, const string & qrel_file
     internal->prepare_training_file(query_file, qrel_file, msetsize);
 }
 
+void
+Letor::prepare_training_data(const vector<Xapian::Query> & queries, const vector<map<Xapian::docid, int> > & qrels, Xapian::doccount msetsize, unsigned threads) {
+    internal->prepare_training_data(queries, qrels, msetsize, threads);
+}
+
+void
+Letor::learn_model(int s, int k) {
+    internal->learn_model(s, k);
+}
+
+void
+LetorReranker::operator()(const Xapian::Query & query,
+			  const Xapian::MSet & candidates,
+			  vector<double> & scores)
+{
+    letor.internal->score_mset(query, candidates, scores);
+}
+
 }
@@ -36,14 +36,20 @@
 #include "safeunistd.h"
 
 #include <algorithm>
-#include <list>
+#include <exception>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <map>
+#include <utility>
+#include <vector>
 #include <math.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #include <libsvm/svm.h>
 #define Malloc(type, n) (type *)malloc((n) * sizeof(type))
 
@@ -58,11 +64,6 @@ struct svm_node *x_space;
 int cross_validation;
 int nr_fold;
 
-struct svm_node *x;
-int max_nr_attr = 64;
-
-int predict_probability = 0;
-
 static char *line = NULL;
 static int max_line_len;
 
@@ -171,189 +172,147 @@ Letor::Internal::collection_termfreq(const Xapian::Database & db, const Xapian::
     return tf;
 }
 
+/* The contribution of a single query term to each feature.  These are shared
+ * by calculate_f1() to calculate_f6() and calculate_features(), so the two
+ * give the same values.  We always use log10(1 + quantity) because
+ * log(1) = 0 and log(0) = -inf.
+ */
+static inline double
+f1_term(double tf)
+{
+    return log10(1 + tf);
+}
+
+static inline double
+f2_term(double tf, double doc_len)
+{
+    return log10(1 + (tf / (1 + doc_len)));
+}
+
+static inline double
+f3_term(double idf)
+{
+    return log10(1 + idf);
+}
+
+static inline double
+f4_term(double coll_tf, double coll_len)
+{
+    return log10(1 + (coll_len / (1 + coll_tf)));
+}
+
+static inline double
+f5_term(double tf, double idf, double doc_len)
+{
+    // 1 + doc_len because if title info is not available then the title
+    // length will be zero.
+    return log10(1 + ((tf * idf) / (1 + doc_len)));
+}
+
+static inline double
+f6_term(double tf, double doc_len, double coll_tf, double coll_len)
+{
+    return log10(1 + ((tf * coll_len) / (1 + (doc_len * coll_tf))));
+}
+
+/// Is @ term from the title (stored with the standard "S" prefix)?
+static inline bool
+is_title_term(const string & term)
+{
+    return term.substr(0, 1) == "S" || term.substr(1, 1) == "S";
+}
+
+/** Does a term count towards part @ ch of the document?
+ *
+ *  @ ch is 't' for the title, 'b' for the body, or anything else for the
+ *  whole document.
+ */
+static inline bool
+in_part(bool title, char ch)
+{
+    if (ch == 't') return title;
+    if (ch == 'b') return !title;
+    return true;
+}
+
+/// The key for part @ ch of the document in a map of lengths.
+static const char *
+part_name(char ch)
+{
+    if (ch == 't') return "title";
+    if (ch == 'b') return "body";
+    return "whole";
+}
+
 double
 Letor::Internal::calculate_f1(const Xapian::Query & query, map<string, long int> & tf, char ch) {
     double value = 0;
-
-    if (ch == 't') {           // if feature1 for title
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + tf[*qt]);       // always use log10(1+quantity) because log(1) = 0 and log(0) = -inf
-	    } else            // if there is no title information stored with standart "S" prefix
-		value += 0;
-	}
-	return value;
-    } else if (ch == 'b') {              //  if for body only
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + tf[*qt]);      //  always use log10(1+quantity) because log(1) = 0 and log(0) = -inf
-	    } else
-		value += 0;
-	}
-	return value;
-    } else {                         //   if for whole document
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1 + tf[*qt]);      //  always use log10(1+quantity) because log(1) = 0 and log(0) = -inf
-	}
-	return value;
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f1_term(tf[*qt]);
     }
+    return value;
 }
 
-
 double
 Letor::Internal::calculate_f2(const Xapian::Query & query, map<string, long int> & tf, map<string, long int> & doc_len, char ch) {
     double value = 0;
-
-    if (ch == 't') {            //if feature1 for title then
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + ((double)tf[*qt] / (1 + (double)doc_len["title"])));        //always use log10(1+quantity) because log(1) = 0 and log(0) = -inf
-	    }
-	}
-	return value;
-    } else if (ch == 'b') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + ((double)tf[*qt] / (1 + (double)doc_len["body"])));
-	    }
-	}
-	return value;
-    } else {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1 + ((double)tf[*qt] / (1 + (double)doc_len["whole"])));
-	}
-	return value;
+    double len = doc_len[part_name(ch)];
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f2_term(tf[*qt], len);
     }
+    return value;
 }
 
 double
 Letor::Internal::calculate_f3(const Xapian::Query & query, map<string, double> & idf, char ch) {
     double value = 0;
-
-    if (ch == 't') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + idf[*qt]);
-	    } else
-		value += 0;
-	}
-	return value;
-    } else if (ch == 'b') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + idf[*qt]);
-	    } else
-		value += 0;
-	}
-	return value;
-    } else {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1 + idf[*qt]);
-	}
-	return value;
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f3_term(idf[*qt]);
     }
+    return value;
 }
 
 double
 Letor::Internal::calculate_f4(const Xapian::Query & query, map<string, long int> & tf, map<string, long int> & coll_len, char ch) {
     double value = 0;
-
-    if (ch == 't') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + ((double)coll_len["title"] / (double)(1 + tf[*qt])));
-	    } else
-		value += 0;
-	}
-	return value;
-    } else if (ch == 'b') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + ((double)coll_len["body"] / (double)(1 + tf[*qt])));
-	    } else
-		value += 0;
-	}
-	return value;
-    } else {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1 + ((double)coll_len["whole"] / (double)(1 + tf[*qt])));
-	}
-	return value;
+    double len = coll_len[part_name(ch)];
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f4_term(tf[*qt], len);
     }
+    return value;
 }
 
 double
 Letor::Internal::calculate_f5(const Xapian::Query & query, map<string, long int> & tf, map<string, double> & idf, map<string, long int> & doc_len, char ch) {
     double value = 0;
-
-    if (ch == 't') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + ((double)(tf[*qt] * idf[*qt]) / (1 + (double)doc_len["title"]))); // 1 + doc_len because if title info is not available then doc_len["title"] will be zero.
-	    } else
-		value += 0;
-	}
-	return value;
-    } else if (ch == 'b') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + ((double)(tf[*qt] * idf[*qt]) / (1 + (double)doc_len["body"])));
-	    } else
-		value += 0;
-	}
-	return value;
-    } else {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1 + ((double)(tf[*qt] * idf[*qt]) / (1 + (double)doc_len["whole"])));
-	}
-	return value;
+    double len = doc_len[part_name(ch)];
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f5_term(tf[*qt], idf[*qt], len);
     }
+    return value;
 }
 
 double
 Letor::Internal::calculate_f6(const Xapian::Query & query, map<string, long int> & tf, map<string, long int> & doc_len, map<string, long int> & coll_tf, map<string, long int> & coll_length, char ch) {
     double value = 0;
-
-    if (ch == 't') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) == "S" || (*qt).substr(1, 1) == "S") {
-		value += log10(1 + (((double)tf[*qt] * (double)coll_length["title"]) / (double)(1 + ((double)doc_len["title"] * (double)coll_tf[*qt]))));
-	    } else
-		value += 0;
-	}
-	return value;
-    } else if (ch == 'b') {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    if ((*qt).substr(0, 1) != "S" && (*qt).substr(1, 1) != "S") {
-		value += log10(1 + (((double)tf[*qt] * (double)coll_length["body"]) / (double)(1 + ((double)doc_len["body"] * (double)coll_tf[*qt]))));
-	    } else
-		value += 0;
-	}
-	return value;
-    } else {
-	for (Xapian::TermIterator qt = query.get_terms_begin();
-	     qt != query.get_terms_end(); ++qt) {
-	    value += log10(1+(((double)tf[*qt] * (double)coll_length["whole"]) / (double)(1 + ((double)doc_len["whole"] * (double)coll_tf[*qt]))));
-	}
-	return value;
+    double len = doc_len[part_name(ch)];
+    double c_len = coll_length[part_name(ch)];
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	if (in_part(is_title_term(*qt), ch))
+	    value += f6_term(tf[*qt], len, coll_tf[*qt], c_len);
     }
+    return value;
 }
 
 
@@ -362,238 +321,251 @@ static void exit_input_error(int line_num) {
     exit(1);
 }
 
-static string convertDouble(double value) {
-    std::ostringstream o;
-    if (!(o << value))
-	return string();
-    return o.str();
-}
-
 static string get_cwd() {
     char temp[MAXPATHLEN];
     return (getcwd(temp, MAXPATHLEN) ? std::string(temp) : std::string());
 }
 
 
-/* This method will calculate the score assigned by the Letor function.
- * It will take MSet as input then convert the documents in feature vectors
- * then normalize them according to QueryLevelNorm
- * and after that use the machine learned model file
- * to assign a score to the document
+/* The features are calculated for all the documents in an MSet together.
+ *
+ * Rather than fetching each document's termlist to find the wdf of each query
+ * term, we open the postlist for each query term once and skip_to() each of
+ * the MSet's docids in ascending order.  The only per-document termlist
+ * access is to find the length of the title, which means skipping to the
+ * S-prefixed terms.
+ *
+ * The result is a dense matrix, with the NUM_FEATURES features of each
+ * document in MSet order, so features[r * NUM_FEATURES + j - 1] is feature
+ * j (as numbered in the documentation) for the document at rank r.
  */
-map<Xapian::docid, double>
-Letor::Internal::letor_score(const Xapian::MSet & mset) {
-
-    map<Xapian::docid, double> letor_mset;
-
-    map<string, long int> coll_len;
-    coll_len = collection_length(letor_db);
-
-    map<string, long int> coll_tf;
-    coll_tf = collection_termfreq(letor_db, letor_query);
-
-    map<string, double> idf;
-    idf = inverse_doc_freq(letor_db, letor_query);
-
-    int first = 1;                //used as a flag in QueryLevelNorm module
-
-    typedef list<double> List1;     //the values of a particular feature for MSet documents will be stored in the list
-    typedef map<int, List1> Map3;    //the above list will be mapped to an integer with its feature id.
-
-    /* So the whole structure will look like below if there are 5 documents in  MSet and 3 features to be calculated
-     *
-     * 1  -> 32.12 - 23.12 - 43.23 - 12.12 - 65.23
-     * 2  -> 31.23 - 21.43 - 33.99 - 65.23 - 22.22
-     * 3  -> 1.21 - 3.12 - 2.23 - 6.32 - 4.23
-     *
-     * And after that we divide the whole list by the maximum value for that feature in all the 5 documents
-     * So we divide the values of Feature 1 in above case by 65.23 and hence all the values of that features for that query
-     * will belongs to [0,1] and is known as Query level Norm
-     */
-
-    Map3 norm;
-
-    map<int, list<double> >::iterator norm_outer;
-    list<double>::iterator norm_inner;
-
-    typedef list<string> List2;
-    List2 doc_ids;
+void
+Letor::Internal::calculate_features(const Xapian::Database & db,
+				    const Xapian::MSet & mset,
+				    const Xapian::Query & query,
+				    map<string, long int> & coll_len,
+				    vector<double> & features)
+{
+    Xapian::doccount rows = mset.size();
+    features.assign(rows * NUM_FEATURES, 0.0);
+    if (rows == 0) return;
+
+    // The query terms in the order the feature functions above iterate over
+    // them (which may include repeats), and the index of each in the vector
+    // of distinct terms.
+    vector<string> distinct_terms;
+    map<string, size_t> term_index;
+    vector<size_t> qterms;
+    vector<bool> is_title;
+    for (Xapian::TermIterator qt = query.get_terms_begin();
+	 qt != query.get_terms_end(); ++qt) {
+	const string & term = *qt;
+	pair<map<string, size_t>::iterator, bool> ins;
+	ins = term_index.insert(make_pair(term, distinct_terms.size()));
+	if (ins.second) distinct_terms.push_back(term);
+	qterms.push_back(ins.first->second);
+	is_title.push_back(is_title_term(term));
+    }
+    size_t n_terms = distinct_terms.size();
+
+    // Collection statistics for each distinct term.
+    map<string, double> idf_map = inverse_doc_freq(db, query);
+    map<string, long int> coll_tf_map = collection_termfreq(db, query);
+    vector<double> idf(n_terms);
+    vector<long int> coll_tf(n_terms);
+    for (size_t t = 0; t != n_terms; ++t) {
+	idf[t] = idf_map[distinct_terms[t]];
+	coll_tf[t] = coll_tf_map[distinct_terms[t]];
+    }
 
+    // The MSet's docids in ascending order, with the rank of each.
+    vector<pair<Xapian::docid, Xapian::doccount> > docs;
+    docs.reserve(rows);
     for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
-	Xapian::Document doc = i.get_document();
-
-	map<string, long int> tf;
-	tf = termfreq(doc, letor_query);
-
-	map<string, long int> doclen;
-	doclen = doc_length(letor_db, doc);
-
-	double f[20];
-
-	f[1] = calculate_f1(letor_query, tf, 't');          //storing the feature values from array index 1 to sync it with feature number.
-	f[2] = calculate_f1(letor_query, tf, 'b');
-	f[3] = calculate_f1(letor_query, tf, 'w');
-
-	f[4] = calculate_f2(letor_query, tf, doclen, 't');
-	f[5] = calculate_f2(letor_query, tf, doclen, 'b');
-	f[6] = calculate_f2(letor_query, tf, doclen, 'w');
-
-	f[7] = calculate_f3(letor_query, idf, 't');
-	f[8] = calculate_f3(letor_query, idf, 'b');
-	f[9] = calculate_f3(letor_query, idf, 'w');
-
-	f[10] = calculate_f4(letor_query, coll_tf, coll_len, 't');
-	f[11] = calculate_f4(letor_query, coll_tf, coll_len, 'b');
-	f[12] = calculate_f4(letor_query, coll_tf, coll_len, 'w');
-
-	f[13] = calculate_f5(letor_query, tf, idf, doclen, 't');
-	f[14] = calculate_f5(letor_query, tf, idf, doclen, 'b');
-	f[15] = calculate_f5(letor_query, tf, idf, doclen, 'w');
-
-	f[16] = calculate_f6(letor_query, tf, doclen, coll_tf, coll_len, 't');
-	f[17] = calculate_f6(letor_query, tf, doclen, coll_tf, coll_len, 'b');
-	f[18] = calculate_f6(letor_query, tf, doclen, coll_tf, coll_len, 'w');
-
-	f[19] = i.get_weight();
-
-	/* This module will make the data structure to store the whole features values for
-	 * all the documents for a particular query along with its relevance judgements
-	 */
-
-	if (first == 1) {
-	    for (int j = 1; j < 20; ++j) {
-		List1 l;
-		l.push_back(f[j]);
-		norm.insert(pair<int, list<double> >(j, l));
-	    }
-	    first = 0;
-	} else {
-	    norm_outer = norm.begin();
-	    int k = 1;
-	    for (; norm_outer != norm.end(); ++norm_outer) {
-		norm_outer->second.push_back(f[k]);
-		++k;
-	    }
-	}
-    }//for closed
-
-    /* this is the place where we have to normalize the norm and after that store it in the file. */
-
-    if (!norm.empty()) {
-	norm_outer = norm.begin();
-	++norm_outer;
-	int k = 0;
-	for (; norm_outer != norm.end(); ++norm_outer) {
-	    k = 0;
-	    double max = norm_outer->second.front();
-	    for (norm_inner = norm_outer->second.begin(); norm_inner != norm_outer->second.end(); ++norm_inner) {
-		if (*norm_inner > max)
-		    max = *norm_inner;
-	    }
-	    for (norm_inner = norm_outer->second.begin(); norm_inner != norm_outer->second.end(); ++norm_inner) {
-		if (max != 0)      // sometimes value for whole feature is 0 and hence it may cause 'divide-by-zero'
-		    *norm_inner /= max;
-		++k;
-	    }
+	docs.push_back(make_pair(*i, Xapian::doccount(i.get_rank() - mset.get_firstitem())));
+    }
+    sort(docs.begin(), docs.end());
+
+    // tf[r * n_terms + t] is the wdf of distinct term t in the document at
+    // rank r.
+    vector<long int> tf(rows * n_terms, 0);
+    for (size_t t = 0; t != n_terms; ++t) {
+	const string & term = distinct_terms[t];
+	Xapian::PostingIterator p = db.postlist_begin(term);
+	Xapian::PostingIterator pend = db.postlist_end(term);
+	for (size_t d = 0; d != docs.size() && p != pend; ++d) {
+	    p.skip_to(docs[d].first);
+	    if (p != pend && *p == docs[d].first)
+		tf[docs[d].second * n_terms + t] = p.get_wdf();
 	}
+    }
 
-	int xx = 0, j = 0;
-	Xapian::MSetIterator mset_iter = mset.begin();
-	Xapian::Document doc;
-	while (xx<k) {
-	    doc = mset_iter.get_document();
-
-	    string test_case = "0 ";
-	    j = 0;
-	    norm_outer = norm.begin();
-	    ++j;
-	    for (; norm_outer != norm.end(); ++norm_outer) {
-		test_case.append(str(j));
-		test_case.append(":");
-		test_case.append(convertDouble(norm_outer->second.front()));
-		test_case.append(" ");
-		norm_outer->second.pop_front();
-		++j;
-	    }
-	    ++xx;
-
-	    string model_file;
-	    model_file = get_cwd();
-	    model_file = model_file.append("/model.txt");       // will create "model.txt" in currect working directory
-
-	    model = svm_load_model(model_file.c_str());
-	    x = (struct svm_node *)malloc(max_nr_attr * sizeof(struct svm_node));
-
-	    int total = 0;
-
-	    int svm_type = svm_get_svm_type(model);
-	    int nr_class = svm_get_nr_class(model);
+    // Document lengths, in the same form as doc_length() returns.
+    vector<long int> title_len(rows), whole_len(rows);
+    for (size_t d = 0; d != docs.size(); ++d) {
+	Xapian::docid did = docs[d].first;
+	Xapian::doccount r = docs[d].second;
+	long int temp_count = 0;
+	Xapian::TermIterator dt = db.termlist_begin(did);
+	Xapian::TermIterator dtend = db.termlist_end(did);
+	for (dt.skip_to("S"); dt != dtend; ++dt) {
+	    if ((*dt)[0] != 'S') break;
+	    temp_count += dt.get_wdf();
+	}
+	title_len[r] = temp_count;
+	whole_len[r] = db.get_doclength(did);
+    }
 
-	    if (predict_probability) {
-		if (svm_type == NU_SVR || svm_type == EPSILON_SVR) {
-		    printf("Prob. model for test data: target value = predicted value + z,\nz: Laplace distribution e^(-|z|/sigma)/(2sigma),sigma=%g\n" , svm_get_svr_probability(model));
-		} else {
-		    int *labels = (int *) malloc(nr_class * sizeof(int));
-		    svm_get_labels(model, labels);
-		    free(labels);
-		}
+    // These are the same calculations as calculate_f1() to calculate_f6(),
+    // done for every document.  Feature j for part k (0 for the title, 1 for
+    // the body, 2 for the whole document) is at offset 3 * (j - 1) + k.
+    static const char parts[3] = { 't', 'b', 'w' };
+    double coll_len_part[3];
+    for (int k = 0; k != 3; ++k)
+	coll_len_part[k] = (double)coll_len[part_name(parts[k])];
+
+    Xapian::MSetIterator m = mset.begin();
+    for (Xapian::doccount r = 0; r != rows; ++r, ++m) {
+	size_t row = r * NUM_FEATURES;
+	const long int * doc_tf = &tf[r * n_terms];
+	double doc_len_part[3];
+	doc_len_part[0] = (double)title_len[r];
+	doc_len_part[1] = (double)(whole_len[r] - title_len[r]);
+	doc_len_part[2] = (double)whole_len[r];
+	for (int k = 0; k != 3; ++k) {
+	    double f1 = 0, f2 = 0, f3 = 0, f4 = 0, f5 = 0, f6 = 0;
+	    for (size_t q = 0; q != qterms.size(); ++q) {
+		if (!in_part(is_title[q], parts[k])) continue;
+		size_t t = qterms[q];
+		f1 += f1_term(doc_tf[t]);
+		f2 += f2_term(doc_tf[t], doc_len_part[k]);
+		f3 += f3_term(idf[t]);
+		f4 += f4_term(coll_tf[t], coll_len_part[k]);
+		f5 += f5_term(doc_tf[t], idf[t], doc_len_part[k]);
+		f6 += f6_term(doc_tf[t], doc_len_part[k], coll_tf[t],
+			      coll_len_part[k]);
 	    }
+	    features[row + k] = f1;
+	    features[row + 3 + k] = f2;
+	    features[row + 6 + k] = f3;
+	    features[row + 9 + k] = f4;
+	    features[row + 12 + k] = f5;
+	    features[row + 15 + k] = f6;
+	}
+	features[row + 18] = m.get_weight();
+    }
+}
 
-	    max_line_len = 1024;
-	    line = (char *)malloc(max_line_len*sizeof(char));
-
-	    line = const_cast<char *>(test_case.c_str());
-
-	    int i = 0;
-	    double predict_label;
-	    char *idx, *val, *label, *endptr;
-	    int inst_max_index = -1; // strtol gives 0 if wrong format, and precomputed kernel has <index> start from 0
+/* Apply QueryLevelNorm to a matrix of features - i.e. divide each feature
+ * by its maximum value over all the documents, so all the values of that
+ * feature for the query are in [0,1].
+ */
+static void
+normalise_features(vector<double> & features)
+{
+    size_t rows = features.size() / NUM_FEATURES;
+    if (rows == 0) return;
+    for (int j = 0; j != NUM_FEATURES; ++j) {
+	double max = features[j];
+	for (size_t r = 1; r != rows; ++r) {
+	    if (features[r * NUM_FEATURES + j] > max)
+		max = features[r * NUM_FEATURES + j];
+	}
+	// Sometimes the value for a whole feature is 0, and we don't want to
+	// divide by zero.
+	if (max == 0) continue;
+	for (size_t r = 0; r != rows; ++r) {
+	    features[r * NUM_FEATURES + j] /= max;
+	}
+    }
+}
 
-	    label = strtok(line, " \t\n");
-	    if (label == NULL) // empty line
-		exit_input_error(total + 1);
+/* Score every row of a matrix of normalised features using the SVM model.
+ * The rows are all converted to libsvm's sparse format in a single
+ * allocation.
+ */
+static void
+score_features(const struct svm_model * svm, const vector<double> & features,
+	       vector<double> & scores)
+{
+    size_t rows = features.size() / NUM_FEATURES;
+    scores.resize(rows);
+    if (rows == 0) return;
+    // Each row needs an extra node for the index = -1 terminator.
+    vector<struct svm_node> nodes(rows * (NUM_FEATURES + 1));
+    struct svm_node * node = &nodes[0];
+    for (size_t r = 0; r != rows; ++r) {
+	struct svm_node * row = node;
+	for (int j = 0; j != NUM_FEATURES; ++j) {
+	    node->index = j + 1;
+	    node->value = features[r * NUM_FEATURES + j];
+	    ++node;
+	}
+	node->index = -1;
+	++node;
+	scores[r] = svm_predict(svm, row);
+    }
+}
 
-	    if (strtod(label, &endptr)) {
-		// Ignore the result (I guess we're just syntax checking the file?)
-	    }
-	    if (endptr == label || *endptr != '\0')
-		exit_input_error(total + 1);
+void
+Letor::Internal::free_model()
+{
+    if (svm) svm_free_and_destroy_model(&svm);
+}
 
-	    while (1) {
-		if (i >= max_nr_attr - 1) {	// need one more for index = -1
-		    max_nr_attr *= 2;
-		    x = (struct svm_node *)realloc(x, max_nr_attr * sizeof(struct svm_node));
-		}
+const struct svm_model *
+Letor::Internal::get_model()
+{
+    if (svm == NULL) {
+	string model_file;
+	model_file = get_cwd();
+	model_file = model_file.append("/model.txt");
+
+	svm = svm_load_model(model_file.c_str());
+	if (svm == NULL) {
+	    throw Xapian::InvalidOperationError("No model learnt, and can't load model file " + model_file);
+	}
+    }
+    return svm;
+}
 
-		idx = strtok(NULL, ":");
-		val = strtok(NULL, " \t");
+void
+Letor::Internal::score_mset(const Xapian::Query & query,
+			    const Xapian::MSet & mset,
+			    vector<double> & scores)
+{
+    scores.clear();
+    if (mset.empty())
+	return;
 
-		if (val == NULL)
-		    break;
-		errno = 0;
-		x[i].index = (int)strtol(idx, &endptr, 10);
+    map<string, long int> coll_len;
+    coll_len = collection_length(letor_db);
 
-		if (endptr == idx || errno != 0 || *endptr != '\0' || x[i].index <= inst_max_index)
-		    exit_input_error(total + 1);
-		else
-		    inst_max_index = x[i].index;
+    vector<double> features;
+    calculate_features(letor_db, mset, query, coll_len, features);
+    normalise_features(features);
 
-		errno = 0;
-		x[i].value = strtod(val, &endptr);
-		if (endptr == val || errno != 0 || (*endptr != '\0' && !isspace(*endptr)))
-		    exit_input_error(total+1);
-		++i;
-	    }
+    score_features(get_model(), features, scores);
+}
 
-	    x[i].index = -1;
+/* This method will calculate the score assigned by the Letor function.
+ * It will take MSet as input then convert the documents in feature vectors
+ * then normalize them according to QueryLevelNorm
+ * and after that use the machine learned model (from learn_model(), or
+ * else the file 'model.txt') to assign a score to the document
+ */
+map<Xapian::docid, double>
+Letor::Internal::letor_score(const Xapian::MSet & mset) {
 
-	    predict_label = svm_predict(model, x);	//this is the score for a particular document
+    map<Xapian::docid, double> letor_mset;
 
-	    letor_mset[doc.get_docid()] = predict_label;
+    vector<double> scores;
+    score_mset(letor_query, mset, scores);
 
-	    ++mset_iter;
-	}//while closed
-    }//if closed
+    Xapian::doccount r = 0;
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i, ++r) {
+	letor_mset[*i] = scores[r];
+    }
 
     return letor_mset;
 }
@@ -710,24 +682,31 @@ static void read_problem(const char *filename) {
 	fclose(fp);
 }
 
+// Set libsvm's default parameters, apart from the svm and kernel types.
+static void
+set_default_parameters(struct svm_parameter & p, int s_type, int k_type)
+{
+    p.svm_type = s_type;
+    p.kernel_type = k_type;
+    p.degree = 3;
+    p.gamma = 0;	// 1/num_features
+    p.coef0 = 0;
+    p.nu = 0.5;
+    p.cache_size = 100;
+    p.C = 1;
+    p.eps = 1e-3;
+    p.p = 0.1;
+    p.shrinking = 1;
+    p.probability = 0;
+    p.nr_weight = 0;
+    p.weight_label = NULL;
+    p.weight = NULL;
+}
+
 void
 Letor::Internal::letor_learn_model(int s_type, int k_type) {
     // default values
-    param.svm_type = s_type;
-    param.kernel_type = k_type;
-    param.degree = 3;
-    param.gamma = 0;	// 1/num_features
-    param.coef0 = 0;
-    param.nu = 0.5;
-    param.cache_size = 100;
-    param.C = 1;
-    param.eps = 1e-3;
-    param.p = 0.1;
-    param.shrinking = 1;
-    param.probability = 0;
-    param.nr_weight = 0;
-    param.weight_label = NULL;
-    param.weight = NULL;
+    set_default_parameters(param, s_type, k_type);
     cross_validation = 0;
 
     printf("Learning the model..");
@@ -750,6 +729,8 @@ Letor::Internal::letor_learn_model(int s_type, int k_type) {
 	fprintf(stderr, "can't save model to file %s\n", model_file_name.c_str());
 	exit(1);
     }
+    // Score with the new model from now on.
+    free_model();
 }
 
 
@@ -822,27 +803,6 @@ Letor::Internal::prepare_training_file(const string & queryfile, const string &
     myfile1.open(queryfile.c_str(), ios::in);
 
     while (!myfile1.eof()) {           //reading all the queries line by line from the query file
-	typedef list<double> List1;		//the values of a particular feature for MSet documents will be stored in the list
-	typedef map<int, List1> Map3;	//the above list will be mapped to an integer with its feature id.
-
-	/* So the whole structure will look like below if there are 5 documents in  MSet and 3 features to be calculated
-	 *
-	 * 1  -> 32.12 - 23.12 - 43.23 - 12.12 - 65.23
-	 * 2  -> 31.23 - 21.43 - 33.99 - 65.23 - 22.22
-	 * 3  -> 1.21 - 3.12 - 2.23 - 6.32 - 4.23
-	 *
-	 * And after that we divide the whole list by the maximum value for that feature in all the 5 documents
-	 * So we divide the values of Feature 1 in above case by 65.23 and hence all the values of that features for that query
-	 * will belongs to [0,1] and is known as Query level Norm
-	 */
-	Map3 norm;
-
-	map< int, list<double> >::iterator norm_outer;
-	list<double>::iterator norm_inner;
-
-	typedef list<string> List2;
-	List2 doc_ids;
-
 	getline(myfile1, str1);
 	if (str1.empty()) {
 	    break;
@@ -878,53 +838,19 @@ Letor::Internal::prepare_training_file(const string & queryfile, const string &
 
 	Xapian::MSet mset = enquire.get_mset(0, msetsize);
 
-	Xapian::Letor ltr;
-
-	map<string, long int> coll_tf;
-	coll_tf = collection_termfreq(letor_db, query);
+	vector<double> mset_features;
+	calculate_features(letor_db, mset, query, coll_len, mset_features);
 
-	map<string, double> idf;
-	idf = inverse_doc_freq(letor_db, query);
-
-	int first = 1;    //used as a flag in QueryLevelNorm and module
+	/* Pick out the features of the documents we have relevance judgements
+	 * for, so they can be normalised together.
+	 */
+	vector<double> features;
+	vector<int> relevance;
 
-	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::doccount r = 0;
+	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i, ++r) {
 	    Xapian::Document doc = i.get_document();
 
-	    map<string, long int> tf;
-	    tf = termfreq(doc, query);
-
-	    map<string, long int> doclen;
-	    doclen = doc_length(letor_db, doc);
-
-	    double f[20];
-
-	    f[1] = calculate_f1(query, tf, 't');
-	    f[2] = calculate_f1(query, tf, 'b');
-	    f[3] = calculate_f1(query, tf, 'w');
-
-	    f[4] = calculate_f2(query, tf, doclen, 't');
-	    f[5] = calculate_f2(query, tf, doclen, 'b');
-	    f[6] = calculate_f2(query, tf, doclen, 'w');
-
-	    f[7] = calculate_f3(query, idf, 't');
-	    f[8] = calculate_f3(query, idf, 'b');
-	    f[9] = calculate_f3(query, idf, 'w');
-
-	    f[10] = calculate_f4(query, coll_tf, coll_len, 't');
-	    f[11] = calculate_f4(query, coll_tf, coll_len, 'b');
-	    f[12] = calculate_f4(query, coll_tf, coll_len, 'w');
-
-	    f[13] = calculate_f5(query, tf, idf, doclen, 't');
-	    f[14] = calculate_f5(query, tf, idf, doclen, 'b');
-	    f[15] = calculate_f5(query, tf, idf, doclen, 'w');
-
-	    f[16] = calculate_f6(query, tf, doclen, coll_tf, coll_len, 't');
-	    f[17] = calculate_f6(query, tf, doclen, coll_tf, coll_len, 'b');
-	    f[18] = calculate_f6(query, tf, doclen, coll_tf, coll_len, 'w');
-
-	    f[19] = i.get_weight();
-
 	    string data = doc.get_data();
 
 	    string temp_id = data.substr(data.find("url=", 0), (data.find("sample=", 0) - data.find("url=", 0)));
@@ -939,79 +865,268 @@ Letor::Internal::prepare_training_file(const string & queryfile, const string &
 		    int q1 = innerit->second;
 		    cout << q1 << " Qid:" << qid << " #docid:" << id << "\n";
 
-		    /* This module will make the data structure to store the whole features values for
-		     * all the documents for a particular query along with its relevance judgements
-		     */
-		    if (first == 1) {
-			List1 l;
-			l.push_back((double)q1);
-			norm.insert(pair<int, list<double> >(0, l));
-			doc_ids.push_back(id);
-			for (int j = 1; j < 20; ++j) {
-			    List1 l1;
-			    l1.push_back(f[j]);
-			    norm.insert(pair<int, list<double> >(j, l1));
-			}
-			first = 0;
-		    } else {
-			norm_outer = norm.begin();
-			norm_outer->second.push_back(q1);
-			++norm_outer;
-			doc_ids.push_back(id);
-			int k = 1;
-			for (; norm_outer != norm.end(); ++norm_outer) {
-			    norm_outer->second.push_back(f[k]);
-			    ++k;
-			}
-		    }
+		    relevance.push_back(q1);
+		    features.insert(features.end(),
+				    mset_features.begin() + r * NUM_FEATURES,
+				    mset_features.begin() + (r + 1) * NUM_FEATURES);
 		}
 	    }
 
 	}//for closed
 
-	/* this is the place where we have to normalize the norm and after that store it in the file. */
+	/* this is the place where we have to normalize the features and after that store them in the file. */
 
-	if (norm.empty())
-	    continue;
+	normalise_features(features);
 
-	norm_outer = norm.begin();
-	++norm_outer;
-	int k = 0;
-	for (; norm_outer != norm.end(); ++norm_outer) {
-	    k = 0;
-	    double max = norm_outer->second.front();
-	    for (norm_inner = norm_outer->second.begin(); norm_inner != norm_outer->second.end(); ++norm_inner) {
-		if (*norm_inner > max)
-		    max = *norm_inner;
-	    }
-	    for (norm_inner = norm_outer->second.begin(); norm_inner != norm_outer->second.end(); ++norm_inner) {
-		if (max != 0)
-		    *norm_inner /= max;
-		++k;
-	    }
-	}
-
-	for (int i = 0; i < k; ++i) {
-	    int j = 0;
-	    norm_outer = norm.begin();
-	    train_file << norm_outer->second.front();
-	    norm_outer->second.pop_front();
-	    ++norm_outer;
-	    ++j;
+	for (size_t k = 0; k != relevance.size(); ++k) {
+	    train_file << relevance[k];
 //Uncomment the line below if you want 'Qid' in the training file
 //          train_file << " qid:" << qid;
-	    for (; norm_outer != norm.end(); ++norm_outer) {
-		train_file << " " << j << ":" << norm_outer->second.front();
-		norm_outer->second.pop_front();
-		++j;
+	    for (int j = 0; j != NUM_FEATURES; ++j) {
+		train_file << " " << j + 1 << ":" << features[k * NUM_FEATURES + j];
 	    }
-//Uncomment the line below if you want 'DocID' in the training file
-//          train_file << " #docid:" << doc_ids.front();
 	    train_file << "\n";
-	    doc_ids.pop_front();
 	}
 
     }//while closed
     myfile1.close();
     train_file.close();
 }
+
+void
+Letor::Internal::training_rows(const Xapian::Database & db,
+			       const Xapian::Query & query,
+			       const map<Xapian::docid, int> & qrel,
+			       Xapian::doccount msetsize,
+			       map<string, long int> & coll_len,
+			       vector<double> & features,
+			       vector<double> & labels)
+{
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query);
+    Xapian::MSet mset = enquire.get_mset(0, msetsize);
+
+    vector<double> mset_features;
+    calculate_features(db, mset, query, coll_len, mset_features);
+
+    // Pick out the documents we have relevance judgements for, and normalise
+    // their features together, as prepare_training_file() does.
+    vector<double> rows;
+    Xapian::doccount r = 0;
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i, ++r) {
+	map<Xapian::docid, int>::const_iterator j = qrel.find(*i);
+	if (j == qrel.end()) continue;
+	labels.push_back(j->second);
+	rows.insert(rows.end(),
+		    mset_features.begin() + r * NUM_FEATURES,
+		    mset_features.begin() + (r + 1) * NUM_FEATURES);
+    }
+    normalise_features(rows);
+    features.insert(features.end(), rows.begin(), rows.end());
+}
+
+/* The work for one thread of prepare_training_data().  Thread t handles
+ * queries t, t + threads, t + 2 * threads, ... and stores the rows for each
+ * query separately, so the result doesn't depend on how the work is split.
+ */
+struct TrainingJob {
+    Letor::Internal * letor;
+
+    /// A Database object for this thread's use only.
+    Xapian::Database db;
+
+    const vector<Xapian::Query> * queries;
+
+    /** The queries in serialised form, or NULL to use @ queries directly.
+     *
+     *  Copying a Query object isn't thread-safe (its reference counts aren't
+     *  atomic), so if we're using several threads each unserialises its own
+     *  Query objects from these.
+     */
+    const vector<string> * serialised_queries;
+
+    const vector<map<Xapian::docid, int> > * qrels;
+
+    Xapian::doccount msetsize;
+
+    /// This thread's copy of the collection lengths.
+    map<string, long int> coll_len;
+
+    unsigned first, step;
+
+    vector<vector<double> > * features;
+
+    vector<vector<double> > * labels;
+
+    /// Description of the error for each query which failed.
+    vector<string> * errors;
+};
+
+static void
+run_training_job(TrainingJob & job)
+{
+    for (size_t i = job.first; i < job.queries->size(); i += job.step) {
+	// Any exception is recorded and then reported by the calling thread,
+	// since one mustn't escape from a thread.
+	try {
+	    Xapian::Query query;
+	    if (job.serialised_queries) {
+		query = Xapian::Query::unserialise((*job.serialised_queries)[i]);
+	    } else {
+		query = (*job.queries)[i];
+	    }
+	    job.letor->training_rows(job.db, query,
+				     (*job.qrels)[i], job.msetsize,
+				     job.coll_len,
+				     (*job.features)[i], (*job.labels)[i]);
+	} catch (const Xapian::Error & e) {
+	    (*job.errors)[i] = e.get_description();
+	} catch (const std::exception & e) {
+	    (*job.errors)[i] = e.what();
+	} catch (...) {
+	    (*job.errors)[i] = "Unknown exception";
+	}
+    }
+}
+
+#ifdef HAVE_PTHREAD_H
+extern "C" {
+static void *
+training_thread(void * arg)
+{
+    run_training_job(*static_cast<TrainingJob *>(arg));
+    return NULL;
+}
+}
+#endif
+
+void
+Letor::Internal::prepare_training_data(const vector<Xapian::Query> & queries,
+				       const vector<map<Xapian::docid, int> > & qrels,
+				       Xapian::doccount msetsize,
+				       unsigned threads)
+{
+    if (queries.size() != qrels.size())
+	throw Xapian::InvalidArgumentError("Need relevance judgements for each query");
+
+#ifndef HAVE_PTHREAD_H
+    threads = 1;
+#endif
+    if (threads > queries.size()) threads = queries.size();
+    if (threads == 0) threads = 1;
+
+    vector<string> serialised_queries;
+    if (threads > 1) {
+	try {
+	    serialised_queries.reserve(queries.size());
+	    for (size_t i = 0; i != queries.size(); ++i)
+		serialised_queries.push_back(queries[i].serialise());
+	} catch (const Xapian::UnimplementedError &) {
+	    // A query uses a PostingSource which can't be serialised, so we
+	    // can't give each thread its own copy of the queries.
+	    threads = 1;
+	}
+    }
+
+    vector<vector<double> > features(queries.size());
+    vector<vector<double> > labels(queries.size());
+    vector<string> errors(queries.size());
+
+    map<string, long int> coll_len;
+    coll_len = collection_length(letor_db);
+
+    vector<TrainingJob> jobs(threads);
+    for (unsigned t = 0; t != threads; ++t) {
+	TrainingJob & job = jobs[t];
+	job.letor = this;
+	// Database objects can't be shared between threads.
+	job.db = (threads == 1) ? letor_db : letor_db.clone_for_thread();
+	job.queries = &queries;
+	job.serialised_queries = (threads == 1) ? NULL : &serialised_queries;
+	job.qrels = &qrels;
+	job.msetsize = msetsize;
+	job.coll_len = coll_len;
+	job.first = t;
+	job.step = threads;
+	job.features = &features;
+	job.labels = &labels;
+	job.errors = &errors;
+    }
+
+#ifdef HAVE_PTHREAD_H
+    if (threads > 1) {
+	vector<pthread_t> tids(threads);
+	vector<bool> started(threads);
+	for (unsigned t = 0; t != threads; ++t) {
+	    started[t] = (pthread_create(&tids[t], NULL, training_thread,
+					 &jobs[t]) == 0);
+	    // If we can't start a thread, just do its share of the work here.
+	    if (!started[t]) run_training_job(jobs[t]);
+	}
+	for (unsigned t = 0; t != threads; ++t) {
+	    if (started[t]) pthread_join(tids[t], NULL);
+	}
+    } else
+#endif
+    {
+	run_training_job(jobs[0]);
+    }
+
+    for (size_t i = 0; i != queries.size(); ++i) {
+	if (!errors[i].empty()) {
+	    throw Xapian::DatabaseError("Preparing training data for query " +
+					str(i) + " failed: " + errors[i]);
+	}
+    }
+
+    train_features.clear();
+    train_labels.clear();
+    for (size_t i = 0; i != queries.size(); ++i) {
+	train_features.insert(train_features.end(),
+			      features[i].begin(), features[i].end());
+	train_labels.insert(train_labels.end(),
+			    labels[i].begin(), labels[i].end());
+    }
+}
+
+void
+Letor::Internal::learn_model(int s_type, int k_type)
+{
+    size_t rows = train_labels.size();
+    if (rows == 0) {
+	throw Xapian::InvalidOperationError("No training data - call prepare_training_data() first");
+    }
+
+    struct svm_parameter parameters;
+    set_default_parameters(parameters, s_type, k_type);
+    parameters.gamma = 1.0 / NUM_FEATURES;
+
+    // The previous model may point into train_nodes, so free it first.
+    free_model();
+    train_nodes.resize(rows * (NUM_FEATURES + 1));
+    train_x.resize(rows);
+    struct svm_node * node = &train_nodes[0];
+    for (size_t r = 0; r != rows; ++r) {
+	train_x[r] = node;
+	for (int j = 0; j != NUM_FEATURES; ++j) {
+	    node->index = j + 1;
+	    node->value = train_features[r * NUM_FEATURES + j];
+	    ++node;
+	}
+	node->index = -1;
+	++node;
+    }
+
+    struct svm_problem problem;
+    problem.l = int(rows);
+    problem.y = &train_labels[0];
+    problem.x = &train_x[0];
+
+    const char * error_msg = svm_check_parameter(&problem, &parameters);
+    if (error_msg) {
+	throw Xapian::InvalidArgumentError(string("Bad SVM parameters: ") +
+					   error_msg);
+    }
+
+    svm = svm_train(&problem, &parameters);
+}
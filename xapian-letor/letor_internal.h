@@ -25,9 +25,15 @@
 #include <xapian/letor.h>
 
 #include <map>
+#include <vector>
+
+#include <libsvm/svm.h>
 
 using namespace std;
 
+/// The number of features calculated for each document.
+#define NUM_FEATURES 19
+
 namespace Xapian {
 
 class Letor::Internal : public Xapian::Internal::intrusive_base {
@@ -35,7 +41,45 @@ class Letor::Internal : public Xapian::Internal::intrusive_base {
     Database letor_db;
     Query letor_query;
 
+    /** The model used to score documents.
+     *
+     *  This is NULL until a model has been trained with learn_model() or
+     *  loaded from 'model.txt'.
+     */
+    struct svm_model * svm;
+
+    /// Feature matrix of the training data from prepare_training_data().
+    vector<double> train_features;
+
+    /// Relevance label for each row of train_features.
+    vector<double> train_labels;
+
+    /** The training data in libsvm's format.
+     *
+     *  A model trained by libsvm points into this, so it must be kept
+     *  until the model is freed.
+     */
+    vector<struct svm_node> train_nodes;
+
+    /// Pointer to the start of each row in train_nodes.
+    vector<struct svm_node *> train_x;
+
+    /// Don't allow copying.
+    Internal(const Internal &);
+
+    /// Don't allow assignment.
+    void operator=(const Internal &);
+
+    /// Free the current model, if any.
+    void free_model();
+
+    /// Return the current model, loading it from 'model.txt' if necessary.
+    const struct svm_model * get_model();
+
   public:
+    Internal() : svm(NULL) { }
+
+    ~Internal() { free_model(); }
 
     map<string, long int> termfreq(const Xapian::Document & doc, const Xapian::Query & query);
 
@@ -59,12 +103,36 @@ class Letor::Internal : public Xapian::Internal::intrusive_base {
 
     double calculate_f6(const Xapian::Query & query, map<string, long int> & tf, map<string, long int> & doc_length, map<string, long int> & coll_tf, map<string, long int> & coll_length, char ch);
 
+    /** Calculate all the features for every document in @a mset.
+     *
+     *  The features are returned in @a features as a dense matrix with
+     *  NUM_FEATURES values for each document, in MSet order.  Only @a db
+     *  is used to look up statistics, so this can be called from several
+     *  threads at once, each with its own Database object.
+     */
+    void calculate_features(const Xapian::Database & db, const Xapian::MSet & mset, const Xapian::Query & query, map<string, long int> & coll_len, vector<double> & features);
+
+    /** Calculate the features for the judged documents in the top
+     *  @a msetsize results for @a query.
+     *
+     *  The normalised features are appended to @a features, and the
+     *  relevance judgement for each row to @a labels.
+     */
+    void training_rows(const Xapian::Database & db, const Xapian::Query & query, const map<Xapian::docid, int> & qrel, Xapian::doccount msetsize, map<string, long int> & coll_len, vector<double> & features, vector<double> & labels);
+
+    /// Score each document in @a mset with the model, in MSet order.
+    void score_mset(const Xapian::Query & query, const Xapian::MSet & mset, vector<double> & scores);
+
     map<Xapian::docid, double> letor_score(const Xapian::MSet & mset);
 
     void letor_learn_model(int svm_type, int kernel_type);
 
     void prepare_training_file(const std::string & query_file, const std::string & qrel_file, Xapian::doccount msetsize);
 
+    void prepare_training_data(const vector<Xapian::Query> & queries, const vector<map<Xapian::docid, int> > & qrels, Xapian::doccount msetsize, unsigned threads);
+
+    void learn_model(int svm_type, int kernel_type);
+
 };
 
 }
@@ -0,0 +1,159 @@
+/* featuretest.cc: check the features calculated for a whole MSet at once
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include <xapian.h>
+
+#include "letor_internal.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The documents to index.  Words starting with '!' are indexed with the title
+// prefix "S".
+static const char * docs[] = {
+    "!alpha !gamma alpha beta beta delta",
+    "!beta alpha alpha alpha epsilon",
+    "gamma delta delta beta",
+    "!alpha !alpha !delta beta gamma gamma gamma",
+    "alpha",
+    "!epsilon epsilon epsilon beta alpha gamma delta",
+    "beta beta beta beta",
+    NULL
+};
+
+static Xapian::Database
+build_database()
+{
+    Xapian::WritableDatabase db = Xapian::InMemory::open();
+    for (const char ** d = docs; *d; ++d) {
+	Xapian::Document doc;
+	const char * p = *d;
+	Xapian::termpos pos = 0;
+	while (*p) {
+	    const char * q = p;
+	    while (*q && *q != ' ') ++q;
+	    string term;
+	    if (*p == '!') {
+		term = "S";
+		++p;
+	    }
+	    term.append(p, q - p);
+	    doc.add_posting(term, ++pos);
+	    p = *q ? q + 1 : q;
+	}
+	db.add_document(doc);
+    }
+    db.commit();
+    return db;
+}
+
+static bool
+check_query(Xapian::Letor::Internal & letor, const Xapian::Database & db,
+	    const Xapian::Query & query)
+{
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    if (mset.empty()) {
+	cerr << query.get_description() << " matched no documents" << endl;
+	return false;
+    }
+
+    map<string, long int> coll_len = letor.collection_length(db);
+    vector<double> features;
+    letor.calculate_features(db, mset, query, coll_len, features);
+    if (features.size() != mset.size() * NUM_FEATURES) {
+	cerr << query.get_description() << ": " << features.size()
+	     << " features calculated for " << mset.size() << " documents"
+	     << endl;
+	return false;
+    }
+
+    map<string, double> idf = letor.inverse_doc_freq(db, query);
+    map<string, long int> coll_tf = letor.collection_termfreq(db, query);
+
+    bool ok = true;
+    size_t r = 0;
+    for (Xapian::MSetIterator m = mset.begin(); m != mset.end(); ++m, ++r) {
+	Xapian::Document doc = m.get_document();
+	map<string, long int> tf = letor.termfreq(doc, query);
+	map<string, long int> doclen = letor.doc_length(db, doc);
+
+	// Calculate the features one at a time, numbered from 1 as in the
+	// documentation.
+	double f[NUM_FEATURES + 1];
+	static const char parts[3] = { 't', 'b', 'w' };
+	for (int k = 0; k != 3; ++k) {
+	    char ch = parts[k];
+	    f[1 + k] = letor.calculate_f1(query, tf, ch);
+	    f[4 + k] = letor.calculate_f2(query, tf, doclen, ch);
+	    f[7 + k] = letor.calculate_f3(query, idf, ch);
+	    f[10 + k] = letor.calculate_f4(query, coll_tf, coll_len, ch);
+	    f[13 + k] = letor.calculate_f5(query, tf, idf, doclen, ch);
+	    f[16 + k] = letor.calculate_f6(query, tf, doclen, coll_tf, coll_len,
+					   ch);
+	}
+	f[19] = m.get_weight();
+
+	for (int j = 1; j <= NUM_FEATURES; ++j) {
+	    double batched = features[r * NUM_FEATURES + j - 1];
+	    if (fabs(batched - f[j]) > 1e-9 * (1 + fabs(f[j]))) {
+		cerr << query.get_description() << ": document " << *m
+		     << " feature " << j << " is " << batched
+		     << " but should be " << f[j] << endl;
+		ok = false;
+	    }
+	}
+    }
+    return ok;
+}
+
+int
+main()
+try {
+    Xapian::Database db = build_database();
+    Xapian::Letor::Internal letor;
+
+    // Include a repeated term, a title term, and a term which doesn't occur,
+    // as these are all handled specially.
+    vector<Xapian::Query> queries;
+    queries.push_back(Xapian::Query("alpha"));
+    queries.push_back(Xapian::Query("Salpha"));
+    const char * terms[] = { "alpha", "Sbeta", "gamma", "nosuchterm", "alpha" };
+    queries.push_back(Xapian::Query(Xapian::Query::OP_OR, terms, terms + 5));
+    const char * terms2[] = { "beta", "delta", "Sdelta", "epsilon" };
+    queries.push_back(Xapian::Query(Xapian::Query::OP_OR, terms2, terms2 + 4));
+
+    bool ok = true;
+    for (size_t i = 0; i != queries.size(); ++i) {
+	if (!check_query(letor, db, queries[i])) ok = false;
+    }
+    return ok ? 0 : 1;
+} catch (const Xapian::Error & e) {
+    cerr << "Exception: " << e.get_description() << endl;
+    return 1;
+}